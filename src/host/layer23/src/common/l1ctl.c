@@ -711,6 +711,21 @@ int l1ctl_tx_sim_req(struct osmocom_ms *ms, uint8_t *data, uint16_t length)
 	return osmo_send_l1(ms, msg);
 }
 
+/* Receive L1CTL_ECHO_REQ (sent by virtphy's fake BTS after each frame),
+ * echo its payload back once all the preceding messages were handled */
+static int rx_l1_echo_req(struct osmocom_ms *ms, struct msgb *msg)
+{
+	struct msgb *nmsg;
+
+	nmsg = osmo_l1_alloc(L1CTL_ECHO_CONF);
+	if (!nmsg)
+		return -1;
+
+	memcpy(msgb_put(nmsg, msgb_l1len(msg)), msg->l1h, msgb_l1len(msg));
+
+	return osmo_send_l1(ms, nmsg);
+}
+
 /* just forward the SIM response to the SIM handler */
 static int rx_l1_sim_conf(struct osmocom_ms *ms, struct msgb *msg)
 {
@@ -1210,6 +1225,10 @@ int l1ctl_recv(struct osmocom_ms *ms, struct msgb *msg)
 	case L1CTL_GPRS_RTS_IND:
 		rc = rx_l1_gprs_rts_ind(ms, msg);
 		break;
+	case L1CTL_ECHO_REQ:
+		rc = rx_l1_echo_req(ms, msg);
+		msgb_free(msg);
+		break;
 	default:
 		LOGP(DL1C, LOGL_ERROR, "Unknown MSG: %u\n", hdr->msg_type);
 		msgb_free(msg);
@@ -0,0 +1,39 @@
+#pragma once
+
+/* Helpers shared by the micro-benchmarks run by 'make check-bench'.
+ * Each result is printed as a single JSON object per line (JSON Lines),
+ * so that the results of different versions can be collected and compared:
+ *
+ *   {"suite":"l1sched","name":"rx_burst/TCH/F","version":"0.7.0.123-abcd",
+ *    "ops":51000,"ns_total":1234567,"ns_per_op":24.21}
+ *
+ * (printed on a single line).  Anything else goes to stderr.  The version
+ * is the one given by git-version-gen (i.e. 'git describe') at configure
+ * time. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+
+#ifndef PACKAGE_VERSION
+#define PACKAGE_VERSION "unknown"
+#endif
+
+static inline uint64_t bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void bench_report(const char *suite, const char *name,
+				unsigned long ops, uint64_t ns_total)
+{
+	printf("{\"suite\":\"%s\",\"name\":\"%s\",\"version\":\"%s\","
+	       "\"ops\":%lu,\"ns_total\":%" PRIu64 ",\"ns_per_op\":%.2f}\n",
+	       suite, name, PACKAGE_VERSION, ops, ns_total,
+	       ops ? (double)ns_total / ops : 0.0);
+	fflush(stdout);
+}
@@ -0,0 +1,229 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * L1CTL encoding micro-benchmark (see bench.h for the output format)
+ *
+ * Measures the cost of composing the L1CTL messages sent for every
+ * decoded block or transmitted burst (DATA.ind, TRAFFIC.ind, DATA.conf,
+ * RACH.conf), as well as PM.conf.  The messages are dropped right away.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+
+#include <osmocom/codec/codec.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+
+#include <osmocom/bb/trxcon/trxcon.h>
+#include <osmocom/bb/trxcon/trxcon_fsm.h>
+#include <osmocom/bb/trxcon/phyif.h>
+#include <osmocom/bb/trxcon/l1ctl.h>
+#include <osmocom/bb/trxcon/logging.h>
+
+#include "bench.h"
+
+/* Number of messages to compose per benchmark */
+#define NUM_MSGS_DEF		1000000
+
+static unsigned long num_bytes;
+
+static const int bench_log_cfg[] = {
+	[TRXCON_LOGC_FSM] = DAPP,
+	[TRXCON_LOGC_L1C] = DL1C,
+	[TRXCON_LOGC_L1D] = DL1D,
+	[TRXCON_LOGC_SCHC] = DSCH,
+	[TRXCON_LOGC_SCHD] = DSCHD,
+	[TRXCON_LOGC_GPRS] = DGPRS,
+};
+
+static const struct log_info_cat bench_log_info_cat[] = {
+	[DAPP] = {
+		.name = "DAPP",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DL1C] = {
+		.name = "DL1C",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DL1D] = {
+		.name = "DL1D",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DTRXC] = {
+		.name = "DTRXC",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DTRXD] = {
+		.name = "DTRXD",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DSCH] = {
+		.name = "DSCH",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DSCHD] = {
+		.name = "DSCHD",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DGPRS] = {
+		.name = "DGPRS",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+};
+
+static const struct log_info bench_log_info = {
+	.cat = bench_log_info_cat,
+	.num_cat = ARRAY_SIZE(bench_log_info_cat),
+};
+
+/* trxcon -> L2/PHY API (normally implemented by trxcon_main.c) */
+
+int trxcon_l1ctl_send(struct trxcon_inst *trxcon, struct msgb *msg)
+{
+	num_bytes += msgb_length(msg);
+	msgb_free(msg);
+	return 0;
+}
+
+void trxcon_l1ctl_close(struct trxcon_inst *trxcon)
+{
+}
+
+int trxcon_phyif_handle_burst_req(void *phyif, const struct trxcon_phyif_burst_req *br)
+{
+	return 0;
+}
+
+int trxcon_phyif_handle_cmd(void *phyif, const struct trxcon_phyif_cmd *cmd)
+{
+	return 0;
+}
+
+void trxcon_phyif_close(void *phyif)
+{
+}
+
+enum bench_msg {
+	BENCH_DATA_IND,
+	BENCH_TRAFFIC_IND,
+	BENCH_DATA_CONF,
+	BENCH_RACH_CONF,
+	BENCH_PM_CONF,
+};
+
+static const char * const bench_msg_names[] = {
+	[BENCH_DATA_IND] = "l1ctl_tx/DATA_IND",
+	[BENCH_TRAFFIC_IND] = "l1ctl_tx/TRAFFIC_IND",
+	[BENCH_DATA_CONF] = "l1ctl_tx/DATA_CONF",
+	[BENCH_RACH_CONF] = "l1ctl_tx/RACH_CONF",
+	[BENCH_PM_CONF] = "l1ctl_tx/PM_CONF",
+};
+
+static void bench_tx(struct trxcon_inst *trxcon, enum bench_msg type, unsigned int num)
+{
+	static const uint8_t data[GSM_MACBLOCK_LEN + 10] = { 0x01, 0x03, 0x01 };
+	uint64_t t0, t1;
+	unsigned int i;
+
+	num_bytes = 0;
+
+	t0 = bench_now_ns();
+	for (i = 0; i < num; i++) {
+		const uint32_t fn = i % GSM_TDMA_HYPERFRAME;
+
+		switch (type) {
+		case BENCH_DATA_IND:
+		case BENCH_TRAFFIC_IND:
+		{
+			const bool traffic = type == BENCH_TRAFFIC_IND;
+			const struct trxcon_param_rx_data_ind ind = {
+				.traffic = traffic,
+				.chan_nr = traffic ? RSL_CHAN_Bm_ACCHs | 2 : RSL_CHAN_SDCCH8_ACCH | 1,
+				.band_arfcn = 871,
+				.frame_nr = fn,
+				.rssi = -60,
+				.n_errors = 3,
+				.n_bits_total = 456,
+				.data_len = traffic ? GSM_FR_BYTES : GSM_MACBLOCK_LEN,
+				.data = &data[0],
+			};
+
+			l1ctl_tx_dt_ind(trxcon, &ind);
+			break;
+		}
+		case BENCH_DATA_CONF:
+		{
+			const struct trxcon_param_tx_data_cnf cnf = {
+				.chan_nr = RSL_CHAN_SDCCH8_ACCH | 1,
+				.band_arfcn = 871,
+				.frame_nr = fn,
+			};
+
+			l1ctl_tx_dt_conf(trxcon, &cnf);
+			break;
+		}
+		case BENCH_RACH_CONF:
+		{
+			const struct trxcon_param_tx_access_burst_cnf cnf = {
+				.band_arfcn = 871,
+				.frame_nr = fn,
+			};
+
+			l1ctl_tx_rach_conf(trxcon, &cnf);
+			break;
+		}
+		case BENCH_PM_CONF:
+			l1ctl_tx_pm_conf(trxcon, i % 1024, -60 - (i % 50), 0);
+			break;
+		}
+	}
+	t1 = bench_now_ns();
+
+	bench_report("l1ctl", bench_msg_names[type], num, t1 - t0);
+	fprintf(stderr, "%s: %lu bytes\n", bench_msg_names[type], num_bytes);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int num_msgs = NUM_MSGS_DEF;
+	struct trxcon_inst *trxcon;
+	void *tall_ctx;
+	unsigned int i;
+
+	if (argc > 1)
+		num_msgs = atoi(argv[1]);
+
+	tall_ctx = talloc_named_const(NULL, 1, "l1ctl_enc_bench");
+	msgb_talloc_ctx_init(tall_ctx, 0);
+	osmo_init_logging2(tall_ctx, &bench_log_info);
+	trxcon_set_log_cfg(&bench_log_cfg[0], ARRAY_SIZE(bench_log_cfg));
+
+	trxcon = trxcon_inst_alloc(tall_ctx, 0);
+	OSMO_ASSERT(trxcon != NULL);
+
+	for (i = 0; i < ARRAY_SIZE(bench_msg_names); i++)
+		bench_tx(trxcon, i, num_msgs);
+
+	trxcon_inst_free(trxcon);
+
+	return 0;
+}
@@ -0,0 +1,373 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * L1CTL server throughput benchmark (see bench.h for the output format)
+ *
+ * One end of a socketpair is handed over to the L1CTL server as a client
+ * connection, the other end acts as the L2 peer.  Messages are pushed in
+ * both directions and verified, the throughput is compared against naive
+ * framing with one read()/write() per length field and payload.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <sys/socket.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+
+#include <osmocom/bb/trxcon/logging.h>
+#include <osmocom/bb/trxcon/l1ctl_server.h>
+
+#include "bench.h"
+
+/* Size of a chunk written by the peer, deliberately not aligned to frames */
+#define PEER_CHUNK_SIZE		1021
+
+static struct {
+	unsigned int num_msgs;
+	unsigned int msg_len;
+	unsigned int batch;
+} app = {
+	.num_msgs = 1000000,
+	.msg_len = 40, /* ~ L1CTL_DATA_IND */
+	.batch = 32,
+};
+
+static const struct log_info_cat bench_log_info_cat[] = {
+	[DL1C] = {
+		.name = "DL1C",
+		.enabled = 1, .loglevel = LOGL_ERROR,
+	},
+	[DL1D] = {
+		.name = "DL1D",
+		.enabled = 1, .loglevel = LOGL_ERROR,
+	},
+};
+
+static const struct log_info bench_log_info = {
+	.cat = bench_log_info_cat,
+	.num_cat = ARRAY_SIZE(bench_log_info_cat),
+};
+
+/* Uplink messages received by the server */
+static unsigned int num_rx;
+
+static void print_result(const char *name, unsigned int num, uint64_t duration_ns)
+{
+	const double sec = (double)duration_ns / 1e9;
+
+	bench_report("l1ctl_server", name, num, duration_ns);
+	fprintf(stderr, "%s: %.1f MB/s\n", name,
+		(double)num * (L1CTL_MSG_LEN_FIELD + app.msg_len) / sec / 1e6);
+}
+
+/* Each message carries its sequence number, the rest is padding */
+static void fill_msg(uint8_t *buf, uint32_t seq)
+{
+	memset(buf, seq & 0xff, app.msg_len);
+	osmo_store32be(seq, buf);
+}
+
+static void check_msg(const uint8_t *buf, unsigned int len, uint32_t seq)
+{
+	if (len != app.msg_len || osmo_load32be(buf) != seq) {
+		fprintf(stderr, "Message #%u is corrupted (len=%u)\n", seq, len);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static int bench_conn_read_cb(struct l1ctl_client *client, struct msgb *msg)
+{
+	check_msg(msgb_l1(msg), msgb_l1len(msg), num_rx++);
+	msgb_free(msg);
+	return 0;
+}
+
+/* Receive and verify all pending frames on the peer side */
+static unsigned int peer_recv(int fd, uint8_t *buf, size_t *buf_len, uint32_t *seq)
+{
+	unsigned int num = 0;
+	ssize_t rc;
+
+	while ((rc = read(fd, &buf[*buf_len], L1CTL_RX_BUF_SIZE - *buf_len)) > 0) {
+		size_t offset = 0;
+
+		*buf_len += rc;
+
+		while (*buf_len - offset >= L1CTL_MSG_LEN_FIELD) {
+			uint16_t len = osmo_load16be(&buf[offset]);
+
+			if (*buf_len - offset < L1CTL_MSG_LEN_FIELD + len)
+				break;
+			check_msg(&buf[offset + L1CTL_MSG_LEN_FIELD], len, (*seq)++);
+			offset += L1CTL_MSG_LEN_FIELD + len;
+			num++;
+		}
+
+		*buf_len -= offset;
+		memmove(&buf[0], &buf[offset], *buf_len);
+	}
+
+	return num;
+}
+
+/* Downlink: l1ctl_client_send() -> peer */
+static uint64_t bench_dl(struct l1ctl_client *client, int peer_fd)
+{
+	uint8_t buf[L1CTL_RX_BUF_SIZE];
+	unsigned int num_tx = 0, num_peer = 0;
+	uint32_t seq = 0;
+	size_t buf_len = 0;
+	uint64_t t0 = bench_now_ns();
+
+	while (num_peer < app.num_msgs) {
+		unsigned int i;
+
+		/* Messages generated within one iteration of the main loop */
+		for (i = 0; i < app.batch && num_tx < app.num_msgs; i++) {
+			struct msgb *msg;
+
+			if (client->tx_queue_len >= L1CTL_TX_QUEUE_MAX)
+				break;
+			msg = msgb_alloc_headroom(L1CTL_LENGTH + L1CTL_HEADROOM,
+						  L1CTL_HEADROOM, "bench_dl");
+			OSMO_ASSERT(msg != NULL);
+			msg->l1h = msgb_put(msg, app.msg_len);
+			fill_msg(msg->l1h, num_tx++);
+			OSMO_ASSERT(l1ctl_client_send(client, msg) == 0);
+		}
+
+		osmo_select_main(1);
+		num_peer += peer_recv(peer_fd, buf, &buf_len, &seq);
+	}
+
+	return bench_now_ns() - t0;
+}
+
+/* Downlink baseline: one (blocking) write() per message */
+static uint64_t bench_dl_naive(int fd, int peer_fd)
+{
+	uint8_t msg[L1CTL_MSG_LEN_FIELD + L1CTL_LENGTH];
+	uint8_t buf[L1CTL_RX_BUF_SIZE];
+	unsigned int num_tx = 0, num_peer = 0;
+	uint32_t seq = 0;
+	size_t buf_len = 0;
+	uint64_t t0 = bench_now_ns();
+
+	while (num_peer < app.num_msgs) {
+		unsigned int i;
+
+		for (i = 0; i < app.batch && num_tx < app.num_msgs; i++) {
+			osmo_store16be(app.msg_len, &msg[0]);
+			fill_msg(&msg[L1CTL_MSG_LEN_FIELD], num_tx++);
+			OSMO_ASSERT(write(fd, msg, L1CTL_MSG_LEN_FIELD + app.msg_len) > 0);
+		}
+
+		num_peer += peer_recv(peer_fd, buf, &buf_len, &seq);
+	}
+
+	return bench_now_ns() - t0;
+}
+
+/* Build the Uplink stream: all frames back to back */
+static uint8_t *build_ul_stream(size_t *len)
+{
+	const size_t frame_len = L1CTL_MSG_LEN_FIELD + app.msg_len;
+	uint8_t *buf;
+	unsigned int i;
+
+	buf = malloc(frame_len * app.num_msgs);
+	OSMO_ASSERT(buf != NULL);
+
+	for (i = 0; i < app.num_msgs; i++) {
+		osmo_store16be(app.msg_len, &buf[i * frame_len]);
+		fill_msg(&buf[i * frame_len + L1CTL_MSG_LEN_FIELD], i);
+	}
+
+	*len = frame_len * app.num_msgs;
+	return buf;
+}
+
+/* Uplink: peer -> conn_read_cb(), frames are split across reads */
+static uint64_t bench_ul(int peer_fd, const uint8_t *stream, size_t len)
+{
+	size_t offset = 0;
+	uint64_t t0 = bench_now_ns();
+	ssize_t rc;
+
+	num_rx = 0;
+
+	while (num_rx < app.num_msgs) {
+		while (offset < len) {
+			rc = write(peer_fd, &stream[offset], OSMO_MIN(len - offset, PEER_CHUNK_SIZE));
+			if (rc <= 0)
+				break; /* EAGAIN, let the server catch up */
+			offset += rc;
+		}
+
+		osmo_select_main(1);
+	}
+
+	return bench_now_ns() - t0;
+}
+
+/* Uplink baseline: read() of the length field, then read() of the payload */
+static uint64_t bench_ul_naive(int fd, int peer_fd, const uint8_t *stream, size_t len)
+{
+	uint8_t msg[L1CTL_MSG_LEN_FIELD + L1CTL_LENGTH];
+	unsigned int num = 0;
+	size_t offset = 0;
+	uint64_t t0 = bench_now_ns();
+	uint16_t msg_len;
+	ssize_t rc;
+
+	while (num < app.num_msgs) {
+		if (offset < len) {
+			rc = write(peer_fd, &stream[offset], OSMO_MIN(len - offset, PEER_CHUNK_SIZE));
+			if (rc > 0)
+				offset += rc;
+		}
+
+		while (num < app.num_msgs) {
+			/* Wait for complete frames, so that both read() calls succeed */
+			rc = recv(fd, msg, L1CTL_MSG_LEN_FIELD, MSG_PEEK | MSG_DONTWAIT);
+			if (rc != L1CTL_MSG_LEN_FIELD)
+				break;
+			msg_len = osmo_load16be(&msg[0]);
+			rc = recv(fd, msg, L1CTL_MSG_LEN_FIELD + msg_len, MSG_PEEK | MSG_DONTWAIT);
+			if (rc != L1CTL_MSG_LEN_FIELD + msg_len)
+				break;
+			OSMO_ASSERT(read(fd, msg, L1CTL_MSG_LEN_FIELD) == L1CTL_MSG_LEN_FIELD);
+			OSMO_ASSERT(read(fd, msg, msg_len) == msg_len);
+			check_msg(msg, app.msg_len, num++);
+		}
+	}
+
+	return bench_now_ns() - t0;
+}
+
+static void print_help(const char *app_name)
+{
+	printf("Usage: %s [options]\n", app_name);
+	printf("  -h --help         this text\n");
+	printf("  -n --num-msgs     Number of messages per direction (default %u)\n", app.num_msgs);
+	printf("  -l --msg-len      L1CTL message length (default %u)\n", app.msg_len);
+	printf("  -b --batch        Downlink messages per main loop iteration (default %u)\n", app.batch);
+	printf("                    (must fit into the socket buffer at once)\n");
+}
+
+static void handle_options(int argc, char **argv)
+{
+	while (1) {
+		int option_index = 0, c;
+		static struct option long_options[] = {
+			{"help", 0, 0, 'h'},
+			{"num-msgs", 1, 0, 'n'},
+			{"msg-len", 1, 0, 'l'},
+			{"batch", 1, 0, 'b'},
+			{0, 0, 0, 0}
+		};
+
+		c = getopt_long(argc, argv, "n:l:b:h", long_options, &option_index);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'n':
+			app.num_msgs = atoi(optarg);
+			break;
+		case 'l':
+			app.msg_len = atoi(optarg);
+			break;
+		case 'b':
+			app.batch = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			print_help(argv[0]);
+			exit(c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+
+	if (app.msg_len < 4 || app.msg_len > L1CTL_LENGTH || app.batch == 0) {
+		print_help(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const struct l1ctl_server_cfg cfg = {
+		.conn_read_cb = &bench_conn_read_cb,
+	};
+	struct l1ctl_server *server;
+	struct l1ctl_client *client;
+	uint8_t *stream;
+	size_t stream_len;
+	void *tall_ctx;
+	int sv[2];
+
+	handle_options(argc, argv);
+
+	tall_ctx = talloc_named_const(NULL, 1, "l1ctl_server_bench");
+	msgb_talloc_ctx_init(tall_ctx, 0);
+	osmo_init_logging2(tall_ctx, &bench_log_info);
+
+	/* A server without a listening socket, clients are added manually */
+	server = l1ctl_server_alloc(tall_ctx, &cfg);
+	OSMO_ASSERT(server != NULL);
+
+	stream = build_ul_stream(&stream_len);
+
+	fprintf(stderr, "%u messages of %u bytes per direction\n", app.num_msgs, app.msg_len);
+
+	/* Buffered framing (l1ctl_server) */
+	OSMO_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+	OSMO_ASSERT(fcntl(sv[1], F_SETFL, O_NONBLOCK) == 0);
+	client = l1ctl_client_alloc(server, sv[0]);
+	OSMO_ASSERT(client != NULL);
+
+	print_result("dl/buffered", app.num_msgs, bench_dl(client, sv[1]));
+	print_result("ul/buffered", app.num_msgs, bench_ul(sv[1], stream, stream_len));
+
+	l1ctl_client_conn_close(client);
+	close(sv[1]);
+
+	/* Naive framing (baseline), the peer drains faster than a batch is written */
+	OSMO_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+	OSMO_ASSERT(fcntl(sv[1], F_SETFL, O_NONBLOCK) == 0);
+
+	print_result("dl/naive", app.num_msgs, bench_dl_naive(sv[0], sv[1]));
+	print_result("ul/naive", app.num_msgs, bench_ul_naive(sv[0], sv[1], stream, stream_len));
+
+	close(sv[0]);
+	close(sv[1]);
+
+	free(stream);
+	l1ctl_server_free(server);
+
+	return EXIT_SUCCESS;
+}
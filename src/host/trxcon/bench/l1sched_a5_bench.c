@@ -0,0 +1,226 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * l1sched A5/X ciphering benchmark (see bench.h for the output format)
+ *
+ * Applies the A5/1 and A5/3 keystream to the Downlink and Uplink bursts
+ * of a ciphered SDCCH/4 and TCH/F, both the way it used to be done (one
+ * osmo_a5() call per burst and direction) and through the scheduler's
+ * keystream cache, and compares the per-burst cost.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+
+#include <osmocom/gsm/a5.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1sched/logging.h>
+#include <osmocom/bb/l1sched/prim.h>
+
+#include "bench.h"
+
+/* Number of multiframes to process */
+#define NUM_MFRAMES_DEF		2000
+
+enum {
+	DSCH,
+	DSCHD,
+};
+
+static const struct log_info_cat bench_log_info_cat[] = {
+	[DSCH] = {
+		.name = "DSCH",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DSCHD] = {
+		.name = "DSCHD",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+};
+
+static const struct log_info bench_log_info = {
+	.cat = bench_log_info_cat,
+	.num_cat = ARRAY_SIZE(bench_log_info_cat),
+};
+
+static const uint8_t bench_key[MAX_A5_KEY_LEN] = {
+	0xde, 0xad, 0xbe, 0xef, 0x01, 0x23, 0x45, 0x67,
+	0x89, 0xab, 0xcd, 0xef, 0xfe, 0xdc, 0xba, 0x98,
+};
+
+/* Scheduler -> user API (normally implemented by trxcon_shim.c) */
+
+int l1sched_prim_to_user(struct l1sched_state *sched, struct msgb *msg)
+{
+	msgb_free(msg);
+	return 0;
+}
+
+/* Keystream generation as formerly done by the scheduler */
+
+static void legacy_burst_dec(const struct l1sched_lchan_state *lchan,
+			     struct l1sched_burst_ind *bi)
+{
+	ubit_t ks[114];
+	int i;
+
+	osmo_a5(lchan->a5.algo, lchan->a5.key, bi->fn, ks, NULL);
+
+	for (i = 0; i < 57; i++) {
+		if (ks[i])
+			bi->burst[i + 3] *= -1;
+		if (ks[i + 57])
+			bi->burst[i + 88] *= -1;
+	}
+}
+
+static void legacy_burst_enc(const struct l1sched_lchan_state *lchan,
+			     struct l1sched_burst_req *br)
+{
+	ubit_t ks[114];
+	int i;
+
+	osmo_a5(lchan->a5.algo, lchan->a5.key, br->fn, NULL, ks);
+
+	for (i = 0; i < 57; i++) {
+		br->burst[i + 3] ^= ks[i];
+		br->burst[i + 88] ^= ks[i + 57];
+	}
+}
+
+static uint64_t run(struct l1sched_lchan_state *lchan, unsigned int num_mframes,
+		    bool cached, unsigned int *num_bursts, uint32_t *csum)
+{
+	const struct l1sched_tdma_multiframe *mf = lchan->ts->mf_layout;
+	const unsigned int num = num_mframes * mf->period;
+	struct l1sched_burst_ind bi = { .burst_len = GSM_NBITS_NB_GMSK_BURST };
+	struct l1sched_burst_req br = { .burst_len = GSM_NBITS_NB_GMSK_BURST };
+	uint64_t t0, t1;
+	unsigned int fn, i;
+
+	for (i = 0; i < GSM_NBITS_NB_GMSK_BURST; i++) {
+		bi.burst[i] = (i & 0x01) ? 64 : -64;
+		br.burst[i] = i & 0x01;
+	}
+
+	*num_bursts = 0;
+
+	t0 = bench_now_ns();
+	for (fn = 0; fn < num; fn++) {
+		const struct l1sched_tdma_frame *fp = &mf->frames[fn % mf->period];
+
+		if (fp->dl_chan == lchan->type) {
+			bi.fn = fn;
+			if (cached) {
+				/* Normally done by the Tx clock, ahead of the Rx path */
+				l1sched_a5_ks_prefetch(lchan, fn);
+				l1sched_a5_burst_dec(lchan, &bi);
+			} else
+				legacy_burst_dec(lchan, &bi);
+			(*num_bursts)++;
+		}
+
+		if (fp->ul_chan == lchan->type) {
+			br.fn = fn;
+			if (cached)
+				l1sched_a5_burst_enc(lchan, &br);
+			else
+				legacy_burst_enc(lchan, &br);
+			(*num_bursts)++;
+		}
+	}
+	t1 = bench_now_ns();
+
+	/* Make sure both variants produce the same output */
+	for (i = 0; i < GSM_NBITS_NB_GMSK_BURST; i++)
+		*csum = *csum * 31 + (uint8_t)bi.burst[i] + br.burst[i];
+
+	return t1 - t0;
+}
+
+static void bench_lchan(struct l1sched_ts *ts, enum l1sched_lchan_type type,
+			unsigned int num_mframes)
+{
+	static const uint8_t algos[] = { 1, 3 };
+	struct l1sched_lchan_state *lchan;
+	unsigned int i;
+
+	lchan = l1sched_find_lchan_by_type(ts, type);
+	OSMO_ASSERT(lchan != NULL && lchan->active);
+
+	for (i = 0; i < ARRAY_SIZE(algos); i++) {
+		uint32_t csum_legacy = 0, csum_cached = 0;
+		unsigned int num_bursts;
+		uint64_t ns_legacy, ns_cached;
+		char name[48];
+
+		OSMO_ASSERT(l1sched_start_ciphering(ts, algos[i], bench_key, 8) == 0);
+
+		ns_legacy = run(lchan, num_mframes, false, &num_bursts, &csum_legacy);
+		ns_cached = run(lchan, num_mframes, true, &num_bursts, &csum_cached);
+		OSMO_ASSERT(csum_legacy == csum_cached);
+
+		snprintf(name, sizeof(name), "%s/A5/%u/per_burst",
+			 l1sched_lchan_desc[type].name, algos[i]);
+		bench_report("l1sched_a5", name, num_bursts, ns_legacy);
+		snprintf(name, sizeof(name), "%s/A5/%u/cached",
+			 l1sched_lchan_desc[type].name, algos[i]);
+		bench_report("l1sched_a5", name, num_bursts, ns_cached);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const struct l1sched_cfg cfg = { .log_prefix = "bench: " };
+	unsigned int num_mframes = NUM_MFRAMES_DEF;
+	struct l1sched_state *sched;
+	void *tall_ctx;
+
+	if (argc > 1)
+		num_mframes = atoi(argv[1]);
+
+	tall_ctx = talloc_named_const(NULL, 1, "l1sched_a5_bench");
+	msgb_talloc_ctx_init(tall_ctx, 0);
+	osmo_init_logging2(tall_ctx, &bench_log_info);
+	l1sched_logging_init(DSCH, DSCHD);
+
+	sched = l1sched_alloc(tall_ctx, &cfg, NULL);
+	OSMO_ASSERT(sched != NULL);
+
+	/* SDCCH/4(0) on TS0 */
+	OSMO_ASSERT(l1sched_configure_ts(sched, 0, GSM_PCHAN_CCCH_SDCCH4) == 0);
+	OSMO_ASSERT(l1sched_set_lchans(sched->ts[0], RSL_CHAN_SDCCH4_ACCH, 1,
+				       GSM48_CMODE_SIGN, 0) == 0);
+	bench_lchan(sched->ts[0], L1SCHED_SDCCH4_0, num_mframes);
+
+	/* TCH/F on TS1 */
+	OSMO_ASSERT(l1sched_configure_ts(sched, 1, GSM_PCHAN_TCH_F) == 0);
+	OSMO_ASSERT(l1sched_set_lchans(sched->ts[1], RSL_CHAN_Bm_ACCHs | 1, 1,
+				       GSM48_CMODE_SPEECH_V1, 0) == 0);
+	bench_lchan(sched->ts[1], L1SCHED_TCHF, num_mframes);
+
+	l1sched_free(sched);
+
+	return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * l1sched hot path micro-benchmarks (see bench.h for the output format)
+ *
+ * For each of the common channel combinations (CCCH, SDCCH/8, TCH/F,
+ * TCH/H and PDCH) a number of multiframes is passed through
+ * l1sched_handle_rx_burst() and l1sched_pull_burst().  A5/X ciphering
+ * is covered by l1sched_a5_bench.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1sched/logging.h>
+#include <osmocom/bb/l1sched/prim.h>
+
+#include "bench.h"
+
+/* Number of multiframes to process per benchmark */
+#define NUM_MFRAMES_DEF		2000
+
+enum {
+	DSCH,
+	DSCHD,
+};
+
+static const struct log_info_cat bench_log_info_cat[] = {
+	[DSCH] = {
+		.name = "DSCH",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DSCHD] = {
+		.name = "DSCHD",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+};
+
+static const struct log_info bench_log_info = {
+	.cat = bench_log_info_cat,
+	.num_cat = ARRAY_SIZE(bench_log_info_cat),
+};
+
+static void *tall_ctx;
+
+/* Scheduler -> user API (normally implemented by trxcon_shim.c) */
+
+int l1sched_prim_to_user(struct l1sched_state *sched, struct msgb *msg)
+{
+	msgb_free(msg);
+	return 0;
+}
+
+struct bench_comb {
+	const char *name;
+	enum gsm_phys_chan_config pchan;
+	uint8_t tn;
+	/* RSL channel number to activate (0: none, see below for PDCH) */
+	uint8_t chan_nr;
+	uint8_t tch_mode;
+};
+
+static const struct bench_comb bench_combs[] = {
+	{ "CCCH", GSM_PCHAN_CCCH, 0 },
+	{ "SDCCH/8", GSM_PCHAN_SDCCH8_SACCH8C, 1,
+	  RSL_CHAN_SDCCH8_ACCH | (2 << 3) | 1, GSM48_CMODE_SIGN },
+	{ "TCH/F", GSM_PCHAN_TCH_F, 2,
+	  RSL_CHAN_Bm_ACCHs | 2, GSM48_CMODE_SPEECH_V1 },
+	{ "TCH/H", GSM_PCHAN_TCH_H, 3,
+	  RSL_CHAN_Lm_ACCHs | (0 << 3) | 3, GSM48_CMODE_SPEECH_V1 },
+	{ "PDCH", GSM_PCHAN_PDCH, 4 },
+};
+
+static struct l1sched_state *bench_sched_alloc(const struct bench_comb *comb)
+{
+	const struct l1sched_cfg cfg = { .log_prefix = "bench: " };
+	struct l1sched_state *sched;
+	struct l1sched_ts *ts;
+
+	sched = l1sched_alloc(tall_ctx, &cfg, NULL);
+	OSMO_ASSERT(sched != NULL);
+
+	OSMO_ASSERT(l1sched_configure_ts(sched, comb->tn, comb->pchan) == 0);
+	ts = sched->ts[comb->tn];
+
+	if (comb->pchan == GSM_PCHAN_PDCH) {
+		/* Same as done by trxcon on TBF establishment */
+		l1sched_activate_lchan(ts, L1SCHED_PDTCH);
+		l1sched_activate_lchan(ts, L1SCHED_PTCCH);
+	} else if (comb->chan_nr != 0) {
+		OSMO_ASSERT(l1sched_set_lchans(ts, comb->chan_nr, 1, comb->tch_mode, 0) == 0);
+	}
+
+	return sched;
+}
+
+static void bench_rx_burst(const struct bench_comb *comb, unsigned int num_mframes)
+{
+	struct l1sched_state *sched = bench_sched_alloc(comb);
+	const unsigned int num = num_mframes * sched->ts[comb->tn]->mf_layout->period;
+	struct l1sched_burst_ind bi = {
+		.tn = comb->tn,
+		.rssi = -60,
+		.burst_len = GSM_NBITS_NB_GMSK_BURST,
+	};
+	char name[32];
+	uint64_t t0, t1;
+	unsigned int i;
+
+	/* Noise: every block gets decoded, and fails to */
+	for (i = 0; i < GSM_NBITS_NB_GMSK_BURST; i++)
+		bi.burst[i] = (int8_t)(rand() % 255 - 127);
+
+	t0 = bench_now_ns();
+	for (i = 0; i < num; i++) {
+		bi.fn = i;
+		l1sched_handle_rx_burst(sched, &bi);
+	}
+	t1 = bench_now_ns();
+
+	snprintf(name, sizeof(name), "rx_burst/%s", comb->name);
+	bench_report("l1sched", name, num, t1 - t0);
+
+	l1sched_free(sched);
+}
+
+static void bench_pull_burst(const struct bench_comb *comb, unsigned int num_mframes)
+{
+	struct l1sched_state *sched = bench_sched_alloc(comb);
+	const unsigned int num = num_mframes * sched->ts[comb->tn]->mf_layout->period;
+	struct l1sched_burst_req br = { .tn = comb->tn };
+	unsigned long num_bursts = 0;
+	char name[32];
+	uint64_t t0, t1;
+	unsigned int i;
+
+	t0 = bench_now_ns();
+	for (i = 0; i < num; i++) {
+		br.fn = i;
+		br.burst_len = 0;
+		l1sched_pull_burst(sched, &br);
+		num_bursts += br.burst_len > 0;
+	}
+	t1 = bench_now_ns();
+
+	/* Per TDMA frame, including those without an Uplink burst */
+	snprintf(name, sizeof(name), "pull_burst/%s", comb->name);
+	bench_report("l1sched", name, num, t1 - t0);
+	fprintf(stderr, "%s: %lu of %u frames with an Uplink burst\n",
+		name, num_bursts, num);
+
+	l1sched_free(sched);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int num_mframes = NUM_MFRAMES_DEF;
+	unsigned int i;
+
+	if (argc > 1)
+		num_mframes = atoi(argv[1]);
+
+	tall_ctx = talloc_named_const(NULL, 1, "l1sched_bench");
+	msgb_talloc_ctx_init(tall_ctx, 0);
+	osmo_init_logging2(tall_ctx, &bench_log_info);
+	l1sched_logging_init(DSCH, DSCHD);
+
+	srand(0xbe7c);
+
+	for (i = 0; i < ARRAY_SIZE(bench_combs); i++)
+		bench_rx_burst(&bench_combs[i], num_mframes);
+	for (i = 0; i < ARRAY_SIZE(bench_combs); i++)
+		bench_pull_burst(&bench_combs[i], num_mframes);
+
+	return 0;
+}
@@ -0,0 +1,237 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * l1sched lchan lookup / burst dispatch benchmark (see bench.h for the
+ * output format)
+ *
+ * Replays a combined CCCH+SDCCH/4 multiframe on TS0 through the scheduler
+ * (Downlink and Uplink) and measures the per-burst dispatch cost, also
+ * with a given share of Downlink bursts randomly lost.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1sched/logging.h>
+#include <osmocom/bb/l1sched/prim.h>
+
+#include "bench.h"
+
+/* Number of 51-multiframes to replay */
+#define NUM_MFRAMES_DEF		10000
+/* Share of randomly lost Downlink bursts (percent) */
+#define LOSS_PERCENT_DEF	10
+
+enum {
+	DSCH,
+	DSCHD,
+};
+
+static const struct log_info_cat bench_log_info_cat[] = {
+	[DSCH] = {
+		.name = "DSCH",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DSCHD] = {
+		.name = "DSCHD",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+};
+
+static const struct log_info bench_log_info = {
+	.cat = bench_log_info_cat,
+	.num_cat = ARRAY_SIZE(bench_log_info_cat),
+};
+
+/* Scheduler -> user API (normally implemented by trxcon_shim.c) */
+
+int l1sched_prim_to_user(struct l1sched_state *sched, struct msgb *msg)
+{
+	msgb_free(msg);
+	return 0;
+}
+
+/* The list walk formerly done by l1sched_find_lchan_by_type() */
+static struct l1sched_lchan_state *find_lchan_list(struct l1sched_ts *ts,
+						   enum l1sched_lchan_type type)
+{
+	struct l1sched_lchan_state *lchan;
+
+	llist_for_each_entry(lchan, &ts->lchans, list)
+		if (lchan->type == type)
+			return lchan;
+
+	return NULL;
+}
+
+static void bench_lookup(struct l1sched_ts *ts, unsigned int num_mframes)
+{
+	const struct l1sched_tdma_multiframe *mf = ts->mf_layout;
+	const unsigned int num = num_mframes * mf->period;
+	uintptr_t sum_list = 0, sum_table = 0;
+	uint64_t t0, t1, t2;
+	unsigned int i;
+
+	t0 = bench_now_ns();
+	for (i = 0; i < num; i++) {
+		const struct l1sched_tdma_frame *frame = &mf->frames[i % mf->period];
+
+		sum_list += (uintptr_t)find_lchan_list(ts, frame->dl_chan);
+		sum_list += (uintptr_t)find_lchan_list(ts, frame->ul_chan);
+	}
+	t1 = bench_now_ns();
+	for (i = 0; i < num; i++) {
+		const struct l1sched_tdma_frame *frame = &mf->frames[i % mf->period];
+
+		sum_table += (uintptr_t)l1sched_find_lchan_by_type(ts, frame->dl_chan);
+		sum_table += (uintptr_t)l1sched_find_lchan_by_type(ts, frame->ul_chan);
+	}
+	t2 = bench_now_ns();
+
+	OSMO_ASSERT(sum_list == sum_table);
+
+	bench_report("l1sched_lchan", "lookup/list_walk", num * 2, t1 - t0);
+	bench_report("l1sched_lchan", "lookup/table", num * 2, t2 - t1);
+}
+
+static void bench_dispatch(struct l1sched_state *sched, const char *mode,
+			   unsigned int num_mframes)
+{
+	const unsigned int num = num_mframes * sched->ts[0]->mf_layout->period;
+	struct l1sched_burst_ind bi = {
+		.tn = 0,
+		.rssi = -60,
+		.burst_len = GSM_NBITS_NB_GMSK_BURST,
+	};
+	struct l1sched_burst_req br = { .tn = 0 };
+	uint64_t t0, t1;
+	unsigned int i;
+	char name[48];
+
+	for (i = 0; i < GSM_NBITS_NB_GMSK_BURST; i++)
+		bi.burst[i] = (i & 0x01) ? 64 : -64;
+
+	t0 = bench_now_ns();
+	for (i = 0; i < num; i++) {
+		bi.fn = i;
+		l1sched_handle_rx_burst(sched, &bi);
+
+		br.fn = i;
+		br.burst_len = 0;
+		l1sched_pull_burst(sched, &br);
+	}
+	t1 = bench_now_ns();
+
+	/* Rx + Tx per frame */
+	snprintf(name, sizeof(name), "dispatch/%s", mode);
+	bench_report("l1sched_lchan", name, num, t1 - t0);
+}
+
+static void bench_dispatch_loss(struct l1sched_state *sched, unsigned int num_mframes,
+				unsigned int loss_percent)
+{
+	const unsigned int num = num_mframes * sched->ts[0]->mf_layout->period;
+	struct l1sched_burst_ind bi = {
+		.tn = 0,
+		.rssi = -60,
+		.burst_len = GSM_NBITS_NB_GMSK_BURST,
+	};
+	struct l1sched_lchan_state *lchan;
+	unsigned long num_lost = 0, num_events = 0;
+	unsigned int i, num_rx = 0;
+	uint64_t t0, t1;
+	char name[48];
+
+	srand(0x10557);
+
+	for (i = 0; i < GSM_NBITS_NB_GMSK_BURST; i++)
+		bi.burst[i] = (i & 0x01) ? 64 : -64;
+
+	t0 = bench_now_ns();
+	for (i = 0; i < num; i++) {
+		if ((unsigned int)(rand() % 100) < loss_percent)
+			continue;
+		bi.fn = i;
+		l1sched_handle_rx_burst(sched, &bi);
+		num_rx++;
+	}
+	t1 = bench_now_ns();
+
+	llist_for_each_entry(lchan, &sched->ts[0]->lchans, list) {
+		num_lost += lchan->tdma.num_lost;
+		num_events += lchan->tdma.num_loss_events;
+	}
+
+	/* Rx only */
+	snprintf(name, sizeof(name), "dispatch/loss_%u%%", loss_percent);
+	bench_report("l1sched_lchan", name, num_rx, t1 - t0);
+	fprintf(stderr, "%s: %lu bursts substituted in %lu events\n",
+		name, num_lost, num_events);
+}
+
+int main(int argc, char **argv)
+{
+	const struct l1sched_cfg cfg = { .log_prefix = "bench: " };
+	unsigned int num_mframes = NUM_MFRAMES_DEF;
+	unsigned int loss_percent = LOSS_PERCENT_DEF;
+	struct l1sched_state *sched;
+	void *tall_ctx;
+
+	if (argc > 1)
+		num_mframes = atoi(argv[1]);
+	if (argc > 2)
+		loss_percent = atoi(argv[2]);
+
+	tall_ctx = talloc_named_const(NULL, 1, "l1sched_lchan_bench");
+	msgb_talloc_ctx_init(tall_ctx, 0);
+	osmo_init_logging2(tall_ctx, &bench_log_info);
+	l1sched_logging_init(DSCH, DSCHD);
+
+	sched = l1sched_alloc(tall_ctx, &cfg, NULL);
+	OSMO_ASSERT(sched != NULL);
+	OSMO_ASSERT(l1sched_configure_ts(sched, 0, GSM_PCHAN_CCCH_SDCCH4) == 0);
+
+	fprintf(stderr, "Replaying %u x %s multiframes\n",
+	       num_mframes, sched->ts[0]->mf_layout->name);
+
+	bench_lookup(sched->ts[0], num_mframes);
+
+	/* Lookup and dispatch only: all lchans inactive */
+	l1sched_deactivate_all_lchans(sched->ts[0]);
+	bench_dispatch(sched, "inactive", num_mframes);
+
+	/* BCCH/CCCH and SDCCH/4(0) with its SACCH active (decoding noise) */
+	OSMO_ASSERT(l1sched_configure_ts(sched, 0, GSM_PCHAN_CCCH_SDCCH4) == 0);
+	OSMO_ASSERT(l1sched_set_lchans(sched->ts[0], RSL_CHAN_SDCCH4_ACCH, 1, 0, 0) == 0);
+	bench_dispatch(sched, "active", num_mframes);
+
+	/* Same as above, with some Downlink bursts lost */
+	OSMO_ASSERT(l1sched_configure_ts(sched, 0, GSM_PCHAN_CCCH_SDCCH4) == 0);
+	OSMO_ASSERT(l1sched_set_lchans(sched->ts[0], RSL_CHAN_SDCCH4_ACCH, 1, 0, 0) == 0);
+	bench_dispatch_loss(sched, num_mframes, loss_percent);
+
+	l1sched_free(sched);
+
+	return 0;
+}
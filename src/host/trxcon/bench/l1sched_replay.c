@@ -0,0 +1,370 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * l1sched replay tool: push a capture of the scheduler input (see trxcon's
+ * -R/--capture option) through the scheduler as fast as possible.
+ *
+ * Reports the overall throughput and the time spent per Downlink logical
+ * channel (including decoding) as bench.h results, and optionally writes all decoded L2
+ * blocks to a file for byte-exact comparison between builds.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <errno.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1sched/capture.h>
+#include <osmocom/bb/l1sched/logging.h>
+#include <osmocom/bb/l1sched/prim.h>
+
+#include "bench.h"
+
+enum {
+	DSCH,
+	DSCHD,
+};
+
+static const struct log_info_cat replay_log_info_cat[] = {
+	[DSCH] = {
+		.name = "DSCH",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DSCHD] = {
+		.name = "DSCHD",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+};
+
+static const struct log_info replay_log_info = {
+	.cat = replay_log_info_cat,
+	.num_cat = ARRAY_SIZE(replay_log_info_cat),
+};
+
+/* Record of the L2 output file (host byte order), followed by the L2 payload */
+struct replay_l2_rec {
+	uint32_t fn;
+	uint8_t chan_nr;
+	uint8_t link_id;
+	uint16_t data_len;
+	int16_t n_errors;
+	int16_t n_bits_total;
+} __attribute__((packed));
+
+static struct {
+	const char *capture_path;
+	const char *l2_path;
+	unsigned int num_runs;
+	unsigned int num_workers;
+} app = {
+	.num_runs = 1,
+};
+
+static struct {
+	/* Only the first run produces output */
+	bool active;
+	FILE *fp;
+	uint32_t hash;
+	unsigned long num_blocks;
+	unsigned long num_bad;
+} l2_out;
+
+/* Per Downlink lchan type statistics */
+static struct {
+	unsigned long num_bursts;
+	uint64_t time_ns;
+} lchan_stats[_L1SCHED_CHAN_MAX];
+
+/* FNV-1a, to compare the output of two builds at a glance */
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	while (len--) {
+		hash ^= *p++;
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+/* Scheduler -> user API (normally implemented by trxcon_shim.c) */
+
+int l1sched_prim_to_user(struct l1sched_state *sched, struct msgb *msg)
+{
+	const struct l1sched_prim *prim = l1sched_prim_from_msgb(msg);
+
+	if (!l2_out.active)
+		goto out;
+	if (prim->oph.primitive != L1SCHED_PRIM_T_DATA || prim->oph.operation != PRIM_OP_INDICATION)
+		goto out;
+
+	const struct replay_l2_rec rec = {
+		.fn = prim->data_ind.chdr.frame_nr,
+		.chan_nr = prim->data_ind.chdr.chan_nr,
+		.link_id = prim->data_ind.chdr.link_id,
+		.data_len = msgb_l2len(msg),
+		.n_errors = prim->data_ind.n_errors,
+		.n_bits_total = prim->data_ind.n_bits_total,
+	};
+
+	l2_out.hash = fnv1a(l2_out.hash, &rec, sizeof(rec));
+	l2_out.hash = fnv1a(l2_out.hash, msgb_l2(msg), rec.data_len);
+	l2_out.num_blocks++;
+	if (rec.data_len == 0)
+		l2_out.num_bad++;
+
+	if (l2_out.fp != NULL) {
+		fwrite(&rec, sizeof(rec), 1, l2_out.fp);
+		fwrite(msgb_l2(msg), rec.data_len, 1, l2_out.fp);
+	}
+
+out:
+	msgb_free(msg);
+	return 0;
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+	uint8_t *buf;
+	FILE *fp;
+	long size;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "Failed to open '%s': %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	buf = malloc(size);
+	OSMO_ASSERT(buf != NULL);
+
+	if (size <= 0 || fread(buf, size, 1, fp) != 1) {
+		fprintf(stderr, "Failed to read '%s'\n", path);
+		free(buf);
+		fclose(fp);
+		return NULL;
+	}
+
+	fclose(fp);
+	*len = size;
+	return buf;
+}
+
+/* Get the Downlink lchan type a burst is going to be dispatched to */
+static enum l1sched_lchan_type burst_lchan_type(const struct l1sched_state *sched,
+						const struct l1sched_capture_rec *rec)
+{
+	const struct l1sched_capture_burst_ind *cbi = (const void *)&rec->payload[0];
+	const struct l1sched_ts *ts;
+
+	if (cbi->tn >= ARRAY_SIZE(sched->ts))
+		return L1SCHED_IDLE;
+	ts = sched->ts[cbi->tn];
+	if (ts == NULL || ts->mf_layout == NULL)
+		return L1SCHED_IDLE;
+
+	return ts->mf_layout->frames[cbi->fn % ts->mf_layout->period].dl_chan;
+}
+
+static int replay_run(void *ctx, const uint8_t *buf, size_t len,
+		      uint64_t *duration_ns, uint64_t *capture_ns)
+{
+	const struct l1sched_cfg cfg = { .log_prefix = "replay: " };
+	const struct l1sched_capture_rec *rec;
+	struct l1sched_state *sched;
+	unsigned long num_recs = 0;
+	size_t offset = 0;
+	uint64_t t0, t1;
+
+	sched = l1sched_alloc(ctx, &cfg, NULL);
+	OSMO_ASSERT(sched != NULL);
+
+	if (app.num_workers > 0)
+		OSMO_ASSERT(l1sched_decoder_start(sched, app.num_workers) == 0);
+
+	*duration_ns = 0;
+
+	while ((rec = l1sched_capture_next(buf, len, &offset)) != NULL) {
+		num_recs++;
+		*capture_ns = rec->time_ns;
+
+		if (rec->type != L1SCHED_CAPTURE_REC_BURST_IND) {
+			l1sched_capture_apply(sched, rec);
+			continue;
+		}
+
+		enum l1sched_lchan_type type = burst_lchan_type(sched, rec);
+
+		t0 = bench_now_ns();
+		l1sched_capture_apply(sched, rec);
+		t1 = bench_now_ns();
+
+		lchan_stats[type].num_bursts++;
+		lchan_stats[type].time_ns += t1 - t0;
+		*duration_ns += t1 - t0;
+
+		/* Deliver blocks decoded by the worker threads (if any) */
+		if (app.num_workers > 0 && lchan_stats[type].num_bursts % 64 == 0)
+			osmo_select_main(1);
+	}
+
+	t0 = bench_now_ns();
+	l1sched_decoder_flush(sched);
+	*duration_ns += bench_now_ns() - t0;
+
+	l1sched_free(sched);
+
+	if (offset < len) {
+		fprintf(stderr, "Capture is truncated or malformed at offset %zu\n", offset);
+		return -EINVAL;
+	}
+
+	return num_recs;
+}
+
+static void print_help(const char *app_name)
+{
+	printf("Usage: %s [options] CAPTURE\n", app_name);
+	printf("  -h --help         this text\n");
+	printf("  -o --l2-output    Write decoded L2 blocks to a file\n");
+	printf("  -n --runs         Number of replay runs (default 1)\n");
+	printf("  -W --decode-workers Number of channel decoding threads (default 0, inline)\n");
+}
+
+static void handle_options(int argc, char **argv)
+{
+	while (1) {
+		int option_index = 0, c;
+		static struct option long_options[] = {
+			{"help", 0, 0, 'h'},
+			{"l2-output", 1, 0, 'o'},
+			{"runs", 1, 0, 'n'},
+			{"decode-workers", 1, 0, 'W'},
+			{0, 0, 0, 0}
+		};
+
+		c = getopt_long(argc, argv, "o:n:W:h", long_options, &option_index);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'o':
+			app.l2_path = optarg;
+			break;
+		case 'n':
+			app.num_runs = atoi(optarg);
+			break;
+		case 'W':
+			app.num_workers = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			print_help(argv[0]);
+			exit(c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+
+	if (optind != argc - 1 || app.num_runs == 0) {
+		print_help(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	app.capture_path = argv[optind];
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t duration_ns = 0, capture_ns = 0;
+	unsigned long num_bursts = 0;
+	unsigned int i, type;
+	void *tall_ctx;
+	uint8_t *buf;
+	size_t len;
+	int rc = 0;
+
+	handle_options(argc, argv);
+
+	tall_ctx = talloc_named_const(NULL, 1, "l1sched_replay");
+	msgb_talloc_ctx_init(tall_ctx, 0);
+	osmo_init_logging2(tall_ctx, &replay_log_info);
+	l1sched_logging_init(DSCH, DSCHD);
+
+	/* The whole capture is loaded in advance, so that I/O is not measured */
+	buf = read_file(app.capture_path, &len);
+	if (buf == NULL)
+		return EXIT_FAILURE;
+
+	if (app.l2_path != NULL) {
+		l2_out.fp = fopen(app.l2_path, "wb");
+		if (l2_out.fp == NULL) {
+			fprintf(stderr, "Failed to open '%s': %s\n", app.l2_path, strerror(errno));
+			return EXIT_FAILURE;
+		}
+	}
+
+	l2_out.hash = 2166136261;
+
+	for (i = 0; i < app.num_runs; i++) {
+		uint64_t run_ns;
+
+		l2_out.active = (i == 0);
+		rc = replay_run(tall_ctx, buf, len, &run_ns, &capture_ns);
+		if (rc < 0)
+			break;
+		duration_ns += run_ns;
+		if (l2_out.active && l2_out.fp != NULL)
+			fclose(l2_out.fp);
+	}
+
+	if (rc < 0)
+		return EXIT_FAILURE;
+
+	for (type = 0; type < _L1SCHED_CHAN_MAX; type++)
+		num_bursts += lchan_stats[type].num_bursts;
+
+	fprintf(stderr, "Replayed %u x '%s' (%d records, %.3f s of capture, %.1fx real time)\n",
+		app.num_runs, app.capture_path, rc, (double)capture_ns / 1e9,
+		duration_ns ? (double)capture_ns * app.num_runs / duration_ns : 0.0);
+
+	bench_report("l1sched_replay", "rx_burst", num_bursts, duration_ns);
+	for (type = 0; type < _L1SCHED_CHAN_MAX; type++) {
+		char name[48];
+
+		if (lchan_stats[type].num_bursts == 0)
+			continue;
+		snprintf(name, sizeof(name), "rx_burst/%s", l1sched_lchan_desc[type].name);
+		bench_report("l1sched_replay", name, lchan_stats[type].num_bursts,
+			     lchan_stats[type].time_ns);
+	}
+
+	fprintf(stderr, "L2 output: %lu blocks (%lu bad), FNV-1a 0x%08x\n",
+		l2_out.num_blocks, l2_out.num_bad, l2_out.hash);
+
+	free(buf);
+	return EXIT_SUCCESS;
+}
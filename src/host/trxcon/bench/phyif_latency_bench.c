@@ -0,0 +1,505 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * PHYIF latency benchmark: UDP (TRXDv0) vs shared memory (see bench.h for
+ * the output format)
+ *
+ * A child process runs the L1 side (trx_if or shm_if) answering each
+ * RTS indication with an Uplink burst, just like the scheduler would.
+ * The parent process acts as the transceiver: it sends Downlink bursts
+ * and measures the time until the corresponding Uplink bursts arrive.
+ * The child only answers frames whose burst indication it got, so that
+ * the shared memory run with NOPE indications checks they are passed up.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <osmocom/core/fsm.h>
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+
+#include <osmocom/gsm/gsm_utils.h>
+
+#include <osmocom/bb/trxcon/phyif.h>
+#include <osmocom/bb/trxcon/trx_if.h>
+#include <osmocom/bb/trxcon/shm_if.h>
+#include <osmocom/bb/trxcon/logging.h>
+
+#include "shm_trx.h"
+#include "bench.h"
+
+#define BENCH_HOST		"127.0.0.1"
+#define BENCH_FN_ADVANCE	2
+/* Iterations excluded from the statistics */
+#define BENCH_WARMUP		100
+/* Timeout for an Uplink response (ms) */
+#define BENCH_TIMEOUT		100
+
+enum bench_transport {
+	BENCH_UDP,
+	BENCH_SHM,
+};
+
+static const char * const bench_transport_names[] = {
+	[BENCH_UDP] = "udp",
+	[BENCH_SHM] = "shm",
+};
+
+static struct {
+	unsigned int num_iter;
+	uint16_t base_port;
+	const char *sock_path;
+	const char *shm_name;
+	int transport; /* -1 means both */
+} app_data = {
+	.num_iter = 10000,
+	.base_port = 6800,
+	.sock_path = "/tmp/trxcon_shm_bench",
+	.shm_name = "/trxcon_shm_bench",
+	.transport = -1,
+};
+
+/* ------------------------------------------------------------------------ */
+/* L1 side (child process)                                                  */
+/* ------------------------------------------------------------------------ */
+
+static struct {
+	enum bench_transport transport;
+	struct trx_instance *trx;
+	struct shm_instance *shm;
+	/* TDMA frame number of the last burst (or NOPE) indication per TS */
+	uint32_t ind_fn[8];
+} l1;
+
+int trxcon_phyif_handle_burst_ind(void *priv, const struct trxcon_phyif_burst_ind *bi)
+{
+	l1.ind_fn[bi->tn & 0x07] = bi->fn;
+	return 0;
+}
+
+int trxcon_phyif_handle_rts_ind(void *priv, const struct trxcon_phyif_rts_ind *rts)
+{
+	static const ubit_t burst[GSM_NBITS_NB_GMSK_BURST];
+	const struct trxcon_phyif_burst_req br = {
+		.fn = rts->fn,
+		.tn = rts->tn,
+		.burst = &burst[0],
+		.burst_len = sizeof(burst),
+	};
+
+	/* Only answer Downlink bursts (and NOPE indications) which have been
+	 * passed up, so that dropped indications show up as lost round trips */
+	if (l1.ind_fn[rts->tn & 0x07] != GSM_TDMA_FN_SUB(rts->fn, BENCH_FN_ADVANCE))
+		return 0;
+
+	if (l1.transport == BENCH_SHM)
+		return shm_if_handle_phyif_burst_req(l1.shm, &br);
+	return trx_if_handle_phyif_burst_req(l1.trx, &br);
+}
+
+int trxcon_phyif_handle_rsp(void *priv, const struct trxcon_phyif_rsp *rsp)
+{
+	return 0;
+}
+
+static void l1_parent_fsm_action(struct osmo_fsm_inst *fi, uint32_t event, void *data)
+{
+	/* The transceiver is gone, we're about to be killed */
+}
+
+static struct osmo_fsm_state l1_parent_fsm_states[] = {
+	{
+		.name = "ST_INIT",
+		.in_event_mask = (1 << 0),
+		.action = &l1_parent_fsm_action,
+	},
+};
+
+static struct osmo_fsm l1_parent_fsm = {
+	.name = "bench_parent",
+	.states = l1_parent_fsm_states,
+	.num_states = ARRAY_SIZE(l1_parent_fsm_states),
+	.log_subsys = DAPP,
+};
+
+static const struct log_info_cat l1_log_info_cat[] = {
+	[DAPP] = {
+		.name = "DAPP",
+		.enabled = 1, .loglevel = LOGL_ERROR,
+	},
+	[DTRXC] = {
+		.name = "DTRXC",
+		.enabled = 1, .loglevel = LOGL_ERROR,
+	},
+	[DTRXD] = {
+		.name = "DTRXD",
+		.enabled = 1, .loglevel = LOGL_ERROR,
+	},
+};
+
+static const struct log_info l1_log_info = {
+	.cat = l1_log_info_cat,
+	.num_cat = ARRAY_SIZE(l1_log_info_cat),
+};
+
+static void l1_main(enum bench_transport transport)
+{
+	void *tall_ctx = talloc_named_const(NULL, 1, "phyif_latency_bench");
+	struct osmo_fsm_inst *parent_fi;
+
+	osmo_init_logging2(tall_ctx, &l1_log_info);
+	memset(&l1.ind_fn[0], 0xff, sizeof(l1.ind_fn));
+	OSMO_ASSERT(osmo_fsm_register(&l1_parent_fsm) == 0);
+
+	parent_fi = osmo_fsm_inst_alloc(&l1_parent_fsm, tall_ctx, NULL, LOGL_ERROR, NULL);
+	OSMO_ASSERT(parent_fi != NULL);
+
+	l1.transport = transport;
+	if (transport == BENCH_SHM) {
+		const struct shm_if_params params = {
+			.sock_path = app_data.sock_path,
+			.fn_advance = BENCH_FN_ADVANCE,
+			.parent_fi = parent_fi,
+			.parent_term_event = 0,
+		};
+
+		l1.shm = shm_if_open(&params);
+		OSMO_ASSERT(l1.shm != NULL);
+	} else {
+		const struct trx_if_params params = {
+			.local_host = BENCH_HOST,
+			.remote_host = BENCH_HOST,
+			.base_port = app_data.base_port,
+			.fn_advance = BENCH_FN_ADVANCE,
+			.parent_fi = parent_fi,
+			.parent_term_event = 0,
+		};
+
+		l1.trx = trx_if_open(&params);
+		OSMO_ASSERT(l1.trx != NULL);
+	}
+
+	while (1)
+		osmo_select_main(0);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Transceiver side (parent process)                                        */
+/* ------------------------------------------------------------------------ */
+
+struct bench_trx {
+	enum bench_transport transport;
+	/* UDP: TRXD socket */
+	int data_fd;
+	/* Shared memory */
+	struct shm_trx shm;
+};
+
+static int udp_open(struct bench_trx *bt)
+{
+	struct sockaddr_in addr = { .sin_family = AF_INET };
+
+	bt->data_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (bt->data_fd < 0)
+		return -errno;
+
+	inet_pton(AF_INET, BENCH_HOST, &addr.sin_addr);
+	addr.sin_port = htons(app_data.base_port + 2);
+	if (bind(bt->data_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+		return -errno;
+	addr.sin_port = htons(app_data.base_port + 102);
+	if (connect(bt->data_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+		return -errno;
+
+	return 0;
+}
+
+/* Send a Downlink burst (or a NOPE indication, shared memory only) for
+ * each of the given number of timeslots */
+static void trx_send_dl(struct bench_trx *bt, uint32_t fn, unsigned int num_ts, bool nope)
+{
+	bool wakeup = false;
+	unsigned int tn;
+
+	for (tn = 0; tn < num_ts; tn++) {
+		if (bt->transport == BENCH_UDP) {
+			uint8_t buf[8 + GSM_NBITS_NB_GMSK_BURST + 2] = { 0 };
+
+			/* TRXDv0: TN, FN, RSSI, ToA256, soft-bits, padding */
+			buf[0] = tn;
+			osmo_store32be(fn, &buf[1]);
+			buf[5] = 60;
+			memset(&buf[8], 127, GSM_NBITS_NB_GMSK_BURST);
+			/* May fail with ECONNREFUSED until the L1 is up */
+			send(bt->data_fd, buf, sizeof(buf), 0);
+		} else {
+			struct shm_if_burst_ind *bi;
+
+			bi = shm_if_ring_prod_slot(&bt->shm.region->dl);
+			OSMO_ASSERT(bi != NULL);
+			bi->fn = fn;
+			bi->tn = tn;
+			bi->rssi = -60;
+			bi->toa256 = 0;
+			bi->burst_len = nope ? 0 : GSM_NBITS_NB_GMSK_BURST;
+			memset(&bi->burst[0], 0, bi->burst_len);
+			if (shm_if_ring_produce(&bt->shm.region->dl.hdr))
+				wakeup = true;
+		}
+	}
+
+	if (wakeup)
+		shm_trx_wakeup_l1(&bt->shm);
+}
+
+/* Receive pending Uplink bursts, return the number of those for the given FN */
+static unsigned int trx_recv_ul(struct bench_trx *bt, uint32_t fn)
+{
+	unsigned int num = 0;
+
+	if (bt->transport == BENCH_UDP) {
+		uint8_t buf[TRXD_BUF_SIZE];
+		ssize_t len;
+
+		while ((len = recv(bt->data_fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+			if (len >= 5 && osmo_load32be(&buf[1]) == fn)
+				num++;
+		}
+	} else {
+		struct shm_if_burst_req *br;
+
+		while ((br = shm_if_ring_cons_slot(&bt->shm.region->ul)) != NULL) {
+			if (br->fn == fn)
+				num++;
+			shm_if_ring_consume(&bt->shm.region->ul.hdr);
+		}
+	}
+
+	return num;
+}
+
+static int trx_wait_ul(struct bench_trx *bt, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = bt->data_fd, .events = POLLIN };
+
+	if (bt->transport == BENCH_SHM)
+		return shm_trx_wait(&bt->shm, timeout_ms);
+	return poll(&pfd, 1, timeout_ms);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	const uint64_t *x = a, *y = b;
+
+	return (*x > *y) - (*x < *y);
+}
+
+static void print_results(enum bench_transport transport, unsigned int num_ts, bool nope,
+			  uint64_t *lat, unsigned int num, unsigned int num_lost)
+{
+	uint64_t sum = 0;
+	unsigned int i;
+	char name[32];
+
+	snprintf(name, sizeof(name), "round_trip/%s%s/ts%u",
+		 bench_transport_names[transport], nope ? "-nope" : "", num_ts);
+	if (num == 0) {
+		fprintf(stderr, "%s: no results\n", name);
+		return;
+	}
+
+	qsort(lat, num, sizeof(*lat), &cmp_u64);
+	for (i = 0; i < num; i++)
+		sum += lat[i];
+
+	bench_report("phyif", name, num, sum);
+	fprintf(stderr, "%s: lost=%u min=%.1f p50=%.1f p99=%.1f max=%.1f (us)\n",
+		name, num_lost, lat[0] / 1e3, lat[num / 2] / 1e3,
+		lat[(num * 99) / 100] / 1e3, lat[num - 1] / 1e3);
+}
+
+static int bench_run(enum bench_transport transport, unsigned int num_ts, bool nope)
+{
+	struct bench_trx bt = { .transport = transport, .data_fd = -1 };
+	unsigned int i, num = 0, num_lost = 0;
+	uint64_t *lat;
+	pid_t pid;
+	int rc;
+
+	lat = calloc(app_data.num_iter, sizeof(*lat));
+	OSMO_ASSERT(lat != NULL);
+
+	if (transport == BENCH_SHM)
+		rc = shm_trx_create(&bt.shm, app_data.sock_path, app_data.shm_name);
+	else
+		rc = udp_open(&bt);
+	if (rc != 0) {
+		fprintf(stderr, "Failed to open the %s transport: %d\n",
+			bench_transport_names[transport], rc);
+		free(lat);
+		return rc;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork()");
+		exit(EXIT_FAILURE);
+	} else if (pid == 0) {
+		l1_main(transport);
+		exit(EXIT_SUCCESS);
+	}
+
+	if (transport == BENCH_SHM && shm_trx_accept(&bt.shm) != 0) {
+		rc = -EIO;
+		goto exit;
+	}
+
+	for (i = 0; i < BENCH_WARMUP + app_data.num_iter; i++) {
+		const uint32_t fn = i % GSM_TDMA_HYPERFRAME;
+		const uint32_t fn_ul = GSM_TDMA_FN_SUM(fn, BENCH_FN_ADVANCE);
+		unsigned int num_ul = 0;
+		uint64_t t0 = bench_now_ns();
+
+		trx_send_dl(&bt, fn, num_ts, nope);
+		while (num_ul < num_ts) {
+			if (trx_wait_ul(&bt, BENCH_TIMEOUT) <= 0)
+				break;
+			num_ul += trx_recv_ul(&bt, fn_ul);
+		}
+
+		if (i < BENCH_WARMUP)
+			continue;
+		if (num_ul < num_ts)
+			num_lost++;
+		else
+			lat[num++] = bench_now_ns() - t0;
+	}
+
+	print_results(transport, num_ts, nope, lat, num, num_lost);
+
+exit:
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+
+	if (transport == BENCH_SHM)
+		shm_trx_destroy(&bt.shm, app_data.sock_path);
+	else
+		close(bt.data_fd);
+	free(lat);
+
+	return rc;
+}
+
+static void print_help(void)
+{
+	printf(" Some help...\n");
+	printf("  -h --help         this text\n");
+	printf("  -n --iterations   Number of Downlink/Uplink round trips (default %u)\n",
+	       app_data.num_iter);
+	printf("  -t --transport    Transport to benchmark: udp or shm (default both)\n");
+	printf("  -p --base-port    Base UDP port for TRXD (default %u)\n",
+	       app_data.base_port);
+	printf("  -s --socket       UNIX socket path (default %s)\n",
+	       app_data.sock_path);
+}
+
+static void handle_options(int argc, char **argv)
+{
+	while (1) {
+		int option_index = 0, c;
+		static struct option long_options[] = {
+			{"help", 0, 0, 'h'},
+			{"iterations", 1, 0, 'n'},
+			{"transport", 1, 0, 't'},
+			{"base-port", 1, 0, 'p'},
+			{"socket", 1, 0, 's'},
+			{0, 0, 0, 0}
+		};
+
+		c = getopt_long(argc, argv, "hn:t:p:s:",
+				long_options, &option_index);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			print_help();
+			exit(0);
+		case 'n':
+			app_data.num_iter = atoi(optarg);
+			break;
+		case 't':
+			if (!strcmp(optarg, "udp"))
+				app_data.transport = BENCH_UDP;
+			else if (!strcmp(optarg, "shm"))
+				app_data.transport = BENCH_SHM;
+			else {
+				print_help();
+				exit(2);
+			}
+			break;
+		case 'p':
+			app_data.base_port = atoi(optarg);
+			break;
+		case 's':
+			app_data.sock_path = optarg;
+			break;
+		default:
+			print_help();
+			exit(2);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	/* A single burst, and a whole TDMA frame (all 8 timeslots) */
+	static const unsigned int num_ts[] = { 1, 8 };
+	unsigned int t, i;
+	int rc = 0;
+
+	handle_options(argc, argv);
+
+	for (t = BENCH_UDP; t <= BENCH_SHM; t++) {
+		if (app_data.transport >= 0 && app_data.transport != t)
+			continue;
+		for (i = 0; i < ARRAY_SIZE(num_ts); i++)
+			rc |= bench_run(t, num_ts[i], false);
+	}
+
+	/* NOPE indications on all timeslots (TRXDv0 cannot express them):
+	 * they must reach the L1 just like bursts, none may get lost */
+	if (app_data.transport < 0 || app_data.transport == BENCH_SHM)
+		rc |= bench_run(BENCH_SHM, 8, true);
+
+	return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,327 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * Stand-in transceiver for the shared memory PHY interface
+ *
+ * Drives trxcon through the shared memory interface: answers the PHYIF
+ * commands, generates (noise) Downlink bursts on a TDMA frame clock and
+ * counts the Uplink bursts, reporting those which arrived late.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include <sys/timerfd.h>
+
+#include <osmocom/gsm/gsm0502.h>
+
+#include <osmocom/bb/trxcon/phyif.h>
+
+#include "shm_trx.h"
+
+#define GSM_BURST_LEN		148
+
+static struct {
+	const char *sock_path;
+	const char *shm_name;
+	unsigned int num_frames;
+	bool quit;
+} app_data = {
+	.sock_path = "/tmp/trxcon_shm",
+	.shm_name = "/trxcon_shm",
+	.num_frames = 0,
+};
+
+static struct {
+	bool powered;
+	uint32_t fn;
+	/* Channel combination per timeslot (0 means not configured) */
+	uint8_t pchan[8];
+	uint8_t ta;
+	uint16_t band_arfcn;
+
+	unsigned long num_dl_bursts;
+	unsigned long num_ul_bursts;
+	unsigned long num_ul_late;
+	unsigned long num_dl_overflows;
+	unsigned long num_cmds;
+} trx;
+
+static void push_rsp(struct shm_trx *st, const struct shm_if_rsp *rsp)
+{
+	struct shm_if_rsp *slot;
+
+	slot = shm_if_ring_prod_slot(&st->region->rsp);
+	if (slot == NULL) {
+		fprintf(stderr, "Response ring is full\n");
+		return;
+	}
+
+	*slot = *rsp;
+	if (shm_if_ring_produce(&st->region->rsp.hdr))
+		shm_trx_wakeup_l1(st);
+}
+
+static void handle_cmd(struct shm_trx *st, const struct shm_if_cmd *cmd)
+{
+	struct shm_if_rsp rsp;
+
+	trx.num_cmds++;
+
+	switch (cmd->type) {
+	case TRXCON_PHYIF_CMDT_RESET:
+		memset(&trx.pchan[0], 0x00, sizeof(trx.pchan));
+		trx.powered = false;
+		break;
+	case TRXCON_PHYIF_CMDT_POWERON:
+		trx.powered = true;
+		break;
+	case TRXCON_PHYIF_CMDT_POWEROFF:
+		trx.powered = false;
+		break;
+	case TRXCON_PHYIF_CMDT_MEASURE:
+		/* Nothing but the noise floor here */
+		rsp = (struct shm_if_rsp) {
+			.type = cmd->type,
+			.param.measure = {
+				.band_arfcn = cmd->param.measure.band_arfcn,
+				.dbm = -110,
+			},
+		};
+		push_rsp(st, &rsp);
+		break;
+	case TRXCON_PHYIF_CMDT_SETFREQ_H0:
+		trx.band_arfcn = cmd->param.setfreq_h0.band_arfcn;
+		break;
+	case TRXCON_PHYIF_CMDT_SETFREQ_H1:
+		break;
+	case TRXCON_PHYIF_CMDT_SETSLOT:
+		if (cmd->param.setslot.tn < ARRAY_SIZE(trx.pchan))
+			trx.pchan[cmd->param.setslot.tn] = cmd->param.setslot.pchan;
+		break;
+	case TRXCON_PHYIF_CMDT_SETTA:
+		trx.ta = cmd->param.setta.ta;
+		break;
+	default:
+		fprintf(stderr, "Unhandled command type=0x%02x\n", cmd->type);
+	}
+}
+
+static void handle_ul(struct shm_trx *st)
+{
+	struct shm_if_burst_req *br;
+	struct shm_if_cmd *cmd;
+
+	while ((cmd = shm_if_ring_cons_slot(&st->region->cmd)) != NULL) {
+		handle_cmd(st, cmd);
+		shm_if_ring_consume(&st->region->cmd.hdr);
+	}
+
+	while ((br = shm_if_ring_cons_slot(&st->region->ul)) != NULL) {
+		uint32_t ahead = GSM_TDMA_FN_SUB(br->fn, trx.fn);
+
+		/* Bursts for the current (or a past) frame cannot be transmitted */
+		if (ahead == 0 || ahead > GSM_TDMA_HYPERFRAME / 2)
+			trx.num_ul_late++;
+		trx.num_ul_bursts++;
+		shm_if_ring_consume(&st->region->ul.hdr);
+	}
+}
+
+static void send_dl_frame(struct shm_trx *st)
+{
+	bool wakeup = false;
+	unsigned int tn, i;
+
+	for (tn = 0; tn < 8; tn++) {
+		struct shm_if_burst_ind *bi;
+
+		bi = shm_if_ring_prod_slot(&st->region->dl);
+		if (bi == NULL) {
+			trx.num_dl_overflows++;
+			continue;
+		}
+
+		bi->fn = trx.fn;
+		bi->tn = tn;
+		bi->rssi = -110;
+		bi->toa256 = 0;
+
+		/* Timeslot 0 is always on (BCCH carrier), NOPE on idle ones */
+		if (tn == 0 || trx.pchan[tn] != 0) {
+			bi->burst_len = GSM_BURST_LEN;
+			for (i = 0; i < GSM_BURST_LEN; i++)
+				bi->burst[i] = (random() % 31) - 15;
+		} else {
+			bi->burst_len = 0;
+		}
+
+		if (shm_if_ring_produce(&st->region->dl.hdr))
+			wakeup = true;
+		trx.num_dl_bursts++;
+	}
+
+	if (wakeup)
+		shm_trx_wakeup_l1(st);
+}
+
+static void print_stats(void)
+{
+	printf("fn=%u cmds=%lu dl_bursts=%lu (overflows=%lu) "
+	       "ul_bursts=%lu (late=%lu)\n",
+	       trx.fn, trx.num_cmds, trx.num_dl_bursts, trx.num_dl_overflows,
+	       trx.num_ul_bursts, trx.num_ul_late);
+}
+
+static int run(struct shm_trx *st, int tfd)
+{
+	struct pollfd pfd[3] = {
+		{ .fd = tfd, .events = POLLIN },
+		{ .fd = st->trx_efd, .events = POLLIN },
+		{ .fd = st->conn_fd, .events = POLLIN },
+	};
+	unsigned int num_frames = 0;
+	uint64_t val;
+
+	while (!app_data.quit) {
+		if (poll(pfd, ARRAY_SIZE(pfd), -1) < 0)
+			continue; /* EINTR */
+
+		if (pfd[2].revents & (POLLIN | POLLHUP | POLLERR)) {
+			printf("L1 has disconnected\n");
+			return 0;
+		}
+
+		if (pfd[1].revents & POLLIN) {
+			if (read(st->trx_efd, &val, sizeof(val)) == sizeof(val))
+				handle_ul(st);
+		}
+
+		if (pfd[0].revents & POLLIN) {
+			if (read(tfd, &val, sizeof(val)) != sizeof(val))
+				continue;
+			/* Catch up if we've been too slow */
+			while (val--) {
+				trx.fn = GSM_TDMA_FN_INC(trx.fn);
+				if (trx.powered)
+					send_dl_frame(st);
+				if ((trx.fn % GSM_TDMA_SUPERFRAME) == 0)
+					print_stats();
+				num_frames++;
+			}
+			if (app_data.num_frames && num_frames >= app_data.num_frames)
+				return 0;
+		}
+	}
+
+	return 0;
+}
+
+static void print_help(void)
+{
+	printf(" Some help...\n");
+	printf("  -h --help         this text\n");
+	printf("  -s --socket       UNIX socket path to listen on (default %s)\n",
+	       app_data.sock_path);
+	printf("  -m --shm-name     POSIX shared memory object name (default %s)\n",
+	       app_data.shm_name);
+	printf("  -n --num-frames   Exit after this many TDMA frames (default unlimited)\n");
+}
+
+static void handle_options(int argc, char **argv)
+{
+	while (1) {
+		int option_index = 0, c;
+		static struct option long_options[] = {
+			{"help", 0, 0, 'h'},
+			{"socket", 1, 0, 's'},
+			{"shm-name", 1, 0, 'm'},
+			{"num-frames", 1, 0, 'n'},
+			{0, 0, 0, 0}
+		};
+
+		c = getopt_long(argc, argv, "hs:m:n:",
+				long_options, &option_index);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			print_help();
+			exit(0);
+		case 's':
+			app_data.sock_path = optarg;
+			break;
+		case 'm':
+			app_data.shm_name = optarg;
+			break;
+		case 'n':
+			app_data.num_frames = atoi(optarg);
+			break;
+		default:
+			print_help();
+			exit(2);
+		}
+	}
+}
+
+static void signal_handler(int signum)
+{
+	app_data.quit = true;
+}
+
+int main(int argc, char **argv)
+{
+	const struct itimerspec its = {
+		.it_interval = { .tv_nsec = GSM_TDMA_FN_DURATION_nS },
+		.it_value = { .tv_nsec = GSM_TDMA_FN_DURATION_nS },
+	};
+	struct shm_trx st;
+	int tfd, rc;
+
+	handle_options(argc, argv);
+
+	signal(SIGINT, &signal_handler);
+	signal(SIGTERM, &signal_handler);
+
+	if (shm_trx_create(&st, app_data.sock_path, app_data.shm_name) != 0)
+		return EXIT_FAILURE;
+
+	tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (tfd < 0) {
+		perror("timerfd_create()");
+		shm_trx_destroy(&st, app_data.sock_path);
+		return EXIT_FAILURE;
+	}
+
+	printf("Waiting for trxcon on '%s'...\n", app_data.sock_path);
+	rc = shm_trx_accept(&st);
+	if (rc == 0) {
+		printf("trxcon has connected\n");
+		timerfd_settime(tfd, 0, &its, NULL);
+		rc = run(&st, tfd);
+		print_stats();
+	}
+
+	close(tfd);
+	shm_trx_destroy(&st, app_data.sock_path);
+
+	return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,175 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * Transceiver side of the shared memory PHY interface
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "shm_trx.h"
+
+/* Create the shared memory region, eventfds and the listening socket */
+int shm_trx_create(struct shm_trx *trx, const char *sock_path, const char *shm_name)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	void *region;
+
+	memset(trx, 0x00, sizeof(*trx));
+	trx->region_fd = trx->listen_fd = trx->conn_fd = -1;
+	trx->l1_efd = trx->trx_efd = -1;
+	snprintf(trx->shm_name, sizeof(trx->shm_name), "%s", shm_name);
+
+	trx->region_fd = shm_open(trx->shm_name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (trx->region_fd < 0)
+		goto error;
+	if (ftruncate(trx->region_fd, sizeof(*trx->region)) != 0)
+		goto error;
+
+	region = mmap(NULL, sizeof(*trx->region), PROT_READ | PROT_WRITE,
+		      MAP_SHARED, trx->region_fd, 0);
+	if (region == MAP_FAILED)
+		goto error;
+	trx->region = region;
+	trx->region->magic = SHM_IF_MAGIC;
+	trx->region->version = SHM_IF_VERSION;
+
+	trx->l1_efd = eventfd(0, EFD_CLOEXEC);
+	trx->trx_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (trx->l1_efd < 0 || trx->trx_efd < 0)
+		goto error;
+
+	if (strlen(sock_path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		goto error;
+	}
+	strcpy(addr.sun_path, sock_path);
+	unlink(sock_path);
+
+	trx->listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (trx->listen_fd < 0)
+		goto error;
+	if (bind(trx->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+		goto error;
+	if (listen(trx->listen_fd, 1) != 0)
+		goto error;
+
+	return 0;
+
+error:
+	perror("shm_trx_create()");
+	shm_trx_destroy(trx, NULL);
+	return -1;
+}
+
+/* Accept a connection from the L1 and pass the file descriptors */
+int shm_trx_accept(struct shm_trx *trx)
+{
+	const int fds[] = { trx->region_fd, trx->l1_efd, trx->trx_efd };
+	const uint32_t version = SHM_IF_VERSION;
+	union {
+		char buf[CMSG_SPACE(sizeof(fds))];
+		struct cmsghdr align;
+	} u;
+	struct iovec iov = {
+		.iov_base = (void *)&version,
+		.iov_len = sizeof(version),
+	};
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = u.buf,
+		.msg_controllen = sizeof(u.buf),
+	};
+	struct cmsghdr *cmsg;
+
+	trx->conn_fd = accept(trx->listen_fd, NULL, NULL);
+	if (trx->conn_fd < 0) {
+		perror("accept()");
+		return -1;
+	}
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), &fds[0], sizeof(fds));
+
+	if (sendmsg(trx->conn_fd, &msg, 0) != sizeof(version)) {
+		perror("sendmsg()");
+		close(trx->conn_fd);
+		trx->conn_fd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+void shm_trx_destroy(struct shm_trx *trx, const char *sock_path)
+{
+	if (trx->conn_fd >= 0)
+		close(trx->conn_fd);
+	if (trx->listen_fd >= 0)
+		close(trx->listen_fd);
+	if (trx->l1_efd >= 0)
+		close(trx->l1_efd);
+	if (trx->trx_efd >= 0)
+		close(trx->trx_efd);
+	if (trx->region != NULL)
+		munmap(trx->region, sizeof(*trx->region));
+	if (trx->region_fd >= 0) {
+		close(trx->region_fd);
+		shm_unlink(trx->shm_name);
+	}
+	if (sock_path != NULL)
+		unlink(sock_path);
+
+	trx->region = NULL;
+	trx->region_fd = trx->listen_fd = trx->conn_fd = -1;
+	trx->l1_efd = trx->trx_efd = -1;
+}
+
+void shm_trx_wakeup_l1(struct shm_trx *trx)
+{
+	const uint64_t val = 1;
+
+	if (write(trx->l1_efd, &val, sizeof(val)) != sizeof(val))
+		perror("write(l1_efd)");
+}
+
+/* Wait for a wakeup from the L1 (or timeout), reset the eventfd counter.
+ * Returns 1 on wakeup, 0 on timeout, negative on error. */
+int shm_trx_wait(struct shm_trx *trx, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = trx->trx_efd, .events = POLLIN };
+	uint64_t val;
+	int rc;
+
+	rc = poll(&pfd, 1, timeout_ms);
+	if (rc <= 0)
+		return rc;
+
+	if (read(trx->trx_efd, &val, sizeof(val)) != sizeof(val))
+		return -errno;
+	return 1;
+}
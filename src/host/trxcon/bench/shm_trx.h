@@ -0,0 +1,29 @@
+#pragma once
+
+/* Transceiver side of the shared memory PHY interface (see shm_if.h) */
+
+#include <stdbool.h>
+
+#include <osmocom/bb/trxcon/shm_if.h>
+
+struct shm_trx {
+	/* Shared memory region (mapped) and its POSIX name */
+	struct shm_if_region *region;
+	char shm_name[64];
+	int region_fd;
+
+	/* UNIX domain socket: listening and connected (L1) */
+	int listen_fd;
+	int conn_fd;
+
+	/* Wakeup eventfds: TRX -> L1 (we write), L1 -> TRX (we read) */
+	int l1_efd;
+	int trx_efd;
+};
+
+int shm_trx_create(struct shm_trx *trx, const char *sock_path, const char *shm_name);
+int shm_trx_accept(struct shm_trx *trx);
+void shm_trx_destroy(struct shm_trx *trx, const char *sock_path);
+
+void shm_trx_wakeup_l1(struct shm_trx *trx);
+int shm_trx_wait(struct shm_trx *trx, int timeout_ms);
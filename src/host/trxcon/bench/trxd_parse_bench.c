@@ -0,0 +1,271 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * TRXD Rx path micro-benchmark (see bench.h for the output format)
+ *
+ * TRXDv0, TRXDv1 and TRXDv2 (8 batched bursts) PDUs are sent to a trx_if
+ * instance over the loopback interface, then its TRXD read callback is
+ * invoked directly: reading, parsing, soft-bit conversion and passing the
+ * bursts up (to no-op handlers) is measured, the sending is not.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <osmocom/core/fsm.h>
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+
+#include <osmocom/gsm/gsm_utils.h>
+
+#include <osmocom/bb/trxcon/phyif.h>
+#include <osmocom/bb/trxcon/trx_if.h>
+#include <osmocom/bb/trxcon/logging.h>
+
+#include "bench.h"
+
+#define BENCH_HOST		"127.0.0.1"
+#define BENCH_BASE_PORT		6950
+/* Number of PDUs to queue in the socket before reading them */
+#define BENCH_CHUNK		32
+/* Number of PDUs to process per benchmark */
+#define NUM_PDUS_DEF		100000
+
+static unsigned long num_burst_ind;
+static unsigned long num_rts_ind;
+
+/* trx_if -> upper layers API (normally implemented by trxcon_shim.c) */
+
+int trxcon_phyif_handle_burst_ind(void *priv, const struct trxcon_phyif_burst_ind *bi)
+{
+	num_burst_ind++;
+	return 0;
+}
+
+int trxcon_phyif_handle_rts_ind(void *priv, const struct trxcon_phyif_rts_ind *rts)
+{
+	num_rts_ind++;
+	return 0;
+}
+
+int trxcon_phyif_handle_rsp(void *priv, const struct trxcon_phyif_rsp *rsp)
+{
+	return 0;
+}
+
+static void bench_parent_fsm_action(struct osmo_fsm_inst *fi, uint32_t event, void *data)
+{
+}
+
+static struct osmo_fsm_state bench_parent_fsm_states[] = {
+	{
+		.name = "ST_INIT",
+		.in_event_mask = (1 << 0),
+		.action = &bench_parent_fsm_action,
+	},
+};
+
+static struct osmo_fsm bench_parent_fsm = {
+	.name = "bench_parent",
+	.states = bench_parent_fsm_states,
+	.num_states = ARRAY_SIZE(bench_parent_fsm_states),
+	.log_subsys = DAPP,
+};
+
+static const struct log_info_cat bench_log_info_cat[] = {
+	[DAPP] = {
+		.name = "DAPP",
+		.enabled = 1, .loglevel = LOGL_ERROR,
+	},
+	[DTRXC] = {
+		.name = "DTRXC",
+		.enabled = 1, .loglevel = LOGL_ERROR,
+	},
+	[DTRXD] = {
+		.name = "DTRXD",
+		.enabled = 1, .loglevel = LOGL_ERROR,
+	},
+};
+
+static const struct log_info bench_log_info = {
+	.cat = bench_log_info_cat,
+	.num_cat = ARRAY_SIZE(bench_log_info_cat),
+};
+
+/* Compose a Downlink TRXD PDU of the given version, return its length */
+static size_t bench_pdu_build(uint8_t *buf, uint8_t ver, uint32_t fn)
+{
+	size_t len = 0;
+	unsigned int tn;
+
+	switch (ver) {
+	case 0:
+		/* TN, FN, RSSI, ToA256, soft-bits, padding */
+		buf[len++] = (ver << 4) | 0;
+		osmo_store32be(fn, &buf[len]);
+		len += 4;
+		buf[len++] = 60;
+		buf[len++] = 0x00;
+		buf[len++] = 0x40;
+		memset(&buf[len], 0x20, GSM_NBITS_NB_GMSK_BURST + 2);
+		len += GSM_NBITS_NB_GMSK_BURST + 2;
+		break;
+	case 1:
+		/* As above, followed by MTS (GMSK) and C/I, no padding */
+		buf[len++] = (ver << 4) | 0;
+		osmo_store32be(fn, &buf[len]);
+		len += 4;
+		buf[len++] = 60;
+		buf[len++] = 0x00;
+		buf[len++] = 0x40;
+		buf[len++] = 0x00;
+		buf[len++] = 0x00;
+		buf[len++] = 0x64;
+		memset(&buf[len], 0x20, GSM_NBITS_NB_GMSK_BURST);
+		len += GSM_NBITS_NB_GMSK_BURST;
+		break;
+	case 2:
+		/* One burst per timeslot: TN, TRXN/BATCH, MTS, RSSI, ToA256, C/I */
+		for (tn = 0; tn < 8; tn++) {
+			buf[len++] = (ver << 4) | tn;
+			buf[len++] = tn < 7 ? 0x80 : 0x00;
+			buf[len++] = 0x00;
+			buf[len++] = 60;
+			buf[len++] = 0x00;
+			buf[len++] = 0x40;
+			buf[len++] = 0x00;
+			buf[len++] = 0x64;
+			if (tn == 0) {
+				osmo_store32be(fn, &buf[len]);
+				len += 4;
+			}
+			memset(&buf[len], 0x20, GSM_NBITS_NB_GMSK_BURST);
+			len += GSM_NBITS_NB_GMSK_BURST;
+		}
+		break;
+	default:
+		OSMO_ASSERT(0);
+	}
+
+	return len;
+}
+
+static int bench_sock_open(void)
+{
+	struct sockaddr_in addr = { .sin_family = AF_INET };
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	OSMO_ASSERT(fd >= 0);
+
+	inet_pton(AF_INET, BENCH_HOST, &addr.sin_addr);
+	addr.sin_port = htons(BENCH_BASE_PORT + 2);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+		return -errno;
+	addr.sin_port = htons(BENCH_BASE_PORT + 102);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+		return -errno;
+
+	return fd;
+}
+
+static void bench_rx(struct trx_instance *trx, int fd, uint8_t ver, unsigned int num_pdus)
+{
+	struct osmo_fd *ofd = &trx->trx_ofd_data;
+	uint8_t buf[TRXD_BUF_SIZE];
+	unsigned long num_bursts;
+	uint64_t ns_total = 0;
+	unsigned int i, j;
+	char name[32];
+
+	num_burst_ind = 0;
+
+	for (i = 0; i < num_pdus; i += BENCH_CHUNK) {
+		uint64_t t0;
+
+		for (j = 0; j < BENCH_CHUNK; j++) {
+			size_t len = bench_pdu_build(buf, ver, (i + j) % GSM_TDMA_HYPERFRAME);
+			OSMO_ASSERT(send(fd, buf, len, 0) == len);
+		}
+
+		t0 = bench_now_ns();
+		for (j = 0; j < BENCH_CHUNK; j++)
+			ofd->cb(ofd, OSMO_FD_READ);
+		ns_total += bench_now_ns() - t0;
+	}
+
+	num_bursts = num_burst_ind;
+	OSMO_ASSERT(num_bursts == (unsigned long)i * (ver == 2 ? 8 : 1));
+
+	snprintf(name, sizeof(name), "trxd_rx/v%u/pdu", ver);
+	bench_report("trxd", name, i, ns_total);
+	snprintf(name, sizeof(name), "trxd_rx/v%u/burst", ver);
+	bench_report("trxd", name, num_bursts, ns_total);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int num_pdus = NUM_PDUS_DEF;
+	struct osmo_fsm_inst *parent_fi;
+	struct trx_instance *trx;
+	void *tall_ctx;
+	uint8_t ver;
+	int fd;
+
+	if (argc > 1)
+		num_pdus = atoi(argv[1]);
+
+	tall_ctx = talloc_named_const(NULL, 1, "trxd_parse_bench");
+	osmo_init_logging2(tall_ctx, &bench_log_info);
+	OSMO_ASSERT(osmo_fsm_register(&bench_parent_fsm) == 0);
+
+	parent_fi = osmo_fsm_inst_alloc(&bench_parent_fsm, tall_ctx, NULL, LOGL_ERROR, NULL);
+	OSMO_ASSERT(parent_fi != NULL);
+
+	fd = bench_sock_open();
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open the TRXD socket: %s\n", strerror(-fd));
+		return EXIT_FAILURE;
+	}
+
+	const struct trx_if_params params = {
+		.local_host = BENCH_HOST,
+		.remote_host = BENCH_HOST,
+		.base_port = BENCH_BASE_PORT,
+		.parent_fi = parent_fi,
+		.parent_term_event = 0,
+	};
+
+	trx = trx_if_open(&params);
+	OSMO_ASSERT(trx != NULL);
+
+	for (ver = 0; ver <= TRXD_VER_MAX; ver++)
+		bench_rx(trx, fd, ver, num_pdus);
+
+	trx_if_close(trx);
+	close(fd);
+
+	return 0;
+}
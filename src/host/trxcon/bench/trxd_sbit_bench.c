@@ -0,0 +1,99 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * TRXD soft-bit conversion micro-benchmark (see bench.h for the output format)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+
+#include <osmocom/gsm/gsm_utils.h>
+
+#include <osmocom/bb/trxcon/trxd_sbit.h>
+
+#include "bench.h"
+
+static const char * const kernels[] = {
+	"generic", "sse2", "avx2", "neon",
+};
+
+static const unsigned int burst_lens[] = {
+	GSM_NBITS_NB_GMSK_BURST,
+	GSM_NBITS_NB_8PSK_BURST,
+};
+
+/* The scalar loop formerly used by trx_if.c (for comparison) */
+static void ubit2sbit_ref(sbit_t *out, const uint8_t *in, unsigned int len)
+{
+	for (unsigned int i = 0; i < len; i++) {
+		if (in[i] == 255)
+			out[i] = -127;
+		else
+			out[i] = 127 - in[i];
+	}
+}
+
+static void bench_run(const char *name, unsigned int burst_len, unsigned int num_iter,
+		      void (*func)(sbit_t *out, const uint8_t *in, unsigned int len))
+{
+	uint8_t in[GSM_NBITS_NB_8PSK_BURST];
+	sbit_t out[GSM_NBITS_NB_8PSK_BURST];
+	uint64_t t0, t1;
+	unsigned int i;
+	char bench_name[32];
+	int sum = 0;
+
+	for (i = 0; i < sizeof(in); i++)
+		in[i] = rand() % 256;
+
+	t0 = bench_now_ns();
+	for (i = 0; i < num_iter; i++) {
+		func(&out[0], &in[0], burst_len);
+		/* Prevent the compiler from optimizing the loop away */
+		sum += out[i % burst_len];
+		in[i % burst_len] ^= sum & 0x01;
+	}
+	t1 = bench_now_ns();
+
+	snprintf(bench_name, sizeof(bench_name), "ubit2sbit/%s/%u", name, burst_len);
+	bench_report("trxd_sbit", bench_name, num_iter, t1 - t0);
+	fprintf(stderr, "%s: %.1f Mbit/s (sum=%d)\n", bench_name,
+		(double)num_iter * burst_len * 1e3 / (t1 - t0), sum);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int num_iter = 1000000;
+	unsigned int i, j;
+
+	if (argc > 1)
+		num_iter = atoi(argv[1]);
+
+	fprintf(stderr, "Selected kernel: %s\n", trxd_ubit2sbit_kernel());
+
+	for (j = 0; j < ARRAY_SIZE(burst_lens); j++) {
+		bench_run("reference", burst_lens[j], num_iter, &ubit2sbit_ref);
+		for (i = 0; i < ARRAY_SIZE(kernels); i++) {
+			if (trxd_ubit2sbit_select(kernels[i]) != 0)
+				continue;
+			bench_run(kernels[i], burst_lens[j], num_iter, &trxd_ubit2sbit);
+		}
+	}
+
+	return 0;
+}
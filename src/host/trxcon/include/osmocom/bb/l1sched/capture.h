@@ -0,0 +1,108 @@
+#pragma once
+
+/* Capture of the scheduler input: every received burst passed to
+ * l1sched_handle_rx_burst() and every configuration command, so that a
+ * session can be replayed offline (see bench/l1sched_replay.c).
+ *
+ * A capture file is a header followed by a sequence of records.  It is
+ * meant for local profiling and regression testing only, so all fields
+ * are stored in host byte order. */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define L1SCHED_CAPTURE_MAGIC		0x4c314350 /* "L1CP" */
+#define L1SCHED_CAPTURE_VERSION		1
+
+struct l1sched_state;
+struct l1sched_burst_ind;
+
+struct l1sched_capture_file_hdr {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+} __attribute__((packed));
+
+enum l1sched_capture_rec_type {
+	L1SCHED_CAPTURE_REC_BURST_IND = 1,	/* l1sched_handle_rx_burst() */
+	L1SCHED_CAPTURE_REC_RESET,		/* l1sched_reset() */
+	L1SCHED_CAPTURE_REC_CONFIGURE_TS,	/* l1sched_configure_ts() */
+	L1SCHED_CAPTURE_REC_DEL_TS,		/* l1sched_del_ts() */
+	L1SCHED_CAPTURE_REC_SET_LCHANS,		/* l1sched_set_lchans() */
+	L1SCHED_CAPTURE_REC_ACTIVATE_LCHAN,	/* l1sched_activate_lchan() */
+	L1SCHED_CAPTURE_REC_DEACTIVATE_ALL,	/* l1sched_deactivate_all_lchans() */
+	L1SCHED_CAPTURE_REC_CIPHERING,		/* l1sched_start_ciphering() */
+	L1SCHED_CAPTURE_REC_AMR_CFG,		/* l1sched_lchan_set_amr_cfg() */
+	L1SCHED_CAPTURE_REC_TCH_MODE,		/* lchan->tch_mode changed */
+};
+
+/* Record header, followed by 'len' bytes of type specific payload */
+struct l1sched_capture_rec {
+	/* Time since the beginning of the capture (CLOCK_MONOTONIC) */
+	uint64_t time_ns;
+	uint16_t type; /* enum l1sched_capture_rec_type */
+	uint16_t len;
+	uint8_t payload[0];
+} __attribute__((packed));
+
+/* Payload of L1SCHED_CAPTURE_REC_BURST_IND */
+struct l1sched_capture_burst_ind {
+	uint32_t fn;
+	uint8_t tn;
+	int8_t rssi;
+	int16_t toa256;
+	uint16_t burst_len;
+	int8_t burst[0]; /* soft-bits */
+} __attribute__((packed));
+
+/* Payload of all configuration records (unused fields are 0) */
+struct l1sched_capture_cfg {
+	uint8_t tn;
+	union {
+		/* L1SCHED_CAPTURE_REC_CONFIGURE_TS */
+		struct {
+			uint8_t pchan;
+		} configure_ts;
+		/* L1SCHED_CAPTURE_REC_SET_LCHANS */
+		struct {
+			uint8_t chan_nr;
+			uint8_t active;
+			uint8_t tch_mode;
+			uint8_t tsc;
+		} set_lchans;
+		/* L1SCHED_CAPTURE_REC_{ACTIVATE_LCHAN,TCH_MODE} */
+		struct {
+			uint8_t type;
+			uint8_t tch_mode;
+		} lchan;
+		/* L1SCHED_CAPTURE_REC_CIPHERING */
+		struct {
+			uint8_t algo;
+			uint8_t key_len;
+			uint8_t key[16];
+		} ciphering;
+		/* L1SCHED_CAPTURE_REC_AMR_CFG */
+		struct {
+			uint8_t type;
+			uint8_t codecs_bitmask;
+			uint8_t start_codec;
+		} amr_cfg;
+	};
+} __attribute__((packed));
+
+int l1sched_capture_start(struct l1sched_state *sched, const char *path);
+void l1sched_capture_stop(struct l1sched_state *sched);
+
+/* Record scheduler input (used internally by the scheduler) */
+void l1sched_capture_burst(struct l1sched_state *sched,
+			   const struct l1sched_burst_ind *bi);
+void l1sched_capture_cfg(struct l1sched_state *sched,
+			 enum l1sched_capture_rec_type type,
+			 const struct l1sched_capture_cfg *cfg);
+
+/* Apply a single record to the given scheduler instance (replay) */
+int l1sched_capture_apply(struct l1sched_state *sched,
+			  const struct l1sched_capture_rec *rec);
+/* Get the next record from a capture buffer, or NULL at the end of it */
+const struct l1sched_capture_rec *l1sched_capture_next(const uint8_t *buf, size_t len,
+							size_t *offset);
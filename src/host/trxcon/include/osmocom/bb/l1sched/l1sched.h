@@ -30,8 +30,15 @@
 #define L1SCHED_CH_FLAG_PDCH	(1 << 0)
 /* Should a channel be activated automatically */
 #define L1SCHED_CH_FLAG_AUTO	(1 << 1)
+/* Rx bursts are collected in a 4-burst block buffer (xCCH, PDTCH),
+ * so lost ones can be substituted without invoking the rx_fn */
+#define L1SCHED_CH_FLAG_RX_BLOCK4	(1 << 2)
 
 #define MAX_A5_KEY_LEN		(128 / 8)
+/* Number of TDMA frames the A5/X keystream is cached for */
+#define L1SCHED_A5_KS_CACHE_SIZE	32
+/* Max number of TDMA frames the A5/X keystream is generated for at once */
+#define L1SCHED_A5_KS_BATCH		8
 #define TRX_TS_COUNT		8
 
 struct l1sched_lchan_state;
@@ -98,6 +105,9 @@ struct l1sched_burst_req {
 	uint8_t tn;
 	uint8_t pwr;
 
+	/*! Time of the RTS indication (CLOCK_MONOTONIC, optional) */
+	struct timespec rts_time;
+
 	/* Internally used by the scheduler */
 	uint8_t bid;
 
@@ -186,6 +196,18 @@ struct l1sched_tdma_multiframe {
 	const struct l1sched_tdma_frame *frames;
 };
 
+/*! Precompiled dispatch entry for a TDMA frame (see l1sched_configure_ts()) */
+struct l1sched_ts_dispatch {
+	/*! Downlink channel state (NULL if none), handler and block ID */
+	struct l1sched_lchan_state *dl_lchan;
+	l1sched_lchan_rx_func *rx_fn;
+	uint8_t dl_bid;
+	/*! Uplink channel state (NULL if none), handler and block ID */
+	struct l1sched_lchan_state *ul_lchan;
+	l1sched_lchan_tx_func *tx_fn;
+	uint8_t ul_bid;
+};
+
 struct l1sched_meas_set {
 	/*! TDMA frame number of the first burst this set belongs to */
 	uint32_t fn;
@@ -193,12 +215,45 @@ struct l1sched_meas_set {
 	int16_t toa256;
 	/*! RSSI (Received Signal Strength Indication) */
 	int8_t rssi;
+	/*! Spread of the averaged values (only set by l1sched_lchan_meas_avg()) */
+	int16_t toa256_min;
+	int16_t toa256_max;
+	int8_t rssi_min;
+	int8_t rssi_max;
+	/*! Population variance of ToA256 (1/256^2 symbol^2) and RSSI (dB^2) */
+	uint32_t toa256_var;
+	uint16_t rssi_var;
 };
 
-/* Simple ring buffer (up to 24 unique measurements) */
+/* Depth of the measurement history */
+#define L1SCHED_MEAS_HIST_LEN		24
+
+/* Ring buffer of the last L1SCHED_MEAS_HIST_LEN measurements, stored as
+ * struct-of-arrays.  Each entry is written twice (at i and at i + the
+ * history depth), so the last n entries are always contiguous and can be
+ * reduced without wrapping around. */
 struct l1sched_lchan_meas_hist {
-	struct l1sched_meas_set buf[24];
-	struct l1sched_meas_set *head;
+	uint32_t fn[2 * L1SCHED_MEAS_HIST_LEN];
+	int16_t toa256[2 * L1SCHED_MEAS_HIST_LEN];
+	int8_t rssi[2 * L1SCHED_MEAS_HIST_LEN];
+	/*! Position of the next entry to be written */
+	uint8_t next;
+	/*! Number of entries written so far (saturating) */
+	uint8_t num;
+};
+
+/* A5/X keystream of a TDMA frame */
+struct l1sched_a5_ks {
+	uint32_t fn;
+	ubit_t dl[114];
+	ubit_t ul[114];
+};
+
+/* Incremental FACCH/F and FACCH/H deinterleaver: coded soft-bits of the
+ * (up to 3) overlapping Downlink blocks, the oldest one at head */
+struct l1sched_facch_dil {
+	sbit_t cB[3][456];
+	uint8_t head;
 };
 
 /* States each channel on a multiframe */
@@ -220,6 +275,8 @@ struct l1sched_lchan_state {
 	sbit_t *rx_bursts;
 	/*! Burst buffer for TX */
 	ubit_t *tx_bursts;
+	/*! Incremental FACCH deinterleaver (TCH only) */
+	struct l1sched_facch_dil *rx_facch;
 
 	/*! Queue of Tx primitives */
 	struct llist_head tx_prims;
@@ -249,6 +306,10 @@ struct l1sched_lchan_state {
 		unsigned long num_proc;
 		/*! Number of lost TDMA frames */
 		unsigned long num_lost;
+		/*! Number of loss events (gaps of one or more lost frames) */
+		unsigned long num_loss_events;
+		/*! Number of gaps too long to be compensated */
+		unsigned long num_resync;
 	} tdma;
 
 	/*! SACCH state */
@@ -290,6 +351,10 @@ struct l1sched_lchan_state {
 		uint8_t key[MAX_A5_KEY_LEN];
 		uint8_t key_len;
 		uint8_t algo;
+		/*! Keystream cache (L1SCHED_A5_KS_CACHE_SIZE entries, allocated on demand) */
+		struct l1sched_a5_ks *ks_cache;
+		/*! Last frame of the latest generated batch of keystream */
+		uint32_t ks_fn_last;
 	} a5;
 
 	/* TS that this lchan belongs to */
@@ -304,6 +369,10 @@ struct l1sched_ts {
 	const struct l1sched_tdma_multiframe *mf_layout;
 	/*! Channel states for logical channels */
 	struct llist_head lchans;
+	/*! Channel states indexed by type (NULL if not allocated) */
+	struct l1sched_lchan_state *lchan_by_type[_L1SCHED_CHAN_MAX];
+	/*! Dispatch table indexed by (fn % mf_layout->period) */
+	struct l1sched_ts_dispatch *dispatch;
 	/*! Backpointer to the scheduler */
 	struct l1sched_state *sched;
 };
@@ -312,6 +381,80 @@ struct l1sched_ts {
 struct l1sched_cfg {
 	/*! Logging context (used as prefix for messages) */
 	const char *log_prefix;
+	/*! Number of preallocated primitives (0: default) */
+	unsigned int prim_pool_size;
+};
+
+/*! Default number of preallocated primitives per scheduler instance */
+#define L1SCHED_PRIM_POOL_SIZE		32
+
+/*! Pool of preallocated primitives (see l1sched_prim_pool_alloc()) */
+struct l1sched_prim_pool {
+	/*! All msgbs owned by the pool, free or in use */
+	struct msgb **msgs;
+	unsigned int num;
+	/*! List of free msgbs */
+	struct llist_head free;
+	unsigned int num_free;
+	/*! Number of primitives allocated from the heap (pool exhausted) */
+	unsigned long num_fallback;
+};
+
+/*! Number of buckets in the RTS-to-burst latency histograms */
+#define L1SCHED_DEADLINE_HIST_LEN	16
+
+/*! Uplink burst deadline accounting (see l1sched_pull_burst()) */
+struct l1sched_deadline {
+	/*! Time budget from the RTS indication to a ready burst (0: no deadline) */
+	uint32_t budget_us;
+	/*! Do not encode new blocks which would miss their deadline anyway */
+	bool skip_late;
+	/*! RTS-to-burst latency histograms: bucket 0 counts latencies below
+	 * 1 us, bucket N counts [2^(N-1), 2^N) us, the last bucket is open. */
+	uint32_t hist[_L1SCHED_CHAN_MAX][L1SCHED_DEADLINE_HIST_LEN];
+	/*! Number of bursts ready after the deadline */
+	uint32_t late[_L1SCHED_CHAN_MAX];
+	/*! Number of blocks skipped due to skip_late */
+	uint32_t skipped[_L1SCHED_CHAN_MAX];
+};
+
+/*! Number of bins in the BER histograms (see struct l1sched_lchan_stats) */
+#define L1SCHED_STATS_BER_BINS		8
+
+/*! Performance counters of a logical channel type.  These are plain counters,
+ * updated by the scheduler's thread only: a concurrent reader (see
+ * l1sched_stats_dump()) may observe slightly stale values. */
+struct l1sched_lchan_stats {
+	/*! Number of Downlink bursts handed over to the lchan */
+	unsigned long bursts_rx;
+	/*! Number of Uplink bursts produced by the lchan */
+	unsigned long bursts_tx;
+	/*! Number of decoded (good) and undecodable (bad) blocks */
+	unsigned long blocks_good;
+	unsigned long blocks_bad;
+	/*! BER histogram of the decoded blocks: bin 0 counts error-free blocks,
+	 * bin N counts BER in (2^(N-2), 2^(N-1)] %, the last bin is open. */
+	unsigned long ber_hist[L1SCHED_STATS_BER_BINS];
+	/*! Measurements (and their spread) of the last decoded block */
+	struct l1sched_meas_set meas_last;
+	/*! Time spent decoding blocks (only if dec_timing is enabled) */
+	uint64_t dec_time_ns;
+	unsigned long dec_time_num;
+	/*! Depth of the Tx primitive queue, sampled at the beginning of a block */
+	unsigned int tx_queue_depth;
+	unsigned int tx_queue_depth_max;
+};
+
+/*! Performance counters of a scheduler instance */
+struct l1sched_stats {
+	/*! Measure the decoding time (two clock readings per Rx burst) */
+	bool dec_timing;
+	/*! Per lchan type counters */
+	struct l1sched_lchan_stats lchan[_L1SCHED_CHAN_MAX];
+	/*! Registration for l1sched_stats_dump() */
+	struct llist_head list;
+	unsigned int id;
+	bool registered;
 };
 
 /*! One scheduler instance */
@@ -324,6 +467,16 @@ struct l1sched_state {
 	uint8_t bsic;
 	/*! Logging context (used as prefix for messages) */
 	const char *log_prefix;
+	/*! Optional decoding offload (NULL: decoding inline) */
+	struct l1sched_decoder *decoder;
+	/*! Uplink burst deadline accounting */
+	struct l1sched_deadline deadline;
+	/*! Optional capture of the scheduler input (NULL: disabled) */
+	struct l1sched_capture *capture;
+	/*! Performance counters */
+	struct l1sched_stats stats;
+	/*! Preallocated primitives for the Uplink path */
+	struct l1sched_prim_pool prim_pool;
 	/*! Some private data */
 	void *priv;
 };
@@ -337,6 +490,16 @@ struct l1sched_state *l1sched_alloc(void *ctx, const struct l1sched_cfg *cfg, vo
 void l1sched_reset(struct l1sched_state *sched);
 void l1sched_free(struct l1sched_state *sched);
 
+/* Optional offloading of channel decoding to worker threads */
+int l1sched_decoder_start(struct l1sched_state *sched, unsigned int num_workers);
+void l1sched_decoder_stop(struct l1sched_state *sched);
+void l1sched_decoder_flush(struct l1sched_state *sched);
+
+/* Performance counters export (Prometheus text format) */
+void l1sched_stats_register(struct l1sched_state *sched, unsigned int id);
+void l1sched_stats_unregister(struct l1sched_state *sched);
+char *l1sched_stats_dump(void *ctx, const char *prefix);
+
 void l1sched_sacch_cache_read(struct l1sched_state *sched, uint8_t *out);
 void l1sched_sacch_cache_update(struct l1sched_state *sched, const uint8_t *in);
 
@@ -394,6 +557,45 @@ extern const uint8_t l1sched_nb_training_bits[8][26];
 
 const char *l1sched_burst_mask2str(const uint32_t *mask, int bits);
 
+/* Decoding offload (used by lchan handlers, see sched_decoder.c) */
+enum l1sched_dec_type {
+	L1SCHED_DEC_XCCH,
+	L1SCHED_DEC_PDTCH,
+};
+
+int l1sched_decoder_submit(struct l1sched_lchan_state *lchan,
+			   enum l1sched_dec_type type,
+			   const sbit_t *bursts);
+
+int l1sched_prim_pool_init(struct l1sched_state *sched, unsigned int size);
+void l1sched_prim_pool_free(struct l1sched_state *sched);
+
+struct msgb *l1sched_prim_alloc_data_ind(uint8_t tn, enum l1sched_lchan_type type,
+					 const struct l1sched_meas_set *meas,
+					 const uint8_t *data, size_t data_len,
+					 int n_errors, int n_bits_total, bool traffic);
+
+/* A5/X ciphering */
+void l1sched_a5_burst_dec(struct l1sched_lchan_state *lchan,
+			  struct l1sched_burst_ind *bi);
+void l1sched_a5_burst_enc(struct l1sched_lchan_state *lchan,
+			  struct l1sched_burst_req *br);
+void l1sched_a5_ks_prefetch(struct l1sched_lchan_state *lchan, uint32_t fn);
+void l1sched_a5_ks_invalidate(struct l1sched_lchan_state *lchan);
+void l1sched_a5_reset(struct l1sched_lchan_state *lchan);
+
+/* Incremental FACCH deinterleaving */
+void l1sched_facch_dil_push(struct l1sched_lchan_state *lchan,
+			    const sbit_t *burst, uint8_t bid);
+void l1sched_facch_dil_shift(struct l1sched_lchan_state *lchan);
+int l1sched_facch_dil_decode(struct l1sched_lchan_state *lchan, uint8_t *data,
+			     int *n_errors, int *n_bits_total);
+
+/* Performance counters */
+void l1sched_stats_block(struct l1sched_state *sched, enum l1sched_lchan_type type,
+			 const struct l1sched_meas_set *meas,
+			 size_t data_len, int n_errors, int n_bits_total);
+
 /* Measurement history */
 void l1sched_lchan_meas_push(struct l1sched_lchan_state *lchan,
 			     const struct l1sched_burst_ind *bi);
@@ -404,4 +606,5 @@ int l1sched_clck_handle(struct l1sched_state *sched, uint32_t fn);
 void l1sched_clck_reset(struct l1sched_state *sched);
 
 void l1sched_pull_burst(struct l1sched_state *sched, struct l1sched_burst_req *br);
+void l1sched_deadline_report(struct l1sched_state *sched);
 void l1sched_pull_send_frame(struct l1sched_state *sched);
@@ -115,6 +115,9 @@ void l1sched_prim_init(struct msgb *msg,
 
 struct msgb *l1sched_prim_alloc(enum l1sched_prim_type type,
 				enum osmo_prim_operation op);
+struct msgb *l1sched_prim_pool_alloc(struct l1sched_state *sched,
+				     enum l1sched_prim_type type,
+				     enum osmo_prim_operation op);
 
 bool l1sched_lchan_amr_prim_is_valid(struct l1sched_lchan_state *lchan,
 				     struct msgb *msg, bool is_cmr);
@@ -130,3 +133,6 @@ int l1sched_lchan_emit_data_cnf(struct l1sched_lchan_state *lchan,
 
 int l1sched_prim_from_user(struct l1sched_state *sched, struct msgb *msg);
 int l1sched_prim_to_user(struct l1sched_state *sched, struct msgb *msg);
+/* Pass a primitive to l1sched_prim_to_user(), preserving the order
+ * with respect to blocks still being decoded (if any) */
+int l1sched_prim_emit(struct l1sched_state *sched, struct msgb *msg);
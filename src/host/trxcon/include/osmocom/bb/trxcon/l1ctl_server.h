@@ -1,8 +1,10 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
-#include <osmocom/core/write_queue.h>
+#include <osmocom/core/linuxlist.h>
 #include <osmocom/core/select.h>
 #include <osmocom/core/timer.h>
 #include <osmocom/core/msgb.h>
@@ -16,13 +18,20 @@
  */
 #define L1CTL_MSG_LEN_FIELD 2
 
+/* Size of the per-client Rx buffer (holds several frames of maximum length) */
+#define L1CTL_RX_BUF_SIZE (8 * (L1CTL_MSG_LEN_FIELD + L1CTL_LENGTH))
+/* Maximum number of messages pending in the per-client Tx queue */
+#define L1CTL_TX_QUEUE_MAX 100
+/* Maximum number of messages coalesced into a single writev() call */
+#define L1CTL_TX_BATCH_MAX 64
+
 struct l1ctl_client;
 
 typedef int l1ctl_conn_data_func(struct l1ctl_client *, struct msgb *);
 typedef void l1ctl_conn_state_func(struct l1ctl_client *);
 
 struct l1ctl_server_cfg {
-	/* UNIX socket path to listen on */
+	/* UNIX socket path to listen on (NULL: see l1ctl_client_alloc()) */
 	const char *sock_path;
 	/* maximum number of connected clients */
 	unsigned int num_clients_max;
@@ -43,6 +52,8 @@ struct l1ctl_server {
 	struct osmo_fd ofd;
 	/* server configuration */
 	const struct l1ctl_server_cfg *cfg;
+	/* some private data */
+	void *priv;
 };
 
 struct l1ctl_client {
@@ -50,8 +61,20 @@ struct l1ctl_client {
 	struct llist_head list;
 	/* struct l1ctl_server we belong to */
 	struct l1ctl_server *server;
-	/* client's write queue */
-	struct osmo_wqueue wq;
+	/* connection socket (non-blocking) */
+	struct osmo_fd ofd;
+	/* Rx buffer: received, but not yet parsed bytes */
+	uint8_t rx_buf[L1CTL_RX_BUF_SIZE];
+	size_t rx_buf_len;
+	/* Tx queue: length-prefixed messages, pending transmission */
+	struct llist_head tx_queue;
+	unsigned int tx_queue_len;
+	/* number of bytes of the first queued message already written */
+	size_t tx_offset;
+	/* set while received messages are being passed to conn_read_cb */
+	bool rx_dispatching;
+	/* connection was closed from within conn_read_cb, free is pending */
+	bool closed;
 	/* logging context (used as prefix for messages) */
 	const char *log_prefix;
 	/* unique client ID */
@@ -63,5 +86,7 @@ struct l1ctl_client {
 struct l1ctl_server *l1ctl_server_alloc(void *ctx, const struct l1ctl_server_cfg *cfg);
 void l1ctl_server_free(struct l1ctl_server *server);
 
+struct l1ctl_client *l1ctl_client_alloc(struct l1ctl_server *server, int fd);
+
 int l1ctl_client_send(struct l1ctl_client *client, struct msgb *msg);
 void l1ctl_client_conn_close(struct l1ctl_client *client);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <time.h>
 #include <stdint.h>
 
 #include <osmocom/core/bits.h>
@@ -73,6 +74,8 @@ struct trxcon_phyif_rsp {
 struct trxcon_phyif_rts_ind {
 	uint32_t fn;
 	uint8_t tn;
+	/* Time of the triggering event (CLOCK_MONOTONIC, optional) */
+	struct timespec time;
 };
 
 /* RTR.ind - Ready-to-Receive indicaton */
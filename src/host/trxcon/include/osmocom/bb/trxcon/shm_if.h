@@ -0,0 +1,211 @@
+#pragma once
+
+/* Shared memory PHY interface: a co-located transceiver exchanges bursts and
+ * commands with trxcon through lock-free SPSC rings in POSIX shared memory.
+ *
+ * The transceiver creates the shared memory region and a pair of eventfds,
+ * and listens on a UNIX domain socket.  trxcon connects to this socket and
+ * receives the file descriptors (region, L1 and TRX wakeup eventfds) via
+ * SCM_RIGHTS.  The socket is kept open for liveness detection only. */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include <osmocom/core/select.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/fsm.h>
+
+#include <osmocom/bb/trxcon/phyif.h>
+
+#define SHM_IF_MAGIC		0x5452584d /* "TRXM" */
+#define SHM_IF_VERSION		1
+
+/* Number of entries in each ring (must be a power of 2) */
+#define SHM_IF_RING_LEN		256
+#define SHM_IF_CMD_RING_LEN	16
+
+/* Max number of bits in a burst (8-PSK) */
+#define SHM_IF_BURST_LEN_MAX	444
+/* Max number of ARFCNs in a Mobile Allocation (SETFREQ_H1) */
+#define SHM_IF_MA_LEN_MAX	64
+
+#define SHM_IF_CACHELINE	64
+
+/* BURST.ind (TRX -> L1): soft-bits {-127..127}, burst_len=0 for NOPE */
+struct shm_if_burst_ind {
+	uint32_t fn;
+	uint8_t tn;
+	int8_t rssi;
+	int16_t toa256;
+	uint16_t burst_len;
+	sbit_t burst[SHM_IF_BURST_LEN_MAX];
+};
+
+/* BURST.req (L1 -> TRX): hard-bits {0,1}, burst_len=0 for NOPE */
+struct shm_if_burst_req {
+	uint32_t fn;
+	uint8_t tn;
+	uint8_t pwr;
+	uint16_t burst_len;
+	ubit_t burst[SHM_IF_BURST_LEN_MAX];
+};
+
+/* Flat (pointer-free) representation of struct trxcon_phyif_cmd */
+struct shm_if_cmd {
+	uint8_t type; /* enum trxcon_phyif_cmd_type */
+	union {
+		struct trxcon_phyif_cmdp_setfreq_h0 setfreq_h0;
+		struct {
+			uint8_t hsn;
+			uint8_t maio;
+			uint16_t ma_len;
+			uint16_t ma[SHM_IF_MA_LEN_MAX];
+		} setfreq_h1;
+		struct trxcon_phyif_cmdp_setslot setslot;
+		struct trxcon_phyif_cmdp_setta setta;
+		struct trxcon_phyif_cmdp_measure measure;
+	} param;
+};
+
+/* Flat representation of struct trxcon_phyif_rsp */
+struct shm_if_rsp {
+	uint8_t type; /* enum trxcon_phyif_cmd_type */
+	union {
+		struct {
+			uint16_t band_arfcn;
+			int16_t dbm;
+		} measure;
+	} param;
+};
+
+/* Ring indices, each on its own cache line to avoid false sharing */
+struct shm_if_ring_hdr {
+	/* Written by the producer only */
+	_Atomic uint32_t head __attribute__((aligned(SHM_IF_CACHELINE)));
+	/* Written by the consumer only */
+	_Atomic uint32_t tail __attribute__((aligned(SHM_IF_CACHELINE)));
+};
+
+#define SHM_IF_RING(name, type, len) \
+	struct name { \
+		struct shm_if_ring_hdr hdr; \
+		type slots[len]; \
+	}
+
+SHM_IF_RING(shm_if_ring_bi, struct shm_if_burst_ind, SHM_IF_RING_LEN);
+SHM_IF_RING(shm_if_ring_br, struct shm_if_burst_req, SHM_IF_RING_LEN);
+SHM_IF_RING(shm_if_ring_cmd, struct shm_if_cmd, SHM_IF_CMD_RING_LEN);
+SHM_IF_RING(shm_if_ring_rsp, struct shm_if_rsp, SHM_IF_CMD_RING_LEN);
+
+/* Layout of the shared memory region */
+struct shm_if_region {
+	uint32_t magic;
+	uint32_t version;
+	/* TRX -> L1 (wakeup via the L1 eventfd) */
+	struct shm_if_ring_bi dl;
+	struct shm_if_ring_rsp rsp;
+	/* L1 -> TRX (wakeup via the TRX eventfd) */
+	struct shm_if_ring_br ul;
+	struct shm_if_ring_cmd cmd;
+};
+
+/* Generic SPSC ring operations (both sides) */
+
+/* Get a pointer to the next free slot, or NULL if the ring is full */
+#define shm_if_ring_prod_slot(ring) \
+	shm_if_ring_prod_slot_(&(ring)->hdr, (void *)&(ring)->slots[0], \
+			       sizeof((ring)->slots[0]), ARRAY_SIZE((ring)->slots))
+/* Get a pointer to the oldest pending slot, or NULL if the ring is empty */
+#define shm_if_ring_cons_slot(ring) \
+	shm_if_ring_cons_slot_(&(ring)->hdr, (void *)&(ring)->slots[0], \
+			       sizeof((ring)->slots[0]), ARRAY_SIZE((ring)->slots))
+
+static inline void *shm_if_ring_prod_slot_(struct shm_if_ring_hdr *hdr, uint8_t *slots,
+					   size_t slot_size, uint32_t len)
+{
+	uint32_t head = atomic_load_explicit(&hdr->head, memory_order_relaxed);
+	uint32_t tail = atomic_load_explicit(&hdr->tail, memory_order_acquire);
+
+	if (head - tail >= len)
+		return NULL;
+	return slots + (head & (len - 1)) * slot_size;
+}
+
+static inline void *shm_if_ring_cons_slot_(struct shm_if_ring_hdr *hdr, uint8_t *slots,
+					   size_t slot_size, uint32_t len)
+{
+	uint32_t tail = atomic_load_explicit(&hdr->tail, memory_order_relaxed);
+	uint32_t head = atomic_load_explicit(&hdr->head, memory_order_acquire);
+
+	if (head == tail)
+		return NULL;
+	return slots + (tail & (len - 1)) * slot_size;
+}
+
+/* Publish the slot returned by shm_if_ring_prod_slot().  Returns true if the
+ * ring was empty before, i.e. the consumer needs to be woken up. */
+static inline bool shm_if_ring_produce(struct shm_if_ring_hdr *hdr)
+{
+	uint32_t head = atomic_load_explicit(&hdr->head, memory_order_relaxed);
+
+	atomic_store_explicit(&hdr->head, head + 1, memory_order_release);
+	/* Order the store above against the load below (see consume()) */
+	atomic_thread_fence(memory_order_seq_cst);
+	return atomic_load_explicit(&hdr->tail, memory_order_relaxed) == head;
+}
+
+/* Release the slot returned by shm_if_ring_cons_slot() */
+static inline void shm_if_ring_consume(struct shm_if_ring_hdr *hdr)
+{
+	uint32_t tail = atomic_load_explicit(&hdr->tail, memory_order_relaxed);
+
+	atomic_store_explicit(&hdr->tail, tail + 1, memory_order_release);
+	/* The consumer re-checks the head after this store, so that a producer
+	 * which has seen a non-empty ring (and thus did not wake us up) cannot
+	 * leave an entry behind. */
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+/* trxcon side of the shared memory interface */
+
+struct shm_instance {
+	/* UNIX domain socket (liveness detection only) */
+	struct osmo_fd sock_ofd;
+	/* Wakeup eventfd: TRX -> L1 (we read it) */
+	struct osmo_fd l1_efd;
+	/* Wakeup eventfd: L1 -> TRX (we write it) */
+	int trx_efd;
+
+	struct shm_if_region *region;
+	struct osmo_fsm_inst *fi;
+	uint32_t fn_advance;
+
+	/* Uplink wakeup is pending until the end of the RTS cycle */
+	bool ul_wakeup;
+	bool draining;
+
+	/* Statistics */
+	unsigned long num_wakeups;
+	unsigned long num_bursts;
+	unsigned long num_ul_overflows;
+
+	/* Some private data */
+	void *priv;
+};
+
+struct shm_if_params {
+	/* Path of the UNIX domain socket the transceiver listens on */
+	const char *sock_path;
+	uint32_t fn_advance;
+
+	struct osmo_fsm_inst *parent_fi;
+	uint32_t parent_term_event;
+	void *priv;
+};
+
+struct shm_instance *shm_if_open(const struct shm_if_params *params);
+void shm_if_close(struct shm_instance *shm);
+
+int shm_if_handle_phyif_burst_req(struct shm_instance *shm, const struct trxcon_phyif_burst_req *br);
+int shm_if_handle_phyif_cmd(struct shm_instance *shm, const struct trxcon_phyif_cmd *cmd);
@@ -8,7 +8,15 @@
 #include <osmocom/bb/trxcon/phyif.h>
 
 #define TRXC_BUF_SIZE	1024
-#define TRXD_BUF_SIZE	512
+/* Large enough for a TRXDv2 PDU carrying 8 batched 8-PSK bursts */
+#define TRXD_BUF_SIZE	4096
+
+/* Max TRXD PDU version supported (and negotiated via SETFORMAT) */
+#define TRXD_VER_MAX	2
+/* Max number of bursts in a single TRXD PDU (TRXDv2: one per timeslot) */
+#define TRXD_BURSTS_MAX	8
+/* Max number of TRXD PDUs received per wakeup (see struct trx_rx_batch) */
+#define TRXD_RX_BATCH_MAX	64
 
 enum trx_fsm_states {
 	TRX_STATE_OFFLINE = 0,
@@ -17,6 +25,50 @@ enum trx_fsm_states {
 	TRX_STATE_RSP_WAIT,
 };
 
+/* A single slot of the TRXD Rx batch (preallocated burst buffer) */
+struct trxd_rx_slot {
+	uint8_t buf[TRXD_BUF_SIZE];
+	struct trxcon_phyif_burst_ind bi[TRXD_BURSTS_MAX];
+};
+
+/* Batched reception of TRXD PDUs using recvmmsg() */
+struct trx_rx_batch {
+	/* Maximum number of PDUs to receive per wakeup */
+	unsigned int max;
+	/* Preallocated ring of burst buffers */
+	struct trxd_rx_slot *slots;
+	struct mmsghdr *msgs;
+	struct iovec *iov;
+	/* Bursts of a wakeup in (FN, TN) order, max * TRXD_BURSTS_MAX entries */
+	struct trxcon_phyif_burst_ind **sorted;
+
+	/* Statistics (for tuning the batch size, see trx_if_stats_dump()) */
+	unsigned long num_wakeups;
+	unsigned long num_bursts;
+	/* Number of wakeups indexed by number of PDUs received [0..max] */
+	unsigned long *pdus_per_wakeup;
+};
+
+/* Batched transmission of TRXD PDUs using sendmmsg() */
+struct trx_tx_batch {
+	/* TDMA frame number of the queued PDUs */
+	uint32_t fn;
+	/* Number of queued PDUs */
+	unsigned int num;
+	/* Number of queued bursts (TRXDv2 packs several bursts into one PDU) */
+	unsigned int num_queued;
+	/* Offset of the last batched TRXDv2 header in the first PDU */
+	unsigned int last_hdr;
+	/* Preallocated burst buffers (one per timeslot) */
+	uint8_t (*bufs)[TRXD_BUF_SIZE];
+	struct mmsghdr *msgs;
+	struct iovec *iov;
+
+	/* Statistics (for tuning) */
+	unsigned long num_flushes;
+	unsigned long num_bursts;
+};
+
 struct trx_instance {
 	struct osmo_fd trx_ofd_ctrl;
 	struct osmo_fd trx_ofd_data;
@@ -26,6 +78,21 @@ struct trx_instance {
 	struct osmo_fsm_inst *fi;
 	uint32_t fn_advance;
 
+	/* TRXD PDU version: configured (max), requested and negotiated (in use) */
+	uint8_t trxd_ver_max;
+	uint8_t trxd_ver_req;
+	uint8_t trxd_ver;
+
+	/* Optional TRXD Rx batching state (NULL if disabled) */
+	struct trx_rx_batch *rx_batch;
+	/* Optional TRXD Tx batching state (NULL if disabled) */
+	struct trx_tx_batch *tx_batch;
+
+	/* Registration for trx_if_stats_dump() */
+	struct llist_head stats_list;
+	bool stats_registered;
+	unsigned int stats_id;
+
 	/* HACK: we need proper state machines */
 	uint32_t prev_state;
 	bool powered_up;
@@ -48,6 +115,12 @@ struct trx_if_params {
 	uint16_t base_port;
 	uint32_t fn_advance;
 	uint8_t instance;
+	/* Max TRXD PDU version to negotiate (0 means no negotiation) */
+	uint8_t trxd_ver;
+	/* Max number of TRXD PDUs per recvmmsg() call (0 or 1 disables batching) */
+	unsigned int rx_batch_max;
+	/* Coalesce Uplink bursts of a TDMA frame into one sendmmsg() call */
+	bool tx_batch;
 
 	struct osmo_fsm_inst *parent_fi;
 	uint32_t parent_term_event;
@@ -57,5 +130,8 @@ struct trx_if_params {
 struct trx_instance *trx_if_open(const struct trx_if_params *params);
 void trx_if_close(struct trx_instance *trx);
 
+void trx_if_stats_register(struct trx_instance *trx, unsigned int id);
+char *trx_if_stats_dump(void *ctx, const char *prefix);
+
 int trx_if_handle_phyif_burst_req(struct trx_instance *trx, const struct trxcon_phyif_burst_req *br);
 int trx_if_handle_phyif_cmd(struct trx_instance *trx, const struct trxcon_phyif_cmd *cmd);
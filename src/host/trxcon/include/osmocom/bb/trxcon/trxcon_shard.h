@@ -0,0 +1,15 @@
+#pragma once
+
+/* Sharded L1CTL server: a set of threads, each running its own event loop
+ * (osmo_select_main()) with its own l1ctl_server.  New connections are
+ * accepted by the thread calling trxcon_shards_alloc() and handed over to
+ * the least loaded shard, where they stay until closed.  All callbacks of
+ * the given l1ctl_server_cfg are invoked from within the shard's thread. */
+
+#include <osmocom/bb/trxcon/l1ctl_server.h>
+
+struct trxcon_shards;
+
+struct trxcon_shards *trxcon_shards_alloc(void *ctx, unsigned int num_shards,
+					  const struct l1ctl_server_cfg *cfg);
+void trxcon_shards_free(struct trxcon_shards *shards);
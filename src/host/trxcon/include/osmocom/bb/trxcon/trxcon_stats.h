@@ -0,0 +1,13 @@
+#pragma once
+
+/* Export of the scheduler performance counters: every connection to the
+ * given UNIX socket gets a dump of all registered l1sched and TRXD interface
+ * instances in the Prometheus text format, after which the connection is
+ * closed, e.g.:
+ *
+ *   socat - UNIX-CONNECT:/tmp/trxcon_stats */
+
+struct trxcon_stats_server;
+
+struct trxcon_stats_server *trxcon_stats_server_alloc(void *ctx, const char *sock_path);
+void trxcon_stats_server_free(struct trxcon_stats_server *server);
@@ -0,0 +1,18 @@
+#pragma once
+
+/* TRXD soft-bit conversion: unsigned soft-bits {254..0} (as sent by the
+ * transceiver, 255 is clamped to 254) to signed soft-bits {-127..127}.
+ * Several kernels (SSE2/AVX2/NEON and a generic one) are available,
+ * the fastest supported by the CPU is selected at runtime. */
+
+#include <stdint.h>
+
+#include <osmocom/core/bits.h>
+
+/* Convert len ubits to sbits, out may be equal to in (in-place) */
+void trxd_ubit2sbit(sbit_t *out, const uint8_t *in, unsigned int len);
+
+/* Name of the currently selected kernel */
+const char *trxd_ubit2sbit_kernel(void);
+/* Select a kernel by name, return -ENOTSUP if not supported by the CPU */
+int trxd_ubit2sbit_select(const char *name);
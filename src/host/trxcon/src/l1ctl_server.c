@@ -25,15 +25,16 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
 
 #include <sys/un.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/select.h>
 #include <osmocom/core/socket.h>
-#include <osmocom/core/write_queue.h>
 
 #include <osmocom/bb/trxcon/logging.h>
 #include <osmocom/bb/trxcon/l1ctl_server.h>
@@ -41,80 +42,196 @@
 #define LOGP_CLI(cli, cat, level, fmt, args...) \
 	LOGP(cat, level, "%s" fmt, (cli)->log_prefix, ## args)
 
-static int l1ctl_client_read_cb(struct osmo_fd *ofd)
+/* Parse and dispatch all complete frames in the Rx buffer */
+static int l1ctl_client_rx_dispatch(struct l1ctl_client *client)
 {
-	struct l1ctl_client *client = (struct l1ctl_client *)ofd->data;
+	size_t offset = 0;
 	struct msgb *msg;
 	uint16_t len;
-	int rc;
 
-	/* Attempt to read from socket */
-	rc = read(ofd->fd, &len, L1CTL_MSG_LEN_FIELD);
-	if (rc != L1CTL_MSG_LEN_FIELD) {
-		if (rc <= 0) {
+	while (client->rx_buf_len - offset >= L1CTL_MSG_LEN_FIELD) {
+		len = osmo_load16be(&client->rx_buf[offset]);
+		if (len > L1CTL_LENGTH) {
+			/* There is no way to re-synchronize with the stream */
+			LOGP_CLI(client, DL1D, LOGL_ERROR, "Length is too big: %u\n", len);
+			l1ctl_client_conn_close(client);
+			return -EBADF;
+		}
+
+		/* Wait for the rest of a partially received frame */
+		if (client->rx_buf_len - offset < L1CTL_MSG_LEN_FIELD + len)
+			break;
+		offset += L1CTL_MSG_LEN_FIELD;
+
+		/* Allocate a new msg */
+		msg = msgb_alloc_headroom(L1CTL_LENGTH + L1CTL_HEADROOM,
+			L1CTL_HEADROOM, "l1ctl_rx_msg");
+		if (!msg) {
+			LOGP_CLI(client, DL1D, LOGL_ERROR, "Failed to allocate msg\n");
+			offset += len;
+			continue;
+		}
+
+		msg->l1h = msgb_put(msg, len);
+		memcpy(msg->l1h, &client->rx_buf[offset], len);
+		offset += len;
+
+		/* Debug print */
+		LOGP_CLI(client, DL1D, LOGL_DEBUG, "RX: '%s'\n", osmo_hexdump(msg->data, msg->len));
+
+		/* Call L1CTL handler, which may close the connection */
+		client->rx_dispatching = true;
+		client->server->cfg->conn_read_cb(client, msg);
+		client->rx_dispatching = false;
+
+		if (client->closed) {
+			talloc_free(client);
+			return -EBADF;
+		}
+	}
+
+	/* Move the remainder (if any) to the beginning of the buffer */
+	client->rx_buf_len -= offset;
+	if (client->rx_buf_len > 0 && offset > 0)
+		memmove(&client->rx_buf[0], &client->rx_buf[offset], client->rx_buf_len);
+
+	return 0;
+}
+
+static int l1ctl_client_read_cb(struct l1ctl_client *client)
+{
+	ssize_t rc;
+
+	/* Read as much as we can, this may be several frames at once */
+	rc = read(client->ofd.fd, &client->rx_buf[client->rx_buf_len],
+		  sizeof(client->rx_buf) - client->rx_buf_len);
+	if (rc <= 0) {
+		if (rc < 0 && (errno == EAGAIN || errno == EINTR))
+			return 0;
+		if (rc == 0) {
 			LOGP_CLI(client, DL1D, LOGL_NOTICE,
-				 "L1CTL connection error: read() failed (rc=%d): %s\n",
-				 rc, strerror(errno));
+				 "L1CTL connection error: connection closed\n");
 		} else {
 			LOGP_CLI(client, DL1D, LOGL_NOTICE,
-				 "L1CTL connection error: short read\n");
-			rc = -EIO;
+				 "L1CTL connection error: read() failed (rc=%zd): %s\n",
+				 rc, strerror(errno));
 		}
 		l1ctl_client_conn_close(client);
 		return -EBADF; /* client fd is gone, avoid processing any other events. */
 	}
 
-	/* Check message length */
-	len = ntohs(len);
-	if (len > L1CTL_LENGTH) {
-		LOGP_CLI(client, DL1D, LOGL_ERROR, "Length is too big: %u\n", len);
-		return -EINVAL;
+	client->rx_buf_len += rc;
+
+	return l1ctl_client_rx_dispatch(client);
+}
+
+static int l1ctl_client_write_cb(struct l1ctl_client *client)
+{
+	struct iovec iov[L1CTL_TX_BATCH_MAX];
+	unsigned int iov_len = 0;
+	struct msgb *msg;
+	ssize_t rc;
+
+	/* Coalesce pending messages into a single writev() call */
+	llist_for_each_entry(msg, &client->tx_queue, list) {
+		iov[iov_len] = (struct iovec) {
+			.iov_base = msg->data,
+			.iov_len = msg->len,
+		};
+		if (iov_len++ == 0) {
+			iov[0].iov_base = msg->data + client->tx_offset;
+			iov[0].iov_len -= client->tx_offset;
+		}
+		if (iov_len == ARRAY_SIZE(iov))
+			break;
 	}
 
-	/* Allocate a new msg */
-	msg = msgb_alloc_headroom(L1CTL_LENGTH + L1CTL_HEADROOM,
-		L1CTL_HEADROOM, "l1ctl_rx_msg");
-	if (!msg) {
-		LOGP_CLI(client, DL1D, LOGL_ERROR, "Failed to allocate msg\n");
-		return -ENOMEM;
+	if (iov_len == 0) {
+		osmo_fd_write_disable(&client->ofd);
+		return 0;
 	}
 
-	msg->l1h = msgb_put(msg, len);
-	rc = read(ofd->fd, msg->l1h, msgb_l1len(msg));
-	if (rc != len) {
+	rc = writev(client->ofd.fd, iov, iov_len);
+	if (rc < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
 		LOGP_CLI(client, DL1D, LOGL_ERROR,
-			 "Can not read data: len=%d < rc=%d: %s\n",
-			 len, rc, strerror(errno));
+			 "Failed to write data: %s\n", strerror(errno));
+		l1ctl_client_conn_close(client);
+		return -EBADF;
+	}
+
+	/* Dequeue completely written messages, remember where we stopped */
+	rc += client->tx_offset;
+	while (!llist_empty(&client->tx_queue)) {
+		msg = llist_first_entry(&client->tx_queue, struct msgb, list);
+		if (rc < msg->len)
+			break;
+		rc -= msg->len;
+		llist_del(&msg->list);
+		client->tx_queue_len--;
 		msgb_free(msg);
-		return rc;
 	}
 
-	/* Debug print */
-	LOGP_CLI(client, DL1D, LOGL_DEBUG, "RX: '%s'\n", osmo_hexdump(msg->data, msg->len));
+	client->tx_offset = rc;
 
-	/* Call L1CTL handler */
-	client->server->cfg->conn_read_cb(client, msg);
+	if (llist_empty(&client->tx_queue))
+		osmo_fd_write_disable(&client->ofd);
 
 	return 0;
 }
 
-static int l1ctl_client_write_cb(struct osmo_fd *ofd, struct msgb *msg)
+static int l1ctl_client_fd_cb(struct osmo_fd *ofd, unsigned int what)
 {
 	struct l1ctl_client *client = (struct l1ctl_client *)ofd->data;
-	int len;
+	int rc = 0;
 
-	if (ofd->fd <= 0)
-		return -EINVAL;
+	if (what & OSMO_FD_READ) {
+		rc = l1ctl_client_read_cb(client);
+		if (rc == -EBADF)
+			return rc;
+	}
 
-	len = write(ofd->fd, msg->data, msg->len);
-	if (len != msg->len) {
-		LOGP_CLI(client, DL1D, LOGL_ERROR,
-			 "Failed to write data: written (%d) < msg_len (%d)\n",
-			 len, msg->len);
-		return -1;
+	if (what & OSMO_FD_WRITE)
+		rc = l1ctl_client_write_cb(client);
+
+	return rc;
+}
+
+struct l1ctl_client *l1ctl_client_alloc(struct l1ctl_server *server, int fd)
+{
+	struct l1ctl_client *client;
+	int flags;
+
+	client = talloc_zero(server, struct l1ctl_client);
+	if (client == NULL) {
+		LOGP(DL1C, LOGL_ERROR, "Failed to allocate an L1CTL client\n");
+		return NULL;
 	}
 
-	return 0;
+	/* Partial reads and writes are handled, never block */
+	flags = fcntl(fd, F_GETFL);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+		LOGP(DL1C, LOGL_ERROR, "Failed to set O_NONBLOCK: %s\n", strerror(errno));
+		talloc_free(client);
+		return NULL;
+	}
+
+	INIT_LLIST_HEAD(&client->tx_queue);
+	osmo_fd_setup(&client->ofd, fd, OSMO_FD_READ, &l1ctl_client_fd_cb, client, 0);
+
+	if (osmo_fd_register(&client->ofd) != 0) {
+		LOGP(DL1C, LOGL_ERROR, "Failed to register a new connection fd\n");
+		talloc_free(client);
+		return NULL;
+	}
+
+	llist_add_tail(&client->list, &server->clients);
+	client->id = server->next_client_id++;
+	client->server = server;
+	server->num_clients++;
+
+	return client;
 }
 
 /* Connection handler */
@@ -122,7 +239,7 @@ static int l1ctl_server_conn_cb(struct osmo_fd *sfd, unsigned int flags)
 {
 	struct l1ctl_server *server = (struct l1ctl_server *)sfd->data;
 	struct l1ctl_client *client;
-	int rc, client_fd;
+	int client_fd;
 
 	client_fd = accept(sfd->fd, NULL, NULL);
 	if (client_fd < 0) {
@@ -139,35 +256,12 @@ static int l1ctl_server_conn_cb(struct osmo_fd *sfd, unsigned int flags)
 		return -ENOMEM;
 	}
 
-	client = talloc_zero(server, struct l1ctl_client);
+	client = l1ctl_client_alloc(server, client_fd);
 	if (client == NULL) {
-		LOGP(DL1C, LOGL_ERROR, "Failed to allocate an L1CTL client\n");
 		close(client_fd);
 		return -ENOMEM;
 	}
 
-	/* Init the client's write queue */
-	osmo_wqueue_init(&client->wq, 100);
-	INIT_LLIST_HEAD(&client->wq.bfd.list);
-
-	client->wq.write_cb = &l1ctl_client_write_cb;
-	client->wq.read_cb = &l1ctl_client_read_cb;
-	osmo_fd_setup(&client->wq.bfd, client_fd, OSMO_FD_READ, &osmo_wqueue_bfd_cb, client, 0);
-
-	/* Register the client's write queue */
-	rc = osmo_fd_register(&client->wq.bfd);
-	if (rc != 0) {
-		LOGP(DL1C, LOGL_ERROR, "Failed to register a new connection fd\n");
-		close(client->wq.bfd.fd);
-		talloc_free(client);
-		return rc;
-	}
-
-	llist_add_tail(&client->list, &server->clients);
-	client->id = server->next_client_id++;
-	client->server = server;
-	server->num_clients++;
-
 	LOGP(DL1C, LOGL_NOTICE, "L1CTL server got a new connection (id=%u)\n", client->id);
 
 	if (client->server->cfg->conn_accept_cb != NULL)
@@ -190,18 +284,28 @@ int l1ctl_client_send(struct l1ctl_client *client, struct msgb *msg)
 	len = msgb_push(msg, L1CTL_MSG_LEN_FIELD);
 	osmo_store16be(msg->len - L1CTL_MSG_LEN_FIELD, len);
 
-	if (osmo_wqueue_enqueue(&client->wq, msg) != 0) {
+	if (client->closed || client->tx_queue_len >= L1CTL_TX_QUEUE_MAX) {
 		LOGP_CLI(client, DL1D, LOGL_ERROR, "Failed to enqueue msg!\n");
 		msgb_free(msg);
 		return -EIO;
 	}
 
+	/* Pending messages are written at once when the socket becomes writable */
+	msgb_enqueue(&client->tx_queue, msg);
+	client->tx_queue_len++;
+	osmo_fd_write_enable(&client->ofd);
+
 	return 0;
 }
 
 void l1ctl_client_conn_close(struct l1ctl_client *client)
 {
 	struct l1ctl_server *server = client->server;
+	struct msgb *msg;
+
+	/* Already closed from within conn_read_cb */
+	if (client->closed)
+		return;
 
 	LOGP_CLI(client, DL1C, LOGL_NOTICE, "Closing L1CTL connection\n");
 
@@ -209,16 +313,23 @@ void l1ctl_client_conn_close(struct l1ctl_client *client)
 		server->cfg->conn_close_cb(client);
 
 	/* Close connection socket */
-	osmo_fd_unregister(&client->wq.bfd);
-	close(client->wq.bfd.fd);
-	client->wq.bfd.fd = -1;
+	osmo_fd_unregister(&client->ofd);
+	close(client->ofd.fd);
+	client->ofd.fd = -1;
 
 	/* Clear pending messages */
-	osmo_wqueue_clear(&client->wq);
+	while ((msg = msgb_dequeue(&client->tx_queue)) != NULL)
+		msgb_free(msg);
+	client->tx_queue_len = 0;
 
 	client->server->num_clients--;
 	llist_del(&client->list);
-	talloc_free(client);
+
+	/* l1ctl_client_rx_dispatch() is still using the client, it frees it */
+	if (client->rx_dispatching)
+		client->closed = true;
+	else
+		talloc_free(client);
 
 	/* If this was the last client, reset the client IDs generator to 0.
 	 * This way avoid assigning huge unreadable client IDs like 26545. */
@@ -231,7 +342,8 @@ struct l1ctl_server *l1ctl_server_alloc(void *ctx, const struct l1ctl_server_cfg
 	struct l1ctl_server *server;
 	int rc;
 
-	LOGP(DL1C, LOGL_NOTICE, "Init L1CTL server (sock_path=%s)\n", cfg->sock_path);
+	LOGP(DL1C, LOGL_NOTICE, "Init L1CTL server (sock_path=%s)\n",
+	     cfg->sock_path != NULL ? cfg->sock_path : "none");
 
 	server = talloc(ctx, struct l1ctl_server);
 	OSMO_ASSERT(server != NULL);
@@ -247,6 +359,10 @@ struct l1ctl_server *l1ctl_server_alloc(void *ctx, const struct l1ctl_server_cfg
 	/* Bind connection handler */
 	osmo_fd_setup(&server->ofd, -1, OSMO_FD_READ, &l1ctl_server_conn_cb, server, 0);
 
+	/* Connections accepted elsewhere are added using l1ctl_client_alloc() */
+	if (cfg->sock_path == NULL)
+		return server;
+
 	rc = osmo_sock_unix_init_ofd(&server->ofd, SOCK_STREAM, 0,
 				     cfg->sock_path, OSMO_SOCK_F_BIND);
 	if (rc < 0) {
@@ -0,0 +1,176 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * TDMA scheduler: A5/X ciphering with keystream caching
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/gsm/a5.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+
+/* The keystream depends on the key and the TDMA frame number only, and
+ * osmo_a5() generates both the Downlink and the Uplink keystream at once.
+ * It is generated in batches of up to L1SCHED_A5_KS_BATCH frames of the
+ * lchan: once the Tx clock (which runs ahead of the Rx path) has reached
+ * the last frame of the current batch, l1sched_a5_ks_prefetch() generates
+ * the next one, so that the Rx path finds the keystream ready.  A miss
+ * (first bursts after the key was set) falls back to generating the batch
+ * on the spot. */
+
+#define A5_KS_FN_INVALID	0xffffffff
+/* A batch spans at most half of the cache, so that the frames the Rx path
+ * (lagging behind the Tx path) still needs are not overwritten */
+#define A5_KS_WINDOW		(L1SCHED_A5_KS_CACHE_SIZE / 2)
+
+static struct l1sched_a5_ks *a5_ks_slot(struct l1sched_lchan_state *lchan, uint32_t fn)
+{
+	return &lchan->a5.ks_cache[fn % L1SCHED_A5_KS_CACHE_SIZE];
+}
+
+static void a5_ks_gen(struct l1sched_lchan_state *lchan, uint32_t fn)
+{
+	struct l1sched_a5_ks *ks = a5_ks_slot(lchan, fn);
+
+	if (ks->fn != fn) {
+		osmo_a5(lchan->a5.algo, lchan->a5.key, fn, ks->dl, ks->ul);
+		ks->fn = fn;
+	}
+}
+
+/* Generate the keystream for the frames of the lchan starting at fn */
+static void a5_ks_gen_batch(struct l1sched_lchan_state *lchan, uint32_t fn)
+{
+	const struct l1sched_tdma_multiframe *mf = lchan->ts->mf_layout;
+	unsigned int i, n = 0;
+
+	for (i = 0; i < A5_KS_WINDOW && n < L1SCHED_A5_KS_BATCH; i++) {
+		const struct l1sched_tdma_frame *fp = &mf->frames[fn % mf->period];
+
+		if (fp->dl_chan == lchan->type || fp->ul_chan == lchan->type) {
+			a5_ks_gen(lchan, fn);
+			lchan->a5.ks_fn_last = fn;
+			n++;
+		}
+
+		fn = GSM_TDMA_FN_INC(fn);
+	}
+}
+
+static void a5_ks_cache_alloc(struct l1sched_lchan_state *lchan)
+{
+	lchan->a5.ks_cache = talloc_array(lchan, struct l1sched_a5_ks,
+					  L1SCHED_A5_KS_CACHE_SIZE);
+	OSMO_ASSERT(lchan->a5.ks_cache != NULL);
+	l1sched_a5_ks_invalidate(lchan);
+}
+
+static const struct l1sched_a5_ks *a5_ks_get(struct l1sched_lchan_state *lchan, uint32_t fn)
+{
+	struct l1sched_a5_ks *ks;
+
+	if (lchan->a5.ks_cache == NULL)
+		a5_ks_cache_alloc(lchan);
+
+	ks = a5_ks_slot(lchan, fn);
+	if (ks->fn != fn) {
+		a5_ks_gen_batch(lchan, fn);
+		/* fn may be out of the lchan's frames (e.g. handover RACH) */
+		a5_ks_gen(lchan, fn);
+	}
+
+	return ks;
+}
+
+/* Called by the Tx clock on each Downlink frame of the lchan, ahead of
+ * the Rx path: generate the next batch of keystream once the given frame
+ * is (past) the last one of the current batch.  Nothing is done on the
+ * frames in between. */
+void l1sched_a5_ks_prefetch(struct l1sched_lchan_state *lchan, uint32_t fn)
+{
+	if (lchan->a5.ks_cache == NULL)
+		a5_ks_cache_alloc(lchan);
+
+	/* Still before the last frame of the current batch? */
+	if (lchan->a5.ks_fn_last != A5_KS_FN_INVALID) {
+		const uint32_t ahead = GSM_TDMA_FN_SUB(lchan->a5.ks_fn_last, fn);
+
+		if (ahead > 0 && ahead <= A5_KS_WINDOW)
+			return;
+	}
+
+	a5_ks_gen_batch(lchan, fn);
+}
+
+void l1sched_a5_ks_invalidate(struct l1sched_lchan_state *lchan)
+{
+	unsigned int i;
+
+	if (lchan->a5.ks_cache == NULL)
+		return;
+
+	for (i = 0; i < L1SCHED_A5_KS_CACHE_SIZE; i++)
+		lchan->a5.ks_cache[i].fn = A5_KS_FN_INVALID;
+	lchan->a5.ks_fn_last = A5_KS_FN_INVALID;
+}
+
+void l1sched_a5_reset(struct l1sched_lchan_state *lchan)
+{
+	talloc_free(lchan->a5.ks_cache);
+	memset(&lchan->a5, 0x00, sizeof(lchan->a5));
+}
+
+/* Branch-free kernels, so that the compiler can vectorize them */
+
+static inline void a5_sbit_apply(sbit_t *sb, const ubit_t *ks, unsigned int n)
+{
+	unsigned int i;
+
+	/* Negate soft-bits where the keystream bit is set: (x ^ m) - m */
+	for (i = 0; i < n; i++) {
+		const int8_t m = -(int8_t)ks[i];
+		sb[i] = (sbit_t)((sb[i] ^ m) - m);
+	}
+}
+
+static inline void a5_ubit_apply(ubit_t *ub, const ubit_t *ks, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		ub[i] ^= ks[i];
+}
+
+void l1sched_a5_burst_dec(struct l1sched_lchan_state *lchan,
+			  struct l1sched_burst_ind *bi)
+{
+	const struct l1sched_a5_ks *ks = a5_ks_get(lchan, bi->fn);
+
+	/* Apply keystream over ciphertext */
+	a5_sbit_apply(&bi->burst[3], &ks->dl[0], 57);
+	a5_sbit_apply(&bi->burst[88], &ks->dl[57], 57);
+}
+
+void l1sched_a5_burst_enc(struct l1sched_lchan_state *lchan,
+			  struct l1sched_burst_req *br)
+{
+	const struct l1sched_a5_ks *ks = a5_ks_get(lchan, br->fn);
+
+	/* Apply keystream over plaintext */
+	a5_ubit_apply(&br->burst[3], &ks->ul[0], 57);
+	a5_ubit_apply(&br->burst[88], &ks->ul[57], 57);
+}
@@ -0,0 +1,322 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * TDMA scheduler: capture and replay of the scheduler input
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/logging.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1sched/capture.h>
+#include <osmocom/bb/l1sched/logging.h>
+
+struct l1sched_capture {
+	FILE *fp;
+	/* Time of the first record */
+	struct timespec start;
+	unsigned long num_bursts;
+	bool failed;
+};
+
+static void capture_write(struct l1sched_state *sched, uint16_t type,
+			  const void *hdr, size_t hdr_len,
+			  const void *data, size_t data_len)
+{
+	struct l1sched_capture *cap = sched->capture;
+	struct l1sched_capture_rec rec;
+	struct timespec now;
+
+	if (cap->failed)
+		return;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+
+	rec = (struct l1sched_capture_rec) {
+		.time_ns = (uint64_t)(now.tv_sec - cap->start.tv_sec) * 1000000000
+			 + (now.tv_nsec - cap->start.tv_nsec),
+		.type = type,
+		.len = hdr_len + data_len,
+	};
+
+	if (fwrite(&rec, sizeof(rec), 1, cap->fp) != 1 ||
+	    fwrite(hdr, hdr_len, 1, cap->fp) != 1 ||
+	    (data_len > 0 && fwrite(data, data_len, 1, cap->fp) != 1)) {
+		LOGP_SCHEDC(sched, LOGL_ERROR, "Failed to write capture record, "
+			    "stopping the capture\n");
+		cap->failed = true;
+	}
+}
+
+void l1sched_capture_burst(struct l1sched_state *sched,
+			   const struct l1sched_burst_ind *bi)
+{
+	const struct l1sched_capture_burst_ind cbi = {
+		.fn = bi->fn,
+		.tn = bi->tn,
+		.rssi = bi->rssi,
+		.toa256 = bi->toa256,
+		.burst_len = bi->burst_len,
+	};
+
+	if (sched->capture == NULL)
+		return;
+
+	capture_write(sched, L1SCHED_CAPTURE_REC_BURST_IND,
+		      &cbi, sizeof(cbi), &bi->burst[0], bi->burst_len);
+	sched->capture->num_bursts++;
+}
+
+void l1sched_capture_cfg(struct l1sched_state *sched,
+			 enum l1sched_capture_rec_type type,
+			 const struct l1sched_capture_cfg *cfg)
+{
+	if (sched->capture == NULL)
+		return;
+	capture_write(sched, type, cfg, sizeof(*cfg), NULL, 0);
+}
+
+/* Record the current configuration, so that the capture is self-contained */
+static void capture_snapshot(struct l1sched_state *sched)
+{
+	for (unsigned int tn = 0; tn < ARRAY_SIZE(sched->ts); tn++) {
+		const struct l1sched_ts *ts = sched->ts[tn];
+		const struct l1sched_lchan_state *lchan;
+
+		if (ts == NULL || ts->mf_layout == NULL)
+			continue;
+
+		l1sched_capture_cfg(sched, L1SCHED_CAPTURE_REC_CONFIGURE_TS,
+				    &(struct l1sched_capture_cfg) {
+			.tn = tn,
+			.configure_ts.pchan = ts->mf_layout->chan_config,
+		});
+
+		llist_for_each_entry(lchan, &ts->lchans, list) {
+			struct l1sched_capture_cfg cfg = {
+				.tn = tn,
+				.lchan.type = lchan->type,
+				.lchan.tch_mode = lchan->tch_mode,
+			};
+
+			if (!lchan->active)
+				continue;
+
+			/* Automatically activated by l1sched_configure_ts() */
+			if (!(l1sched_lchan_desc[lchan->type].flags & L1SCHED_CH_FLAG_AUTO))
+				l1sched_capture_cfg(sched, L1SCHED_CAPTURE_REC_ACTIVATE_LCHAN, &cfg);
+			l1sched_capture_cfg(sched, L1SCHED_CAPTURE_REC_TCH_MODE, &cfg);
+
+			if (lchan->amr.codecs > 0) {
+				uint8_t codecs_bitmask = 0;
+
+				for (unsigned int i = 0; i < lchan->amr.codecs; i++)
+					codecs_bitmask |= (1 << lchan->amr.codec[i]);
+				cfg = (struct l1sched_capture_cfg) {
+					.tn = tn,
+					.amr_cfg.type = lchan->type,
+					.amr_cfg.codecs_bitmask = codecs_bitmask,
+					.amr_cfg.start_codec = lchan->amr.dl_ft,
+				};
+				l1sched_capture_cfg(sched, L1SCHED_CAPTURE_REC_AMR_CFG, &cfg);
+			}
+
+			/* The same A5/X configuration applies to all active lchans */
+			if (lchan->a5.algo) {
+				cfg = (struct l1sched_capture_cfg) {
+					.tn = tn,
+					.ciphering.algo = lchan->a5.algo,
+					.ciphering.key_len = lchan->a5.key_len,
+				};
+				memcpy(&cfg.ciphering.key[0], &lchan->a5.key[0], lchan->a5.key_len);
+				l1sched_capture_cfg(sched, L1SCHED_CAPTURE_REC_CIPHERING, &cfg);
+			}
+		}
+	}
+}
+
+int l1sched_capture_start(struct l1sched_state *sched, const char *path)
+{
+	const struct l1sched_capture_file_hdr hdr = {
+		.magic = L1SCHED_CAPTURE_MAGIC,
+		.version = L1SCHED_CAPTURE_VERSION,
+	};
+	struct l1sched_capture *cap;
+	int rc;
+
+	if (sched->capture != NULL)
+		return -EALREADY;
+
+	cap = talloc_zero(sched, struct l1sched_capture);
+	if (cap == NULL)
+		return -ENOMEM;
+
+	cap->fp = fopen(path, "wb");
+	if (cap->fp == NULL) {
+		rc = -errno;
+		talloc_free(cap);
+		return rc;
+	}
+
+	if (fwrite(&hdr, sizeof(hdr), 1, cap->fp) != 1) {
+		fclose(cap->fp);
+		talloc_free(cap);
+		return -EIO;
+	}
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &cap->start);
+	sched->capture = cap;
+
+	LOGP_SCHEDC(sched, LOGL_NOTICE, "Capturing the scheduler input to '%s'\n", path);
+
+	capture_snapshot(sched);
+
+	return 0;
+}
+
+void l1sched_capture_stop(struct l1sched_state *sched)
+{
+	struct l1sched_capture *cap = sched->capture;
+
+	if (cap == NULL)
+		return;
+
+	LOGP_SCHEDC(sched, LOGL_NOTICE, "Capture stopped (%lu bursts)\n", cap->num_bursts);
+
+	fclose(cap->fp);
+	sched->capture = NULL;
+	talloc_free(cap);
+}
+
+const struct l1sched_capture_rec *l1sched_capture_next(const uint8_t *buf, size_t len,
+							size_t *offset)
+{
+	const struct l1sched_capture_rec *rec;
+
+	/* Skip the file header */
+	if (*offset == 0) {
+		const struct l1sched_capture_file_hdr *hdr = (const void *)buf;
+
+		if (len < sizeof(*hdr))
+			return NULL;
+		if (hdr->magic != L1SCHED_CAPTURE_MAGIC || hdr->version != L1SCHED_CAPTURE_VERSION)
+			return NULL;
+		*offset = sizeof(*hdr);
+	}
+
+	if (len - *offset < sizeof(*rec))
+		return NULL;
+	rec = (const void *)&buf[*offset];
+	if (len - *offset - sizeof(*rec) < rec->len)
+		return NULL;
+
+	*offset += sizeof(*rec) + rec->len;
+	return rec;
+}
+
+static int capture_apply_burst(struct l1sched_state *sched,
+			       const struct l1sched_capture_rec *rec)
+{
+	const struct l1sched_capture_burst_ind *cbi = (const void *)&rec->payload[0];
+	struct l1sched_burst_ind bi;
+
+	if (rec->len < sizeof(*cbi) || rec->len - sizeof(*cbi) < cbi->burst_len)
+		return -EINVAL;
+	if (cbi->burst_len > sizeof(bi.burst) || cbi->tn >= ARRAY_SIZE(sched->ts))
+		return -EINVAL;
+
+	bi = (struct l1sched_burst_ind) {
+		.fn = cbi->fn,
+		.tn = cbi->tn,
+		.rssi = cbi->rssi,
+		.toa256 = cbi->toa256,
+		.burst_len = cbi->burst_len,
+	};
+	memcpy(&bi.burst[0], &cbi->burst[0], cbi->burst_len);
+
+	return l1sched_handle_rx_burst(sched, &bi);
+}
+
+int l1sched_capture_apply(struct l1sched_state *sched,
+			  const struct l1sched_capture_rec *rec)
+{
+	const struct l1sched_capture_cfg *cfg = (const void *)&rec->payload[0];
+	struct l1sched_lchan_state *lchan;
+	struct l1sched_ts *ts;
+
+	if (rec->type == L1SCHED_CAPTURE_REC_BURST_IND)
+		return capture_apply_burst(sched, rec);
+	if (rec->type == L1SCHED_CAPTURE_REC_RESET) {
+		l1sched_reset(sched);
+		return 0;
+	}
+
+	/* All other records are configuration commands */
+	if (rec->len < sizeof(*cfg) || cfg->tn >= ARRAY_SIZE(sched->ts))
+		return -EINVAL;
+
+	switch (rec->type) {
+	case L1SCHED_CAPTURE_REC_CONFIGURE_TS:
+		return l1sched_configure_ts(sched, cfg->tn, cfg->configure_ts.pchan);
+	case L1SCHED_CAPTURE_REC_DEL_TS:
+		l1sched_del_ts(sched, cfg->tn);
+		return 0;
+	default:
+		break;
+	}
+
+	/* The remaining commands apply to a configured timeslot */
+	ts = sched->ts[cfg->tn];
+	if (ts == NULL || ts->mf_layout == NULL)
+		return -ENODEV;
+
+	switch (rec->type) {
+	case L1SCHED_CAPTURE_REC_SET_LCHANS:
+		return l1sched_set_lchans(ts, cfg->set_lchans.chan_nr,
+					  cfg->set_lchans.active,
+					  cfg->set_lchans.tch_mode,
+					  cfg->set_lchans.tsc);
+	case L1SCHED_CAPTURE_REC_ACTIVATE_LCHAN:
+		if (cfg->lchan.type >= _L1SCHED_CHAN_MAX)
+			return -EINVAL;
+		return l1sched_activate_lchan(ts, cfg->lchan.type);
+	case L1SCHED_CAPTURE_REC_DEACTIVATE_ALL:
+		l1sched_deactivate_all_lchans(ts);
+		return 0;
+	case L1SCHED_CAPTURE_REC_CIPHERING:
+		return l1sched_start_ciphering(ts, cfg->ciphering.algo,
+					       cfg->ciphering.key,
+					       cfg->ciphering.key_len);
+	case L1SCHED_CAPTURE_REC_AMR_CFG:
+		lchan = l1sched_find_lchan_by_type(ts, cfg->amr_cfg.type);
+		if (lchan == NULL)
+			return -ENODEV;
+		return l1sched_lchan_set_amr_cfg(lchan, cfg->amr_cfg.codecs_bitmask,
+						 cfg->amr_cfg.start_codec);
+	case L1SCHED_CAPTURE_REC_TCH_MODE:
+		lchan = l1sched_find_lchan_by_type(ts, cfg->lchan.type);
+		if (lchan == NULL)
+			return -ENODEV;
+		lchan->tch_mode = cfg->lchan.tch_mode;
+		return 0;
+	default:
+		return -ENOTSUP;
+	}
+}
@@ -0,0 +1,420 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * TDMA scheduler: offloading of channel decoding to worker threads
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * The lchan handlers collect bursts and submit complete blocks to a pool of
+ * worker threads.  Jobs live in a ring owned by the main thread: it fills
+ * the ring at the head and delivers decoded blocks from the tail, strictly
+ * in submission order.  Workers pick jobs under a mutex, but they hand the
+ * results back without locking: by setting the job's 'done' flag and
+ * waking up the main loop through an eventfd.
+ *
+ * Primitives which do not need decoding (e.g. DATA.cnf) are queued as
+ * already completed jobs while there are blocks being decoded, so that the
+ * user observes exactly the same order as with inline decoding.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sys/eventfd.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/coding/gsm0503_coding.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1sched/logging.h>
+
+/* Max number of jobs in flight (must be a power of 2) */
+#define L1SCHED_DEC_RING_LEN	256
+
+struct l1sched_dec_job {
+	/* Decoding job or a primitive to be delivered as-is */
+	bool is_prim;
+	struct msgb *msg;
+
+	/* Set by a worker once the result is ready */
+	atomic_bool done;
+
+	/* Decoding context (snapshot at submission time) */
+	enum l1sched_dec_type type;
+	uint8_t tn;
+	enum l1sched_lchan_type lchan_type;
+	struct l1sched_meas_set meas;
+	sbit_t bursts[4 * 116];
+
+	/* Decoding result */
+	uint8_t l2[GPRS_L2_MAX_LEN];
+	int rc;
+	int n_errors;
+	int n_bits_total;
+
+	/* Decoding time (only if sched->stats.dec_timing is enabled) */
+	bool timed;
+	uint64_t time_ns;
+};
+
+struct l1sched_decoder {
+	struct l1sched_state *sched;
+
+	/* Ring of jobs, head and tail are only accessed by the main thread */
+	struct l1sched_dec_job jobs[L1SCHED_DEC_RING_LEN];
+	uint32_t head;
+	uint32_t tail;
+
+	/* Work distribution (protected by the mutex) */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint32_t work_next;
+	uint32_t work_end;
+	bool stop;
+
+	pthread_t *workers;
+	unsigned int num_workers;
+
+	/* Workers -> main thread wakeup */
+	struct osmo_fd efd;
+};
+
+#define DEC_JOB(dec, idx) \
+	(&(dec)->jobs[(idx) & (L1SCHED_DEC_RING_LEN - 1)])
+
+static void dec_job_decode(struct l1sched_dec_job *job)
+{
+	struct timespec t0, t1;
+
+	if (job->timed)
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	switch (job->type) {
+	case L1SCHED_DEC_XCCH:
+		job->rc = gsm0503_xcch_decode(&job->l2[0], &job->bursts[0],
+					      &job->n_errors, &job->n_bits_total);
+		break;
+	case L1SCHED_DEC_PDTCH:
+		job->rc = gsm0503_pdtch_decode(&job->l2[0], &job->bursts[0], NULL,
+					       &job->n_errors, &job->n_bits_total);
+		break;
+	}
+
+	if (job->timed) {
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		job->time_ns = (uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000
+			     + (t1.tv_nsec - t0.tv_nsec);
+	}
+}
+
+static void *dec_worker(void *arg)
+{
+	struct l1sched_decoder *dec = arg;
+	const uint64_t val = 1;
+
+	while (1) {
+		struct l1sched_dec_job *job;
+
+		pthread_mutex_lock(&dec->lock);
+		while (1) {
+			/* Skip primitives, they need no decoding */
+			while (dec->work_next != dec->work_end &&
+			       DEC_JOB(dec, dec->work_next)->is_prim)
+				dec->work_next++;
+			if (dec->stop || dec->work_next != dec->work_end)
+				break;
+			pthread_cond_wait(&dec->cond, &dec->lock);
+		}
+		if (dec->stop) {
+			pthread_mutex_unlock(&dec->lock);
+			break;
+		}
+		job = DEC_JOB(dec, dec->work_next++);
+		pthread_mutex_unlock(&dec->lock);
+
+		dec_job_decode(job);
+
+		/* Hand the result back to the main thread */
+		atomic_store_explicit(&job->done, true, memory_order_release);
+		if (write(dec->efd.fd, &val, sizeof(val)) != sizeof(val))
+			continue; /* the counter can't overflow in practice */
+	}
+
+	return NULL;
+}
+
+/* Deliver a completed job to the user (main thread) */
+static void dec_job_deliver(struct l1sched_decoder *dec, struct l1sched_dec_job *job)
+{
+	struct l1sched_state *sched = dec->sched;
+	size_t l2_len;
+
+	if (job->is_prim) {
+		l1sched_prim_to_user(sched, job->msg);
+		job->msg = NULL;
+		return;
+	}
+
+	switch (job->type) {
+	case L1SCHED_DEC_XCCH:
+		l2_len = job->rc ? 0 : GSM_MACBLOCK_LEN;
+		break;
+	case L1SCHED_DEC_PDTCH:
+		l2_len = job->rc > 0 ? job->rc : 0;
+		break;
+	default:
+		OSMO_ASSERT(0);
+	}
+
+	if (l2_len == 0) {
+		LOGP_SCHEDD(sched, LOGL_ERROR,
+			    LOGP_LCHAN_NAME_FMT " Received bad frame (rc=%d, ber=%d/%d) at fn=%u\n",
+			    job->tn, l1sched_lchan_desc[job->lchan_type].name,
+			    job->rc, job->n_errors, job->n_bits_total, job->meas.fn);
+	}
+
+	l1sched_stats_block(sched, job->lchan_type, &job->meas,
+			    l2_len, job->n_errors, job->n_bits_total);
+	if (job->timed) {
+		sched->stats.lchan[job->lchan_type].dec_time_ns += job->time_ns;
+		sched->stats.lchan[job->lchan_type].dec_time_num++;
+	}
+
+	l1sched_prim_to_user(sched,
+		l1sched_prim_alloc_data_ind(job->tn, job->lchan_type, &job->meas,
+					    &job->l2[0], l2_len,
+					    job->n_errors, job->n_bits_total,
+					    job->type == L1SCHED_DEC_PDTCH));
+}
+
+/* Deliver completed jobs in order, optionally waiting for all of them */
+static void dec_deliver(struct l1sched_decoder *dec, bool wait)
+{
+	while (dec->tail != dec->head) {
+		struct l1sched_dec_job *job = DEC_JOB(dec, dec->tail);
+		uint64_t val;
+
+		if (!atomic_load_explicit(&job->done, memory_order_acquire)) {
+			if (!wait)
+				break;
+			/* Block until one of the workers completes a job */
+			if (read(dec->efd.fd, &val, sizeof(val)) != sizeof(val))
+				OSMO_ASSERT(0);
+			continue;
+		}
+
+		/* The user may submit new jobs from here (e.g. DATA.cnf) */
+		dec->tail++;
+		dec_job_deliver(dec, job);
+	}
+}
+
+static int dec_efd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct l1sched_decoder *dec = ofd->data;
+	uint64_t val;
+
+	/* Reset the eventfd counter, then deliver whatever is ready */
+	if (read(ofd->fd, &val, sizeof(val)) != sizeof(val))
+		return 0;
+	dec_deliver(dec, false);
+
+	return 0;
+}
+
+static struct l1sched_dec_job *dec_job_alloc(struct l1sched_decoder *dec)
+{
+	struct l1sched_dec_job *job;
+
+	/* The ring is full: wait for the oldest job(s) to complete */
+	while (dec->head - dec->tail >= L1SCHED_DEC_RING_LEN) {
+		struct l1sched_dec_job *oldest = DEC_JOB(dec, dec->tail);
+		uint64_t val;
+
+		if (!atomic_load_explicit(&oldest->done, memory_order_acquire)) {
+			if (read(dec->efd.fd, &val, sizeof(val)) != sizeof(val))
+				OSMO_ASSERT(0);
+		}
+		dec_deliver(dec, false);
+	}
+
+	job = DEC_JOB(dec, dec->head);
+	atomic_store_explicit(&job->done, false, memory_order_relaxed);
+	job->is_prim = false;
+	job->msg = NULL;
+
+	return job;
+}
+
+int l1sched_decoder_submit(struct l1sched_lchan_state *lchan,
+			   enum l1sched_dec_type type,
+			   const sbit_t *bursts)
+{
+	struct l1sched_decoder *dec = lchan->ts->sched->decoder;
+	struct l1sched_dec_job *job;
+
+	if (dec == NULL)
+		return -EAGAIN;
+
+	job = dec_job_alloc(dec);
+	job->type = type;
+	job->tn = lchan->ts->index;
+	job->lchan_type = lchan->type;
+	job->meas = lchan->meas_avg;
+	memcpy(&job->bursts[0], bursts, sizeof(job->bursts));
+	job->timed = lchan->ts->sched->stats.dec_timing;
+
+	/* Publish the job to the workers */
+	pthread_mutex_lock(&dec->lock);
+	dec->head++;
+	dec->work_end = dec->head;
+	pthread_cond_signal(&dec->cond);
+	pthread_mutex_unlock(&dec->lock);
+
+	return 0;
+}
+
+int l1sched_prim_emit(struct l1sched_state *sched, struct msgb *msg)
+{
+	struct l1sched_decoder *dec = sched->decoder;
+	struct l1sched_dec_job *job;
+
+	/* Nothing is being decoded, no need to queue */
+	if (dec == NULL || dec->head == dec->tail)
+		return l1sched_prim_to_user(sched, msg);
+
+	job = dec_job_alloc(dec);
+	job->is_prim = true;
+	job->msg = msg;
+	atomic_store_explicit(&job->done, true, memory_order_relaxed);
+
+	/* Published like a decoding job, the workers will skip it */
+	pthread_mutex_lock(&dec->lock);
+	dec->head++;
+	dec->work_end = dec->head;
+	pthread_mutex_unlock(&dec->lock);
+
+	return 0;
+}
+
+int l1sched_decoder_start(struct l1sched_state *sched, unsigned int num_workers)
+{
+	struct l1sched_decoder *dec;
+	unsigned int i;
+	int fd, rc;
+
+	if (sched->decoder != NULL)
+		return -EALREADY;
+	if (num_workers == 0)
+		return -EINVAL;
+
+	dec = talloc_zero(sched, struct l1sched_decoder);
+	if (dec == NULL)
+		return -ENOMEM;
+	dec->sched = sched;
+
+	dec->workers = talloc_zero_array(dec, pthread_t, num_workers);
+	if (dec->workers == NULL) {
+		talloc_free(dec);
+		return -ENOMEM;
+	}
+
+	fd = eventfd(0, EFD_CLOEXEC);
+	if (fd < 0) {
+		rc = -errno;
+		talloc_free(dec);
+		return rc;
+	}
+
+	osmo_fd_setup(&dec->efd, fd, OSMO_FD_READ, &dec_efd_cb, dec, 0);
+	if (osmo_fd_register(&dec->efd) != 0) {
+		close(fd);
+		talloc_free(dec);
+		return -EIO;
+	}
+
+	pthread_mutex_init(&dec->lock, NULL);
+	pthread_cond_init(&dec->cond, NULL);
+
+	for (i = 0; i < num_workers; i++) {
+		rc = pthread_create(&dec->workers[i], NULL, &dec_worker, dec);
+		if (rc != 0)
+			break;
+		dec->num_workers++;
+	}
+
+	sched->decoder = dec;
+
+	if (dec->num_workers < num_workers) {
+		LOGP_SCHEDC(sched, LOGL_ERROR,
+			    "Failed to start decoding worker threads (rc=%d)\n", rc);
+		l1sched_decoder_stop(sched);
+		return -rc;
+	}
+
+	LOGP_SCHEDC(sched, LOGL_NOTICE,
+		    "Offloading channel decoding to %u worker thread(s)\n", num_workers);
+
+	return 0;
+}
+
+/* Stop the workers, pending results are dropped */
+void l1sched_decoder_stop(struct l1sched_state *sched)
+{
+	struct l1sched_decoder *dec = sched->decoder;
+	unsigned int i;
+
+	if (dec == NULL)
+		return;
+
+	pthread_mutex_lock(&dec->lock);
+	dec->stop = true;
+	pthread_cond_broadcast(&dec->cond);
+	pthread_mutex_unlock(&dec->lock);
+
+	for (i = 0; i < dec->num_workers; i++)
+		pthread_join(dec->workers[i], NULL);
+
+	/* Free the primitives which have not been delivered */
+	for (; dec->tail != dec->head; dec->tail++) {
+		struct l1sched_dec_job *job = DEC_JOB(dec, dec->tail);
+
+		if (job->is_prim)
+			msgb_free(job->msg);
+	}
+
+	osmo_fd_unregister(&dec->efd);
+	close(dec->efd.fd);
+
+	pthread_cond_destroy(&dec->cond);
+	pthread_mutex_destroy(&dec->lock);
+
+	sched->decoder = NULL;
+	talloc_free(dec);
+}
+
+/* Wait for all pending blocks to be decoded and deliver them */
+void l1sched_decoder_flush(struct l1sched_state *sched)
+{
+	if (sched->decoder == NULL)
+		return;
+	dec_deliver(sched->decoder, true);
+}
@@ -0,0 +1,135 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * TDMA scheduler: incremental deinterleaving of FACCH/F and FACCH/H
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/conv.h>
+#include <osmocom/core/crc64gen.h>
+
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+
+#include <osmocom/coding/gsm0503.h>
+#include <osmocom/coding/gsm0503_parity.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+
+/* FACCH/F is diagonally interleaved over 8 bursts, FACCH/H over 6 bursts
+ * (3GPP TS 45.003, sections 4.2.4 and 4.3.4), and a new block may start
+ * every 4 (TCH/F) or every 2 (TCH/H) bursts.  Instead of deinterleaving
+ * all bursts of a block once the last one is received, each burst is
+ * deinterleaved into all of the (2 or 3) overlapping blocks it belongs
+ * to as soon as it arrives, so only the Viterbi decoding is left to be
+ * done at the block boundary. */
+
+#define FACCH_CB_LEN		456
+
+struct facch_dil_layout {
+	/*! Number of overlapping blocks */
+	uint8_t num_blocks;
+	/*! Number of bursts between the beginnings of two blocks */
+	uint8_t step;
+};
+
+static const struct facch_dil_layout facch_f_layout = { .num_blocks = 2, .step = 4 };
+static const struct facch_dil_layout facch_h_layout = { .num_blocks = 3, .step = 2 };
+
+static const struct facch_dil_layout *facch_dil_layout(const struct l1sched_lchan_state *lchan)
+{
+	if (lchan->type == L1SCHED_TCHF)
+		return &facch_f_layout;
+	return &facch_h_layout;
+}
+
+/* Scatter the interleaved bits i(B, j) of a burst into every 8th bit of
+ * the coded block, starting from bit k:
+ *   j = 2 * ((49 * k) mod 57) + ((k mod 8) div 4)
+ * The burst is stored along with the stealing flags (116 bits), so the
+ * second half of the bits is shifted by 2. */
+static void facch_dil_scatter(sbit_t *cB, const sbit_t *burst, unsigned int k)
+{
+	const unsigned int odd = (k & 7) >> 2;
+	unsigned int r = (49 * k) % 57;
+
+	for (; k < FACCH_CB_LEN; k += 8) {
+		const unsigned int j = 2 * r + odd;
+
+		cB[k] = burst[j < 57 ? j : j + 2];
+
+		/* 49 * 8 = 392 = 50 (mod 57) */
+		r += 50;
+		if (r >= 57)
+			r -= 57;
+	}
+}
+
+/*! Deinterleave a received burst into the blocks it belongs to.
+ * \param[in] lchan TCH/F or TCH/H logical channel state.
+ * \param[in] burst 116 soft-bits (including the stealing flags).
+ * \param[in] bid Burst ID within the current (4 or 2 bursts) block. */
+void l1sched_facch_dil_push(struct l1sched_lchan_state *lchan,
+			    const sbit_t *burst, uint8_t bid)
+{
+	const struct facch_dil_layout *layout = facch_dil_layout(lchan);
+	struct l1sched_facch_dil *dil = lchan->rx_facch;
+	unsigned int i;
+
+	for (i = 0; i < layout->num_blocks; i++) {
+		sbit_t *cB = dil->cB[(dil->head + i) % layout->num_blocks];
+		/* Position of the burst within the i-th oldest block */
+		const unsigned int B = bid + layout->step * (layout->num_blocks - 1 - i);
+
+		facch_dil_scatter(cB, burst, B);
+
+		/* FACCH/H: bursts 2 and 3 carry the odd bits of B + 4 too */
+		if (layout->num_blocks == 3 && (B == 2 || B == 3))
+			facch_dil_scatter(cB, burst, B + 4);
+	}
+}
+
+/*! Drop the oldest block, making room for a new one.  To be called
+ * along with the shifting of the burst buffer (on the first burst). */
+void l1sched_facch_dil_shift(struct l1sched_lchan_state *lchan)
+{
+	const struct facch_dil_layout *layout = facch_dil_layout(lchan);
+	struct l1sched_facch_dil *dil = lchan->rx_facch;
+
+	memset(dil->cB[dil->head], 0, sizeof(dil->cB[0]));
+	dil->head = (dil->head + 1) % layout->num_blocks;
+}
+
+/*! Decode the oldest block, which is complete on the last burst.
+ * \param[in] lchan TCH/F or TCH/H logical channel state.
+ * \param[out] data Buffer for the decoded L2 frame (GSM_MACBLOCK_LEN).
+ * \param[out] n_errors Number of detected bit errors.
+ * \param[out] n_bits_total Total number of decoded bits.
+ * \returns GSM_MACBLOCK_LEN on success, -1 otherwise. */
+int l1sched_facch_dil_decode(struct l1sched_lchan_state *lchan, uint8_t *data,
+			     int *n_errors, int *n_bits_total)
+{
+	const struct l1sched_facch_dil *dil = lchan->rx_facch;
+	ubit_t conv[224];
+
+	osmo_conv_decode_ber(&gsm0503_xcch, dil->cB[dil->head],
+			     &conv[0], n_errors, n_bits_total);
+	if (osmo_crc64gen_check_bits(&gsm0503_fire_crc40, &conv[0], 184, &conv[184]))
+		return -1;
+
+	osmo_ubit2pbit_ext(data, 0, &conv[0], 0, 184, 1);
+
+	return GSM_MACBLOCK_LEN;
+}
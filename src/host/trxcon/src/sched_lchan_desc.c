@@ -89,7 +89,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 		 * regular interleaving (3GPP TS 05.02, clause 7, table 3):
 		 * a L2 frame is interleaved over 4 consecutive bursts. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
-		.flags = L1SCHED_CH_FLAG_AUTO,
+		.flags = L1SCHED_CH_FLAG_AUTO | L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 	},
 	[L1SCHED_RACH] = {
@@ -110,7 +110,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 		 * regular interleaving (3GPP TS 05.02, clause 7, table 3):
 		 * a L2 frame is interleaved over 4 consecutive bursts. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
-		.flags = L1SCHED_CH_FLAG_AUTO,
+		.flags = L1SCHED_CH_FLAG_AUTO | L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 	},
 	[L1SCHED_TCHF] = {
@@ -179,6 +179,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -190,6 +191,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -201,6 +203,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -212,6 +215,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -223,6 +227,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH4_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -234,6 +239,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH4_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -245,6 +251,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH4_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -256,6 +263,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH4_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -267,6 +275,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH4_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -278,6 +287,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH4_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -289,6 +299,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH4_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -300,6 +311,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH4_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -311,6 +323,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -322,6 +335,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -333,6 +347,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -344,6 +359,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH4_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -355,6 +371,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH4_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -366,6 +383,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH4_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -377,6 +395,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH4_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -388,6 +407,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH8_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -399,6 +419,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH8_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -410,6 +431,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH8_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -421,6 +443,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH8_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -432,6 +455,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH8_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -443,6 +467,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH8_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -454,6 +479,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH8_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -465,6 +491,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH and L1SCHED_SDCCH8_* (xCCH), see above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 		.tx_fn = tx_data_fn,
 	},
@@ -478,7 +505,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 		 * NOTE: the burst buffer is three times bigger because the
 		 * payload of EDGE bursts is three times longer. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_8PSK_PAYLOAD,
-		.flags = L1SCHED_CH_FLAG_PDCH,
+		.flags = L1SCHED_CH_FLAG_PDCH | L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_pdtch_fn,
 		.tx_fn = tx_pdtch_fn,
 	},
@@ -494,7 +521,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 		 * updates for several mobile stations. The coding scheme used
 		 * for PTCCH/D messages is the same as for PDTCH CS-1. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
-		.flags = L1SCHED_CH_FLAG_PDCH,
+		.flags = L1SCHED_CH_FLAG_PDCH | L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_pdtch_fn,
 		.tx_fn = tx_rach_fn,
 	},
@@ -505,7 +532,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH (xCCH), but Rx only. See above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
-		.flags = L1SCHED_CH_FLAG_AUTO,
+		.flags = L1SCHED_CH_FLAG_AUTO | L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 	},
 	[L1SCHED_SDCCH8_CBCH] = {
@@ -515,6 +542,7 @@ const struct l1sched_lchan_desc l1sched_lchan_desc[_L1SCHED_CHAN_MAX] = {
 
 		/* Same as for L1SCHED_BCCH (xCCH), but Rx only. See above. */
 		.burst_buf_size = 4 * GSM_NBITS_NB_GMSK_PAYLOAD,
+		.flags = L1SCHED_CH_FLAG_RX_BLOCK4,
 		.rx_fn = rx_data_fn,
 	},
 };
@@ -85,6 +85,10 @@ int rx_pdtch_fn(struct l1sched_lchan_state *lchan,
 	/* Keep the mask updated */
 	*mask = *mask << 4;
 
+	/* Offload decoding to the worker threads (if enabled) */
+	if (l1sched_decoder_submit(lchan, L1SCHED_DEC_PDTCH, bursts_p) == 0)
+		return 0;
+
 	/* Attempt to decode */
 	rc = gsm0503_pdtch_decode(l2, bursts_p,
 		NULL, &n_errors, &n_bits_total);
@@ -73,7 +73,7 @@ static int handle_sch_ind(struct l1sched_state *sched, uint32_t fn, uint8_t bsic
 	prim->sch_ind.frame_nr = fn;
 	prim->sch_ind.bsic = bsic;
 
-	return l1sched_prim_to_user(sched, msg);
+	return l1sched_prim_emit(sched, msg);
 }
 
 int rx_sch_fn(struct l1sched_lchan_state *lchan,
@@ -71,8 +71,7 @@ static int decode_fr_facch(struct l1sched_lchan_state *lchan)
 	int n_errors, n_bits_total;
 	int rc;
 
-	rc = gsm0503_tch_fr_facch_decode(&data[0], BUFTAIL8(lchan->rx_bursts),
-					 &n_errors, &n_bits_total);
+	rc = l1sched_facch_dil_decode(lchan, &data[0], &n_errors, &n_bits_total);
 	if (rc != GSM_MACBLOCK_LEN)
 		return rc;
 
@@ -108,6 +107,7 @@ int rx_tchf_fn(struct l1sched_lchan_state *lchan,
 		memmove(BUFPOS(bursts_p, 0), BUFPOS(bursts_p, 4), 20 * BPLEN);
 		memset(BUFPOS(bursts_p, 20), 0, 4 * BPLEN);
 		*mask = *mask << 4;
+		l1sched_facch_dil_shift(lchan);
 	} else {
 		/* Align to the first burst of a block */
 		if (*mask == 0x00)
@@ -125,6 +125,21 @@ int rx_tchf_fn(struct l1sched_lchan_state *lchan,
 	memcpy(burst, bi->burst + 3, 58);
 	memcpy(burst + 58, bi->burst + 87, 58);
 
+	/* Deinterleave it into both of the overlapping FACCH/F blocks, in the
+	 * modes decoding FACCH/F with l1sched_facch_dil_decode() */
+	switch (lchan->tch_mode) {
+	case GSM48_CMODE_SIGN:
+	case GSM48_CMODE_DATA_14k5:
+	case GSM48_CMODE_DATA_12k0:
+	case GSM48_CMODE_DATA_6k0:
+	case GSM48_CMODE_DATA_3k6:
+		l1sched_facch_dil_push(lchan, burst, bi->bid);
+		break;
+	default:
+		/* Speech: gsm0503_tch_{fr,afs}_decode() detect FACCH/F themselves */
+		break;
+	}
+
 	/* Wait until complete set of bursts */
 	if (bi->bid != 3)
 		return 0;
@@ -148,6 +163,9 @@ int rx_tchf_fn(struct l1sched_lchan_state *lchan,
 	 * decode only the last 8 bursts to avoid introducing additional delays. */
 	switch (lchan->tch_mode) {
 	case GSM48_CMODE_SIGN:
+		/* Signalling only: the block has already been deinterleaved */
+		rc = l1sched_facch_dil_decode(lchan, &tch_data[0], &n_errors, &n_bits_total);
+		break;
 	case GSM48_CMODE_SPEECH_V1: /* FR */
 		rc = gsm0503_tch_fr_decode(&tch_data[0], BUFTAIL8(bursts_p),
 					   1, 0, &n_errors, &n_bits_total);
@@ -144,8 +144,7 @@ static int decode_hr_facch(struct l1sched_lchan_state *lchan)
 	int n_errors, n_bits_total;
 	int rc;
 
-	rc = gsm0503_tch_hr_facch_decode(&data[0], BUFTAIL8(lchan->rx_bursts),
-					 &n_errors, &n_bits_total);
+	rc = l1sched_facch_dil_decode(lchan, &data[0], &n_errors, &n_bits_total);
 	if (rc != GSM_MACBLOCK_LEN)
 		return rc;
 
@@ -181,6 +180,7 @@ int rx_tchh_fn(struct l1sched_lchan_state *lchan,
 		memmove(BUFPOS(bursts_p, 0), BUFPOS(bursts_p, 2), 20 * BPLEN);
 		memset(BUFPOS(bursts_p, 20), 0, 2 * BPLEN);
 		*mask = *mask << 2;
+		l1sched_facch_dil_shift(lchan);
 	}
 
 	if (*mask == 0x00) {
@@ -206,6 +206,18 @@ int rx_tchh_fn(struct l1sched_lchan_state *lchan,
 	memcpy(burst, bi->burst + 3, 58);
 	memcpy(burst + 58, bi->burst + 87, 58);
 
+	/* Deinterleave it into all of the overlapping FACCH/H blocks, in the
+	 * modes decoding FACCH/H with l1sched_facch_dil_decode() */
+	switch (lchan->tch_mode) {
+	case GSM48_CMODE_DATA_6k0:
+	case GSM48_CMODE_DATA_3k6:
+		l1sched_facch_dil_push(lchan, burst, bi->bid);
+		break;
+	default:
+		/* Signalling and speech: gsm0503_tch_{hr,ahs}_decode() detect FACCH/H */
+		break;
+	}
+
 	/* Wait until the second burst */
 	if (bi->bid != 1)
 		return 0;
@@ -86,6 +86,10 @@ int rx_data_fn(struct l1sched_lchan_state *lchan,
 	/* Keep the mask updated */
 	*mask = *mask << 4;
 
+	/* Offload decoding to the worker threads (if enabled) */
+	if (l1sched_decoder_submit(lchan, L1SCHED_DEC_XCCH, bursts_p) == 0)
+		return 0;
+
 	/* Attempt to decode */
 	rc = gsm0503_xcch_decode(l2, bursts_p, &n_errors, &n_bits_total);
 	if (rc) {
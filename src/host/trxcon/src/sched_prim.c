@@ -76,6 +76,113 @@ struct msgb *l1sched_prim_alloc(enum l1sched_prim_type type,
 	return msg;
 }
 
+/* Primitives allocated by l1sched_prim_pool_alloc() are regular msgbs,
+ * which can be passed around and released using msgb_free() as usual.
+ * Instead of being freed, they are put back into the pool of the
+ * scheduler instance they belong to: the destructor refuses the
+ * deallocation, so talloc keeps the memory. */
+static int prim_pool_msgb_destructor(struct msgb *msg)
+{
+	struct l1sched_prim_pool *pool = msg->dst;
+
+	msgb_reset(msg);
+	msg->dst = pool;
+
+	llist_add(&msg->list, &pool->free);
+	pool->num_free++;
+
+	return -1;
+}
+
+int l1sched_prim_pool_init(struct l1sched_state *sched, unsigned int size)
+{
+	struct l1sched_prim_pool *pool = &sched->prim_pool;
+	unsigned int i;
+
+	INIT_LLIST_HEAD(&pool->free);
+
+	pool->msgs = talloc_zero_array(sched, struct msgb *, size);
+	if (pool->msgs == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < size; i++) {
+		struct msgb *msg;
+
+		msg = msgb_alloc_headroom(L1SCHED_PRIM_HEADROOM + L1SCHED_PRIM_TAILROOM,
+					  L1SCHED_PRIM_HEADROOM, "l1sched_prim");
+		if (msg == NULL) {
+			l1sched_prim_pool_free(sched);
+			return -ENOMEM;
+		}
+
+		msg->dst = pool;
+		talloc_set_destructor(msg, prim_pool_msgb_destructor);
+		pool->msgs[pool->num++] = msg;
+
+		llist_add_tail(&msg->list, &pool->free);
+		pool->num_free++;
+	}
+
+	return 0;
+}
+
+void l1sched_prim_pool_free(struct l1sched_state *sched)
+{
+	struct l1sched_prim_pool *pool = &sched->prim_pool;
+	struct msgb *msg, *tmp;
+	unsigned int i;
+
+	if (pool->msgs == NULL)
+		return;
+
+	/* msgbs still being in use become regular ones, their owner frees them */
+	for (i = 0; i < pool->num; i++) {
+		talloc_set_destructor(pool->msgs[i], NULL);
+		pool->msgs[i]->dst = NULL;
+	}
+
+	llist_for_each_entry_safe(msg, tmp, &pool->free, list) {
+		llist_del(&msg->list);
+		msgb_free(msg);
+	}
+
+	if (pool->num_free < pool->num) {
+		LOGP_SCHEDC(sched, LOGL_NOTICE, "%u pooled primitives are still in use\n",
+			    pool->num - pool->num_free);
+	}
+
+	TALLOC_FREE(pool->msgs);
+	pool->num = pool->num_free = 0;
+}
+
+/*! Allocate a primitive from the pool of the given scheduler instance.
+ * Falls back to l1sched_prim_alloc() if the pool is exhausted.
+ * \param[in] sched Scheduler instance.
+ * \param[in] type Primitive type.
+ * \param[in] op Primitive operation.
+ * \returns an msgb, to be released with msgb_free() as usual. */
+struct msgb *l1sched_prim_pool_alloc(struct l1sched_state *sched,
+				     enum l1sched_prim_type type,
+				     enum osmo_prim_operation op)
+{
+	struct l1sched_prim_pool *pool = &sched->prim_pool;
+	struct msgb *msg;
+
+	if (OSMO_UNLIKELY(pool->num_free == 0)) {
+		pool->num_fallback++;
+		return l1sched_prim_alloc(type, op);
+	}
+
+	msg = llist_first_entry(&pool->free, struct msgb, list);
+	llist_del(&msg->list);
+	pool->num_free--;
+
+	msgb_reserve(msg, L1SCHED_PRIM_HEADROOM);
+	l1sched_prim_init(msg, type, op);
+
+	return msg;
+}
+
 /**
  * Composes a new primitive from cached RR Measurement Report.
  *
@@ -88,7 +195,7 @@ static struct msgb *prim_compose_mr(struct l1sched_lchan_state *lchan)
 	struct msgb *msg;
 
 	/* Allocate a new primitive */
-	msg = l1sched_prim_alloc(L1SCHED_PRIM_T_DATA, PRIM_OP_REQUEST);
+	msg = l1sched_prim_pool_alloc(lchan->ts->sched, L1SCHED_PRIM_T_DATA, PRIM_OP_REQUEST);
 	OSMO_ASSERT(msg != NULL);
 
 	prim = l1sched_prim_from_msgb(msg);
@@ -237,6 +344,14 @@ struct msgb *l1sched_lchan_prim_dequeue_tch(struct l1sched_lchan_state *lchan, b
 	return NULL;
 }
 
+/**
+ * TS 144.006, section 8.4.2.3 "Fill frames"
+ * A fill frame is a UI command frame for SAPI 0, P=0
+ * and with an information field of 0 octet length,
+ * followed by the first octet of fill bits ("00101011").
+ */
+static const uint8_t lapdm_fill_frame[] = { 0x01, 0x03, 0x01, 0x2b };
+
 /**
  * Allocate a DATA.req with dummy LAPDm func=UI frame for the given logical channel.
  * To be used when no suitable DATA.req is present in the Tx queue.
@@ -253,7 +368,7 @@ struct msgb *l1sched_lchan_prim_dummy_lapdm(const struct l1sched_lchan_state *lc
 	/* LAPDm func=UI is not applicable for SACCH */
 	OSMO_ASSERT(!L1SCHED_CHAN_IS_SACCH(lchan->type));
 
-	msg = l1sched_prim_alloc(L1SCHED_PRIM_T_DATA, PRIM_OP_REQUEST);
+	msg = l1sched_prim_pool_alloc(lchan->ts->sched, L1SCHED_PRIM_T_DATA, PRIM_OP_REQUEST);
 	OSMO_ASSERT(msg != NULL);
 
 	prim = l1sched_prim_from_msgb(msg);
@@ -264,14 +379,9 @@ struct msgb *l1sched_lchan_prim_dummy_lapdm(const struct l1sched_lchan_state *lc
 
 	ptr = msgb_put(msg, GSM_MACBLOCK_LEN);
 
-	/**
-	 * TS 144.006, section 8.4.2.3 "Fill frames"
-	 * A fill frame is a UI command frame for SAPI 0, P=0
-	 * and with an information field of 0 octet length.
-	 */
-	*(ptr++) = 0x01;
-	*(ptr++) = 0x03;
-	*(ptr++) = 0x01;
+	/* Fill frame header and the first octet of fill bits */
+	memcpy(ptr, lapdm_fill_frame, sizeof(lapdm_fill_frame));
+	ptr += sizeof(lapdm_fill_frame);
 
 	/**
 	 * TS 144.006, section 5.2 "Frame delimitation and fill bits"
@@ -279,25 +389,21 @@ struct msgb *l1sched_lchan_prim_dummy_lapdm(const struct l1sched_lchan_state *lc
 	 * be set to the binary value "00101011", each fill bit should
 	 * be set to a random value when sent by the network.
 	 */
-	*(ptr++) = 0x2b;
 	while (ptr < msg->tail)
 		*(ptr++) = (uint8_t)rand();
 
 	return msg;
 }
 
-int l1sched_lchan_emit_data_ind(struct l1sched_lchan_state *lchan,
-				const uint8_t *data, size_t data_len,
-				int n_errors, int n_bits_total,
-				bool traffic)
+struct msgb *l1sched_prim_alloc_data_ind(uint8_t tn, enum l1sched_lchan_type type,
+					 const struct l1sched_meas_set *meas,
+					 const uint8_t *data, size_t data_len,
+					 int n_errors, int n_bits_total, bool traffic)
 {
-	const struct l1sched_meas_set *meas = &lchan->meas_avg;
-	const struct l1sched_lchan_desc *lchan_desc;
+	const struct l1sched_lchan_desc *lchan_desc = &l1sched_lchan_desc[type];
 	struct l1sched_prim *prim;
 	struct msgb *msg;
 
-	lchan_desc = &l1sched_lchan_desc[lchan->type];
-
 	msg = l1sched_prim_alloc(L1SCHED_PRIM_T_DATA, PRIM_OP_INDICATION);
 	OSMO_ASSERT(msg != NULL);
 
@@ -305,7 +411,7 @@ int l1sched_lchan_emit_data_ind(struct l1sched_lchan_state *lchan,
 	prim->data_ind = (struct l1sched_prim_data_ind) {
 		.chdr = {
 			.frame_nr = meas->fn,
-			.chan_nr = lchan_desc->chan_nr | lchan->ts->index,
+			.chan_nr = lchan_desc->chan_nr | tn,
 			.link_id = lchan_desc->link_id,
 			.traffic = traffic,
 		},
@@ -318,7 +424,23 @@ int l1sched_lchan_emit_data_ind(struct l1sched_lchan_state *lchan,
 	if (data_len > 0)
 		memcpy(msgb_put(msg, data_len), data, data_len);
 
-	return l1sched_prim_to_user(lchan->ts->sched, msg);
+	return msg;
+}
+
+int l1sched_lchan_emit_data_ind(struct l1sched_lchan_state *lchan,
+				const uint8_t *data, size_t data_len,
+				int n_errors, int n_bits_total,
+				bool traffic)
+{
+	struct msgb *msg;
+
+	msg = l1sched_prim_alloc_data_ind(lchan->ts->index, lchan->type,
+					  &lchan->meas_avg, data, data_len,
+					  n_errors, n_bits_total, traffic);
+	l1sched_stats_block(lchan->ts->sched, lchan->type, &lchan->meas_avg,
+			    data_len, n_errors, n_bits_total);
+
+	return l1sched_prim_emit(lchan->ts->sched, msg);
 }
 
 int l1sched_lchan_emit_data_cnf(struct l1sched_lchan_state *lchan,
@@ -345,7 +467,7 @@ int l1sched_lchan_emit_data_cnf(struct l1sched_lchan_state *lchan,
 		OSMO_ASSERT(0);
 	}
 
-	return l1sched_prim_to_user(lchan->ts->sched, msg);
+	return l1sched_prim_emit(lchan->ts->sched, msg);
 }
 
 static int prim_enqeue(struct l1sched_state *sched, struct msgb *msg,
@@ -0,0 +1,279 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * TDMA scheduler: performance counters and their export
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <inttypes.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/linuxlist.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+
+/* Instances registered for l1sched_stats_dump().  The counters themselves
+ * are not protected: each instance updates its own ones from the thread
+ * it's running in, the lock only keeps an instance from being freed
+ * while it's being dumped. */
+static LLIST_HEAD(stats_registry);
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void l1sched_stats_block(struct l1sched_state *sched, enum l1sched_lchan_type type,
+			 const struct l1sched_meas_set *meas,
+			 size_t data_len, int n_errors, int n_bits_total)
+{
+	struct l1sched_lchan_stats *st = &sched->stats.lchan[type];
+	unsigned int bin = 0;
+
+	/* No decoding attempt (e.g. a BFI during FACCH/H) */
+	if (n_bits_total <= 0)
+		return;
+
+	if (data_len > 0)
+		st->blocks_good++;
+	else
+		st->blocks_bad++;
+	st->meas_last = *meas;
+
+	/* Find the bin without division: BER in (2^(bin-2), 2^(bin-1)] % */
+	if (n_errors > 0) {
+		const uint64_t ber100 = (uint64_t)n_errors * 100;
+
+		bin = 1;
+		while (bin < L1SCHED_STATS_BER_BINS - 1 &&
+		       ber100 > ((uint64_t)n_bits_total << (bin - 1)))
+			bin++;
+	}
+
+	st->ber_hist[bin]++;
+}
+
+void l1sched_stats_register(struct l1sched_state *sched, unsigned int id)
+{
+	pthread_mutex_lock(&stats_lock);
+	if (!sched->stats.registered) {
+		sched->stats.id = id;
+		sched->stats.registered = true;
+		llist_add_tail(&sched->stats.list, &stats_registry);
+	}
+	pthread_mutex_unlock(&stats_lock);
+}
+
+void l1sched_stats_unregister(struct l1sched_state *sched)
+{
+	pthread_mutex_lock(&stats_lock);
+	if (sched->stats.registered) {
+		llist_del(&sched->stats.list);
+		sched->stats.registered = false;
+	}
+	pthread_mutex_unlock(&stats_lock);
+}
+
+/* Whether the given lchan type of an instance has anything to report */
+static bool stats_lchan_active(const struct l1sched_state *sched,
+			       enum l1sched_lchan_type type)
+{
+	const struct l1sched_lchan_stats *st = &sched->stats.lchan[type];
+
+	return st->bursts_rx > 0 || st->bursts_tx > 0 ||
+	       sched->deadline.skipped[type] > 0;
+}
+
+/* Plain per-lchan counters */
+static const struct {
+	const char *name;
+	const char *help;
+	size_t offset;
+} stats_counters[] = {
+	{ "bursts_rx_total", "Downlink bursts handed over to the lchan",
+	  offsetof(struct l1sched_lchan_stats, bursts_rx) },
+	{ "bursts_tx_total", "Uplink bursts produced by the lchan",
+	  offsetof(struct l1sched_lchan_stats, bursts_tx) },
+	{ "blocks_good_total", "Successfully decoded Downlink blocks",
+	  offsetof(struct l1sched_lchan_stats, blocks_good) },
+	{ "blocks_bad_total", "Downlink blocks which could not be decoded",
+	  offsetof(struct l1sched_lchan_stats, blocks_bad) },
+};
+
+#define STATS_FOREACH(sched, type) \
+	llist_for_each_entry(sched, &stats_registry, stats.list) \
+		for (type = 0; type < _L1SCHED_CHAN_MAX; type++) \
+			if (stats_lchan_active(sched, type))
+
+#define STATS_LABELS_FMT	"instance=\"%u\",lchan=\"%s\""
+#define STATS_LABELS_ARGS(sched, type) \
+	(sched)->stats.id, l1sched_lchan_desc[type].name
+
+static char *stats_family(char *buf, const char *prefix, const char *name,
+			  const char *type, const char *help)
+{
+	return talloc_asprintf_append_buffer(buf, "# HELP %s_%s %s\n# TYPE %s_%s %s\n",
+					     prefix, name, help, prefix, name, type);
+}
+
+/*! Dump the counters of all registered instances in the Prometheus text format.
+ * \param[in] ctx talloc context to allocate the resulting string from.
+ * \param[in] prefix Prefix of the metric names (e.g. "trxcon").
+ * \returns a talloc-allocated string, or NULL on error. */
+char *l1sched_stats_dump(void *ctx, const char *prefix)
+{
+	const struct l1sched_state *sched;
+	unsigned int type, i;
+	char *buf;
+
+	buf = talloc_strdup(ctx, "");
+	if (buf == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&stats_lock);
+
+	for (i = 0; i < ARRAY_SIZE(stats_counters); i++) {
+		buf = stats_family(buf, prefix, stats_counters[i].name,
+				   "counter", stats_counters[i].help);
+		STATS_FOREACH(sched, type) {
+			const void *st = &sched->stats.lchan[type];
+			const unsigned long *val = (const void *)((const uint8_t *)st + stats_counters[i].offset);
+
+			buf = talloc_asprintf_append_buffer(buf, "%s_%s{" STATS_LABELS_FMT "} %lu\n",
+							    prefix, stats_counters[i].name,
+							    STATS_LABELS_ARGS(sched, type), *val);
+		}
+	}
+
+	buf = stats_family(buf, prefix, "block_ber_percent", "histogram",
+			   "Bit error rate of the decoded Downlink blocks");
+	STATS_FOREACH(sched, type) {
+		const struct l1sched_lchan_stats *st = &sched->stats.lchan[type];
+		unsigned long cnt = 0;
+
+		for (i = 0; i < L1SCHED_STATS_BER_BINS; i++) {
+			cnt += st->ber_hist[i];
+			if (i < L1SCHED_STATS_BER_BINS - 1) {
+				buf = talloc_asprintf_append_buffer(buf,
+					"%s_block_ber_percent_bucket{" STATS_LABELS_FMT ",le=\"%u\"} %lu\n",
+					prefix, STATS_LABELS_ARGS(sched, type), i ? 1 << (i - 1) : 0, cnt);
+			} else {
+				buf = talloc_asprintf_append_buffer(buf,
+					"%s_block_ber_percent_bucket{" STATS_LABELS_FMT ",le=\"+Inf\"} %lu\n",
+					prefix, STATS_LABELS_ARGS(sched, type), cnt);
+			}
+		}
+		buf = talloc_asprintf_append_buffer(buf, "%s_block_ber_percent_count{" STATS_LABELS_FMT "} %lu\n",
+						    prefix, STATS_LABELS_ARGS(sched, type), cnt);
+	}
+
+	/* Spread of the measurements over the bursts of the last block */
+	buf = stats_family(buf, prefix, "block_toa256_spread", "gauge",
+			   "ToA256 of the bursts of the last decoded block (min, max, variance)");
+	STATS_FOREACH(sched, type) {
+		const struct l1sched_meas_set *meas = &sched->stats.lchan[type].meas_last;
+
+		buf = talloc_asprintf_append_buffer(buf,
+			"%s_block_toa256_spread{" STATS_LABELS_FMT ",stat=\"min\"} %d\n"
+			"%s_block_toa256_spread{" STATS_LABELS_FMT ",stat=\"max\"} %d\n"
+			"%s_block_toa256_spread{" STATS_LABELS_FMT ",stat=\"var\"} %u\n",
+			prefix, STATS_LABELS_ARGS(sched, type), meas->toa256_min,
+			prefix, STATS_LABELS_ARGS(sched, type), meas->toa256_max,
+			prefix, STATS_LABELS_ARGS(sched, type), meas->toa256_var);
+	}
+
+	buf = stats_family(buf, prefix, "block_rssi_spread", "gauge",
+			   "RSSI of the bursts of the last decoded block (min, max, variance)");
+	STATS_FOREACH(sched, type) {
+		const struct l1sched_meas_set *meas = &sched->stats.lchan[type].meas_last;
+
+		buf = talloc_asprintf_append_buffer(buf,
+			"%s_block_rssi_spread{" STATS_LABELS_FMT ",stat=\"min\"} %d\n"
+			"%s_block_rssi_spread{" STATS_LABELS_FMT ",stat=\"max\"} %d\n"
+			"%s_block_rssi_spread{" STATS_LABELS_FMT ",stat=\"var\"} %u\n",
+			prefix, STATS_LABELS_ARGS(sched, type), meas->rssi_min,
+			prefix, STATS_LABELS_ARGS(sched, type), meas->rssi_max,
+			prefix, STATS_LABELS_ARGS(sched, type), meas->rssi_var);
+	}
+
+	buf = stats_family(buf, prefix, "decode_seconds", "summary",
+			   "Time spent decoding Downlink blocks");
+	STATS_FOREACH(sched, type) {
+		const struct l1sched_lchan_stats *st = &sched->stats.lchan[type];
+
+		if (!sched->stats.dec_timing)
+			continue;
+		buf = talloc_asprintf_append_buffer(buf,
+			"%s_decode_seconds_sum{" STATS_LABELS_FMT "} %.9f\n"
+			"%s_decode_seconds_count{" STATS_LABELS_FMT "} %lu\n",
+			prefix, STATS_LABELS_ARGS(sched, type), (double)st->dec_time_ns / 1e9,
+			prefix, STATS_LABELS_ARGS(sched, type), st->dec_time_num);
+	}
+
+	buf = stats_family(buf, prefix, "tx_queue_depth", "gauge",
+			   "Depth of the Uplink primitive queue at the last block");
+	STATS_FOREACH(sched, type) {
+		buf = talloc_asprintf_append_buffer(buf, "%s_tx_queue_depth{" STATS_LABELS_FMT "} %u\n",
+						    prefix, STATS_LABELS_ARGS(sched, type),
+						    sched->stats.lchan[type].tx_queue_depth);
+	}
+
+	buf = stats_family(buf, prefix, "tx_queue_depth_max", "gauge",
+			   "Maximum depth of the Uplink primitive queue");
+	STATS_FOREACH(sched, type) {
+		buf = talloc_asprintf_append_buffer(buf, "%s_tx_queue_depth_max{" STATS_LABELS_FMT "} %u\n",
+						    prefix, STATS_LABELS_ARGS(sched, type),
+						    sched->stats.lchan[type].tx_queue_depth_max);
+	}
+
+	/* Bucket N of the deadline histograms counts [2^(N-1), 2^N) us */
+	buf = stats_family(buf, prefix, "rts_latency_us", "histogram",
+			   "Latency from the RTS indication to a ready Uplink burst");
+	STATS_FOREACH(sched, type) {
+		const struct l1sched_deadline *dl = &sched->deadline;
+		unsigned long cnt = 0;
+
+		for (i = 0; i < L1SCHED_DEADLINE_HIST_LEN; i++) {
+			cnt += dl->hist[type][i];
+			if (i < L1SCHED_DEADLINE_HIST_LEN - 1) {
+				buf = talloc_asprintf_append_buffer(buf,
+					"%s_rts_latency_us_bucket{" STATS_LABELS_FMT ",le=\"%u\"} %lu\n",
+					prefix, STATS_LABELS_ARGS(sched, type), (1 << i) - 1, cnt);
+			} else {
+				buf = talloc_asprintf_append_buffer(buf,
+					"%s_rts_latency_us_bucket{" STATS_LABELS_FMT ",le=\"+Inf\"} %lu\n",
+					prefix, STATS_LABELS_ARGS(sched, type), cnt);
+			}
+		}
+		buf = talloc_asprintf_append_buffer(buf, "%s_rts_latency_us_count{" STATS_LABELS_FMT "} %lu\n",
+						    prefix, STATS_LABELS_ARGS(sched, type), cnt);
+	}
+
+	buf = stats_family(buf, prefix, "bursts_late_total", "counter",
+			   "Uplink bursts ready after their deadline");
+	STATS_FOREACH(sched, type) {
+		buf = talloc_asprintf_append_buffer(buf, "%s_bursts_late_total{" STATS_LABELS_FMT "} %u\n",
+						    prefix, STATS_LABELS_ARGS(sched, type),
+						    sched->deadline.late[type]);
+	}
+
+	buf = stats_family(buf, prefix, "blocks_skipped_total", "counter",
+			   "Uplink blocks not encoded because they would miss their deadline");
+	STATS_FOREACH(sched, type) {
+		buf = talloc_asprintf_append_buffer(buf, "%s_blocks_skipped_total{" STATS_LABELS_FMT "} %u\n",
+						    prefix, STATS_LABELS_ARGS(sched, type),
+						    sched->deadline.skipped[type]);
+	}
+
+	pthread_mutex_unlock(&stats_lock);
+
+	return buf;
+}
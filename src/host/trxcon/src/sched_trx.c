@@ -22,10 +22,10 @@
 #include <error.h>
 #include <errno.h>
 #include <string.h>
+#include <inttypes.h>
 #include <talloc.h>
 #include <stdbool.h>
 
-#include <osmocom/gsm/a5.h>
 #include <osmocom/gsm/protocol/gsm_08_58.h>
 #include <osmocom/core/bits.h>
 #include <osmocom/core/msgb.h>
@@ -33,6 +33,7 @@
 #include <osmocom/core/linuxlist.h>
 
 #include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1sched/capture.h>
 #include <osmocom/bb/l1sched/logging.h>
 
 /* Logging categories to be used for common/data messages */
@@ -81,11 +82,67 @@ static int l1sched_cfg_pchan_comb_ind(struct l1sched_state *sched,
 	prim->pchan_comb_ind.tn = tn;
 	prim->pchan_comb_ind.pchan = pchan;
 
-	return l1sched_prim_to_user(sched, msg);
+	return l1sched_prim_emit(sched, msg);
 }
 
-static void l1sched_a5_burst_enc(struct l1sched_lchan_state *lchan,
-				 struct l1sched_burst_req *br);
+static int ts_activate_lchan(struct l1sched_ts *ts, enum l1sched_lchan_type chan);
+static void ts_deactivate_all_lchans(struct l1sched_ts *ts);
+
+/* Time elapsed since the RTS indication (in us), or -1 if it's not timestamped */
+static int64_t l1sched_rts_elapsed_us(const struct l1sched_burst_req *br)
+{
+	struct timespec now;
+
+	if (br->rts_time.tv_sec == 0 && br->rts_time.tv_nsec == 0)
+		return -1;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)(now.tv_sec - br->rts_time.tv_sec) * 1000000
+	     + (now.tv_nsec - br->rts_time.tv_nsec) / 1000;
+}
+
+/* Check whether a new block would miss its deadline, so its encoding can be skipped.
+ * TCH blocks are never skipped: the diagonal interleaver state must keep advancing. */
+static bool l1sched_block_is_late(struct l1sched_state *sched,
+				  const struct l1sched_lchan_state *lchan,
+				  const struct l1sched_burst_req *br)
+{
+	const struct l1sched_deadline *dl = &sched->deadline;
+	int64_t elapsed_us;
+
+	if (!dl->skip_late || dl->budget_us == 0 || br->bid != 0)
+		return false;
+	if (L1SCHED_CHAN_IS_TCH(lchan->type))
+		return false;
+
+	elapsed_us = l1sched_rts_elapsed_us(br);
+	return elapsed_us > dl->budget_us;
+}
+
+/* Account the RTS-to-burst latency of a burst produced by the given lchan */
+static void l1sched_deadline_account(struct l1sched_state *sched,
+				     const struct l1sched_lchan_state *lchan,
+				     const struct l1sched_burst_req *br)
+{
+	struct l1sched_deadline *dl = &sched->deadline;
+	unsigned int bucket = 0;
+	int64_t elapsed_us;
+
+	elapsed_us = l1sched_rts_elapsed_us(br);
+	if (elapsed_us < 0)
+		return;
+
+	while (bucket < L1SCHED_DEADLINE_HIST_LEN - 1 && (elapsed_us >> bucket) > 0)
+		bucket++;
+	dl->hist[lchan->type][bucket]++;
+
+	if (dl->budget_us > 0 && elapsed_us > dl->budget_us) {
+		LOGP_LCHAND(lchan, LOGL_INFO, "Burst fn=%u bid=%u missed its deadline "
+			    "(%" PRId64 " us > %u us)\n", br->fn, br->bid,
+			    elapsed_us, dl->budget_us);
+		dl->late[lchan->type]++;
+	}
+}
 
 /* Pull an Uplink burst from the scheduler and store it to br->burst[].
  * The TDMA Fn advance must be applied by the caller (if needed).
@@ -93,31 +150,31 @@ static void l1sched_a5_burst_enc(struct l1sched_lchan_state *lchan,
 void l1sched_pull_burst(struct l1sched_state *sched, struct l1sched_burst_req *br)
 {
 	struct l1sched_ts *ts = sched->ts[br->tn];
-	const struct l1sched_tdma_frame *frame;
+	const struct l1sched_ts_dispatch *d;
 	struct l1sched_lchan_state *lchan;
 	l1sched_lchan_tx_func *handler;
-	enum l1sched_lchan_type chan;
-	unsigned int offset;
 
 	/* Check if the given timeslot is configured */
-	if (ts == NULL || ts->mf_layout == NULL)
+	if (ts == NULL || ts->dispatch == NULL)
 		return;
 
-	/* Get frame from multiframe */
-	offset = br->fn % ts->mf_layout->period;
-	frame = &ts->mf_layout->frames[offset];
+	/* Get the precompiled dispatch entry for this frame */
+	d = &ts->dispatch[br->fn % ts->mf_layout->period];
+	br->bid = d->ul_bid;
+	handler = d->tx_fn;
 
-	/* Get required info from frame */
-	br->bid = frame->ul_bid;
-	chan = frame->ul_chan;
-	handler = l1sched_lchan_desc[chan].tx_fn;
+	/* The Tx clock runs ahead of the Rx path: generate the A5/X
+	 * keystream for the Downlink bursts to come */
+	lchan = d->dl_lchan;
+	if (lchan != NULL && lchan->active && lchan->a5.algo)
+		l1sched_a5_ks_prefetch(lchan, br->fn);
 
 	/* Omit lchans without handler */
 	if (handler == NULL)
 		return;
 
 	/* Make sure that lchan is allocated and active */
-	lchan = l1sched_find_lchan_by_type(ts, chan);
+	lchan = d->ul_lchan;
 	if (lchan == NULL || !lchan->active)
 		return;
 
@@ -127,12 +184,60 @@ void l1sched_pull_burst(struct l1sched_state *sched, struct l1sched_burst_req *b
 	if (msg && l1sched_prim_type_from_msgb(msg) == L1SCHED_PRIM_T_RACH)
 		handler = l1sched_lchan_desc[L1SCHED_RACH].tx_fn;
 
+	/* Do not waste time on encoding a block which can no longer make its
+	 * frame.  The prim (if any) stays in the queue for the next block. */
+	if (l1sched_block_is_late(sched, lchan, br)) {
+		LOGP_LCHAND(lchan, LOGL_NOTICE, "Skipping late block at fn=%u\n", br->fn);
+		sched->deadline.skipped[lchan->type]++;
+		/* Do not send the remaining bursts of the previous block */
+		lchan->tx_burst_mask = 0x00;
+		return;
+	}
+
+	/* Sample the Tx queue depth once per block */
+	if (br->bid == 0) {
+		struct l1sched_lchan_stats *st = &sched->stats.lchan[lchan->type];
+
+		st->tx_queue_depth = llist_count(&lchan->tx_prims);
+		if (st->tx_queue_depth > st->tx_queue_depth_max)
+			st->tx_queue_depth_max = st->tx_queue_depth;
+	}
+
 	/* Poke lchan handler */
 	handler(lchan, br);
 
 	/* Perform A5/X burst encryption if required */
 	if (lchan->a5.algo)
 		l1sched_a5_burst_enc(lchan, br);
+
+	if (br->burst_len > 0) {
+		sched->stats.lchan[lchan->type].bursts_tx++;
+		l1sched_deadline_account(sched, lchan, br);
+	}
+}
+
+/* Log the RTS-to-burst latency histograms and deadline misses */
+void l1sched_deadline_report(struct l1sched_state *sched)
+{
+	const struct l1sched_deadline *dl = &sched->deadline;
+	unsigned int type, i;
+
+	for (type = 0; type < _L1SCHED_CHAN_MAX; type++) {
+		char buf[256];
+		struct osmo_strbuf sb = { .buf = buf, .len = sizeof(buf) };
+		unsigned long total = 0;
+
+		for (i = 0; i < L1SCHED_DEADLINE_HIST_LEN; i++) {
+			total += dl->hist[type][i];
+			OSMO_STRBUF_PRINTF(sb, " %u", dl->hist[type][i]);
+		}
+		if (total == 0 && dl->skipped[type] == 0)
+			continue;
+
+		LOGP_SCHEDC(sched, LOGL_NOTICE, "%s: %lu bursts, %u late, %u blocks skipped, "
+			    "latency histogram (log2 us):%s\n", l1sched_lchan_desc[type].name,
+			    total, dl->late[type], dl->skipped[type], buf);
+	}
 }
 
 void l1sched_logging_init(int log_cat_common, int log_cat_data)
@@ -153,6 +258,11 @@ struct l1sched_state *l1sched_alloc(void *ctx, const struct l1sched_cfg *cfg, vo
 		.priv = priv,
 	};
 
+	if (l1sched_prim_pool_init(sched, cfg->prim_pool_size ? : L1SCHED_PRIM_POOL_SIZE) != 0) {
+		talloc_free(sched);
+		return NULL;
+	}
+
 	/* Populate UL SACCH cache */
 	l1sched_sacch_cache_update(sched, meas_rep_dummy);
 
@@ -171,9 +281,19 @@ void l1sched_free(struct l1sched_state *sched)
 
 	LOGP_SCHEDC(sched, LOGL_NOTICE, "Shutdown scheduler\n");
 
+	l1sched_stats_unregister(sched);
+
+	l1sched_deadline_report(sched);
+
+	/* Stop decoding workers (if any), pending blocks are dropped */
+	l1sched_decoder_stop(sched);
+	l1sched_capture_stop(sched);
+
 	/* Free all potentially allocated timeslots */
 	l1sched_del_all_ts(sched);
 
+	l1sched_prim_pool_free(sched);
+
 	talloc_free(sched);
 }
 
@@ -184,6 +304,12 @@ void l1sched_reset(struct l1sched_state *sched)
 
 	LOGP_SCHEDC(sched, LOGL_NOTICE, "Reset scheduler\n");
 
+	l1sched_capture_cfg(sched, L1SCHED_CAPTURE_REC_RESET,
+			    &(struct l1sched_capture_cfg) { 0 });
+
+	/* Deliver blocks which are still being decoded (if any) */
+	l1sched_decoder_flush(sched);
+
 	/* Free all potentially allocated timeslots */
 	l1sched_del_all_ts(sched);
 	/* Reset UL SACCH cache */
@@ -231,14 +357,18 @@ void l1sched_del_ts(struct l1sched_state *sched, int tn)
 
 	LOGP_SCHEDC(sched, LOGL_NOTICE, "Delete TDMA timeslot #%u\n", tn);
 
+	l1sched_capture_cfg(sched, L1SCHED_CAPTURE_REC_DEL_TS,
+			    &(struct l1sched_capture_cfg) { .tn = tn });
+
 	/* Deactivate all logical channels */
-	l1sched_deactivate_all_lchans(ts);
+	ts_deactivate_all_lchans(ts);
 
 	/* Free channel states */
 	llist_for_each_entry_safe(lchan, lchan_next, &ts->lchans, list) {
 		llist_del(&lchan->list);
 		talloc_free(lchan);
 	}
+	memset(&ts->lchan_by_type[0], 0x00, sizeof(ts->lchan_by_type));
 
 	/* Remove ts from list and free memory */
 	sched->ts[tn] = NULL;
@@ -276,10 +406,11 @@ l1sched_ts_add_lchan(struct l1sched_ts *ts,
 	l1sched_sacch_cache_read(ts->sched, lchan->sacch.mr_cache);
 	/* Add to the list of channel states */
 	llist_add_tail(&lchan->list, &ts->lchans);
+	ts->lchan_by_type[type] = lchan;
 
 	/* Enable channel automatically if required */
 	if (l1sched_lchan_desc[type].flags & L1SCHED_CH_FLAG_AUTO)
-		l1sched_activate_lchan(ts, type);
+		ts_activate_lchan(ts, type);
 
 	return lchan;
 }
@@ -293,6 +424,12 @@ int l1sched_configure_ts(struct l1sched_state *sched, int tn,
 	enum l1sched_lchan_type type;
 	struct l1sched_ts *ts;
 
+	l1sched_capture_cfg(sched, L1SCHED_CAPTURE_REC_CONFIGURE_TS,
+			    &(struct l1sched_capture_cfg) {
+		.tn = tn,
+		.configure_ts.pchan = config,
+	});
+
 	/* Try to find specified ts */
 	ts = sched->ts[tn];
 	if (ts != NULL) {
@@ -326,6 +463,24 @@ int l1sched_configure_ts(struct l1sched_state *sched, int tn,
 		l1sched_ts_add_lchan(ts, type);
 	}
 
+	/* Resolve lchan states and handlers for each frame of the layout */
+	ts->dispatch = talloc_array(ts, struct l1sched_ts_dispatch, ts->mf_layout->period);
+	if (ts->dispatch == NULL)
+		return -ENOMEM;
+
+	for (unsigned int i = 0; i < ts->mf_layout->period; i++) {
+		const struct l1sched_tdma_frame *frame = &ts->mf_layout->frames[i];
+
+		ts->dispatch[i] = (struct l1sched_ts_dispatch) {
+			.dl_lchan = l1sched_find_lchan_by_type(ts, frame->dl_chan),
+			.rx_fn = l1sched_lchan_desc[frame->dl_chan].rx_fn,
+			.dl_bid = frame->dl_bid,
+			.ul_lchan = l1sched_find_lchan_by_type(ts, frame->ul_chan),
+			.tx_fn = l1sched_lchan_desc[frame->ul_chan].tx_fn,
+			.ul_bid = frame->ul_bid,
+		};
+	}
+
 	/* Notify transceiver about TS activation */
 	l1sched_cfg_pchan_comb_ind(sched, tn, config);
 
@@ -344,15 +499,17 @@ int l1sched_reset_ts(struct l1sched_state *sched, int tn)
 
 	/* Undefine multiframe layout */
 	ts->mf_layout = NULL;
+	TALLOC_FREE(ts->dispatch);
 
 	/* Deactivate all logical channels */
-	l1sched_deactivate_all_lchans(ts);
+	ts_deactivate_all_lchans(ts);
 
 	/* Free channel states */
 	llist_for_each_entry_safe(lchan, lchan_next, &ts->lchans, list) {
 		llist_del(&lchan->list);
 		talloc_free(lchan);
 	}
+	memset(&ts->lchan_by_type[0], 0x00, sizeof(ts->lchan_by_type));
 
 	/* Notify transceiver about that */
 	l1sched_cfg_pchan_comb_ind(sched, tn, GSM_PCHAN_NONE);
@@ -373,6 +530,14 @@ int l1sched_start_ciphering(struct l1sched_ts *ts, uint8_t algo,
 	if (key_len > MAX_A5_KEY_LEN)
 		return -ERANGE;
 
+	struct l1sched_capture_cfg cfg = {
+		.tn = ts->index,
+		.ciphering.algo = algo,
+		.ciphering.key_len = key_len,
+	};
+	memcpy(&cfg.ciphering.key[0], key, key_len);
+	l1sched_capture_cfg(ts->sched, L1SCHED_CAPTURE_REC_CIPHERING, &cfg);
+
 	/* Iterate over all allocated logical channels */
 	llist_for_each_entry(lchan, &ts->lchans, list) {
 		/* Omit inactive channels */
@@ -386,6 +551,9 @@ int l1sched_start_ciphering(struct l1sched_ts *ts, uint8_t algo,
 		/* Copy requested key */
 		if (key_len)
 			memcpy(lchan->a5.key, key, key_len);
+
+		/* Drop the keystream generated with the old key (if any) */
+		l1sched_a5_ks_invalidate(lchan);
 	}
 
 	return 0;
@@ -394,13 +562,10 @@ int l1sched_start_ciphering(struct l1sched_ts *ts, uint8_t algo,
 struct l1sched_lchan_state *l1sched_find_lchan_by_type(struct l1sched_ts *ts,
 						       enum l1sched_lchan_type type)
 {
-	struct l1sched_lchan_state *lchan;
-
-	llist_for_each_entry(lchan, &ts->lchans, list)
-		if (lchan->type == type)
-			return lchan;
-
-	return NULL;
+	/* Direct lookup, this is called for every burst */
+	if (type >= _L1SCHED_CHAN_MAX)
+		return NULL;
+	return ts->lchan_by_type[type];
 }
 
 struct l1sched_lchan_state *l1sched_find_lchan_by_chan_nr(struct l1sched_state *sched,
@@ -435,13 +600,24 @@ int l1sched_set_lchans(struct l1sched_ts *ts, uint8_t chan_nr,
 	/* Prevent NULL-pointer deference */
 	OSMO_ASSERT(ts != NULL);
 
+	l1sched_capture_cfg(ts->sched, L1SCHED_CAPTURE_REC_SET_LCHANS,
+			    &(struct l1sched_capture_cfg) {
+		.tn = ts->index,
+		.set_lchans = {
+			.chan_nr = chan_nr,
+			.active = active,
+			.tch_mode = tch_mode,
+			.tsc = tsc,
+		},
+	});
+
 	/* Iterate over all allocated lchans */
 	llist_for_each_entry(lchan, &ts->lchans, list) {
 		lchan_desc = &l1sched_lchan_desc[lchan->type];
 
 		if (lchan_desc->chan_nr == (chan_nr & RSL_CHAN_NR_MASK)) {
 			if (active) {
-				rc |= l1sched_activate_lchan(ts, lchan->type);
+				rc |= ts_activate_lchan(ts, lchan->type);
 				lchan->tch_mode = tch_mode;
 				lchan->tsc = tsc;
 			} else
@@ -455,6 +631,7 @@ int l1sched_set_lchans(struct l1sched_ts *ts, uint8_t chan_nr,
 int l1sched_lchan_set_amr_cfg(struct l1sched_lchan_state *lchan,
 			      uint8_t codecs_bitmask, uint8_t start_codec)
 {
+	const uint8_t codecs_bitmask_orig = codecs_bitmask;
 	int n = 0;
 	int acum = 0;
 	int pos;
@@ -470,6 +647,16 @@ int l1sched_lchan_set_amr_cfg(struct l1sched_lchan_state *lchan,
 		return -EINVAL;
 	}
 
+	l1sched_capture_cfg(lchan->ts->sched, L1SCHED_CAPTURE_REC_AMR_CFG,
+			    &(struct l1sched_capture_cfg) {
+		.tn = lchan->ts->index,
+		.amr_cfg = {
+			.type = lchan->type,
+			.codecs_bitmask = codecs_bitmask_orig,
+			.start_codec = start_codec,
+		},
+	});
+
 	lchan->amr.codecs = n;
 	lchan->amr.dl_ft = start_codec;
 	lchan->amr.dl_cmr = start_codec;
@@ -479,7 +666,7 @@ int l1sched_lchan_set_amr_cfg(struct l1sched_lchan_state *lchan,
 	return 0;
 }
 
-int l1sched_activate_lchan(struct l1sched_ts *ts, enum l1sched_lchan_type chan)
+static int ts_activate_lchan(struct l1sched_ts *ts, enum l1sched_lchan_type chan)
 {
 	const struct l1sched_lchan_desc *lchan_desc = &l1sched_lchan_desc[chan];
 	struct l1sched_lchan_state *lchan;
@@ -511,12 +698,29 @@ int l1sched_activate_lchan(struct l1sched_ts *ts, enum l1sched_lchan_type chan)
 			return -ENOMEM;
 	}
 
+	if (lchan_desc->rx_fn && L1SCHED_CHAN_IS_TCH(chan)) {
+		lchan->rx_facch = talloc_zero(lchan, struct l1sched_facch_dil);
+		if (lchan->rx_facch == NULL)
+			return -ENOMEM;
+	}
+
 	/* Finally, update channel status */
 	lchan->active = 1;
 
 	return 0;
 }
 
+int l1sched_activate_lchan(struct l1sched_ts *ts, enum l1sched_lchan_type chan)
+{
+	l1sched_capture_cfg(ts->sched, L1SCHED_CAPTURE_REC_ACTIVATE_LCHAN,
+			    &(struct l1sched_capture_cfg) {
+		.tn = ts->index,
+		.lchan.type = chan,
+	});
+
+	return ts_activate_lchan(ts, chan);
+}
+
 static void l1sched_reset_lchan(struct l1sched_lchan_state *lchan)
 {
 	struct msgb *msg;
@@ -528,9 +732,12 @@ static void l1sched_reset_lchan(struct l1sched_lchan_state *lchan)
 	if (l1sched_lchan_desc[lchan->type].rx_fn && lchan->active) {
 		LOGP_LCHANC(lchan, LOGL_DEBUG, "TDMA statistics: "
 			    "%lu DL frames have been processed, "
-			    "%lu lost (compensated), last fn=%u\n",
+			    "%lu lost (compensated) in %lu events, "
+			    "%lu resync(s), last fn=%u\n",
 			    lchan->tdma.num_proc,
 			    lchan->tdma.num_lost,
+			    lchan->tdma.num_loss_events,
+			    lchan->tdma.num_resync,
 			    lchan->tdma.last_proc);
 	}
 
@@ -541,9 +748,11 @@ static void l1sched_reset_lchan(struct l1sched_lchan_state *lchan)
 	/* Free burst memory */
 	talloc_free(lchan->rx_bursts);
 	talloc_free(lchan->tx_bursts);
+	talloc_free(lchan->rx_facch);
 
 	lchan->rx_bursts = NULL;
 	lchan->tx_bursts = NULL;
+	lchan->rx_facch = NULL;
 
 	/* Flush the queue of pending Tx prims */
 	while ((msg = msgb_dequeue(&lchan->tx_prims)) != NULL) {
@@ -569,7 +778,7 @@ static void l1sched_reset_lchan(struct l1sched_lchan_state *lchan)
 	}
 
 	/* Reset ciphering state */
-	memset(&lchan->a5, 0x00, sizeof(lchan->a5));
+	l1sched_a5_reset(lchan);
 
 	/* Reset TDMA frame statistics */
 	memset(&lchan->tdma, 0x00, sizeof(lchan->tdma));
@@ -600,7 +809,7 @@ int l1sched_deactivate_lchan(struct l1sched_ts *ts, enum l1sched_lchan_type chan
 	return 0;
 }
 
-void l1sched_deactivate_all_lchans(struct l1sched_ts *ts)
+static void ts_deactivate_all_lchans(struct l1sched_ts *ts)
 {
 	struct l1sched_lchan_state *lchan;
 
@@ -621,6 +830,14 @@ void l1sched_deactivate_all_lchans(struct l1sched_ts *ts)
 	}
 }
 
+void l1sched_deactivate_all_lchans(struct l1sched_ts *ts)
+{
+	l1sched_capture_cfg(ts->sched, L1SCHED_CAPTURE_REC_DEACTIVATE_ALL,
+			    &(struct l1sched_capture_cfg) { .tn = ts->index });
+
+	ts_deactivate_all_lchans(ts);
+}
+
 enum gsm_phys_chan_config l1sched_chan_nr2pchan_config(uint8_t chan_nr)
 {
 	uint8_t cbits = chan_nr >> 3;
@@ -643,46 +860,15 @@ enum gsm_phys_chan_config l1sched_chan_nr2pchan_config(uint8_t chan_nr)
 	return GSM_PCHAN_NONE;
 }
 
-static void l1sched_a5_burst_dec(struct l1sched_lchan_state *lchan,
-				 struct l1sched_burst_ind *bi)
-{
-	ubit_t ks[114];
-	int i;
-
-	/* Generate keystream for a DL burst */
-	osmo_a5(lchan->a5.algo, lchan->a5.key, bi->fn, ks, NULL);
-
-	/* Apply keystream over ciphertext */
-	for (i = 0; i < 57; i++) {
-		if (ks[i])
-			bi->burst[i + 3] *= -1;
-		if (ks[i + 57])
-			bi->burst[i + 88] *= -1;
-	}
-}
-
-static void l1sched_a5_burst_enc(struct l1sched_lchan_state *lchan,
-				 struct l1sched_burst_req *br)
-{
-	ubit_t ks[114];
-	int i;
-
-	/* Generate keystream for an UL burst */
-	osmo_a5(lchan->a5.algo, lchan->a5.key, br->fn, NULL, ks);
-
-	/* Apply keystream over plaintext */
-	for (i = 0; i < 57; i++) {
-		br->burst[i + 3] ^= ks[i];
-		br->burst[i + 88] ^= ks[i + 57];
-	}
-}
-
 static int subst_frame_loss(struct l1sched_lchan_state *lchan,
 			    l1sched_lchan_rx_func *handler,
 			    uint32_t fn)
 {
 	const struct l1sched_tdma_multiframe *mf;
 	const struct l1sched_tdma_frame *fp;
+	unsigned int num_lost = 0;
+	uint32_t fn_lost;
+	bool block4;
 	int elapsed, i;
 
 	/* Wait until at least one TDMA frame is processed */
@@ -716,6 +902,7 @@ static int subst_frame_loss(struct l1sched_lchan_state *lchan,
 			    "Too many (>%u) contiguous TDMA frames elapsed (%d) "
 			    "since the last processed fn=%u (current %u)\n",
 			    mf->period, elapsed, lchan->tdma.last_proc, fn);
+		lchan->tdma.num_resync++;
 		return -EIO;
 	} else if (elapsed == 0) {
 		LOGP_LCHANC(lchan, LOGL_ERROR,
@@ -724,8 +911,11 @@ static int subst_frame_loss(struct l1sched_lchan_state *lchan,
 		return -EIO;
 	}
 
+	/* Nothing has been lost (the most common case) */
+	if (elapsed == 1)
+		return 0;
+
 	struct l1sched_burst_ind bi = {
-		.fn = lchan->tdma.last_proc,
 		.tn = lchan->ts->index,
 		.toa256 = 0,
 		.rssi = -120,
@@ -733,22 +923,45 @@ static int subst_frame_loss(struct l1sched_lchan_state *lchan,
 		.burst_len = GSM_NBITS_NB_GMSK_BURST,
 	};
 
-	/* Traverse from fp till the current frame */
+	/* Lost bursts of a block-interleaved channel can be marked in the
+	 * buffer directly, so the handler is only invoked for the last burst
+	 * of a block (which triggers decoding). */
+	block4 = !!(l1sched_lchan_desc[lchan->type].flags & L1SCHED_CH_FLAG_RX_BLOCK4);
+
+	/* Traverse from the last processed till the current frame */
+	fn_lost = lchan->tdma.last_proc;
 	for (i = 0; i < elapsed - 1; i++) {
-		fp = &mf->frames[GSM_TDMA_FN_INC(bi.fn) % mf->period];
+		fn_lost = GSM_TDMA_FN_INC(fn_lost);
+		fp = &mf->frames[fn_lost % mf->period];
 		if (fp->dl_chan != lchan->type)
 			continue;
 
-		LOGP_LCHANC(lchan, LOGL_NOTICE,
-			    "Substituting lost TDMA frame fn=%u\n", bi.fn);
-
+		bi.fn = fn_lost;
 		bi.bid = fp->dl_bid;
-		handler(lchan, &bi);
+
+		if (block4 && bi.bid != 3) {
+			/* Same as the rx_fn would do with an all-zero burst */
+			if (lchan->rx_burst_mask != 0x00 || bi.bid == 0) {
+				lchan->rx_burst_mask |= (1 << bi.bid);
+				l1sched_lchan_meas_push(lchan, &bi);
+				memset(&lchan->rx_bursts[bi.bid * 116], 0, 116 * sizeof(sbit_t));
+			}
+		} else {
+			handler(lchan, &bi);
+		}
 
 		/* Update TDMA frame statistics */
 		lchan->tdma.last_proc = bi.fn;
 		lchan->tdma.num_proc++;
-		lchan->tdma.num_lost++;
+		num_lost++;
+	}
+
+	if (num_lost > 0) {
+		LOGP_LCHAND(lchan, LOGL_DEBUG, "Substituted %u lost TDMA frame(s) "
+			    "after fn=%u (current %u)\n", num_lost,
+			    GSM_TDMA_FN_SUB(fn, elapsed), fn);
+		lchan->tdma.num_lost += num_lost;
+		lchan->tdma.num_loss_events++;
 	}
 
 	return 0;
@@ -758,29 +971,27 @@ int l1sched_handle_rx_burst(struct l1sched_state *sched,
 			    struct l1sched_burst_ind *bi)
 {
 	struct l1sched_lchan_state *lchan;
-	const struct l1sched_tdma_frame *frame;
+	const struct l1sched_ts_dispatch *d;
+	struct l1sched_lchan_stats *st;
 	struct l1sched_ts *ts = sched->ts[bi->tn];
 
 	l1sched_lchan_rx_func *handler;
-	enum l1sched_lchan_type chan;
-	uint8_t offset;
 	int rc;
 
+	if (sched->capture != NULL)
+		l1sched_capture_burst(sched, bi);
+
 	/* Check whether required timeslot is allocated and configured */
-	if (ts == NULL || ts->mf_layout == NULL) {
+	if (ts == NULL || ts->dispatch == NULL) {
 		LOGP_SCHEDD(sched, LOGL_DEBUG,
 			    "Timeslot #%u isn't configured, ignoring burst...\n", bi->tn);
 		return -EINVAL;
 	}
 
-	/* Get frame from multiframe */
-	offset = bi->fn % ts->mf_layout->period;
-	frame = ts->mf_layout->frames + offset;
-
-	/* Get required info from frame */
-	bi->bid = frame->dl_bid;
-	chan = frame->dl_chan;
-	handler = l1sched_lchan_desc[chan].rx_fn;
+	/* Get the precompiled dispatch entry for this frame */
+	d = &ts->dispatch[bi->fn % ts->mf_layout->period];
+	bi->bid = d->dl_bid;
+	handler = d->rx_fn;
 
 	/* Omit bursts which have no handler, like IDLE bursts.
 	 * TODO: handle noise indications during IDLE frames. */
@@ -788,7 +999,7 @@ int l1sched_handle_rx_burst(struct l1sched_state *sched,
 		return -ENODEV;
 
 	/* Find required channel state */
-	lchan = l1sched_find_lchan_by_type(ts, chan);
+	lchan = d->dl_lchan;
 	if (lchan == NULL)
 		return -ENODEV;
 
@@ -805,8 +1016,27 @@ int l1sched_handle_rx_burst(struct l1sched_state *sched,
 	if (lchan->a5.algo)
 		l1sched_a5_burst_dec(lchan, bi);
 
+	st = &sched->stats.lchan[lchan->type];
+	st->bursts_rx++;
+
 	/* Put burst to handler */
-	handler(lchan, bi);
+	if (OSMO_UNLIKELY(sched->stats.dec_timing)) {
+		/* Only account bursts which completed the decoding of a block */
+		const unsigned long num_blocks = st->blocks_good + st->blocks_bad;
+		struct timespec t0, t1;
+
+		osmo_clock_gettime(CLOCK_MONOTONIC, &t0);
+		handler(lchan, bi);
+		osmo_clock_gettime(CLOCK_MONOTONIC, &t1);
+
+		if (st->blocks_good + st->blocks_bad != num_blocks) {
+			st->dec_time_ns += (uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000
+					 + (t1.tv_nsec - t0.tv_nsec);
+			st->dec_time_num++;
+		}
+	} else {
+		handler(lchan, bi);
+	}
 
 	/* Update TDMA frame statistics */
 	lchan->tdma.last_proc = bi->fn;
@@ -829,23 +1059,20 @@ int l1sched_handle_rx_probe(struct l1sched_state *sched,
 			    struct l1sched_probe *probe)
 {
 	struct l1sched_ts *ts = sched->ts[probe->tn];
-	const struct l1sched_tdma_frame *frame;
+	const struct l1sched_ts_dispatch *d;
 	struct l1sched_lchan_state *lchan;
-	unsigned int offset;
 
 	/* Check whether required timeslot is allocated and configured */
-	if (ts == NULL || ts->mf_layout == NULL)
+	if (ts == NULL || ts->dispatch == NULL)
 		return -EINVAL;
 
-	/* Get frame from multiframe */
-	offset = probe->fn % ts->mf_layout->period;
-	frame = &ts->mf_layout->frames[offset];
-
-	if (l1sched_lchan_desc[frame->dl_chan].rx_fn == NULL)
+	/* Get the precompiled dispatch entry for this frame */
+	d = &ts->dispatch[probe->fn % ts->mf_layout->period];
+	if (d->rx_fn == NULL)
 		return -ENODEV;
 
 	/* Find the appropriate logical channel */
-	lchan = l1sched_find_lchan_by_type(ts, frame->dl_chan);
+	lchan = d->dl_lchan;
 	if (lchan == NULL)
 		return -ENODEV;
 
@@ -855,61 +1082,97 @@ int l1sched_handle_rx_probe(struct l1sched_state *sched,
 	return 0;
 }
 
-#define MEAS_HIST_FIRST(hist) \
-	(&hist->buf[0])
-#define MEAS_HIST_LAST(hist) \
-	(MEAS_HIST_FIRST(hist) + ARRAY_SIZE(hist->buf) - 1)
-
 /* Add a new set of measurements to the history */
 void l1sched_lchan_meas_push(struct l1sched_lchan_state *lchan,
 			     const struct l1sched_burst_ind *bi)
 {
 	struct l1sched_lchan_meas_hist *hist = &lchan->meas_hist;
+	const unsigned int i = hist->next;
 
-	/* Find a new position where to store the measurements */
-	if (hist->head == MEAS_HIST_LAST(hist) || hist->head == NULL)
-		hist->head = MEAS_HIST_FIRST(hist);
-	else
-		hist->head++;
+	/* Store twice, so that l1sched_lchan_meas_avg() never wraps around */
+	hist->fn[i] = hist->fn[i + L1SCHED_MEAS_HIST_LEN] = bi->fn;
+	hist->toa256[i] = hist->toa256[i + L1SCHED_MEAS_HIST_LEN] = bi->toa256;
+	hist->rssi[i] = hist->rssi[i + L1SCHED_MEAS_HIST_LEN] = bi->rssi;
 
-	*hist->head = (struct l1sched_meas_set) {
-		.fn = bi->fn,
-		.toa256 = bi->toa256,
-		.rssi = bi->rssi,
-	};
+	if (++hist->next == L1SCHED_MEAS_HIST_LEN)
+		hist->next = 0;
+	if (hist->num < L1SCHED_MEAS_HIST_LEN)
+		hist->num++;
 }
 
-/* Calculate the AVG of n measurements from the history */
-void l1sched_lchan_meas_avg(struct l1sched_lchan_state *lchan, unsigned int n)
+/* The reductions below are kept free of data dependent branches and
+ * operate on one contiguous array each, so that the compiler can
+ * vectorize them (min/max, sum and sum of squares). */
+static void meas_reduce_s16(const int16_t *v, unsigned int n,
+			    int16_t *min, int16_t *max, int32_t *sum, int64_t *sum_sq)
 {
-	struct l1sched_lchan_meas_hist *hist = &lchan->meas_hist;
-	struct l1sched_meas_set *meas = hist->head;
-	int toa256_sum = 0;
-	int rssi_sum = 0;
-	int i;
+	int16_t lo = v[0], hi = v[0];
+	int32_t s = 0;
+	int64_t sq = 0;
+	unsigned int i;
 
-	OSMO_ASSERT(n > 0 && n <= ARRAY_SIZE(hist->buf));
-	OSMO_ASSERT(meas != NULL);
-
-	/* Traverse backwards up to n entries, calculate the sum */
 	for (i = 0; i < n; i++) {
-		toa256_sum += meas->toa256;
-		rssi_sum += meas->rssi;
+		lo = v[i] < lo ? v[i] : lo;
+		hi = v[i] > hi ? v[i] : hi;
+		s += v[i];
+		sq += (int32_t)v[i] * v[i];
+	}
+
+	*min = lo;
+	*max = hi;
+	*sum = s;
+	*sum_sq = sq;
+}
 
-		/* Do not go below the first burst */
-		if (i + 1 == n)
-			break;
+static void meas_reduce_s8(const int8_t *v, unsigned int n,
+			   int8_t *min, int8_t *max, int32_t *sum, int32_t *sum_sq)
+{
+	int8_t lo = v[0], hi = v[0];
+	int32_t s = 0, sq = 0;
+	unsigned int i;
 
-		if (meas == MEAS_HIST_FIRST(hist))
-			meas = MEAS_HIST_LAST(hist);
-		else
-			meas--;
+	for (i = 0; i < n; i++) {
+		lo = v[i] < lo ? v[i] : lo;
+		hi = v[i] > hi ? v[i] : hi;
+		s += v[i];
+		sq += (int16_t)v[i] * v[i];
 	}
 
+	*min = lo;
+	*max = hi;
+	*sum = s;
+	*sum_sq = sq;
+}
+
+/* Calculate the AVG (as well as min/max and variance) of the last n
+ * measurements from the history */
+void l1sched_lchan_meas_avg(struct l1sched_lchan_state *lchan, unsigned int n)
+{
+	const struct l1sched_lchan_meas_hist *hist = &lchan->meas_hist;
+	struct l1sched_meas_set *avg = &lchan->meas_avg;
+	int32_t toa256_sum, rssi_sum, rssi_sum_sq;
+	int64_t toa256_sum_sq;
+	unsigned int first;
+
+	OSMO_ASSERT(n > 0 && n <= L1SCHED_MEAS_HIST_LEN);
+	OSMO_ASSERT(hist->num > 0);
+
+	/* Index of the oldest of the last n entries in the mirrored arrays */
+	first = hist->next + L1SCHED_MEAS_HIST_LEN - n;
+
+	meas_reduce_s16(&hist->toa256[first], n, &avg->toa256_min, &avg->toa256_max,
+			&toa256_sum, &toa256_sum_sq);
+	meas_reduce_s8(&hist->rssi[first], n, &avg->rssi_min, &avg->rssi_max,
+		       &rssi_sum, &rssi_sum_sq);
+
 	/* Calculate the AVG */
-	lchan->meas_avg.toa256 = toa256_sum / n;
-	lchan->meas_avg.rssi = rssi_sum / n;
+	avg->toa256 = toa256_sum / (int)n;
+	avg->rssi = rssi_sum / (int)n;
+
+	/* Var(X) = (n * sum(X^2) - sum(X)^2) / n^2 */
+	avg->toa256_var = ((int64_t)n * toa256_sum_sq - (int64_t)toa256_sum * toa256_sum) / (n * n);
+	avg->rssi_var = ((int32_t)n * rssi_sum_sq - rssi_sum * rssi_sum) / (int32_t)(n * n);
 
 	/* As a bonus, store TDMA frame number of the first burst */
-	lchan->meas_avg.fn = meas->fn;
+	avg->fn = hist->fn[first];
 }
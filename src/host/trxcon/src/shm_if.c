@@ -0,0 +1,475 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * Shared memory PHY interface (co-located transceiver)
+ *
+ * The state machine and the PHYIF glue are modelled after trx_if.c,
+ * hence the same license as trx_if.c.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/socket.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/fsm.h>
+
+#include <osmocom/gsm/gsm0502.h>
+
+#include <osmocom/bb/trxcon/shm_if.h>
+#include <osmocom/bb/trxcon/logging.h>
+
+/* File descriptors passed by the transceiver via SCM_RIGHTS */
+enum shm_if_fd {
+	SHM_IF_FD_REGION,
+	SHM_IF_FD_L1_EVENT,
+	SHM_IF_FD_TRX_EVENT,
+	_SHM_IF_FD_NUM
+};
+
+static void shm_fsm_cleanup_cb(struct osmo_fsm_inst *fi,
+			       enum osmo_fsm_term_cause cause);
+
+static const struct value_string shm_evt_names[] = {
+	{ 0, NULL } /* no events? */
+};
+
+static const struct osmo_fsm_state shm_fsm_states[] = {
+	{
+		.name = "ACTIVE",
+	},
+};
+
+static struct osmo_fsm shm_fsm = {
+	.name = "shm_interface",
+	.states = shm_fsm_states,
+	.num_states = ARRAY_SIZE(shm_fsm_states),
+	.log_subsys = DTRXC,
+	.event_names = shm_evt_names,
+	.cleanup = &shm_fsm_cleanup_cb,
+};
+
+/* Wake up the transceiver (if it's waiting for something to consume) */
+static void shm_if_wakeup_trx(struct shm_instance *shm)
+{
+	const uint64_t val = 1;
+
+	if (write(shm->trx_efd, &val, sizeof(val)) != sizeof(val))
+		LOGPFSML(shm->fi, LOGL_ERROR, "Failed to signal the transceiver\n");
+}
+
+/* ------------------------------------------------------------------------ */
+/* TRX -> L1 (bursts and command responses)                                 */
+/* ------------------------------------------------------------------------ */
+
+static void shm_if_handle_rsp(struct shm_instance *shm, const struct shm_if_rsp *srsp)
+{
+	switch (srsp->type) {
+	case TRXCON_PHYIF_CMDT_MEASURE:
+	{
+		const struct trxcon_phyif_rsp rsp = {
+			.type = TRXCON_PHYIF_CMDT_MEASURE,
+			.param.measure = {
+				.band_arfcn = srsp->param.measure.band_arfcn,
+				.dbm = srsp->param.measure.dbm,
+			},
+		};
+
+		trxcon_phyif_handle_rsp(shm->priv, &rsp);
+		break;
+	}
+	default:
+		LOGPFSML(shm->fi, LOGL_ERROR,
+			 "Unhandled PHYIF response type=0x%02x\n", srsp->type);
+	}
+}
+
+static void shm_if_handle_burst_ind(struct shm_instance *shm,
+				    const struct shm_if_burst_ind *sbi,
+				    const struct timespec *rx_time)
+{
+	/* Soft-bits are passed up directly from the shared memory */
+	const struct trxcon_phyif_burst_ind bi = {
+		.fn = sbi->fn,
+		.tn = sbi->tn,
+		.rssi = sbi->rssi,
+		.toa256 = sbi->toa256,
+		.burst = &sbi->burst[0],
+		.burst_len = sbi->burst_len,
+	};
+
+	LOGPFSMSL(shm->fi, DTRXD, LOGL_DEBUG,
+		  "RX burst tn=%u fn=%u rssi=%d toa=%d\n",
+		  bi.tn, bi.fn, bi.rssi, bi.toa256);
+
+	/* NOPE / IDLE indications (burst_len == 0) are passed up too: the
+	 * scheduler accounts them as received frames, not as lost ones */
+	trxcon_phyif_handle_burst_ind(shm->priv, &bi);
+
+	const struct trxcon_phyif_rts_ind rts = {
+		.fn = GSM_TDMA_FN_SUM(bi.fn, shm->fn_advance),
+		.tn = bi.tn,
+		.time = *rx_time,
+	};
+
+	trxcon_phyif_handle_rts_ind(shm->priv, &rts);
+}
+
+static int shm_if_l1_event_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct shm_instance *shm = ofd->data;
+	struct shm_if_region *region = shm->region;
+	struct shm_if_burst_ind *sbi;
+	struct shm_if_rsp *srsp;
+	struct timespec rx_time;
+	uint64_t val;
+
+	/* Reset the eventfd counter, then drain both rings */
+	if (read(ofd->fd, &val, sizeof(val)) != sizeof(val))
+		return 0;
+	osmo_clock_gettime(CLOCK_MONOTONIC, &rx_time);
+	shm->num_wakeups++;
+	shm->ul_wakeup = false;
+	shm->draining = true;
+
+	while ((srsp = shm_if_ring_cons_slot(&region->rsp)) != NULL) {
+		shm_if_handle_rsp(shm, srsp);
+		shm_if_ring_consume(&region->rsp.hdr);
+	}
+
+	while ((sbi = shm_if_ring_cons_slot(&region->dl)) != NULL) {
+		shm_if_handle_burst_ind(shm, sbi, &rx_time);
+		/* The slot is released only after it has been handled */
+		shm_if_ring_consume(&region->dl.hdr);
+		shm->num_bursts++;
+	}
+
+	shm->draining = false;
+
+	/* End of the RTS cycle: wake up the transceiver once (if needed) */
+	if (shm->ul_wakeup)
+		shm_if_wakeup_trx(shm);
+
+	return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* L1 -> TRX (bursts and commands)                                          */
+/* ------------------------------------------------------------------------ */
+
+int shm_if_handle_phyif_burst_req(struct shm_instance *shm,
+				  const struct trxcon_phyif_burst_req *br)
+{
+	struct shm_if_burst_req *sbr;
+
+	LOGPFSMSL(shm->fi, DTRXD, LOGL_DEBUG,
+		  "TX burst tn=%u fn=%u pwr=%u\n",
+		  br->tn, br->fn, br->pwr);
+
+	OSMO_ASSERT(br->burst_len <= sizeof(sbr->burst));
+
+	sbr = shm_if_ring_prod_slot(&shm->region->ul);
+	if (sbr == NULL) {
+		shm->num_ul_overflows++;
+		LOGPFSMSL(shm->fi, DTRXD, LOGL_ERROR,
+			  "Uplink ring is full, dropping burst tn=%u fn=%u\n",
+			  br->tn, br->fn);
+		return -ENOSPC;
+	}
+
+	sbr->fn = br->fn;
+	sbr->tn = br->tn;
+	sbr->pwr = br->pwr;
+	sbr->burst_len = br->burst_len;
+	if (br->burst_len != 0)
+		memcpy(&sbr->burst[0], br->burst, br->burst_len);
+
+	if (shm_if_ring_produce(&shm->region->ul.hdr)) {
+		/* Deferred until the end of the RTS cycle (if any) */
+		shm->ul_wakeup = true;
+		if (!shm->draining)
+			shm_if_wakeup_trx(shm);
+	}
+
+	return 0;
+}
+
+int shm_if_handle_phyif_cmd(struct shm_instance *shm, const struct trxcon_phyif_cmd *cmd)
+{
+	struct shm_if_cmd *scmd;
+
+	scmd = shm_if_ring_prod_slot(&shm->region->cmd);
+	if (scmd == NULL) {
+		LOGPFSML(shm->fi, LOGL_ERROR, "Command ring is full\n");
+		return -ENOSPC;
+	}
+
+	memset(scmd, 0x00, sizeof(*scmd));
+	scmd->type = cmd->type;
+
+	switch (cmd->type) {
+	case TRXCON_PHYIF_CMDT_RESET:
+	case TRXCON_PHYIF_CMDT_POWERON:
+	case TRXCON_PHYIF_CMDT_POWEROFF:
+		break;
+	case TRXCON_PHYIF_CMDT_MEASURE:
+		scmd->param.measure = cmd->param.measure;
+		break;
+	case TRXCON_PHYIF_CMDT_SETFREQ_H0:
+		scmd->param.setfreq_h0 = cmd->param.setfreq_h0;
+		break;
+	case TRXCON_PHYIF_CMDT_SETFREQ_H1:
+	{
+		const struct trxcon_phyif_cmdp_setfreq_h1 *h1 = &cmd->param.setfreq_h1;
+
+		if (h1->ma_len > ARRAY_SIZE(scmd->param.setfreq_h1.ma)) {
+			LOGPFSML(shm->fi, LOGL_ERROR, "Mobile Allocation is too long "
+				 "(N=%u)\n", h1->ma_len);
+			return -ENOSPC;
+		}
+
+		scmd->param.setfreq_h1.hsn = h1->hsn;
+		scmd->param.setfreq_h1.maio = h1->maio;
+		scmd->param.setfreq_h1.ma_len = h1->ma_len;
+		memcpy(&scmd->param.setfreq_h1.ma[0], h1->ma, h1->ma_len * sizeof(h1->ma[0]));
+		break;
+	}
+	case TRXCON_PHYIF_CMDT_SETSLOT:
+		scmd->param.setslot = cmd->param.setslot;
+		break;
+	case TRXCON_PHYIF_CMDT_SETTA:
+		scmd->param.setta = cmd->param.setta;
+		break;
+	default:
+		LOGPFSML(shm->fi, LOGL_ERROR,
+			 "Unhandled PHYIF command type=0x%02x\n", cmd->type);
+		return -ENODEV;
+	}
+
+	LOGPFSML(shm->fi, LOGL_DEBUG, "Sending PHYIF command type=0x%02x\n", cmd->type);
+
+	if (shm_if_ring_produce(&shm->region->cmd.hdr))
+		shm_if_wakeup_trx(shm);
+
+	return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Connection management                                                    */
+/* ------------------------------------------------------------------------ */
+
+/* The socket is only used for liveness detection after the handshake */
+static int shm_if_sock_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct shm_instance *shm = ofd->data;
+	uint8_t buf[16];
+	ssize_t rc;
+
+	rc = read(ofd->fd, buf, sizeof(buf));
+	if (rc > 0)
+		return 0;
+
+	LOGPFSML(shm->fi, LOGL_NOTICE, "Transceiver has closed the connection\n");
+	osmo_fsm_inst_term(shm->fi, OSMO_FSM_TERM_ERROR, NULL);
+	return -EBADF;
+}
+
+/* Receive the file descriptors passed by the transceiver */
+static int shm_if_recv_fds(int sock, int *fds)
+{
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * _SHM_IF_FD_NUM)];
+		struct cmsghdr align;
+	} u;
+	struct cmsghdr *cmsg;
+	uint32_t version;
+	struct iovec iov = {
+		.iov_base = &version,
+		.iov_len = sizeof(version),
+	};
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = u.buf,
+		.msg_controllen = sizeof(u.buf),
+	};
+
+	if (recvmsg(sock, &msg, 0) != sizeof(version))
+		return -EIO;
+	if (version != SHM_IF_VERSION)
+		return -EPROTO;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+		return -EPROTO;
+	if (cmsg->cmsg_len != CMSG_LEN(sizeof(int) * _SHM_IF_FD_NUM))
+		return -EPROTO;
+
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * _SHM_IF_FD_NUM);
+	return 0;
+}
+
+/* Init shared memory interface (UNIX socket, shared memory region and FSM) */
+struct shm_instance *shm_if_open(const struct shm_if_params *params)
+{
+	int fds[_SHM_IF_FD_NUM] = { -1, -1, -1 };
+	struct shm_instance *shm;
+	struct osmo_fsm_inst *fi;
+	struct stat st;
+	void *region;
+	int sock, rc;
+
+	LOGPFSML(params->parent_fi, LOGL_NOTICE,
+		 "Init shared memory interface (%s)\n", params->sock_path);
+
+	/* Allocate a new dedicated state machine */
+	fi = osmo_fsm_inst_alloc_child(&shm_fsm, params->parent_fi,
+				       params->parent_term_event);
+	if (fi == NULL) {
+		LOGPFSML(params->parent_fi, LOGL_ERROR,
+			 "Failed to allocate an instance of FSM '%s'\n",
+			 shm_fsm.name);
+		return NULL;
+	}
+
+	shm = talloc_zero(fi, struct shm_instance);
+	if (!shm) {
+		LOGPFSML(params->parent_fi, LOGL_ERROR, "Failed to allocate memory\n");
+		osmo_fsm_inst_free(fi);
+		return NULL;
+	}
+
+	shm->sock_ofd.fd = -1;
+	shm->l1_efd.fd = -1;
+	shm->trx_efd = -1;
+	shm->fn_advance = params->fn_advance;
+	shm->priv = params->priv;
+	fi->priv = shm;
+	shm->fi = fi;
+
+	sock = osmo_sock_unix_init(SOCK_SEQPACKET, 0, params->sock_path,
+				   OSMO_SOCK_F_CONNECT);
+	if (sock < 0) {
+		LOGPFSML(fi, LOGL_ERROR, "Failed to connect to '%s'\n", params->sock_path);
+		goto error;
+	}
+	osmo_fd_setup(&shm->sock_ofd, sock, OSMO_FD_READ, &shm_if_sock_cb, shm, 0);
+
+	rc = shm_if_recv_fds(sock, &fds[0]);
+	if (rc != 0) {
+		LOGPFSML(fi, LOGL_ERROR, "Handshake with the transceiver failed (%d)\n", rc);
+		goto error;
+	}
+
+	/* Accessing a mapping beyond the end of a short region raises SIGBUS */
+	if (fstat(fds[SHM_IF_FD_REGION], &st) != 0)
+		st.st_size = 0;
+	if (st.st_size < (off_t)sizeof(*shm->region)) {
+		LOGPFSML(fi, LOGL_ERROR, "The shared memory region is too small "
+			 "(%lld < %zu bytes)\n", (long long)st.st_size, sizeof(*shm->region));
+		close(fds[SHM_IF_FD_REGION]);
+		close(fds[SHM_IF_FD_L1_EVENT]);
+		close(fds[SHM_IF_FD_TRX_EVENT]);
+		goto error;
+	}
+
+	region = mmap(NULL, sizeof(*shm->region), PROT_READ | PROT_WRITE,
+		      MAP_SHARED, fds[SHM_IF_FD_REGION], 0);
+	close(fds[SHM_IF_FD_REGION]);
+	if (region == MAP_FAILED) {
+		LOGPFSML(fi, LOGL_ERROR, "Failed to map the shared memory region\n");
+		close(fds[SHM_IF_FD_L1_EVENT]);
+		close(fds[SHM_IF_FD_TRX_EVENT]);
+		goto error;
+	}
+
+	shm->region = region;
+	shm->trx_efd = fds[SHM_IF_FD_TRX_EVENT];
+	osmo_fd_setup(&shm->l1_efd, fds[SHM_IF_FD_L1_EVENT], OSMO_FD_READ,
+		      &shm_if_l1_event_cb, shm, 0);
+
+	if (shm->region->magic != SHM_IF_MAGIC || shm->region->version != SHM_IF_VERSION) {
+		LOGPFSML(fi, LOGL_ERROR, "Unexpected shared memory region magic/version\n");
+		goto error;
+	}
+
+	if (osmo_fd_register(&shm->sock_ofd) != 0 || osmo_fd_register(&shm->l1_efd) != 0)
+		goto error;
+
+	return shm;
+
+error:
+	osmo_fsm_inst_free(fi);
+	return NULL;
+}
+
+void shm_if_close(struct shm_instance *shm)
+{
+	if (shm == NULL || shm->fi == NULL)
+		return;
+	osmo_fsm_inst_term(shm->fi, OSMO_FSM_TERM_REQUEST, NULL);
+}
+
+static void shm_if_close_fd(struct osmo_fd *ofd)
+{
+	if (ofd->fd < 0)
+		return;
+	if (osmo_fd_is_registered(ofd))
+		osmo_fd_unregister(ofd);
+	close(ofd->fd);
+	ofd->fd = -1;
+}
+
+static void shm_fsm_cleanup_cb(struct osmo_fsm_inst *fi,
+			       enum osmo_fsm_term_cause cause)
+{
+	struct shm_instance *shm = fi->priv;
+
+	/* May be unallocated due to init error */
+	if (!shm)
+		return;
+
+	LOGPFSML(fi, LOGL_NOTICE, "Shutdown shared memory interface "
+		 "(%lu bursts in %lu wakeups, %lu Uplink overflows)\n",
+		 shm->num_bursts, shm->num_wakeups, shm->num_ul_overflows);
+
+	shm_if_close_fd(&shm->sock_ofd);
+	shm_if_close_fd(&shm->l1_efd);
+	if (shm->trx_efd >= 0)
+		close(shm->trx_efd);
+	if (shm->region != NULL)
+		munmap(shm->region, sizeof(*shm->region));
+
+	/* Free memory */
+	fi->priv = NULL;
+	talloc_free(shm);
+}
+
+static __attribute__((constructor)) void on_dso_load(void)
+{
+	OSMO_ASSERT(osmo_fsm_register(&shm_fsm) == 0);
+}
@@ -22,19 +22,25 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <errno.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <osmocom/core/logging.h>
 #include <osmocom/core/select.h>
 #include <osmocom/core/socket.h>
 #include <osmocom/core/talloc.h>
+#include <osmocom/core/timer.h>
 #include <osmocom/core/bits.h>
 #include <osmocom/core/fsm.h>
 
@@ -42,14 +48,27 @@
 #include <osmocom/gsm/gsm0502.h>
 
 #include <osmocom/bb/trxcon/trx_if.h>
+#include <osmocom/bb/trxcon/trxd_sbit.h>
 #include <osmocom/bb/trxcon/logging.h>
 
 #define TRXDv0_HDR_LEN		8
+#define TRXDv1_HDR_LEN		11
+/* TRXDv2 per-burst header length (the first one is followed by FN) */
+#define TRXDv2_HDR_LEN		8
+
+/* MTS: NOPE / IDLE indication (no burst bits) */
+#define TRXD_MTS_NOPE		(1 << 7)
+/* TRXDv2: another burst follows in the same PDU */
+#define TRXDv2_BATCH		(1 << 7)
+
+/* Max number of Uplink PDUs per sendmmsg(), one per timeslot */
+#define TRX_TX_BATCH_MAX	8
 
 #define S(x)	(1 << (x))
 
 static void trx_fsm_cleanup_cb(struct osmo_fsm_inst *fi,
 			       enum osmo_fsm_term_cause cause);
+static void trx_tx_batch_flush(struct trx_instance *trx);
 
 static struct value_string trx_evt_names[] = {
 	{ 0, NULL } /* no events? */
@@ -477,6 +496,46 @@ static int trx_if_cmd_setfh(struct trx_instance *trx,
 	return trx_ctrl_cmd(trx, 1, "SETFH", "%u %u %s", cmdp->hsn, cmdp->maio, ma_buf);
 }
 
+/*
+ * TRXD PDU version negotiation
+ *
+ * SETFORMAT instructs the transceiver to use the given TRXD PDU
+ * version.  If the requested version is not supported, the
+ * transceiver indicates a preferred (lower) one, so that the
+ * negotiation can be repeated.  The status field is the version.
+ *
+ * CMD SETFORMAT <VER_REQ>
+ * RSP SETFORMAT <VER_RSP> <VER_REQ>
+ */
+
+static int trx_if_cmd_setformat(struct trx_instance *trx, uint8_t ver)
+{
+	return trx_ctrl_cmd(trx, 0, "SETFORMAT", "%u", ver);
+}
+
+static void trx_if_setformat_rsp_cb(struct trx_instance *trx, int ver_rsp)
+{
+	if (ver_rsp < 0 || ver_rsp > trx->trxd_ver_req) {
+		LOGPFSML(trx->fi, LOGL_ERROR, "Transceiver rejected TRXD PDU version "
+			 "negotiation (rsp=%d), falling back to TRXDv0\n", ver_rsp);
+		trx->trxd_ver_req = 0;
+		trx->trxd_ver = 0;
+		return;
+	}
+
+	if (ver_rsp == trx->trxd_ver_req) {
+		LOGPFSML(trx->fi, LOGL_NOTICE, "Using TRXD PDU version %d\n", ver_rsp);
+		trx->trxd_ver = ver_rsp;
+		return;
+	}
+
+	/* The transceiver suggests an older version, try again */
+	LOGPFSML(trx->fi, LOGL_NOTICE, "Transceiver does not support TRXD PDU "
+		 "version %u, suggests %d\n", trx->trxd_ver_req, ver_rsp);
+	trx->trxd_ver_req = ver_rsp;
+	trx_if_cmd_setformat(trx, ver_rsp);
+}
+
 /* Get response from CTRL socket */
 static int trx_ctrl_read_cb(struct osmo_fd *ofd, unsigned int what)
 {
@@ -524,9 +583,9 @@ static int trx_ctrl_read_cb(struct osmo_fd *ofd, unsigned int what)
 		goto rsp_error;
 	}
 
-	/* Check for response code */
+	/* Check for response code (SETFORMAT indicates a version instead) */
 	sscanf(p + 1, "%d", &resp);
-	if (resp) {
+	if (resp && !!strncmp(tcm->cmd + 4, "SETFORMAT", 9)) {
 		LOGPFSML(trx->fi, (tcm->critical) ? LOGL_FATAL : LOGL_ERROR,
 			"Transceiver rejected TRX command with "
 			"response: '%s'\n", buf);
@@ -548,6 +607,10 @@ static int trx_ctrl_read_cb(struct osmo_fd *ofd, unsigned int what)
 		trx_if_measure_rsp_cb(trx, buf + 14);
 	else if (!strncmp(tcm->cmd + 4, "ECHO", 4))
 		osmo_fsm_inst_state_chg(trx->fi, TRX_STATE_IDLE, 0, 0);
+	else if (!strncmp(tcm->cmd + 4, "SETFORMAT", 9)) {
+		trx_if_setformat_rsp_cb(trx, resp);
+		osmo_fsm_inst_state_chg(trx->fi, trx->prev_state, 0, 0);
+	}
 	else
 		osmo_fsm_inst_state_chg(trx->fi, trx->prev_state, 0, 0);
 
@@ -573,7 +636,15 @@ int trx_if_handle_phyif_cmd(struct trx_instance *trx, const struct trxcon_phyif_
 	case TRXCON_PHYIF_CMDT_RESET:
 		if ((rc = trx_if_cmd_poweroff(trx)) != 0)
 			return rc;
-		rc = trx_if_cmd_echo(trx);
+		if ((rc = trx_if_cmd_echo(trx)) != 0)
+			return rc;
+		/* Negotiate TRXD PDU version (if requested) from scratch: the
+		 * transceiver may have been restarted, and a previous negotiation
+		 * may have lowered the requested version */
+		trx->trxd_ver_req = trx->trxd_ver_max;
+		trx->trxd_ver = 0;
+		if (trx->trxd_ver_req > 0)
+			rc = trx_if_cmd_setformat(trx, trx->trxd_ver_req);
 		break;
 	case TRXCON_PHYIF_CMDT_POWERON:
 		rc = trx_if_cmd_poweron(trx);
@@ -613,9 +684,11 @@ int trx_if_handle_phyif_cmd(struct trx_instance *trx, const struct trxcon_phyif_
 /* ------------------------------------------------------------------------ */
 /* DATA interface                                                           */
 /*                                                                          */
-/* Messages on the data interface carry one radio burst per UDP message.    */
+/* Messages on the data interface carry one radio burst per UDP message     */
+/* (TRXDv0 and TRXDv1), or several batched bursts (TRXDv2).                 */
+/* The header version is indicated in the 4 MSB of the first octet.         */
 /*                                                                          */
-/* Received Data Burst:                                                     */
+/* Received Data Burst (TRXDv0):                                            */
 /* 1 byte timeslot index                                                    */
 /* 4 bytes GSM frame number, BE                                             */
 /* 1 byte RSSI in -dBm                                                      */
@@ -623,42 +696,57 @@ int trx_if_handle_phyif_cmd(struct trx_instance *trx, const struct trxcon_phyif_
 /* 148 bytes soft symbol estimates, 0 -> definite "0", 255 -> definite "1"  */
 /* 2 bytes are not used, but being sent by OsmoTRX                          */
 /*                                                                          */
-/* Transmit Data Burst:                                                     */
+/* Received Data Burst (TRXDv1), in addition to TRXDv0:                     */
+/* 1 byte MTS (NOPE, Modulation and Training Sequence)                      */
+/* 2 bytes C/I (Carrier-to-Interference ratio) in cB, BE                    */
+/* soft symbol estimates (length depends on modulation, absent for NOPE)    */
+/*                                                                          */
+/* Received Data Burst (TRXDv2):                                            */
+/* 1 byte timeslot index                                                    */
+/* 1 byte BATCH flag (another burst follows) and TRXN                       */
+/* 1 byte MTS, 1 byte RSSI, 2 bytes ToA256, 2 bytes C/I                     */
+/* 4 bytes GSM frame number, BE (only in the first burst of a PDU)          */
+/* soft symbol estimates (length depends on modulation, absent for NOPE)    */
+/*                                                                          */
+/* Transmit Data Burst (TRXDv0 and TRXDv1):                                 */
 /* 1 byte timeslot index                                                    */
 /* 4 bytes GSM frame number, BE                                             */
 /* 1 byte transmit level wrt ARFCN max, -dB (attenuation)                   */
 /* 148 bytes output symbol values, 0 & 1                                    */
+/*                                                                          */
+/* Transmit Data Burst (TRXDv2):                                            */
+/* 1 byte timeslot index                                                    */
+/* 1 byte BATCH flag (another burst follows) and TRXN                       */
+/* 1 byte MTS, 1 byte transmit level, 1 byte SCPIR, 3 bytes spare           */
+/* 4 bytes GSM frame number, BE (only in the first burst of a PDU)          */
+/* 148 bytes output symbol values, 0 & 1 (absent for NOPE)                  */
 /* ------------------------------------------------------------------------ */
 
-static int trx_data_rx_cb(struct osmo_fd *ofd, unsigned int what)
+/* Get burst length by the modulation type indicated in MTS */
+static int trx_data_mts_burst_len(uint8_t mts)
 {
-	struct trx_instance *trx = ofd->data;
-	struct trxcon_phyif_burst_ind bi;
-	uint8_t buf[TRXD_BUF_SIZE];
-	ssize_t read_len;
-	sbit_t *burst;
+	uint8_t mod = (mts >> 3) & 0x0f;
 
-	read_len = read(ofd->fd, buf, sizeof(buf));
-	if (read_len <= 0) {
-		strerror_r(errno, (char *)buf, sizeof(buf));
-		LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR,
-			  "read() failed on TRXD with rc=%zd (%s)\n",
-			  read_len, (const char *)buf);
-		return read_len;
-	}
+	if ((mod >> 2) == 0x00) /* GMSK */
+		return GSM_NBITS_NB_GMSK_BURST;
+	if (mod == 0x06) /* GMSK (Access Burst) */
+		return GSM_NBITS_NB_GMSK_BURST;
+	if ((mod >> 1) == 0x02) /* 8-PSK */
+		return GSM_NBITS_NB_8PSK_BURST;
+
+	/* AQPSK, 16QAM and 32QAM are not supported */
+	return -ENOTSUP;
+}
 
+static int trx_data_parse_pdu_v0(struct trx_instance *trx, uint8_t *buf, ssize_t read_len,
+				 struct trxcon_phyif_burst_ind *bi)
+{
 	if (read_len < TRXDv0_HDR_LEN) {
 		LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR,
-			  "Got malformed TRXD PDU (short length=%zd)\n", read_len);
+			  "Got malformed TRXDv0 PDU (short length=%zd)\n", read_len);
 		return -EINVAL;
 	}
 
-	if ((buf[0] >> 4) != 0) {
-		LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR,
-			  "Got TRXD PDU with unexpected version\n");
-		return -ENOTSUP;
-	}
-
 	read_len -= TRXDv0_HDR_LEN;
 	switch (read_len) {
 	/* TRXDv0 PDUs may have 2 dummy bytes at the end */
@@ -675,46 +763,539 @@ static int trx_data_rx_cb(struct osmo_fd *ofd, unsigned int what)
 		return -EINVAL;
 	}
 
-	burst = (sbit_t *)&buf[8];
-
-	bi = (struct trxcon_phyif_burst_ind) {
+	*bi = (struct trxcon_phyif_burst_ind) {
 		.tn = buf[0] & 0x07,
 		.fn = osmo_load32be(buf + 1),
 		.rssi = -(int8_t) buf[5],
 		.toa256 = (int16_t) (buf[6] << 8) | buf[7],
-		.burst = burst, /* at least GSM_NBITS_NB_GMSK_BURST */
+		.burst = (sbit_t *)&buf[TRXDv0_HDR_LEN],
 		.burst_len = read_len,
 	};
 
 	/* Convert ubits {254..0} to sbits {-127..127} in-place */
-	for (unsigned int i = 0; i < bi.burst_len; i++) {
-		if (buf[8 + i] == 255)
-			burst[i] = -127;
-		else
-			burst[i] = 127 - buf[8 + i];
+	trxd_ubit2sbit((sbit_t *)&buf[TRXDv0_HDR_LEN], &buf[TRXDv0_HDR_LEN], bi->burst_len);
+
+	return 1;
+}
+
+static int trx_data_parse_pdu_v1(struct trx_instance *trx, uint8_t *buf, ssize_t read_len,
+				 struct trxcon_phyif_burst_ind *bi)
+{
+	int burst_len = 0;
+
+	if (read_len < TRXDv1_HDR_LEN) {
+		LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR,
+			  "Got malformed TRXDv1 PDU (short length=%zd)\n", read_len);
+		return -EINVAL;
+	}
+
+	/* NOPE / IDLE indications carry no burst bits */
+	if (~buf[8] & TRXD_MTS_NOPE) {
+		burst_len = trx_data_mts_burst_len(buf[8]);
+		if (burst_len < 0 || read_len - TRXDv1_HDR_LEN < burst_len) {
+			LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR,
+				  "Got TRXDv1 PDU with unexpected MTS=0x%02x or "
+				  "burst length=%zd\n", buf[8], read_len - TRXDv1_HDR_LEN);
+			return -EINVAL;
+		}
 	}
 
-	if (bi.fn >= GSM_TDMA_HYPERFRAME) {
-		LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR, "Illegal FN %u\n", bi.fn);
+	/* C/I (buf[9..10]) is not used by the upper layers */
+	*bi = (struct trxcon_phyif_burst_ind) {
+		.tn = buf[0] & 0x07,
+		.fn = osmo_load32be(buf + 1),
+		.rssi = -(int8_t) buf[5],
+		.toa256 = (int16_t) (buf[6] << 8) | buf[7],
+		.burst = burst_len ? (sbit_t *)&buf[TRXDv1_HDR_LEN] : NULL,
+		.burst_len = burst_len,
+	};
+
+	trxd_ubit2sbit((sbit_t *)&buf[TRXDv1_HDR_LEN], &buf[TRXDv1_HDR_LEN], bi->burst_len);
+
+	return 1;
+}
+
+static int trx_data_parse_pdu_v2(struct trx_instance *trx, uint8_t *buf, ssize_t read_len,
+				 struct trxcon_phyif_burst_ind *bi)
+{
+	unsigned int num_bursts = 0;
+	ssize_t offset = 0;
+	uint32_t fn;
+
+	if (read_len < TRXDv2_HDR_LEN + 4) {
+		LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR,
+			  "Got malformed TRXDv2 PDU (short length=%zd)\n", read_len);
 		return -EINVAL;
 	}
 
+	/* TDMA frame number is present in the first burst only */
+	fn = osmo_load32be(buf + TRXDv2_HDR_LEN);
+
+	while (1) {
+		const uint8_t *hdr = &buf[offset];
+		ssize_t hdr_len = TRXDv2_HDR_LEN + (offset == 0 ? 4 : 0);
+		int burst_len = 0;
+
+		if (read_len - offset < hdr_len) {
+			LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR,
+				  "Got malformed TRXDv2 PDU (truncated batch)\n");
+			return -EINVAL;
+		}
+
+		/* NOPE / IDLE indications carry no burst bits */
+		if (~hdr[2] & TRXD_MTS_NOPE) {
+			burst_len = trx_data_mts_burst_len(hdr[2]);
+			if (burst_len < 0 || read_len - offset - hdr_len < burst_len) {
+				LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR,
+					  "Got TRXDv2 PDU with unexpected MTS=0x%02x or "
+					  "burst length=%zd\n", hdr[2], read_len - offset - hdr_len);
+				return -EINVAL;
+			}
+		}
+
+		/* TRXN (hdr[1]) and C/I (hdr[6..7]) are not used by the upper layers */
+		bi[num_bursts] = (struct trxcon_phyif_burst_ind) {
+			.tn = hdr[0] & 0x07,
+			.fn = fn,
+			.rssi = -(int8_t) hdr[3],
+			.toa256 = (int16_t) (hdr[4] << 8) | hdr[5],
+			.burst = burst_len ? (sbit_t *)&buf[offset + hdr_len] : NULL,
+			.burst_len = burst_len,
+		};
+
+		trxd_ubit2sbit((sbit_t *)&buf[offset + hdr_len], &buf[offset + hdr_len], burst_len);
+		num_bursts++;
+
+		/* Is there another batched burst? */
+		if (~hdr[1] & TRXDv2_BATCH)
+			break;
+		if (num_bursts == TRXD_BURSTS_MAX) {
+			LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR,
+				  "Got TRXDv2 PDU with too many batched bursts\n");
+			return -EINVAL;
+		}
+
+		offset += hdr_len + burst_len;
+	}
+
+	return num_bursts;
+}
+
+/* Parse a TRXD PDU, convert soft-bits in-place and fill in up to
+ * TRXD_BURSTS_MAX burst indications.  Return the number of bursts. */
+static int trx_data_parse_pdu(struct trx_instance *trx, uint8_t *buf, ssize_t read_len,
+			      struct trxcon_phyif_burst_ind *bi)
+{
+	int num_bursts;
+
+	if (read_len < 1) {
+		LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR, "Got empty TRXD PDU\n");
+		return -EINVAL;
+	}
+
+	switch (buf[0] >> 4) {
+	case 0:
+		num_bursts = trx_data_parse_pdu_v0(trx, buf, read_len, bi);
+		break;
+	case 1:
+		num_bursts = trx_data_parse_pdu_v1(trx, buf, read_len, bi);
+		break;
+	case 2:
+		num_bursts = trx_data_parse_pdu_v2(trx, buf, read_len, bi);
+		break;
+	default:
+		LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR,
+			  "Got TRXD PDU with unexpected version %u\n", buf[0] >> 4);
+		return -ENOTSUP;
+	}
+
+	if (num_bursts <= 0)
+		return num_bursts;
+
+	/* All bursts of a PDU share the same TDMA frame number */
+	if (bi[0].fn >= GSM_TDMA_HYPERFRAME) {
+		LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR, "Illegal FN %u\n", bi[0].fn);
+		return -EINVAL;
+	}
+
+	return num_bursts;
+}
+
+/* Pass a parsed burst to the upper layers and poke the Uplink scheduler */
+static void trx_data_handle_burst_ind(struct trx_instance *trx,
+				      const struct trxcon_phyif_burst_ind *bi,
+				      const struct timespec *rx_time)
+{
 	LOGPFSMSL(trx->fi, DTRXD, LOGL_DEBUG,
 		  "RX burst tn=%u fn=%u rssi=%d toa=%d\n",
-		  bi.tn, bi.fn, bi.rssi, bi.toa256);
+		  bi->tn, bi->fn, bi->rssi, bi->toa256);
 
-	trxcon_phyif_handle_burst_ind(trx->priv, &bi);
+	/* NOPE / IDLE indications (burst_len == 0) are passed up too: the
+	 * scheduler accounts them as received frames, not as lost ones */
+	trxcon_phyif_handle_burst_ind(trx->priv, bi);
 
 	struct trxcon_phyif_rts_ind rts = {
-		.fn = GSM_TDMA_FN_SUM(bi.fn, trx->fn_advance),
-		.tn = bi.tn,
+		.fn = GSM_TDMA_FN_SUM(bi->fn, trx->fn_advance),
+		.tn = bi->tn,
+		.time = *rx_time,
 	};
 
 	trxcon_phyif_handle_rts_ind(trx->priv, &rts);
+}
+
+static int trx_data_rx_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct trx_instance *trx = ofd->data;
+	struct trxcon_phyif_burst_ind bi[TRXD_BURSTS_MAX];
+	uint8_t buf[TRXD_BUF_SIZE];
+	struct timespec rx_time;
+	ssize_t read_len;
+	int num_bursts;
+
+	read_len = read(ofd->fd, buf, sizeof(buf));
+	osmo_clock_gettime(CLOCK_MONOTONIC, &rx_time);
+	if (read_len <= 0) {
+		strerror_r(errno, (char *)buf, sizeof(buf));
+		LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR,
+			  "read() failed on TRXD with rc=%zd (%s)\n",
+			  read_len, (const char *)buf);
+		return read_len;
+	}
+
+	num_bursts = trx_data_parse_pdu(trx, buf, read_len, &bi[0]);
+	if (num_bursts < 0)
+		return num_bursts;
+
+	for (unsigned int i = 0; i < num_bursts; i++)
+		trx_data_handle_burst_ind(trx, &bi[i], &rx_time);
+
+	/* End of the RTS cycle: send queued Uplink bursts (if any) */
+	trx_tx_batch_flush(trx);
+
+	return 0;
+}
+
+/* Order bursts by TDMA frame number first, then by timeslot number */
+static int trxd_burst_ind_cmp(const struct trxcon_phyif_burst_ind *a,
+			      const struct trxcon_phyif_burst_ind *b)
+{
+	int rc = gsm0502_fncmp(a->fn, b->fn);
+	if (rc != 0)
+		return rc;
+	return (int)a->tn - (int)b->tn;
+}
+
+/* Batched variant of trx_data_rx_cb(): drain up to rx_batch.max pending
+ * TRXD PDUs using a single recvmmsg() call, and dispatch them in FN order. */
+static int trx_data_rx_batch_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct trx_instance *trx = ofd->data;
+	struct trx_rx_batch *batch = trx->rx_batch;
+	struct trxcon_phyif_burst_ind **sorted = batch->sorted;
+	unsigned int num_bursts = 0;
+	struct timespec rx_time;
+	int num_pdus, i, j, k, n;
+
+	num_pdus = recvmmsg(ofd->fd, batch->msgs, batch->max, MSG_DONTWAIT, NULL);
+	osmo_clock_gettime(CLOCK_MONOTONIC, &rx_time);
+	if (num_pdus <= 0) {
+		char errbuf[64];
+
+		strerror_r(errno, errbuf, sizeof(errbuf));
+		LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR,
+			  "recvmmsg() failed on TRXD with rc=%d (%s)\n",
+			  num_pdus, errbuf);
+		return num_pdus;
+	}
+
+	/* Parse all PDUs, insertion-sort valid bursts by (FN, TN) */
+	for (i = 0; i < num_pdus; i++) {
+		struct trxd_rx_slot *slot = &batch->slots[i];
+
+		n = trx_data_parse_pdu(trx, slot->buf, batch->msgs[i].msg_len, &slot->bi[0]);
+		for (k = 0; k < n; k++) {
+			for (j = num_bursts; j > 0; j--) {
+				if (trxd_burst_ind_cmp(sorted[j - 1], &slot->bi[k]) <= 0)
+					break;
+				sorted[j] = sorted[j - 1];
+			}
+			sorted[j] = &slot->bi[k];
+			num_bursts++;
+		}
+	}
+
+	/* Update statistics (for tuning the batch size) */
+	batch->num_wakeups++;
+	batch->num_bursts += num_bursts;
+	batch->pdus_per_wakeup[num_pdus]++;
+
+	for (i = 0; i < num_bursts; i++)
+		trx_data_handle_burst_ind(trx, sorted[i], &rx_time);
+
+	/* End of the RTS cycle: send queued Uplink bursts (if any) */
+	trx_tx_batch_flush(trx);
 
 	return 0;
 }
 
+static struct trx_rx_batch *trx_rx_batch_alloc(void *ctx, unsigned int max)
+{
+	struct trx_rx_batch *batch;
+
+	batch = talloc_zero(ctx, struct trx_rx_batch);
+	if (batch == NULL)
+		return NULL;
+
+	batch->max = max;
+	batch->slots = talloc_zero_array(batch, struct trxd_rx_slot, max);
+	batch->msgs = talloc_zero_array(batch, struct mmsghdr, max);
+	batch->iov = talloc_zero_array(batch, struct iovec, max);
+	batch->sorted = talloc_zero_array(batch, struct trxcon_phyif_burst_ind *,
+					  max * TRXD_BURSTS_MAX);
+	batch->pdus_per_wakeup = talloc_zero_array(batch, unsigned long, max + 1);
+	if (!batch->slots || !batch->msgs || !batch->iov ||
+	    !batch->sorted || !batch->pdus_per_wakeup) {
+		talloc_free(batch);
+		return NULL;
+	}
+
+	/* Each message points to its own preallocated burst buffer */
+	for (unsigned int i = 0; i < max; i++) {
+		batch->iov[i].iov_base = &batch->slots[i].buf[0];
+		batch->iov[i].iov_len = sizeof(batch->slots[i].buf);
+		batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+		batch->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	return batch;
+}
+
+/* Instances registered for trx_if_stats_dump(), see l1sched_stats_dump():
+ * the counters are updated unlocked by the thread serving an instance, the
+ * lock only keeps an instance from being freed while it's being dumped. */
+static LLIST_HEAD(stats_registry);
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void trx_if_stats_register(struct trx_instance *trx, unsigned int id)
+{
+	pthread_mutex_lock(&stats_lock);
+	if (!trx->stats_registered) {
+		trx->stats_id = id;
+		trx->stats_registered = true;
+		llist_add_tail(&trx->stats_list, &stats_registry);
+	}
+	pthread_mutex_unlock(&stats_lock);
+}
+
+static void trx_if_stats_unregister(struct trx_instance *trx)
+{
+	pthread_mutex_lock(&stats_lock);
+	if (trx->stats_registered) {
+		llist_del(&trx->stats_list);
+		trx->stats_registered = false;
+	}
+	pthread_mutex_unlock(&stats_lock);
+}
+
+#define STATS_FOREACH_RX_BATCH(trx) \
+	llist_for_each_entry(trx, &stats_registry, stats_list) \
+		if (trx->rx_batch != NULL)
+
+/*! Dump the TRXD Rx batching counters of all registered instances in the
+ * Prometheus text format (like l1sched_stats_dump() does for l1sched).
+ * \param[in] ctx talloc context to allocate the resulting string from.
+ * \param[in] prefix Prefix of the metric names (e.g. "trxcon").
+ * \returns a talloc-allocated string, or NULL on error. */
+char *trx_if_stats_dump(void *ctx, const char *prefix)
+{
+	const struct trx_instance *trx;
+	char *buf;
+
+	buf = talloc_strdup(ctx, "");
+	if (buf == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&stats_lock);
+
+	buf = talloc_asprintf_append_buffer(buf,
+		"# HELP %s_trxd_rx_bursts_total Downlink bursts received in batches\n"
+		"# TYPE %s_trxd_rx_bursts_total counter\n", prefix, prefix);
+	STATS_FOREACH_RX_BATCH(trx) {
+		buf = talloc_asprintf_append_buffer(buf, "%s_trxd_rx_bursts_total{instance=\"%u\"} %lu\n",
+						    prefix, trx->stats_id, trx->rx_batch->num_bursts);
+	}
+
+	/* _count is the number of wakeups, _sum the number of PDUs */
+	buf = talloc_asprintf_append_buffer(buf,
+		"# HELP %s_trxd_rx_pdus_per_wakeup TRXD PDUs received per recvmmsg() call\n"
+		"# TYPE %s_trxd_rx_pdus_per_wakeup histogram\n", prefix, prefix);
+	STATS_FOREACH_RX_BATCH(trx) {
+		const struct trx_rx_batch *batch = trx->rx_batch;
+		unsigned long cnt = 0, sum = 0;
+
+		for (unsigned int n = 1; n <= batch->max; n++) {
+			cnt += batch->pdus_per_wakeup[n];
+			sum += batch->pdus_per_wakeup[n] * n;
+			buf = talloc_asprintf_append_buffer(buf,
+				"%s_trxd_rx_pdus_per_wakeup_bucket{instance=\"%u\",le=\"%u\"} %lu\n",
+				prefix, trx->stats_id, n, cnt);
+		}
+		buf = talloc_asprintf_append_buffer(buf,
+			"%s_trxd_rx_pdus_per_wakeup_bucket{instance=\"%u\",le=\"+Inf\"} %lu\n"
+			"%s_trxd_rx_pdus_per_wakeup_sum{instance=\"%u\"} %lu\n"
+			"%s_trxd_rx_pdus_per_wakeup_count{instance=\"%u\"} %lu\n",
+			prefix, trx->stats_id, cnt,
+			prefix, trx->stats_id, sum,
+			prefix, trx->stats_id, cnt);
+	}
+
+	pthread_mutex_unlock(&stats_lock);
+
+	return buf;
+}
+
+/* Build an Uplink TRXD PDU in the given buffer, return its length.  For
+ * TRXDv2, a batched burst (appended to a previous one) has no FN field. */
+static size_t trx_data_build_pdu(uint8_t ver, bool batched, uint8_t *buf,
+				 const struct trxcon_phyif_burst_req *br)
+{
+	size_t length;
+
+	if (ver < 2) {
+		buf[0] = (ver << 4) | br->tn;
+		osmo_store32be(br->fn, buf + 1);
+		buf[5] = br->pwr;
+		length = 6;
+	} else {
+		buf[0] = batched ? br->tn : (ver << 4) | br->tn;
+		buf[1] = 0x00; /* BATCH is set when appending, TRXN=0 */
+		/* NOPE.req or GMSK with TSC set/number 0 (not used by the transceiver) */
+		buf[2] = br->burst_len == 0 ? TRXD_MTS_NOPE : 0x00;
+		buf[3] = br->pwr;
+		buf[4] = 0x00; /* SCPIR is not used */
+		memset(buf + 5, 0x00, 3); /* spare */
+		length = TRXDv2_HDR_LEN;
+		if (!batched) {
+			osmo_store32be(br->fn, buf + length);
+			length += 4;
+		}
+	}
+
+	/* Copy ubits {0,1} */
+	if (br->burst_len != 0) {
+		memcpy(buf + length, br->burst, br->burst_len);
+		length += br->burst_len;
+	}
+
+	return length;
+}
+
+/* Send all queued Uplink PDUs to the transceiver using sendmmsg() */
+static void trx_tx_batch_flush(struct trx_instance *trx)
+{
+	struct trx_tx_batch *batch = trx->tx_batch;
+	unsigned int sent = 0;
+	int rc;
+
+	if (batch == NULL || batch->num == 0)
+		return;
+
+	while (sent < batch->num) {
+		rc = sendmmsg(trx->trx_ofd_data.fd, &batch->msgs[sent],
+			      batch->num - sent, 0);
+		if (rc <= 0) {
+			char errbuf[64];
+
+			strerror_r(errno, errbuf, sizeof(errbuf));
+			LOGPFSMSL(trx->fi, DTRXD, LOGL_ERROR,
+				  "sendmmsg() failed on TRXD with rc=%d (%s), "
+				  "dropping %u burst(s) for fn=%u\n",
+				  rc, errbuf, batch->num - sent, batch->fn);
+			break;
+		}
+		sent += rc;
+	}
+
+	batch->num_flushes++;
+	if (sent == batch->num)
+		batch->num_bursts += batch->num_queued;
+	batch->num_queued = 0;
+	batch->num = 0;
+}
+
+/* Queue an Uplink PDU, flushing the previously queued TDMA frame (if any) */
+static int trx_tx_batch_enqueue(struct trx_instance *trx,
+				const struct trxcon_phyif_burst_req *br)
+{
+	struct trx_tx_batch *batch = trx->tx_batch;
+
+	if (batch->num > 0 && batch->fn != br->fn)
+		trx_tx_batch_flush(trx);
+	if (batch->num_queued == TRX_TX_BATCH_MAX)
+		trx_tx_batch_flush(trx);
+
+	/* TRXDv2: append to the PDU of the same TDMA frame (if any) */
+	if (trx->trxd_ver >= 2 && batch->num > 0) {
+		struct iovec *iov = &batch->iov[0];
+		uint8_t *buf = iov->iov_base;
+
+		/* Indicate that another burst follows the previous one */
+		buf[batch->last_hdr + 1] |= TRXDv2_BATCH;
+		batch->last_hdr = iov->iov_len;
+		iov->iov_len += trx_data_build_pdu(trx->trxd_ver, true, buf + iov->iov_len, br);
+		batch->num_queued++;
+		return 0;
+	}
+
+	batch->fn = br->fn;
+	batch->last_hdr = 0;
+	batch->iov[batch->num].iov_len = trx_data_build_pdu(trx->trxd_ver, false,
+							    batch->bufs[batch->num], br);
+	batch->num_queued++;
+	batch->num++;
+
+	return 0;
+}
+
+static struct trx_tx_batch *trx_tx_batch_alloc(void *ctx)
+{
+	struct trx_tx_batch *batch;
+
+	batch = talloc_zero(ctx, struct trx_tx_batch);
+	if (batch == NULL)
+		return NULL;
+
+	batch->bufs = talloc_zero_size(batch, TRX_TX_BATCH_MAX * TRXD_BUF_SIZE);
+	batch->msgs = talloc_zero_array(batch, struct mmsghdr, TRX_TX_BATCH_MAX);
+	batch->iov = talloc_zero_array(batch, struct iovec, TRX_TX_BATCH_MAX);
+	if (!batch->bufs || !batch->msgs || !batch->iov) {
+		talloc_free(batch);
+		return NULL;
+	}
+
+	/* Each message points to its own preallocated burst buffer */
+	for (unsigned int i = 0; i < TRX_TX_BATCH_MAX; i++) {
+		batch->iov[i].iov_base = &batch->bufs[i][0];
+		batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+		batch->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	return batch;
+}
+
+static void trx_tx_batch_log_stats(const struct trx_instance *trx)
+{
+	const struct trx_tx_batch *batch = trx->tx_batch;
+
+	if (batch == NULL || batch->num_flushes == 0)
+		return;
+
+	LOGPFSMSL(trx->fi, DTRXD, LOGL_NOTICE,
+		  "TRXD Tx batching statistics: %lu bursts in %lu sendmmsg() calls (avg %.2f)\n",
+		  batch->num_bursts, batch->num_flushes,
+		  (float)batch->num_bursts / batch->num_flushes);
+}
+
 int trx_if_handle_phyif_burst_req(struct trx_instance *trx,
 				  const struct trxcon_phyif_burst_req *br)
 {
@@ -740,16 +1321,11 @@ int trx_if_handle_phyif_burst_req(struct trx_instance *trx,
 		  "TX burst tn=%u fn=%u pwr=%u\n",
 		  br->tn, br->fn, br->pwr);
 
-	buf[0] = br->tn;
-	osmo_store32be(br->fn, buf + 1);
-	buf[5] = br->pwr;
-	length = 6;
+	/* Coalesce bursts of the same TDMA frame (if enabled) */
+	if (trx->tx_batch != NULL)
+		return trx_tx_batch_enqueue(trx, br);
 
-	/* Copy ubits {0,1} */
-	if (br->burst_len != 0) {
-		memcpy(buf + 6, br->burst, br->burst_len);
-		length += br->burst_len;
-	}
+	length = trx_data_build_pdu(trx->trxd_ver, false, &buf[0], br);
 
 	/* Send data to transceiver */
 	send(trx->trx_ofd_data.fd, buf, length, 0);
@@ -798,14 +1374,38 @@ struct trx_instance *trx_if_open(const struct trx_if_params *params)
 	if (rc < 0)
 		goto udp_error;
 
+	/* Optional batched reception of TRXD PDUs */
+	if (params->rx_batch_max > 1) {
+		trx->rx_batch = trx_rx_batch_alloc(trx, params->rx_batch_max);
+		if (trx->rx_batch == NULL) {
+			LOGPFSML(params->parent_fi, LOGL_ERROR,
+				 "Failed to allocate TRXD Rx batch buffers\n");
+			osmo_fsm_inst_free(fi);
+			return NULL;
+		}
+	}
+
+	/* Optional coalescing of Uplink TRXD PDUs */
+	if (params->tx_batch) {
+		trx->tx_batch = trx_tx_batch_alloc(trx);
+		if (trx->tx_batch == NULL) {
+			LOGPFSML(params->parent_fi, LOGL_ERROR,
+				 "Failed to allocate TRXD Tx batch buffers\n");
+			osmo_fsm_inst_free(fi);
+			return NULL;
+		}
+	}
+
 	rc = trx_udp_open(trx, &trx->trx_ofd_data, /* TRXD */
 			  params->local_host, params->base_port + 102 + offset,
 			  params->remote_host, params->base_port + 2 + offset,
-			  trx_data_rx_cb);
+			  trx->rx_batch ? trx_data_rx_batch_cb : trx_data_rx_cb);
 	if (rc < 0)
 		goto udp_error;
 
 	trx->fn_advance = params->fn_advance;
+	trx->trxd_ver_max = OSMO_MIN(params->trxd_ver, TRXD_VER_MAX);
+	trx->trxd_ver_req = trx->trxd_ver_max;
 	trx->priv = params->priv;
 	fi->priv = trx;
 	trx->fi = fi;
@@ -860,6 +1460,11 @@ static void trx_fsm_cleanup_cb(struct osmo_fsm_inst *fi,
 	/* Flush CTRL message list */
 	trx_if_flush_ctrl(trx);
 
+	/* Print some TRXD Tx batching statistics (if enabled),
+	 * the Rx ones are exported by trx_if_stats_dump() */
+	trx_tx_batch_log_stats(trx);
+	trx_if_stats_unregister(trx);
+
 	/* Power off if the transceiver is up */
 	if (trx->powered_up && trx->trx_ofd_ctrl.fd >= 0)
 		send(trx->trx_ofd_ctrl.fd, &cmd_poweroff[0], sizeof(cmd_poweroff), 0);
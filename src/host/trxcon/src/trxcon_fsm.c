@@ -36,6 +36,7 @@
 #include <osmocom/bb/trxcon/phyif.h>
 #include <osmocom/bb/trxcon/l1ctl.h>
 #include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1sched/capture.h>
 #include <osmocom/bb/l1gprs.h>
 
 #define S(x)	(1 << (x))
@@ -286,7 +287,7 @@ static void handle_tx_access_burst_req(struct osmo_fsm_inst *fi,
 	struct l1sched_prim *prim;
 	struct msgb *msg;
 
-	msg = l1sched_prim_alloc(L1SCHED_PRIM_T_RACH, PRIM_OP_REQUEST);
+	msg = l1sched_prim_pool_alloc(trxcon->sched, L1SCHED_PRIM_T_RACH, PRIM_OP_REQUEST);
 	OSMO_ASSERT(msg != NULL);
 
 	prim = l1sched_prim_from_msgb(msg);
@@ -465,6 +466,14 @@ static void trxcon_st_dedicated_action(struct osmo_fsm_inst *fi,
 						continue;
 				}
 				lchan->tch_mode = req->mode;
+				l1sched_capture_cfg(trxcon->sched, L1SCHED_CAPTURE_REC_TCH_MODE,
+						    &(struct l1sched_capture_cfg) {
+					.tn = tn,
+					.lchan = {
+						.type = lchan->type,
+						.tch_mode = req->mode,
+					},
+				});
 				req->applied = true;
 			}
 		}
@@ -495,7 +504,7 @@ static void trxcon_st_dedicated_action(struct osmo_fsm_inst *fi,
 		struct l1sched_prim *prim;
 		struct msgb *msg;
 
-		msg = l1sched_prim_alloc(L1SCHED_PRIM_T_DATA, PRIM_OP_REQUEST);
+		msg = l1sched_prim_pool_alloc(trxcon->sched, L1SCHED_PRIM_T_DATA, PRIM_OP_REQUEST);
 		OSMO_ASSERT(msg != NULL);
 
 		prim = l1sched_prim_from_msgb(msg);
@@ -596,7 +605,7 @@ static void trxcon_st_packet_data_action(struct osmo_fsm_inst *fi,
 		if (l1gprs_handle_ul_block_req(trxcon->gprs, &block_req, msg) != 0)
 			return;
 
-		msg = l1sched_prim_alloc(L1SCHED_PRIM_T_DATA, PRIM_OP_REQUEST);
+		msg = l1sched_prim_pool_alloc(trxcon->sched, L1SCHED_PRIM_T_DATA, PRIM_OP_REQUEST);
 		OSMO_ASSERT(msg != NULL);
 
 		prim = l1sched_prim_from_msgb(msg);
@@ -27,6 +27,7 @@
 #include <signal.h>
 #include <errno.h>
 #include <time.h>
+#include <limits.h>
 
 #include <osmocom/core/fsm.h>
 #include <osmocom/core/msgb.h>
@@ -37,12 +38,18 @@
 #include <osmocom/core/gsmtap_util.h>
 #include <osmocom/core/gsmtap.h>
 
+#include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1sched/capture.h>
+
 #include <osmocom/bb/trxcon/trxcon.h>
 #include <osmocom/bb/trxcon/trxcon_fsm.h>
 #include <osmocom/bb/trxcon/phyif.h>
 #include <osmocom/bb/trxcon/trx_if.h>
+#include <osmocom/bb/trxcon/shm_if.h>
 #include <osmocom/bb/trxcon/logging.h>
 #include <osmocom/bb/trxcon/l1ctl_server.h>
+#include <osmocom/bb/trxcon/trxcon_shard.h>
+#include <osmocom/bb/trxcon/trxcon_stats.h>
 
 #define COPYRIGHT \
 	"Copyright (C) 2016-2022 by Vadim Yanitskiy <axilirator@gmail.com>\n" \
@@ -60,16 +67,37 @@ static struct {
 	/* L1CTL specific */
 	unsigned int max_clients;
 	const char *bind_socket;
+	/* Number of event loop threads serving L1CTL clients (0 means none) */
+	unsigned int num_shards;
 
 	/* TRX specific */
 	const char *trx_bind_ip;
 	const char *trx_remote_ip;
 	uint16_t trx_base_port;
 	uint32_t trx_fn_advance;
+	unsigned int trx_rx_batch;
+	bool trx_tx_batch;
+	unsigned int trxd_ver;
+
+	/* Shared memory PHY interface (instead of TRX over UDP) */
+	const char *shm_sock_path;
 
 	/* PHY quirk: FBSB timeout extension (in TDMA FNs) */
 	unsigned int phyq_fbsb_extend_fns;
 
+	/* Number of channel decoding worker threads (0 means inline) */
+	unsigned int decode_workers;
+
+	/* Uplink burst deadline (in us, -1 means derived from trx_fn_advance) */
+	long deadline_us;
+	bool skip_late;
+
+	/* Capture of the scheduler input (for offline replay) */
+	const char *capture_path;
+
+	/* Export of the scheduler performance counters */
+	const char *stats_socket;
+
 	/* GSMTAP specific */
 	struct gsmtap_inst *gsmtap;
 	const char *gsmtap_ip;
@@ -81,23 +109,31 @@ static struct {
 	.trx_base_port = 6700,
 	.trx_fn_advance = 2,
 	.phyq_fbsb_extend_fns = 0,
+	.deadline_us = -1,
 };
 
 static void *tall_trxcon_ctx = NULL;
 
 int trxcon_phyif_handle_burst_req(void *phyif, const struct trxcon_phyif_burst_req *br)
 {
+	if (app_data.shm_sock_path != NULL)
+		return shm_if_handle_phyif_burst_req(phyif, br);
 	return trx_if_handle_phyif_burst_req(phyif, br);
 }
 
 int trxcon_phyif_handle_cmd(void *phyif, const struct trxcon_phyif_cmd *cmd)
 {
+	if (app_data.shm_sock_path != NULL)
+		return shm_if_handle_phyif_cmd(phyif, cmd);
 	return trx_if_handle_phyif_cmd(phyif, cmd);
 }
 
 void trxcon_phyif_close(void *phyif)
 {
-	trx_if_close(phyif);
+	if (app_data.shm_sock_path != NULL)
+		shm_if_close(phyif);
+	else
+		trx_if_close(phyif);
 }
 
 void trxcon_l1ctl_close(struct trxcon_inst *trxcon)
@@ -123,6 +159,41 @@ static int l1ctl_rx_cb(struct l1ctl_client *l1c, struct msgb *msg)
 	return trxcon_l1ctl_receive(trxcon, msg);
 }
 
+static struct shm_instance *shm_if_open_inst(struct trxcon_inst *trxcon)
+{
+	char sock_path[PATH_MAX];
+
+	/* Each additional instance gets its own socket: <path>.<id> */
+	if (trxcon->id > 0)
+		snprintf(sock_path, sizeof(sock_path), "%s.%u", app_data.shm_sock_path, trxcon->id);
+	else
+		OSMO_STRLCPY_ARRAY(sock_path, app_data.shm_sock_path);
+
+	const struct shm_if_params params = {
+		.sock_path = sock_path,
+		.fn_advance = app_data.trx_fn_advance,
+
+		.parent_fi = trxcon->fi,
+		.parent_term_event = TRXCON_EV_PHYIF_FAILURE,
+		.priv = trxcon,
+	};
+
+	return shm_if_open(&params);
+}
+
+/* osmo_fsm links all instances of an FSM into a process-wide list, which is
+ * not protected against concurrent access.  Nothing in trxcon looks them up,
+ * so with several shards they are unlinked right after allocation (while
+ * conn_accept_cb is serialized), so that freeing them later is safe. */
+static void fsm_inst_unlink(struct osmo_fsm_inst *fi)
+{
+	struct osmo_fsm_inst *child;
+
+	llist_del_init(&fi->list);
+	llist_for_each_entry(child, &fi->proc.children, proc.child)
+		fsm_inst_unlink(child);
+}
+
 static void l1ctl_conn_accept_cb(struct l1ctl_client *l1c)
 {
 	struct trxcon_inst *trxcon;
@@ -142,6 +213,9 @@ static void l1ctl_conn_accept_cb(struct l1ctl_client *l1c)
 		.remote_host = app_data.trx_remote_ip,
 		.base_port = app_data.trx_base_port,
 		.fn_advance = app_data.trx_fn_advance,
+		.rx_batch_max = app_data.trx_rx_batch,
+		.tx_batch = app_data.trx_tx_batch,
+		.trxd_ver = app_data.trxd_ver,
 		.instance = trxcon->id,
 
 		.parent_fi = trxcon->fi,
@@ -150,7 +224,10 @@ static void l1ctl_conn_accept_cb(struct l1ctl_client *l1c)
 	};
 
 	/* Init transceiver interface */
-	trxcon->phyif = trx_if_open(&trxcon_phyif_params);
+	if (app_data.shm_sock_path != NULL)
+		trxcon->phyif = shm_if_open_inst(trxcon);
+	else
+		trxcon->phyif = trx_if_open(&trxcon_phyif_params);
 	if (trxcon->phyif == NULL) {
 		/* TRXCON_EV_PHYIF_FAILURE triggers l1ctl_client_conn_close() */
 		osmo_fsm_inst_dispatch(trxcon->fi, TRXCON_EV_PHYIF_FAILURE, NULL);
@@ -159,6 +236,43 @@ static void l1ctl_conn_accept_cb(struct l1ctl_client *l1c)
 
 	trxcon->gsmtap = app_data.gsmtap;
 	trxcon->phy_quirks.fbsb_extend_fns = app_data.phyq_fbsb_extend_fns;
+
+	/* By default, an Uplink burst must be ready one TDMA frame before it's due */
+	if (app_data.deadline_us >= 0)
+		trxcon->sched->deadline.budget_us = app_data.deadline_us;
+	else if (app_data.trx_fn_advance > 1)
+		trxcon->sched->deadline.budget_us = (app_data.trx_fn_advance - 1) * GSM_TDMA_FN_DURATION_uS;
+	trxcon->sched->deadline.skip_late = app_data.skip_late;
+
+	/* Optionally capture the scheduler input: <path>[.<id>] */
+	if (app_data.capture_path != NULL) {
+		char path[PATH_MAX];
+
+		if (trxcon->id > 0)
+			snprintf(path, sizeof(path), "%s.%u", app_data.capture_path, trxcon->id);
+		else
+			OSMO_STRLCPY_ARRAY(path, app_data.capture_path);
+		if (l1sched_capture_start(trxcon->sched, path) != 0)
+			LOGPFSML(trxcon->fi, LOGL_ERROR, "Failed to start capture to '%s'\n", path);
+	}
+
+	/* Optionally export the performance counters */
+	if (app_data.stats_socket != NULL) {
+		trxcon->sched->stats.dec_timing = true;
+		l1sched_stats_register(trxcon->sched, trxcon->id);
+		if (app_data.shm_sock_path == NULL)
+			trx_if_stats_register(trxcon->phyif, trxcon->id);
+	}
+
+	/* Optionally offload channel decoding to worker threads */
+	if (app_data.decode_workers > 0) {
+		if (l1sched_decoder_start(trxcon->sched, app_data.decode_workers) != 0)
+			LOGPFSML(trxcon->fi, LOGL_ERROR, "Failed to start decoding workers, "
+				 "decoding inline\n");
+	}
+
+	if (app_data.num_shards > 0)
+		fsm_inst_unlink(trxcon->fi);
 }
 
 static void l1ctl_conn_close_cb(struct l1ctl_client *l1c)
@@ -185,10 +299,21 @@ static void print_help(void)
 	printf("  -i --trx-remote   TRX remote IP address (default 127.0.0.1)\n");
 	printf("  -p --trx-port     Base port of TRX instance (default 6700)\n");
 	printf("  -f --trx-advance  Uplink burst scheduling advance (default 2)\n");
+	printf("  -B --trx-rx-batch Max TRXD PDUs to receive per wakeup (default 1, no batching, max %u)\n",
+	       TRXD_RX_BATCH_MAX);
+	printf("  -T --trx-tx-batch Coalesce Uplink bursts of a TDMA frame into one sendmmsg()\n");
+	printf("  -V --trxd-ver     Max TRXD PDU version to negotiate (default 0)\n");
+	printf("  -M --shm-socket   Use shared memory PHY interface (transceiver's UNIX socket)\n");
 	printf("  -F --fbsb-extend  FBSB timeout extension (in TDMA FNs, default 0)\n");
+	printf("  -W --decode-workers Number of channel decoding threads (default 0, inline)\n");
+	printf("  -L --deadline     Uplink burst deadline after RTS (in us, default trx-advance - 1 frames)\n");
+	printf("  -S --skip-late    Do not encode Uplink blocks which would miss their deadline\n");
+	printf("  -R --capture      Capture the scheduler input to a file (see l1sched_replay)\n");
+	printf("  -E --stats-socket Export performance counters on a UNIX socket (Prometheus text)\n");
 	printf("  -s --socket       Listening socket for layer23 (default /tmp/osmocom_l2)\n");
 	printf("  -g --gsmtap-ip    The destination IP used for GSMTAP (disabled by default)\n");
 	printf("  -C --max-clients  Maximum number of L1CTL connections (default 1)\n");
+	printf("  -t --threads      Serve L1CTL connections by N event loop threads (default 0, main thread)\n");
 	printf("  -D --daemonize    Run as daemon\n");
 }
 
@@ -196,6 +321,7 @@ static void handle_options(int argc, char **argv)
 {
 	while (1) {
 		char *endptr = NULL;
+		unsigned long val;
 		int option_index = 0, c;
 		static struct option long_options[] = {
 			{"help", 0, 0, 'h'},
@@ -208,14 +334,24 @@ static void handle_options(int argc, char **argv)
 			{"trx-remote", 1, 0, 'i'},
 			{"trx-port", 1, 0, 'p'},
 			{"trx-advance", 1, 0, 'f'},
+			{"trx-rx-batch", 1, 0, 'B'},
+			{"trx-tx-batch", 0, 0, 'T'},
+			{"trxd-ver", 1, 0, 'V'},
+			{"shm-socket", 1, 0, 'M'},
 			{"fbsb-extend", 1, 0, 'F'},
+			{"decode-workers", 1, 0, 'W'},
+			{"deadline", 1, 0, 'L'},
+			{"skip-late", 0, 0, 'S'},
+			{"capture", 1, 0, 'R'},
+			{"stats-socket", 1, 0, 'E'},
 			{"gsmtap-ip", 1, 0, 'g'},
 			{"max-clients", 1, 0, 'C'},
+			{"threads", 1, 0, 't'},
 			{"daemonize", 0, 0, 'D'},
 			{0, 0, 0, 0}
 		};
 
-		c = getopt_long(argc, argv, "d:b:i:p:f:F:s:g:C:Dh",
+		c = getopt_long(argc, argv, "d:b:i:p:f:B:TV:M:F:W:L:SR:E:s:g:C:t:Dh",
 				long_options, &option_index);
 		if (c == -1)
 			break;
@@ -251,6 +387,26 @@ static void handle_options(int argc, char **argv)
 				exit(EXIT_FAILURE);
 			}
 			break;
+		case 'B':
+			app_data.trx_rx_batch = strtoul(optarg, &endptr, 10);
+			if (errno || *endptr != '\0' || app_data.trx_rx_batch > TRXD_RX_BATCH_MAX) {
+				fprintf(stderr, "Failed to parse -B/--trx-rx-batch=%s\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'T':
+			app_data.trx_tx_batch = true;
+			break;
+		case 'V':
+			app_data.trxd_ver = strtoul(optarg, &endptr, 10);
+			if (errno || *endptr != '\0' || app_data.trxd_ver > TRXD_VER_MAX) {
+				fprintf(stderr, "Failed to parse -V/--trxd-ver=%s\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'M':
+			app_data.shm_sock_path = optarg;
+			break;
 		case 'F':
 			app_data.phyq_fbsb_extend_fns = strtoul(optarg, &endptr, 10);
 			if (errno || *endptr != '\0') {
@@ -258,6 +414,31 @@ static void handle_options(int argc, char **argv)
 				exit(EXIT_FAILURE);
 			}
 			break;
+		case 'W':
+			app_data.decode_workers = strtoul(optarg, &endptr, 10);
+			if (errno || *endptr != '\0') {
+				fprintf(stderr, "Failed to parse -W/--decode-workers=%s\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'L':
+			/* strtoul() silently negates "-1", so reject any sign */
+			val = strtoul(optarg, &endptr, 10);
+			if (errno || *endptr != '\0' || strchr(optarg, '-') != NULL || val > UINT32_MAX) {
+				fprintf(stderr, "Failed to parse -L/--deadline=%s\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			app_data.deadline_us = val;
+			break;
+		case 'S':
+			app_data.skip_late = true;
+			break;
+		case 'R':
+			app_data.capture_path = optarg;
+			break;
+		case 'E':
+			app_data.stats_socket = optarg;
+			break;
 		case 's':
 			app_data.bind_socket = optarg;
 			break;
@@ -271,6 +452,13 @@ static void handle_options(int argc, char **argv)
 				exit(EXIT_FAILURE);
 			}
 			break;
+		case 't':
+			app_data.num_shards = strtoul(optarg, &endptr, 10);
+			if (errno || *endptr != '\0') {
+				fprintf(stderr, "Failed to parse -t/--threads=%s\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
 		case 'D':
 			app_data.daemonize = 1;
 			break;
@@ -313,17 +501,22 @@ int main(int argc, char **argv)
 {
 	struct l1ctl_server_cfg server_cfg;
 	struct l1ctl_server *server = NULL;
+	struct trxcon_shards *shards = NULL;
+	struct trxcon_stats_server *stats = NULL;
 	int rc = 0;
 
 	printf("%s", COPYRIGHT);
 	handle_options(argc, argv);
 
-	/* Track the use of talloc NULL memory contexts */
-	talloc_enable_null_tracking();
+	/* talloc is not thread-safe: with several shards, neither the NULL
+	 * context tracking nor a common msgb context can be used. */
+	if (app_data.num_shards == 0)
+		talloc_enable_null_tracking();
 
 	/* Init talloc memory management system */
 	tall_trxcon_ctx = talloc_init("trxcon context");
-	msgb_talloc_ctx_init(tall_trxcon_ctx, 0);
+	if (app_data.num_shards == 0)
+		msgb_talloc_ctx_init(tall_trxcon_ctx, 0);
 
 	/* Setup signal handlers */
 	signal(SIGINT, &signal_handler);
@@ -336,6 +529,12 @@ int main(int argc, char **argv)
 	/* Init logging system */
 	trxcon_logging_init(tall_trxcon_ctx, app_data.debug_mask);
 
+	/* Shards are logging from their own threads */
+	if (app_data.num_shards > 0) {
+		log_target_file_switch_to_stream(osmo_stderr_target);
+		log_enable_multithread();
+	}
+
 	/* Configure pretty logging */
 	log_set_print_extended_timestamp(osmo_stderr_target, 1);
 	log_set_print_category_hex(osmo_stderr_target, 0);
@@ -351,7 +550,9 @@ int main(int argc, char **argv)
 	if (app_data.gsmtap_ip != NULL) {
 		struct log_target *lt;
 
-		app_data.gsmtap = gsmtap_source_init(app_data.gsmtap_ip, GSMTAP_UDP_PORT, 1);
+		/* A write queue can only be served by a single thread */
+		app_data.gsmtap = gsmtap_source_init(app_data.gsmtap_ip, GSMTAP_UDP_PORT,
+						     app_data.num_shards == 0);
 		if (!app_data.gsmtap) {
 			LOGP(DAPP, LOGL_ERROR, "Failed to init GSMTAP Um logging\n");
 			goto exit;
@@ -379,10 +580,26 @@ int main(int argc, char **argv)
 		.conn_close_cb = &l1ctl_conn_close_cb,
 	};
 
-	server = l1ctl_server_alloc(tall_trxcon_ctx, &server_cfg);
-	if (server == NULL) {
-		rc = EXIT_FAILURE;
-		goto exit;
+	if (app_data.num_shards > 0) {
+		shards = trxcon_shards_alloc(tall_trxcon_ctx, app_data.num_shards, &server_cfg);
+		if (shards == NULL) {
+			rc = EXIT_FAILURE;
+			goto exit;
+		}
+	} else {
+		server = l1ctl_server_alloc(tall_trxcon_ctx, &server_cfg);
+		if (server == NULL) {
+			rc = EXIT_FAILURE;
+			goto exit;
+		}
+	}
+
+	if (app_data.stats_socket != NULL) {
+		stats = trxcon_stats_server_alloc(tall_trxcon_ctx, app_data.stats_socket);
+		if (stats == NULL) {
+			rc = EXIT_FAILURE;
+			goto exit;
+		}
 	}
 
 	LOGP(DAPP, LOGL_NOTICE, "Init complete\n");
@@ -402,6 +619,10 @@ int main(int argc, char **argv)
 		osmo_select_main(0);
 
 exit:
+	if (stats != NULL)
+		trxcon_stats_server_free(stats);
+	if (shards != NULL)
+		trxcon_shards_free(shards);
 	if (server != NULL)
 		l1ctl_server_free(server);
 
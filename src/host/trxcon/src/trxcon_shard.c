@@ -0,0 +1,401 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * Sharded L1CTL server: distributing connections over event loop threads
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * libosmocore keeps the osmo_fd list and the timers per thread, so each
+ * shard simply runs osmo_select_main() in its own thread.  Everything a
+ * connection owns (the L1CTL client, the trxcon instance, its scheduler
+ * and its PHY interface sockets) is allocated from within that thread and
+ * never leaves it.  The accepting thread hands new connections over to
+ * the least loaded shard through a pipe, together with a process-wide
+ * unique client ID (which determines e.g. the TRX port numbers).
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include <sys/socket.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/socket.h>
+#include <osmocom/core/context.h>
+
+#include <osmocom/bb/trxcon/logging.h>
+#include <osmocom/bb/trxcon/l1ctl_server.h>
+#include <osmocom/bb/trxcon/trxcon_shard.h>
+
+#define LOGP_SHARD(shard, level, fmt, args...) \
+	LOGP(DL1C, level, "(shard #%u) " fmt, (shard)->index, ## args)
+
+/* Passed from the accepting thread to a shard through its pipe */
+struct trxcon_shard_conn {
+	int fd; /* -1 asks the shard to stop */
+	unsigned int id;
+};
+
+struct trxcon_shard {
+	struct trxcon_shards *shards;
+	unsigned int index;
+	pthread_t thread;
+	/* [0] is read by the shard, [1] is written by the accepting thread */
+	int pipe_fd[2];
+	struct osmo_fd ofd;
+	/* the shard's own server (without a listening socket) */
+	struct l1ctl_server_cfg server_cfg;
+	struct l1ctl_server *server;
+	/* number of connections (protected by trxcon_shards.lock) */
+	unsigned int num_clients;
+	/* only accessed by the shard's thread */
+	bool quit;
+};
+
+struct trxcon_shards {
+	const struct l1ctl_server_cfg *cfg;
+	/* listening socket (served by the thread which allocated us) */
+	struct osmo_fd ofd;
+	struct trxcon_shard *shard;
+	unsigned int num_shards;
+	/* serializes conn_accept_cb between shards */
+	pthread_mutex_t accept_lock;
+	/* protects the fields below and trxcon_shard.num_clients */
+	pthread_mutex_t lock;
+	unsigned int num_clients;
+	bool *ids_used;
+	unsigned int ids_len;
+};
+
+/* Allocate the lowest unused client ID (called with shards->lock held) */
+static int shards_id_alloc(struct trxcon_shards *shards)
+{
+	unsigned int id;
+
+	for (id = 0; id < shards->ids_len; id++) {
+		if (!shards->ids_used[id])
+			break;
+	}
+
+	if (id == shards->ids_len) {
+		bool *ids_used;
+
+		ids_used = talloc_realloc(shards, shards->ids_used, bool, id + 16);
+		if (ids_used == NULL)
+			return -ENOMEM;
+		memset(&ids_used[id], 0, 16 * sizeof(bool));
+		shards->ids_used = ids_used;
+		shards->ids_len = id + 16;
+	}
+
+	shards->ids_used[id] = true;
+	return id;
+}
+
+static void shards_conn_release(struct trxcon_shard *shard, unsigned int id)
+{
+	struct trxcon_shards *shards = shard->shards;
+
+	pthread_mutex_lock(&shards->lock);
+	shards->ids_used[id] = false;
+	shards->num_clients--;
+	shard->num_clients--;
+	pthread_mutex_unlock(&shards->lock);
+}
+
+static int shard_conn_read_cb(struct l1ctl_client *client, struct msgb *msg)
+{
+	struct trxcon_shard *shard = client->server->priv;
+
+	return shard->shards->cfg->conn_read_cb(client, msg);
+}
+
+static void shard_conn_close_cb(struct l1ctl_client *client)
+{
+	struct trxcon_shard *shard = client->server->priv;
+
+	if (shard->shards->cfg->conn_close_cb != NULL)
+		shard->shards->cfg->conn_close_cb(client);
+
+	shards_conn_release(shard, client->id);
+}
+
+/* A new connection (or a stop request) from the accepting thread */
+static int shard_pipe_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct trxcon_shard *shard = (struct trxcon_shard *)ofd->data;
+	struct trxcon_shards *shards = shard->shards;
+	struct trxcon_shard_conn conn;
+	struct l1ctl_client *client;
+
+	if (read(ofd->fd, &conn, sizeof(conn)) != sizeof(conn)) {
+		LOGP_SHARD(shard, LOGL_ERROR, "Failed to read from pipe: %s\n", strerror(errno));
+		return -EIO;
+	}
+
+	if (conn.fd < 0) {
+		shard->quit = true;
+		return 0;
+	}
+
+	client = l1ctl_client_alloc(shard->server, conn.fd);
+	if (client == NULL) {
+		close(conn.fd);
+		shards_conn_release(shard, conn.id);
+		return -ENOMEM;
+	}
+
+	/* Override the shard local ID */
+	client->id = conn.id;
+
+	LOGP_SHARD(shard, LOGL_NOTICE, "Serving a new connection (id=%u)\n", client->id);
+
+	if (shards->cfg->conn_accept_cb != NULL) {
+		pthread_mutex_lock(&shards->accept_lock);
+		shards->cfg->conn_accept_cb(client);
+		pthread_mutex_unlock(&shards->accept_lock);
+	}
+
+	return 0;
+}
+
+static void *shard_thread(void *data)
+{
+	struct trxcon_shard *shard = (struct trxcon_shard *)data;
+	char name[16];
+	void *ctx;
+
+	snprintf(name, sizeof(name), "trxcon-shard%u", shard->index);
+	pthread_setname_np(pthread_self(), name);
+
+	/* Thread local libosmocore state (osmo_fd list, timers) */
+	OSMO_ASSERT(osmo_ctx_init(name) == 0);
+	osmo_select_init();
+
+	ctx = talloc_named_const(NULL, 0, name);
+	OSMO_ASSERT(ctx != NULL);
+
+	shard->server = l1ctl_server_alloc(ctx, &shard->server_cfg);
+	OSMO_ASSERT(shard->server != NULL);
+	shard->server->priv = shard;
+
+	osmo_fd_setup(&shard->ofd, shard->pipe_fd[0], OSMO_FD_READ, &shard_pipe_cb, shard, 0);
+	OSMO_ASSERT(osmo_fd_register(&shard->ofd) == 0);
+
+	while (!shard->quit)
+		osmo_select_main(0);
+
+	osmo_fd_unregister(&shard->ofd);
+	l1ctl_server_free(shard->server);
+	talloc_free(ctx);
+
+	return NULL;
+}
+
+/* Connection handler: hand over to the least loaded shard */
+static int shards_accept_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct trxcon_shards *shards = (struct trxcon_shards *)ofd->data;
+	struct trxcon_shard *shard = NULL;
+	struct trxcon_shard_conn conn;
+	unsigned int i;
+	int rc;
+
+	conn.fd = accept(ofd->fd, NULL, NULL);
+	if (conn.fd < 0) {
+		LOGP(DL1C, LOGL_ERROR, "Failed to accept() a new connection: "
+		     "%s\n", strerror(errno));
+		return conn.fd;
+	}
+
+	pthread_mutex_lock(&shards->lock);
+
+	if (shards->cfg->num_clients_max > 0 /* 0 means unlimited */ &&
+	    shards->num_clients >= shards->cfg->num_clients_max) {
+		pthread_mutex_unlock(&shards->lock);
+		LOGP(DL1C, LOGL_NOTICE, "L1CTL server cannot accept more "
+		     "than %u connection(s)\n", shards->cfg->num_clients_max);
+		close(conn.fd);
+		return -ENOMEM;
+	}
+
+	rc = shards_id_alloc(shards);
+	if (rc < 0) {
+		pthread_mutex_unlock(&shards->lock);
+		close(conn.fd);
+		return rc;
+	}
+	conn.id = rc;
+
+	for (i = 0; i < shards->num_shards; i++) {
+		if (shard == NULL || shards->shard[i].num_clients < shard->num_clients)
+			shard = &shards->shard[i];
+	}
+
+	shard->num_clients++;
+	shards->num_clients++;
+
+	pthread_mutex_unlock(&shards->lock);
+
+	LOGP(DL1C, LOGL_NOTICE, "L1CTL server got a new connection (id=%u), "
+	     "handing over to shard #%u\n", conn.id, shard->index);
+
+	if (write(shard->pipe_fd[1], &conn, sizeof(conn)) != sizeof(conn)) {
+		LOGP_SHARD(shard, LOGL_ERROR, "Failed to write to pipe: %s\n", strerror(errno));
+		close(conn.fd);
+		shards_conn_release(shard, conn.id);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static void shards_stop(struct trxcon_shards *shards, unsigned int num_started)
+{
+	const struct trxcon_shard_conn stop = { .fd = -1 };
+	unsigned int i;
+
+	for (i = 0; i < num_started; i++) {
+		struct trxcon_shard *shard = &shards->shard[i];
+
+		if (write(shard->pipe_fd[1], &stop, sizeof(stop)) == sizeof(stop))
+			pthread_join(shard->thread, NULL);
+		else
+			LOGP_SHARD(shard, LOGL_ERROR, "Failed to stop the thread\n");
+	}
+
+	for (i = 0; i < shards->num_shards; i++) {
+		struct trxcon_shard *shard = &shards->shard[i];
+
+		if (shard->pipe_fd[0] >= 0) {
+			close(shard->pipe_fd[0]);
+			close(shard->pipe_fd[1]);
+		}
+	}
+}
+
+struct trxcon_shards *trxcon_shards_alloc(void *ctx, unsigned int num_shards,
+					  const struct l1ctl_server_cfg *cfg)
+{
+	struct trxcon_shards *shards;
+	sigset_t sigset, sigset_old;
+	unsigned int i, num_started = 0;
+	int rc;
+
+	LOGP(DL1C, LOGL_NOTICE, "Init L1CTL server (sock_path=%s, %u shards)\n",
+	     cfg->sock_path, num_shards);
+
+	OSMO_ASSERT(num_shards > 0);
+	OSMO_ASSERT(cfg->sock_path != NULL);
+	OSMO_ASSERT(cfg->conn_read_cb != NULL);
+
+	shards = talloc_zero(ctx, struct trxcon_shards);
+	OSMO_ASSERT(shards != NULL);
+
+	shards->shard = talloc_zero_array(shards, struct trxcon_shard, num_shards);
+	OSMO_ASSERT(shards->shard != NULL);
+
+	shards->cfg = cfg;
+	shards->num_shards = num_shards;
+	pthread_mutex_init(&shards->accept_lock, NULL);
+	pthread_mutex_init(&shards->lock, NULL);
+
+	for (i = 0; i < num_shards; i++) {
+		shards->shard[i] = (struct trxcon_shard) {
+			.shards = shards,
+			.index = i,
+			.pipe_fd = { -1, -1 },
+			.server_cfg = {
+				.conn_read_cb = &shard_conn_read_cb,
+				.conn_close_cb = &shard_conn_close_cb,
+			},
+		};
+	}
+
+	for (i = 0; i < num_shards; i++) {
+		struct trxcon_shard *shard = &shards->shard[i];
+
+		if (pipe2(shard->pipe_fd, O_CLOEXEC) != 0) {
+			LOGP_SHARD(shard, LOGL_ERROR, "Failed to create pipe: %s\n", strerror(errno));
+			shard->pipe_fd[0] = shard->pipe_fd[1] = -1;
+			goto err_stop;
+		}
+	}
+
+	/* Signals are to be handled by the main thread only */
+	sigfillset(&sigset);
+	pthread_sigmask(SIG_BLOCK, &sigset, &sigset_old);
+
+	for (num_started = 0; num_started < num_shards; num_started++) {
+		struct trxcon_shard *shard = &shards->shard[num_started];
+
+		rc = pthread_create(&shard->thread, NULL, &shard_thread, shard);
+		if (rc != 0) {
+			LOGP_SHARD(shard, LOGL_ERROR, "Failed to start thread: %s\n", strerror(rc));
+			break;
+		}
+	}
+
+	pthread_sigmask(SIG_SETMASK, &sigset_old, NULL);
+
+	if (num_started < num_shards)
+		goto err_stop;
+
+	/* Bind connection handler */
+	osmo_fd_setup(&shards->ofd, -1, OSMO_FD_READ, &shards_accept_cb, shards, 0);
+
+	rc = osmo_sock_unix_init_ofd(&shards->ofd, SOCK_STREAM, 0,
+				     cfg->sock_path, OSMO_SOCK_F_BIND);
+	if (rc < 0) {
+		LOGP(DL1C, LOGL_ERROR, "Could not create UNIX socket: %s\n",
+			strerror(errno));
+		goto err_stop;
+	}
+
+	return shards;
+
+err_stop:
+	shards_stop(shards, num_started);
+	pthread_mutex_destroy(&shards->accept_lock);
+	pthread_mutex_destroy(&shards->lock);
+	talloc_free(shards);
+	return NULL;
+}
+
+void trxcon_shards_free(struct trxcon_shards *shards)
+{
+	LOGP(DL1C, LOGL_NOTICE, "Shutdown L1CTL server\n");
+
+	/* Stop accepting new connections */
+	if (shards->ofd.fd != -1) {
+		osmo_fd_unregister(&shards->ofd);
+		close(shards->ofd.fd);
+		shards->ofd.fd = -1;
+	}
+
+	/* Each shard closes its connections on its own */
+	shards_stop(shards, shards->num_shards);
+
+	pthread_mutex_destroy(&shards->accept_lock);
+	pthread_mutex_destroy(&shards->lock);
+	talloc_free(shards);
+}
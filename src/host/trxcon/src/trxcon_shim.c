@@ -194,6 +194,7 @@ int trxcon_phyif_handle_rts_ind(void *priv, const struct trxcon_phyif_rts_ind *r
 	struct l1sched_burst_req br = {
 		.fn = rts->fn,
 		.tn = rts->tn,
+		.rts_time = rts->time,
 		.burst_len = 0, /* NOPE.ind */
 	};
 
@@ -228,7 +229,8 @@ int trxcon_phyif_handle_burst_ind(void *priv, const struct trxcon_phyif_burst_in
 		.tn = phybi->tn,
 		.toa256 = phybi->toa256,
 		.rssi = phybi->rssi,
-		/* .burst[] is populated below */
+		/* .burst[] is populated below, it stays zeroed (erasure)
+		 * for a NOPE.ind (burst_len == 0) */
 		.burst_len = phybi->burst_len,
 	};
 
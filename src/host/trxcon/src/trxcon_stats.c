@@ -0,0 +1,179 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * Export of the scheduler performance counters over a UNIX socket
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <sys/socket.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/socket.h>
+#include <osmocom/core/linuxlist.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+
+#include <osmocom/bb/trxcon/logging.h>
+#include <osmocom/bb/trxcon/trx_if.h>
+#include <osmocom/bb/trxcon/trxcon_stats.h>
+
+struct trxcon_stats_server {
+	struct osmo_fd ofd;
+	/* Connections being served */
+	struct llist_head conns;
+};
+
+/* A connection being served with a dump */
+struct trxcon_stats_conn {
+	struct llist_head list;
+	struct osmo_fd ofd;
+	char *buf;
+	size_t len;
+	size_t offset;
+};
+
+static void stats_conn_close(struct trxcon_stats_conn *conn)
+{
+	llist_del(&conn->list);
+	osmo_fd_unregister(&conn->ofd);
+	close(conn->ofd.fd);
+	talloc_free(conn);
+}
+
+static int stats_conn_write_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct trxcon_stats_conn *conn = ofd->data;
+	ssize_t rc;
+
+	rc = write(ofd->fd, conn->buf + conn->offset, conn->len - conn->offset);
+	if (rc < 0 && (errno == EAGAIN || errno == EINTR))
+		return 0;
+	if (rc <= 0) {
+		stats_conn_close(conn);
+		return 0;
+	}
+
+	conn->offset += rc;
+	if (conn->offset == conn->len)
+		stats_conn_close(conn);
+
+	return 0;
+}
+
+/* Counters of the scheduler instances, followed by the TRXD ones */
+static char *stats_dump(void *ctx)
+{
+	char *buf, *trxd;
+
+	buf = l1sched_stats_dump(ctx, "trxcon");
+	if (buf == NULL)
+		return NULL;
+	trxd = trx_if_stats_dump(ctx, "trxcon");
+	if (trxd == NULL) {
+		talloc_free(buf);
+		return NULL;
+	}
+
+	buf = talloc_strdup_append_buffer(buf, trxd);
+	talloc_free(trxd);
+	return buf;
+}
+
+static int stats_server_conn_cb(struct osmo_fd *sfd, unsigned int what)
+{
+	struct trxcon_stats_server *server = sfd->data;
+	struct trxcon_stats_conn *conn;
+	int fd;
+
+	fd = accept(sfd->fd, NULL, NULL);
+	if (fd < 0) {
+		LOGP(DAPP, LOGL_ERROR, "Failed to accept() a stats connection: %s\n",
+		     strerror(errno));
+		return fd;
+	}
+
+	/* A slow reader must not stall the event loop */
+	if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0)
+		goto error;
+
+	conn = talloc_zero(server, struct trxcon_stats_conn);
+	if (conn == NULL)
+		goto error;
+
+	conn->buf = stats_dump(conn);
+	if (conn->buf == NULL) {
+		talloc_free(conn);
+		goto error;
+	}
+	conn->len = strlen(conn->buf);
+
+	osmo_fd_setup(&conn->ofd, fd, OSMO_FD_WRITE, &stats_conn_write_cb, conn, 0);
+	if (osmo_fd_register(&conn->ofd) != 0) {
+		talloc_free(conn);
+		goto error;
+	}
+
+	llist_add_tail(&conn->list, &server->conns);
+	return 0;
+
+error:
+	close(fd);
+	return -EIO;
+}
+
+struct trxcon_stats_server *trxcon_stats_server_alloc(void *ctx, const char *sock_path)
+{
+	struct trxcon_stats_server *server;
+	int rc;
+
+	LOGP(DAPP, LOGL_NOTICE, "Init stats server (sock_path=%s)\n", sock_path);
+
+	server = talloc_zero(ctx, struct trxcon_stats_server);
+	if (server == NULL)
+		return NULL;
+
+	INIT_LLIST_HEAD(&server->conns);
+	osmo_fd_setup(&server->ofd, -1, OSMO_FD_READ, &stats_server_conn_cb, server, 0);
+
+	rc = osmo_sock_unix_init_ofd(&server->ofd, SOCK_STREAM, 0,
+				     sock_path, OSMO_SOCK_F_BIND);
+	if (rc < 0) {
+		LOGP(DAPP, LOGL_ERROR, "Could not create UNIX socket: %s\n",
+		     strerror(errno));
+		talloc_free(server);
+		return NULL;
+	}
+
+	return server;
+}
+
+void trxcon_stats_server_free(struct trxcon_stats_server *server)
+{
+	struct trxcon_stats_conn *conn, *tmp;
+
+	if (server == NULL)
+		return;
+
+	/* Close pending connections */
+	llist_for_each_entry_safe(conn, tmp, &server->conns, list)
+		stats_conn_close(conn);
+
+	osmo_fd_unregister(&server->ofd);
+	close(server->ofd.fd);
+	talloc_free(server);
+}
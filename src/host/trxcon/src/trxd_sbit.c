@@ -0,0 +1,184 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * TRXD soft-bit conversion kernels
+ *
+ * The generic kernel is the conversion loop formerly found in trx_if.c,
+ * hence the same license as trx_if.c.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <osmocom/core/utils.h>
+
+#include <osmocom/bb/trxcon/trxd_sbit.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#define HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* The conversion is: sbit = 127 - min(ubit, 254).  The clamping maps
+ * ubit=255 (not a valid soft-bit, but sent by some transceivers) to -127,
+ * which is exactly what the SIMD unsigned minimum instructions do. */
+
+static void ubit2sbit_generic(sbit_t *out, const uint8_t *in, unsigned int len)
+{
+	for (unsigned int i = 0; i < len; i++)
+		out[i] = in[i] == 255 ? -127 : 127 - in[i];
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+static void ubit2sbit_sse2(sbit_t *out, const uint8_t *in, unsigned int len)
+{
+	const __m128i max = _mm_set1_epi8((char)254);
+	const __m128i c127 = _mm_set1_epi8(127);
+	unsigned int i = 0;
+
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)&in[i]);
+		v = _mm_sub_epi8(c127, _mm_min_epu8(v, max));
+		_mm_storeu_si128((__m128i *)&out[i], v);
+	}
+
+	ubit2sbit_generic(&out[i], &in[i], len - i);
+}
+
+__attribute__((target("avx2")))
+static void ubit2sbit_avx2(sbit_t *out, const uint8_t *in, unsigned int len)
+{
+	const __m256i max = _mm256_set1_epi8((char)254);
+	const __m256i c127 = _mm256_set1_epi8(127);
+	unsigned int i = 0;
+
+	for (; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)&in[i]);
+		v = _mm256_sub_epi8(c127, _mm256_min_epu8(v, max));
+		_mm256_storeu_si256((__m256i *)&out[i], v);
+	}
+
+	/* Up to 31 bits left: a 128-bit step (still VEX encoded, calling the
+	 * SSE2 kernel here would incur AVX-SSE transition penalties) */
+	if (i + 16 <= len) {
+		__m128i v = _mm_loadu_si128((const __m128i *)&in[i]);
+		v = _mm_sub_epi8(_mm256_castsi256_si128(c127),
+				 _mm_min_epu8(v, _mm256_castsi256_si128(max)));
+		_mm_storeu_si128((__m128i *)&out[i], v);
+		i += 16;
+	}
+
+	ubit2sbit_generic(&out[i], &in[i], len - i);
+}
+
+static bool have_sse2(void)
+{
+	return __builtin_cpu_supports("sse2");
+}
+
+static bool have_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+#endif /* HAVE_X86_SIMD */
+
+#ifdef HAVE_NEON
+static void ubit2sbit_neon(sbit_t *out, const uint8_t *in, unsigned int len)
+{
+	const uint8x16_t max = vdupq_n_u8(254);
+	const uint8x16_t c127 = vdupq_n_u8(127);
+	unsigned int i = 0;
+
+	for (; i + 16 <= len; i += 16) {
+		uint8x16_t v = vld1q_u8(&in[i]);
+		v = vsubq_u8(c127, vminq_u8(v, max));
+		vst1q_u8((uint8_t *)&out[i], v);
+	}
+
+	ubit2sbit_generic(&out[i], &in[i], len - i);
+}
+#endif /* HAVE_NEON */
+
+static bool have_always(void)
+{
+	return true;
+}
+
+static const struct ubit2sbit_kernel {
+	const char *name;
+	bool (*supported)(void);
+	void (*func)(sbit_t *out, const uint8_t *in, unsigned int len);
+} ubit2sbit_kernels[] = {
+	/* Ordered by preference (most preferred first) */
+#ifdef HAVE_X86_SIMD
+	{ "avx2", &have_avx2, &ubit2sbit_avx2 },
+	{ "sse2", &have_sse2, &ubit2sbit_sse2 },
+#endif
+#ifdef HAVE_NEON
+	{ "neon", &have_always, &ubit2sbit_neon },
+#endif
+	{ "generic", &have_always, &ubit2sbit_generic },
+};
+
+static const struct ubit2sbit_kernel *ubit2sbit_kernel =
+	&ubit2sbit_kernels[ARRAY_SIZE(ubit2sbit_kernels) - 1];
+
+void trxd_ubit2sbit(sbit_t *out, const uint8_t *in, unsigned int len)
+{
+	ubit2sbit_kernel->func(out, in, len);
+}
+
+const char *trxd_ubit2sbit_kernel(void)
+{
+	return ubit2sbit_kernel->name;
+}
+
+int trxd_ubit2sbit_select(const char *name)
+{
+	for (unsigned int i = 0; i < ARRAY_SIZE(ubit2sbit_kernels); i++) {
+		const struct ubit2sbit_kernel *k = &ubit2sbit_kernels[i];
+
+		if (strcmp(k->name, name) != 0)
+			continue;
+		if (!k->supported())
+			return -ENOTSUP;
+		ubit2sbit_kernel = k;
+		return 0;
+	}
+
+	return -ENOTSUP;
+}
+
+static __attribute__((constructor)) void on_dso_load(void)
+{
+#ifdef HAVE_X86_SIMD
+	__builtin_cpu_init();
+#endif
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(ubit2sbit_kernels); i++) {
+		if (ubit2sbit_kernels[i].supported()) {
+			ubit2sbit_kernel = &ubit2sbit_kernels[i];
+			break;
+		}
+	}
+}
@@ -0,0 +1,207 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * Scheduler input capture test: the L2 output of a scheduler instance fed
+ * with bursts and configuration commands must be reproduced byte-exact by
+ * replaying the resulting capture through another instance.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
+
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+#include <osmocom/coding/gsm0503_coding.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1sched/capture.h>
+#include <osmocom/bb/l1sched/prim.h>
+
+#include "sched_test.h"
+
+/* Every Nth Downlink block is replaced by noise */
+#define BAD_BLOCK_EVERY		5
+
+/* L2 output (DATA.ind) of a scheduler instance */
+struct test_output {
+	uint8_t buf[16 * 1024];
+	size_t len;
+	unsigned int num_blocks;
+	unsigned int num_bad;
+};
+
+static struct test_output *cur_output;
+static void *tall_ctx;
+
+/* Scheduler -> user API (normally implemented by trxcon_shim.c) */
+
+int l1sched_prim_to_user(struct l1sched_state *sched, struct msgb *msg)
+{
+	const struct l1sched_prim *prim = l1sched_prim_from_msgb(msg);
+	struct test_output *out = cur_output;
+
+	if (prim->oph.primitive == L1SCHED_PRIM_T_DATA &&
+	    prim->oph.operation == PRIM_OP_INDICATION) {
+		OSMO_ASSERT(out->len + sizeof(prim->data_ind) + msgb_l2len(msg) <= sizeof(out->buf));
+		memcpy(&out->buf[out->len], &prim->data_ind, sizeof(prim->data_ind));
+		out->len += sizeof(prim->data_ind);
+		memcpy(&out->buf[out->len], msgb_l2(msg), msgb_l2len(msg));
+		out->len += msgb_l2len(msg);
+
+		out->num_blocks++;
+		if (msgb_l2len(msg) == 0)
+			out->num_bad++;
+	}
+
+	msgb_free(msg);
+	return 0;
+}
+
+/* Feed two 102-multiframes of Downlink bursts while capturing */
+static void test_capture(const char *path, struct test_output *out)
+{
+	const struct l1sched_cfg cfg = { .log_prefix = "capture: " };
+	struct l1sched_state *sched;
+	struct l1sched_ts *ts;
+	ubit_t bits[4 * 116];
+	uint32_t seed = 0x5eed;
+	unsigned int num_blocks = 0;
+	uint32_t fn;
+
+	cur_output = out;
+
+	sched = l1sched_alloc(tall_ctx, &cfg, NULL);
+	OSMO_ASSERT(sched != NULL);
+	OSMO_ASSERT(l1sched_capture_start(sched, path) == 0);
+
+	OSMO_ASSERT(l1sched_configure_ts(sched, 0, GSM_PCHAN_CCCH_SDCCH4) == 0);
+	ts = sched->ts[0];
+	OSMO_ASSERT(l1sched_set_lchans(ts, RSL_CHAN_SDCCH4_ACCH, 1, GSM48_CMODE_SIGN, 0) == 0);
+
+	for (fn = 0; fn < 2 * ts->mf_layout->period; fn++) {
+		const struct l1sched_tdma_frame *frame = &ts->mf_layout->frames[fn % ts->mf_layout->period];
+		const ubit_t *ub = &bits[frame->dl_bid * 116];
+		struct l1sched_burst_ind bi = {
+			.fn = fn,
+			.tn = 0,
+			.rssi = -60,
+			.burst_len = GSM_NBITS_NB_GMSK_BURST,
+		};
+		unsigned int i;
+
+		switch (frame->dl_chan) {
+		case L1SCHED_BCCH:
+		case L1SCHED_CCCH:
+		case L1SCHED_SDCCH4_0:
+		case L1SCHED_SACCH4_0:
+			break;
+		default:
+			continue;
+		}
+
+		/* Encode a new L2 block, or generate noise */
+		if (frame->dl_bid == 0) {
+			if (++num_blocks % BAD_BLOCK_EVERY == 0) {
+				for (i = 0; i < ARRAY_SIZE(bits); i++)
+					bits[i] = test_rand(&seed) & 1;
+			} else {
+				uint8_t l2[GSM_MACBLOCK_LEN];
+
+				for (i = 0; i < ARRAY_SIZE(l2); i++)
+					l2[i] = test_rand(&seed);
+				OSMO_ASSERT(gsm0503_xcch_encode(bits, l2) == 0);
+			}
+		}
+
+		for (i = 0; i < 58; i++) {
+			bi.burst[3 + i] = ub[i] ? -127 : 127;
+			bi.burst[87 + i] = ub[58 + i] ? -127 : 127;
+		}
+
+		l1sched_handle_rx_burst(sched, &bi);
+	}
+
+	l1sched_capture_stop(sched);
+	l1sched_free(sched);
+}
+
+static void test_replay(const char *path, struct test_output *out)
+{
+	const struct l1sched_cfg cfg = { .log_prefix = "replay: " };
+	const struct l1sched_capture_rec *rec;
+	unsigned int num_bursts = 0, num_cfg = 0;
+	struct l1sched_state *sched;
+	uint8_t buf[64 * 1024];
+	size_t len, offset = 0;
+	FILE *fp;
+
+	cur_output = out;
+
+	fp = fopen(path, "rb");
+	OSMO_ASSERT(fp != NULL);
+	len = fread(buf, 1, sizeof(buf), fp);
+	OSMO_ASSERT(feof(fp));
+	fclose(fp);
+
+	sched = l1sched_alloc(tall_ctx, &cfg, NULL);
+	OSMO_ASSERT(sched != NULL);
+
+	while ((rec = l1sched_capture_next(buf, len, &offset)) != NULL) {
+		if (rec->type == L1SCHED_CAPTURE_REC_BURST_IND)
+			num_bursts++;
+		else
+			num_cfg++;
+		l1sched_capture_apply(sched, rec);
+	}
+
+	OSMO_ASSERT(offset == len);
+	printf("Capture: %u configuration records, %u bursts\n", num_cfg, num_bursts);
+
+	l1sched_free(sched);
+}
+
+int main(int argc, char **argv)
+{
+	static struct test_output out_capture, out_replay;
+	char path[] = "/tmp/sched_capture_test.XXXXXX";
+	int fd;
+
+	tall_ctx = sched_test_init(__FILE__);
+
+	fd = mkstemp(path);
+	OSMO_ASSERT(fd >= 0);
+	close(fd);
+
+	test_capture(path, &out_capture);
+	printf("Captured: %u DATA.ind (%u bad)\n",
+	       out_capture.num_blocks, out_capture.num_bad);
+
+	test_replay(path, &out_replay);
+	printf("Replayed: %u DATA.ind (%u bad)\n",
+	       out_replay.num_blocks, out_replay.num_bad);
+
+	printf("L2 output identical: %s\n",
+	       out_capture.len == out_replay.len &&
+	       !memcmp(out_capture.buf, out_replay.buf, out_capture.len) ? "yes" : "no");
+
+	unlink(path);
+
+	return 0;
+}
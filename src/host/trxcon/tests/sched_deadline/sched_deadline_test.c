@@ -0,0 +1,132 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * Uplink burst deadline test: RTS-to-burst latency accounting and
+ * skipping of late blocks in l1sched_pull_burst(), using a mocked clock.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/talloc.h>
+
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1sched/prim.h>
+
+#include "sched_test.h"
+
+#define BUDGET_US		4000
+/* Time spent between the RTS indication and l1sched_pull_burst() */
+#define DELAY_US		100
+#define DELAY_LATE_US		5000
+/* TDMA frame number of the SDCCH/4(0) Uplink block which is delayed */
+#define LATE_BLOCK_FN		88
+
+static void *tall_ctx;
+
+/* Scheduler -> user API (normally implemented by trxcon_shim.c) */
+
+int l1sched_prim_to_user(struct l1sched_state *sched, struct msgb *msg)
+{
+	msgb_free(msg);
+	return 0;
+}
+
+static void print_stats(const struct l1sched_state *sched)
+{
+	const struct l1sched_deadline *dl = &sched->deadline;
+	unsigned int type, i;
+
+	for (type = 0; type < _L1SCHED_CHAN_MAX; type++) {
+		unsigned int total = 0;
+
+		for (i = 0; i < L1SCHED_DEADLINE_HIST_LEN; i++)
+			total += dl->hist[type][i];
+		if (total == 0 && dl->skipped[type] == 0)
+			continue;
+
+		printf("  %s: late=%u skipped=%u hist:", l1sched_lchan_desc[type].name,
+		       dl->late[type], dl->skipped[type]);
+		for (i = 0; i < L1SCHED_DEADLINE_HIST_LEN; i++) {
+			if (dl->hist[type][i] > 0)
+				printf(" [%u]=%u", i, dl->hist[type][i]);
+		}
+		printf("\n");
+	}
+}
+
+static void test_deadline(bool skip_late)
+{
+	const struct l1sched_cfg cfg = { .log_prefix = "test: " };
+	struct l1sched_state *sched;
+	struct l1sched_ts *ts;
+	uint32_t fn;
+
+	printf("=== %s(skip_late=%d)\n", __func__, skip_late);
+
+	sched = l1sched_alloc(tall_ctx, &cfg, NULL);
+	OSMO_ASSERT(sched != NULL);
+	sched->deadline.budget_us = BUDGET_US;
+	sched->deadline.skip_late = skip_late;
+
+	OSMO_ASSERT(l1sched_configure_ts(sched, 0, GSM_PCHAN_CCCH_SDCCH4) == 0);
+	ts = sched->ts[0];
+	OSMO_ASSERT(l1sched_set_lchans(ts, RSL_CHAN_SDCCH4_ACCH, 1, 0, 0) == 0);
+
+	for (fn = 0; fn < 2 * ts->mf_layout->period; fn++) {
+		const struct l1sched_tdma_frame *frame = &ts->mf_layout->frames[fn % ts->mf_layout->period];
+		struct l1sched_burst_req br = {
+			.fn = fn,
+			.tn = 0,
+			.rts_time = *osmo_clock_override_gettimespec(CLOCK_MONOTONIC),
+		};
+
+		/* Simulate processing delays between the RTS indication and here */
+		if (fn == LATE_BLOCK_FN)
+			osmo_clock_override_add(CLOCK_MONOTONIC, 0, DELAY_LATE_US * 1000);
+		else
+			osmo_clock_override_add(CLOCK_MONOTONIC, 0, DELAY_US * 1000);
+
+		l1sched_pull_burst(sched, &br);
+
+		if (frame->ul_chan != L1SCHED_SDCCH4_0)
+			continue;
+		printf("  fn=%u bid=%u: %s\n", fn, frame->ul_bid,
+		       br.burst_len > 0 ? "burst" : "NOPE");
+	}
+
+	print_stats(sched);
+	l1sched_free(sched);
+}
+
+int main(int argc, char **argv)
+{
+	tall_ctx = sched_test_init(__FILE__);
+
+	osmo_clock_override_enable(CLOCK_MONOTONIC, true);
+	osmo_clock_override_gettimespec(CLOCK_MONOTONIC)->tv_sec = 1;
+
+	test_deadline(false);
+	test_deadline(true);
+
+	return 0;
+}
@@ -0,0 +1,296 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * Decoding offload test: a BCCH/CCCH multiframe with both valid and
+ * corrupted blocks, as well as a RACH request, is replayed through
+ * trxcon with channel decoding done inline and by 1 or 4 worker threads.
+ * The resulting L1CTL output must be identical in all cases.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/fsm.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+
+#include <osmocom/gsm/gsm_utils.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+#include <osmocom/coding/gsm0503_coding.h>
+
+#include <osmocom/bb/trxcon/trxcon.h>
+#include <osmocom/bb/trxcon/trxcon_fsm.h>
+#include <osmocom/bb/trxcon/phyif.h>
+#include <osmocom/bb/trxcon/logging.h>
+#include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1ctl_proto.h>
+
+#include "sched_test.h"
+
+/* Number of 51-multiframes to replay */
+#define MFRAMES_NUM		20
+/* Every Nth Downlink block is replaced by noise */
+#define BAD_BLOCK_EVERY		5
+/* TDMA frame number at which the RACH request is sent */
+#define RACH_REQ_FN		(5 * 51 + 7)
+
+/* L1CTL messages (as sent to L2) of a single run */
+struct test_run {
+	uint8_t buf[64 * 1024];
+	size_t len;
+};
+
+static struct test_run *cur_run;
+static void *tall_ctx;
+
+static const int test_log_cfg[] = {
+	[TRXCON_LOGC_FSM] = DAPP,
+	[TRXCON_LOGC_L1C] = DL1C,
+	[TRXCON_LOGC_L1D] = DL1D,
+	[TRXCON_LOGC_SCHC] = DSCH,
+	[TRXCON_LOGC_SCHD] = DSCHD,
+	[TRXCON_LOGC_GPRS] = DGPRS,
+};
+
+/* trxcon -> L2/PHY API (normally implemented by trxcon_main.c) */
+
+int trxcon_l1ctl_send(struct trxcon_inst *trxcon, struct msgb *msg)
+{
+	OSMO_ASSERT(cur_run->len + msgb_length(msg) <= sizeof(cur_run->buf));
+	memcpy(&cur_run->buf[cur_run->len], msgb_data(msg), msgb_length(msg));
+	cur_run->len += msgb_length(msg);
+
+	msgb_free(msg);
+	return 0;
+}
+
+void trxcon_l1ctl_close(struct trxcon_inst *trxcon)
+{
+}
+
+int trxcon_phyif_handle_burst_req(void *phyif, const struct trxcon_phyif_burst_req *br)
+{
+	return 0;
+}
+
+int trxcon_phyif_handle_cmd(void *phyif, const struct trxcon_phyif_cmd *cmd)
+{
+	return 0;
+}
+
+void trxcon_phyif_close(void *phyif)
+{
+}
+
+static void test_run(struct test_run *run, unsigned int num_workers)
+{
+	const struct l1sched_tdma_multiframe *mf;
+	struct trxcon_inst *trxcon;
+	ubit_t bits[4 * 116];
+	sbit_t burst[GSM_NBITS_NB_GMSK_BURST];
+	uint32_t seed = 0x5eed;
+	unsigned int num_blocks = 0;
+	uint32_t fn;
+
+	cur_run = run;
+	run->len = 0;
+
+	trxcon = trxcon_inst_alloc(tall_ctx, 0);
+	OSMO_ASSERT(trxcon != NULL);
+	if (num_workers > 0)
+		OSMO_ASSERT(l1sched_decoder_start(trxcon->sched, num_workers) == 0);
+
+	const struct trxcon_param_fbsb_search_req fbsb_req = {
+		.band_arfcn = 871,
+		.timeout_fns = 0xffff,
+		.pchan_config = GSM_PCHAN_CCCH,
+	};
+
+	osmo_fsm_inst_dispatch(trxcon->fi, TRXCON_EV_FBSB_SEARCH_REQ, (void *)&fbsb_req);
+	osmo_fsm_inst_dispatch(trxcon->fi, TRXCON_EV_FBSB_SEARCH_RES, NULL);
+	OSMO_ASSERT(trxcon->fi->state == TRXCON_ST_BCCH_CCCH);
+
+	mf = l1sched_mframe_layout(GSM_PCHAN_CCCH, 0);
+	OSMO_ASSERT(mf != NULL);
+
+	memset(&burst[0], 0, sizeof(burst));
+
+	for (fn = 0; fn < MFRAMES_NUM * mf->period; fn++) {
+		const struct l1sched_tdma_frame *frame = &mf->frames[fn % mf->period];
+
+		if (fn == RACH_REQ_FN) {
+			const struct trxcon_param_tx_access_burst_req req = {
+				.chan_nr = RSL_CHAN_RACH,
+				.ra = 0x42,
+			};
+
+			osmo_fsm_inst_dispatch(trxcon->fi, TRXCON_EV_TX_ACCESS_BURST_REQ,
+					       (void *)&req);
+		}
+
+		if (frame->dl_chan == L1SCHED_BCCH || frame->dl_chan == L1SCHED_CCCH) {
+			const ubit_t *ub = &bits[frame->dl_bid * 116];
+			const struct trxcon_phyif_burst_ind bi = {
+				.fn = fn,
+				.tn = 0,
+				.toa256 = 0,
+				.rssi = -60,
+				.burst = &burst[0],
+				.burst_len = GSM_NBITS_NB_GMSK_BURST,
+			};
+			unsigned int i;
+
+			/* Encode a new L2 block, or generate noise */
+			if (frame->dl_bid == 0) {
+				if (++num_blocks % BAD_BLOCK_EVERY == 0) {
+					for (i = 0; i < ARRAY_SIZE(bits); i++)
+						bits[i] = test_rand(&seed) & 1;
+				} else {
+					uint8_t l2[GSM_MACBLOCK_LEN];
+
+					for (i = 0; i < ARRAY_SIZE(l2); i++)
+						l2[i] = test_rand(&seed);
+					OSMO_ASSERT(gsm0503_xcch_encode(bits, l2) == 0);
+				}
+			}
+
+			for (i = 0; i < 58; i++) {
+				burst[3 + i] = ub[i] ? -127 : 127;
+				burst[87 + i] = ub[58 + i] ? -127 : 127;
+			}
+
+			trxcon_phyif_handle_burst_ind(trxcon, &bi);
+		}
+
+		const struct trxcon_phyif_rts_ind rts = { .fn = fn, .tn = 0 };
+		trxcon_phyif_handle_rts_ind(trxcon, &rts);
+
+		/* Let the decoded blocks be delivered */
+		if (fn % 8 == 0)
+			osmo_select_main(1);
+	}
+
+	l1sched_decoder_flush(trxcon->sched);
+	trxcon_inst_free(trxcon);
+}
+
+static void test_run_summary(const struct test_run *run)
+{
+	unsigned int num_data_ind = 0;
+	unsigned int num_bad_ind = 0;
+	unsigned int num_rach_conf = 0;
+	unsigned int num_fbsb_conf = 0;
+	size_t offset = 0;
+
+	while (offset < run->len) {
+		const struct l1ctl_hdr *l1h = (void *)&run->buf[offset];
+		const struct l1ctl_info_dl *dl = (void *)&l1h->data[0];
+
+		switch (l1h->msg_type) {
+		case L1CTL_DATA_IND:
+			num_data_ind++;
+			if (dl->fire_crc == 2)
+				num_bad_ind++;
+			offset += sizeof(*l1h) + sizeof(*dl);
+			if (dl->fire_crc != 2)
+				offset += GSM_MACBLOCK_LEN;
+			break;
+		case L1CTL_RACH_CONF:
+			num_rach_conf++;
+			offset += sizeof(*l1h) + sizeof(*dl);
+			break;
+		case L1CTL_FBSB_CONF:
+			num_fbsb_conf++;
+			offset += sizeof(*l1h) + sizeof(*dl);
+			offset += sizeof(struct l1ctl_fbsb_conf);
+			break;
+		default:
+			printf("Unexpected L1CTL message type 0x%02x\n", l1h->msg_type);
+			return;
+		}
+	}
+
+	printf("DATA_IND=%u (bad=%u), RACH_CONF=%u, FBSB_CONF=%u\n",
+	       num_data_ind, num_bad_ind, num_rach_conf, num_fbsb_conf);
+}
+
+static const struct log_info_cat test_log_info_cat[] = {
+	[DAPP] = {
+		.name = "DAPP",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DL1C] = {
+		.name = "DL1C",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DL1D] = {
+		.name = "DL1D",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DTRXC] = {
+		.name = "DTRXC",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DTRXD] = {
+		.name = "DTRXD",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DSCH] = {
+		.name = "DSCH",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DSCHD] = {
+		.name = "DSCHD",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DGPRS] = {
+		.name = "DGPRS",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+};
+
+static const struct log_info test_log_info = {
+	.cat = test_log_info_cat,
+	.num_cat = ARRAY_SIZE(test_log_info_cat),
+};
+
+int main(int argc, char **argv)
+{
+	static const unsigned int workers[] = { 0, 1, 4 };
+	static struct test_run runs[ARRAY_SIZE(workers)];
+	unsigned int i;
+
+	tall_ctx = talloc_named_const(NULL, 1, __FILE__);
+	osmo_init_logging2(tall_ctx, &test_log_info);
+	trxcon_set_log_cfg(&test_log_cfg[0], ARRAY_SIZE(test_log_cfg));
+
+	for (i = 0; i < ARRAY_SIZE(workers); i++) {
+		printf("Running with %u decoder worker(s)\n", workers[i]);
+		test_run(&runs[i], workers[i]);
+		test_run_summary(&runs[i]);
+		if (i == 0)
+			continue;
+		printf("L1CTL output identical to inline decoding: %s\n",
+		       runs[i].len == runs[0].len &&
+		       !memcmp(runs[i].buf, runs[0].buf, runs[0].len) ? "yes" : "no");
+	}
+
+	return 0;
+}
@@ -0,0 +1,281 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * Incremental FACCH deinterleaving test: the coded blocks built burst by
+ * burst must match the output of the reference deinterleaver, decoding
+ * them must give the same as the reference FACCH/F and FACCH/H decoders,
+ * and FACCH/F blocks sent over a TCH/F in signalling mode must be received
+ * intact.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
+
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+#include <osmocom/coding/gsm0503_coding.h>
+#include <osmocom/coding/gsm0503_interleaving.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1sched/prim.h>
+
+#include "sched_test.h"
+
+/* Number of FACCH/F blocks to send */
+#define NUM_BLOCKS		12
+
+static uint8_t sent[NUM_BLOCKS][GSM_MACBLOCK_LEN];
+static unsigned int num_received;
+static void *tall_ctx;
+
+/* Scheduler -> user API (normally implemented by trxcon_shim.c) */
+
+int l1sched_prim_to_user(struct l1sched_state *sched, struct msgb *msg)
+{
+	const struct l1sched_prim *prim = l1sched_prim_from_msgb(msg);
+
+	if (prim->oph.primitive == L1SCHED_PRIM_T_DATA &&
+	    prim->oph.operation == PRIM_OP_INDICATION &&
+	    msgb_l2len(msg) == GSM_MACBLOCK_LEN &&
+	    num_received < NUM_BLOCKS &&
+	    !memcmp(msgb_l2(msg), sent[num_received], GSM_MACBLOCK_LEN))
+		num_received++;
+
+	msgb_free(msg);
+	return 0;
+}
+
+/* Unmap a burst (116 bits, including the stealing flags) into iB */
+static void test_unmap(sbit_t *iB, const sbit_t *burst)
+{
+	memcpy(&iB[0], &burst[0], 57);
+	memcpy(&iB[57], &burst[59], 57);
+}
+
+/* Push random bursts one by one, and compare the oldest coded block on
+ * each block boundary with the output of gsm0503_tch_fr_deinterleave().
+ * FACCH/H is deinterleaved the same way as FACCH/F, with bursts 2 and 3
+ * standing for bursts 6 and 7 (3GPP TS 45.003, section 4.3.4). */
+static void test_dil(enum l1sched_lchan_type type)
+{
+	const unsigned int step = (type == L1SCHED_TCHF) ? 4 : 2;
+	const unsigned int num = (type == L1SCHED_TCHF) ? 8 : 6;
+	struct l1sched_facch_dil dil = { 0 };
+	struct l1sched_lchan_state lchan = {
+		.type = type,
+		.rx_facch = &dil,
+	};
+	sbit_t bursts[32][116];
+	unsigned int i, j, num_ok = 0, num_checked = 0;
+	uint32_t seed = 0xfacc;
+
+	for (i = 0; i < ARRAY_SIZE(bursts); i++) {
+		const uint8_t bid = i % step;
+
+		for (j = 0; j < 116; j++)
+			bursts[i][j] = (int8_t)test_rand(&seed);
+
+		if (bid == 0)
+			l1sched_facch_dil_shift(&lchan);
+		l1sched_facch_dil_push(&lchan, bursts[i], bid);
+
+		/* Wait for the last burst of a complete block */
+		if (bid != step - 1 || i + 1 < num) {
+			continue;
+		} else {
+			const sbit_t (*b)[116] = &bursts[i + 1 - num];
+			sbit_t iB[8 * 114], cB[456];
+
+			for (j = 0; j < 8; j++)
+				test_unmap(&iB[j * 114], b[j < num ? j : j - 4]);
+			gsm0503_tch_fr_deinterleave(&cB[0], &iB[0]);
+
+			num_checked++;
+			if (!memcmp(cB, dil.cB[dil.head], sizeof(cB)))
+				num_ok++;
+		}
+	}
+
+	printf("%s: %u of %u coded blocks match the reference\n",
+	       l1sched_lchan_desc[type].name, num_ok, num_checked);
+}
+
+/* Encode FACCH/F (8 bursts) or FACCH/H (6 bursts) blocks, feed their bursts
+ * one by one into the incremental deinterleaver, and check that decoding the
+ * result gives the same as gsm0503_tch_{fr,hr}_facch_decode() on the bursts.
+ * In the noisy variant, every 29th bit is flipped and the soft-bits are of
+ * varying confidence. */
+static void test_dil_decode(enum l1sched_lchan_type type, bool noisy)
+{
+	const bool tchf = (type == L1SCHED_TCHF);
+	const unsigned int step = tchf ? 4 : 2;
+	const unsigned int num = tchf ? 8 : 6;
+	unsigned int i, n, num_ok = 0, num_decoded = 0;
+	uint32_t seed = noisy ? 0xdec0 : 0xdec1;
+
+	for (n = 0; n < NUM_BLOCKS; n++) {
+		struct l1sched_facch_dil dil = { 0 };
+		struct l1sched_lchan_state lchan = {
+			.type = type,
+			.rx_facch = &dil,
+		};
+		uint8_t data[GSM_MACBLOCK_LEN], dec[GSM_MACBLOCK_LEN], ref[GSM_MACBLOCK_LEN];
+		int n_errors, n_bits_total, ref_n_errors, ref_n_bits_total;
+		ubit_t ub[8 * 116];
+		sbit_t sb[8 * 116];
+		int rc, ref_rc;
+
+		for (i = 0; i < GSM_MACBLOCK_LEN; i++)
+			data[i] = test_rand(&seed);
+
+		memset(ub, 0, sizeof(ub));
+		if (tchf)
+			OSMO_ASSERT(gsm0503_tch_fr_facch_encode(&ub[0], &data[0]) == 0);
+		else
+			OSMO_ASSERT(gsm0503_tch_hr_facch_encode(&ub[0], &data[0]) == 0);
+
+		for (i = 0; i < num * 116; i++) {
+			int v = ub[i] ? -127 : 127;
+
+			if (noisy) {
+				v = v * (int)(32 + test_rand(&seed) % 96) / 127;
+				if (i % 29 == 0)
+					v = -v;
+			}
+			sb[i] = v;
+		}
+
+		/* The block starts on the first burst of the newest block, and is
+		 * the oldest one once its last burst has been pushed */
+		for (i = 0; i < num; i++) {
+			if (i % step == 0)
+				l1sched_facch_dil_shift(&lchan);
+			l1sched_facch_dil_push(&lchan, &sb[i * 116], i % step);
+		}
+
+		rc = l1sched_facch_dil_decode(&lchan, &dec[0], &n_errors, &n_bits_total);
+		if (tchf)
+			ref_rc = gsm0503_tch_fr_facch_decode(&ref[0], &sb[0],
+							     &ref_n_errors, &ref_n_bits_total);
+		else
+			ref_rc = gsm0503_tch_hr_facch_decode(&ref[0], &sb[0],
+							     &ref_n_errors, &ref_n_bits_total);
+
+		if (rc == GSM_MACBLOCK_LEN && !memcmp(dec, data, sizeof(data)))
+			num_decoded++;
+
+		if ((rc == GSM_MACBLOCK_LEN) != (ref_rc == GSM_MACBLOCK_LEN))
+			continue;
+		if (n_errors != ref_n_errors || n_bits_total != ref_n_bits_total)
+			continue;
+		if (rc == GSM_MACBLOCK_LEN && memcmp(dec, ref, sizeof(dec)))
+			continue;
+		num_ok++;
+	}
+
+	if (noisy) {
+		printf("%s (noisy): %u of %u blocks decoded as by the reference\n",
+		       l1sched_lchan_desc[type].name, num_ok, NUM_BLOCKS);
+	} else {
+		printf("%s: %u of %u blocks decoded as by the reference, %u intact\n",
+		       l1sched_lchan_desc[type].name, num_ok, NUM_BLOCKS, num_decoded);
+	}
+}
+
+/* Send FACCH/F blocks over a TCH/F in signalling mode */
+static void test_tchf_facch(void)
+{
+	const struct l1sched_cfg cfg = { .log_prefix = "facch: " };
+	const struct l1sched_tdma_multiframe *mf;
+	struct l1sched_state *sched;
+	struct l1sched_ts *ts;
+	ubit_t bits[8 * 116];
+	unsigned int num_blocks = 0, i;
+	uint32_t seed = 0x5eed;
+	uint32_t fn;
+
+	num_received = 0;
+
+	sched = l1sched_alloc(tall_ctx, &cfg, NULL);
+	OSMO_ASSERT(sched != NULL);
+
+	OSMO_ASSERT(l1sched_configure_ts(sched, 1, GSM_PCHAN_TCH_F) == 0);
+	ts = sched->ts[1];
+	OSMO_ASSERT(l1sched_set_lchans(ts, RSL_CHAN_Bm_ACCHs | 1, 1, GSM48_CMODE_SIGN, 0) == 0);
+	mf = ts->mf_layout;
+
+	memset(bits, 0, sizeof(bits));
+
+	/* The last block sent is complete with the 4 bursts of the next one,
+	 * stop on the first burst of the one after */
+	for (fn = 0; num_blocks < NUM_BLOCKS + 2; fn++) {
+		const struct l1sched_tdma_frame *frame = &mf->frames[fn % mf->period];
+		struct l1sched_burst_ind bi = {
+			.fn = fn,
+			.tn = 1,
+			.rssi = -60,
+			.burst_len = GSM_NBITS_NB_GMSK_BURST,
+		};
+		const ubit_t *ub;
+
+		if (frame->dl_chan != L1SCHED_TCHF)
+			continue;
+
+		/* Shift the burst buffer by 4 bursts, encode a new block */
+		if (frame->dl_bid == 0) {
+			memmove(&bits[0], &bits[4 * 116], 4 * 116);
+			memset(&bits[4 * 116], 0, 4 * 116);
+			if (num_blocks < NUM_BLOCKS) {
+				for (i = 0; i < GSM_MACBLOCK_LEN; i++)
+					sent[num_blocks][i] = test_rand(&seed);
+				OSMO_ASSERT(gsm0503_tch_fr_encode(bits, sent[num_blocks],
+								  GSM_MACBLOCK_LEN, 1) == 0);
+			}
+			num_blocks++;
+		}
+
+		ub = &bits[frame->dl_bid * 116];
+		for (i = 0; i < 58; i++) {
+			bi.burst[3 + i] = ub[i] ? -127 : 127;
+			bi.burst[87 + i] = ub[58 + i] ? -127 : 127;
+		}
+
+		l1sched_handle_rx_burst(sched, &bi);
+	}
+
+	printf("TCH/F: %u of %u FACCH/F blocks received\n", num_received, NUM_BLOCKS);
+
+	l1sched_free(sched);
+}
+
+int main(int argc, char **argv)
+{
+	tall_ctx = sched_test_init(__FILE__);
+
+	test_dil(L1SCHED_TCHF);
+	test_dil(L1SCHED_TCHH_0);
+	test_dil_decode(L1SCHED_TCHF, false);
+	test_dil_decode(L1SCHED_TCHF, true);
+	test_dil_decode(L1SCHED_TCHH_0, false);
+	test_dil_decode(L1SCHED_TCHH_0, true);
+	test_tchf_facch();
+
+	return 0;
+}
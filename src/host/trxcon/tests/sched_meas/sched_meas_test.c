@@ -0,0 +1,133 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * Measurement history test: average, min/max and variance of ToA256 and
+ * RSSI as computed by l1sched_lchan_meas_avg(), also once the history
+ * has wrapped around.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+
+#include "sched_test.h"
+
+static void *tall_ctx;
+
+/* Scheduler -> user API (normally implemented by trxcon_shim.c) */
+
+int l1sched_prim_to_user(struct l1sched_state *sched, struct msgb *msg)
+{
+	msgb_free(msg);
+	return 0;
+}
+
+static void push(struct l1sched_lchan_state *lchan, uint32_t fn, int16_t toa256, int8_t rssi)
+{
+	const struct l1sched_burst_ind bi = {
+		.fn = fn,
+		.toa256 = toa256,
+		.rssi = rssi,
+	};
+
+	l1sched_lchan_meas_push(lchan, &bi);
+}
+
+static void print_avg(struct l1sched_lchan_state *lchan, unsigned int n)
+{
+	const struct l1sched_meas_set *avg = &lchan->meas_avg;
+
+	l1sched_lchan_meas_avg(lchan, n);
+	printf("n=%u fn=%u: toa256 avg=%d min=%d max=%d var=%u, "
+	       "rssi avg=%d min=%d max=%d var=%u\n", n, avg->fn,
+	       avg->toa256, avg->toa256_min, avg->toa256_max, avg->toa256_var,
+	       avg->rssi, avg->rssi_min, avg->rssi_max, avg->rssi_var);
+}
+
+/* A block of four bursts: var(toa256) = 81920, var(rssi) = 5 */
+static void test_block(struct l1sched_lchan_state *lchan)
+{
+	printf("%s()\n", __func__);
+
+	push(lchan, 100, -256, -60);
+	push(lchan, 101, 0, -62);
+	push(lchan, 102, 256, -64);
+	push(lchan, 103, 512, -66);
+
+	print_avg(lchan, 4);
+	/* only the last two */
+	print_avg(lchan, 2);
+	/* a single burst has no spread */
+	print_avg(lchan, 1);
+}
+
+/* More bursts than the depth of the history: the oldest ones are gone, the
+ * last n entries are taken from the mirrored part of the arrays */
+static void test_wrap(struct l1sched_lchan_state *lchan)
+{
+	unsigned int i;
+
+	printf("%s()\n", __func__);
+
+	for (i = 0; i < 30; i++)
+		push(lchan, i, i * 16, -50 - (i % 4));
+
+	/* bursts 22..29: toa256 352..464 (var 1344), rssi -50..-53 (var 1.25) */
+	print_avg(lchan, 8);
+	/* bursts 6..29 */
+	print_avg(lchan, L1SCHED_MEAS_HIST_LEN);
+}
+
+/* The whole range of the values: neither the sums nor the variance overflow */
+static void test_extremes(struct l1sched_lchan_state *lchan)
+{
+	unsigned int i;
+
+	printf("%s()\n", __func__);
+
+	for (i = 0; i < L1SCHED_MEAS_HIST_LEN; i++) {
+		if (i % 2)
+			push(lchan, i, -32767, -120);
+		else
+			push(lchan, i, 32767, -20);
+	}
+
+	print_avg(lchan, L1SCHED_MEAS_HIST_LEN);
+}
+
+int main(int argc, char **argv)
+{
+	struct l1sched_lchan_state *lchan;
+
+	tall_ctx = sched_test_init(__FILE__);
+
+	lchan = talloc_zero(tall_ctx, struct l1sched_lchan_state);
+	test_block(lchan);
+
+	memset(lchan, 0, sizeof(*lchan));
+	test_wrap(lchan);
+
+	memset(lchan, 0, sizeof(*lchan));
+	test_extremes(lchan);
+
+	talloc_free(lchan);
+	talloc_free(tall_ctx);
+
+	return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * Primitive pool test: the steady-state Uplink path (DATA.req from the
+ * user, dummy LAPDm frames, cached Measurement Reports, DATA.cnf back to
+ * the user) shall not allocate anything from the heap.  Allocations are
+ * counted by watching the number of blocks of the root talloc context.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
+
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1sched/prim.h>
+
+#include "sched_test.h"
+
+/* Number of multiframes to run, the first one is warm-up */
+#define NUM_MF			4
+
+static void *tall_ctx;
+
+/* Number of talloc blocks in the steady state (0: warming up) */
+static size_t num_blocks_steady;
+static unsigned int num_heap_allocs;
+static unsigned int num_cnf_sdcch;
+static unsigned int num_cnf_dummy;
+static unsigned int num_cnf_sacch;
+
+static void check_heap(void)
+{
+	if (num_blocks_steady > 0 && talloc_total_blocks(tall_ctx) != num_blocks_steady)
+		num_heap_allocs++;
+}
+
+/* Scheduler -> user API (normally implemented by trxcon_shim.c) */
+
+int l1sched_prim_to_user(struct l1sched_state *sched, struct msgb *msg)
+{
+	const struct l1sched_prim *prim = l1sched_prim_from_msgb(msg);
+
+	/* A heap allocated DATA.cnf would still be alive here */
+	check_heap();
+
+	if (OSMO_PRIM_HDR(&prim->oph) == OSMO_PRIM(L1SCHED_PRIM_T_DATA, PRIM_OP_CONFIRM) &&
+	    num_blocks_steady > 0) {
+		if (prim->data_req.link_id == L1SCHED_CH_LID_SACCH)
+			num_cnf_sacch++;
+		else if (msgb_l2(msg)[0] == 0x01) /* LAPDm fill frame */
+			num_cnf_dummy++;
+		else
+			num_cnf_sdcch++;
+	}
+
+	msgb_free(msg);
+	return 0;
+}
+
+/* Send a DATA.req for every other SDCCH/4(0) block, dummy frames in between */
+static void test_steady_state(void)
+{
+	const struct l1sched_cfg cfg = { .log_prefix = "pool: " };
+	struct l1sched_state *sched;
+	struct l1sched_ts *ts;
+	unsigned int num_blocks = 0;
+	uint32_t fn;
+
+	printf("=== %s()\n", __func__);
+
+	sched = l1sched_alloc(tall_ctx, &cfg, NULL);
+	OSMO_ASSERT(sched != NULL);
+
+	OSMO_ASSERT(l1sched_configure_ts(sched, 0, GSM_PCHAN_CCCH_SDCCH4) == 0);
+	ts = sched->ts[0];
+	OSMO_ASSERT(l1sched_set_lchans(ts, RSL_CHAN_SDCCH4_ACCH, 1, 0, 0) == 0);
+
+	for (fn = 0; fn < NUM_MF * ts->mf_layout->period; fn++) {
+		const struct l1sched_tdma_frame *frame = &ts->mf_layout->frames[fn % ts->mf_layout->period];
+		struct l1sched_burst_req br = {
+			.fn = fn,
+			.tn = 0,
+		};
+
+		if (fn == ts->mf_layout->period)
+			num_blocks_steady = talloc_total_blocks(tall_ctx);
+
+		if (frame->ul_chan == L1SCHED_SDCCH4_0 && frame->ul_bid == 0) {
+			if (num_blocks++ % 2 == 0)
+				enqueue_data_req(sched);
+		}
+
+		l1sched_pull_burst(sched, &br);
+		check_heap();
+	}
+
+	printf("  DATA.cnf: SDCCH=%u dummy=%u SACCH=%u\n",
+	       num_cnf_sdcch, num_cnf_dummy, num_cnf_sacch);
+	printf("  heap allocations: %u, pool fallbacks: %lu\n",
+	       num_heap_allocs, sched->prim_pool.num_fallback);
+
+	num_blocks_steady = 0;
+	l1sched_free(sched);
+}
+
+/* Exhaust the pool, then free the scheduler with a primitive still in use */
+static void test_exhaustion(void)
+{
+	const struct l1sched_cfg cfg = {
+		.log_prefix = "pool: ",
+		.prim_pool_size = 4,
+	};
+	struct l1sched_state *sched;
+	struct msgb *msgs[5];
+	size_t num_blocks;
+	unsigned int i;
+
+	printf("=== %s()\n", __func__);
+
+	num_blocks = talloc_total_blocks(tall_ctx);
+
+	sched = l1sched_alloc(tall_ctx, &cfg, NULL);
+	OSMO_ASSERT(sched != NULL);
+
+	for (i = 0; i < ARRAY_SIZE(msgs); i++) {
+		msgs[i] = l1sched_prim_pool_alloc(sched, L1SCHED_PRIM_T_DATA, PRIM_OP_REQUEST);
+		OSMO_ASSERT(msgs[i] != NULL);
+	}
+	printf("  allocated %zu: free=%u fallbacks=%lu\n", ARRAY_SIZE(msgs),
+	       sched->prim_pool.num_free, sched->prim_pool.num_fallback);
+
+	for (i = 1; i < ARRAY_SIZE(msgs); i++)
+		msgb_free(msgs[i]);
+	printf("  released %zu: free=%u\n", ARRAY_SIZE(msgs) - 1,
+	       sched->prim_pool.num_free);
+
+	/* msgs[0] is still in use, it shall outlive the scheduler */
+	l1sched_free(sched);
+	OSMO_ASSERT(msgb_l2len(msgs[0]) == 0);
+	msgb_free(msgs[0]);
+
+	printf("  leaked blocks: %zu\n", talloc_total_blocks(tall_ctx) - num_blocks);
+}
+
+int main(int argc, char **argv)
+{
+	tall_ctx = sched_test_init(__FILE__);
+
+	test_steady_state();
+	test_exhaustion();
+
+	return 0;
+}
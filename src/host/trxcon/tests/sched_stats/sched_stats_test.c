@@ -0,0 +1,175 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * Scheduler performance counters test: feed a known sequence of Downlink
+ * blocks (with a known number of bit errors and measurements) and Uplink
+ * bursts through the scheduler and check the exported counters.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/talloc.h>
+
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+#include <osmocom/coding/gsm0503_coding.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1sched/prim.h>
+
+#include "sched_test.h"
+
+/* Simulated delay between the RTS indication and the Uplink burst */
+#define DELAY_US		100
+/* Number of DATA.req primitives queued for SDCCH/4(0) in advance */
+#define NUM_DATA_REQ		3
+
+/* Bit errors injected into the n-th Downlink SDCCH/4(0) block (456 bits).
+ * The positions are spread over the data bits of all four bursts. */
+static const struct {
+	unsigned int num;
+	unsigned int step;
+} test_errors[] = {
+	{ 0, 0 },
+	{ 10, 46 },	/* BER 2.19% */
+	{ 5, 92 },	/* BER 1.10% */
+	{ 0, 0 },
+};
+
+static void *tall_ctx;
+
+/* Scheduler -> user API (normally implemented by trxcon_shim.c) */
+
+int l1sched_prim_to_user(struct l1sched_state *sched, struct msgb *msg)
+{
+	msgb_free(msg);
+	return 0;
+}
+
+/* Number of samples (non-comment lines) in a dump */
+static unsigned int dump_num_samples(const char *dump)
+{
+	unsigned int num = 0;
+
+	while (*dump != '\0') {
+		if (*dump != '#')
+			num++;
+		dump = strchrnul(dump, '\n');
+		if (*dump == '\n')
+			dump++;
+	}
+
+	return num;
+}
+
+int main(int argc, char **argv)
+{
+	const struct l1sched_cfg cfg = { .log_prefix = "test: " };
+	struct l1sched_state *sched;
+	struct l1sched_ts *ts;
+	ubit_t bits[4 * 116];
+	uint32_t seed = 0x5eed;
+	unsigned int i, num_blocks = 0;
+	uint32_t fn;
+	char *dump;
+
+	tall_ctx = sched_test_init(__FILE__);
+
+	/* Both the decoding time and the RTS-to-burst latency are deterministic */
+	osmo_clock_override_enable(CLOCK_MONOTONIC, true);
+	osmo_clock_override_gettimespec(CLOCK_MONOTONIC)->tv_sec = 1;
+
+	sched = l1sched_alloc(tall_ctx, &cfg, NULL);
+	OSMO_ASSERT(sched != NULL);
+	sched->stats.dec_timing = true;
+	l1sched_stats_register(sched, 0);
+
+	OSMO_ASSERT(l1sched_configure_ts(sched, 0, GSM_PCHAN_CCCH_SDCCH4) == 0);
+	ts = sched->ts[0];
+	OSMO_ASSERT(l1sched_set_lchans(ts, RSL_CHAN_SDCCH4_ACCH, 1, GSM48_CMODE_SIGN, 0) == 0);
+
+	for (i = 0; i < NUM_DATA_REQ; i++)
+		enqueue_data_req(sched);
+
+	for (fn = 0; fn < 2 * ts->mf_layout->period; fn++) {
+		const struct l1sched_tdma_frame *frame = &ts->mf_layout->frames[fn % ts->mf_layout->period];
+		struct l1sched_burst_req br = {
+			.fn = fn,
+			.tn = 0,
+			.rts_time = *osmo_clock_override_gettimespec(CLOCK_MONOTONIC),
+		};
+
+		osmo_clock_override_add(CLOCK_MONOTONIC, 0, DELAY_US * 1000);
+		l1sched_pull_burst(sched, &br);
+
+		if (frame->dl_chan != L1SCHED_SDCCH4_0)
+			continue;
+
+		/* Encode a new L2 block, then inject bit errors */
+		if (frame->dl_bid == 0) {
+			uint8_t l2[GSM_MACBLOCK_LEN];
+
+			OSMO_ASSERT(num_blocks < ARRAY_SIZE(test_errors));
+			for (i = 0; i < ARRAY_SIZE(l2); i++)
+				l2[i] = test_rand(&seed);
+			OSMO_ASSERT(gsm0503_xcch_encode(bits, l2) == 0);
+
+			for (i = 0; i < test_errors[num_blocks].num; i++) {
+				unsigned int pos = 1 + i * test_errors[num_blocks].step;
+
+				/* Stealing flags are not part of the coded block */
+				OSMO_ASSERT(pos % 116 != 57 && pos % 116 != 58);
+				bits[pos] ^= 1;
+			}
+
+			num_blocks++;
+		}
+
+		/* ToA256 and RSSI vary over the bursts of a block */
+		const ubit_t *ub = &bits[frame->dl_bid * 116];
+		struct l1sched_burst_ind bi = {
+			.fn = fn,
+			.tn = 0,
+			.toa256 = 16 * frame->dl_bid,
+			.rssi = -60 - frame->dl_bid,
+			.burst_len = GSM_NBITS_NB_GMSK_BURST,
+		};
+
+		for (i = 0; i < 58; i++) {
+			bi.burst[3 + i] = ub[i] ? -127 : 127;
+			bi.burst[87 + i] = ub[58 + i] ? -127 : 127;
+		}
+
+		l1sched_handle_rx_burst(sched, &bi);
+	}
+
+	dump = l1sched_stats_dump(tall_ctx, "test");
+	OSMO_ASSERT(dump != NULL);
+	printf("%s", dump);
+	talloc_free(dump);
+
+	/* Unregistered on free */
+	l1sched_free(sched);
+	dump = l1sched_stats_dump(tall_ctx, "test");
+	printf("Samples after l1sched_free(): %u\n", dump_num_samples(dump));
+	talloc_free(dump);
+
+	return 0;
+}
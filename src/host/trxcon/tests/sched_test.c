@@ -0,0 +1,92 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * Helpers shared by the l1sched tests
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+
+#include <osmocom/gsm/gsm_utils.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+
+#include <osmocom/bb/l1sched/l1sched.h>
+#include <osmocom/bb/l1sched/logging.h>
+#include <osmocom/bb/l1sched/prim.h>
+
+#include "sched_test.h"
+
+enum {
+	DSCH,
+	DSCHD,
+};
+
+static const struct log_info_cat test_log_info_cat[] = {
+	[DSCH] = {
+		.name = "DSCH",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+	[DSCHD] = {
+		.name = "DSCHD",
+		.enabled = 1, .loglevel = LOGL_FATAL,
+	},
+};
+
+static const struct log_info test_log_info = {
+	.cat = test_log_info_cat,
+	.num_cat = ARRAY_SIZE(test_log_info_cat),
+};
+
+void *sched_test_init(const char *name)
+{
+	void *ctx = talloc_named_const(NULL, 1, name);
+
+	msgb_talloc_ctx_init(ctx, 0);
+	osmo_init_logging2(ctx, &test_log_info);
+	l1sched_logging_init(DSCH, DSCHD);
+
+	return ctx;
+}
+
+uint32_t test_rand(uint32_t *state)
+{
+	*state = *state * 1103515245 + 12345;
+	return *state >> 16;
+}
+
+void enqueue_data_req(struct l1sched_state *sched)
+{
+	struct l1sched_prim *prim;
+	struct msgb *msg;
+
+	msg = l1sched_prim_pool_alloc(sched, L1SCHED_PRIM_T_DATA, PRIM_OP_REQUEST);
+	OSMO_ASSERT(msg != NULL);
+
+	prim = l1sched_prim_from_msgb(msg);
+	prim->data_req = (struct l1sched_prim_chdr) {
+		.chan_nr = RSL_CHAN_SDCCH4_ACCH,
+		.link_id = L1SCHED_CH_LID_DEDIC,
+	};
+
+	/* I-frame on SAPI0 */
+	memset(msgb_put(msg, GSM_MACBLOCK_LEN), 0x2b, GSM_MACBLOCK_LEN);
+	msgb_l2(msg)[0] = 0x03;
+
+	OSMO_ASSERT(l1sched_prim_from_user(sched, msg) == 0);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+/* Helpers shared by the l1sched tests (tests/sched_*) */
+
+#include <stdint.h>
+
+struct l1sched_state;
+
+/* Allocate the root talloc context of a test, and set up msgb allocation
+ * and logging (only fatal messages of the scheduler are printed) */
+void *sched_test_init(const char *name);
+
+/* Simple deterministic PRNG (LCG), so that all runs get the same input */
+uint32_t test_rand(uint32_t *state);
+
+/* Queue a DATA.req (an I-frame on SAPI0) for SDCCH/4(0), allocated from
+ * the primitive pool of the scheduler (if any) */
+void enqueue_data_req(struct l1sched_state *sched);
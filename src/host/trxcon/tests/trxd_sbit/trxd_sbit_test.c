@@ -0,0 +1,123 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * TRXD soft-bit conversion test: all kernels supported by the CPU must be
+ * bit-exact with the reference (scalar) implementation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+
+#include <osmocom/bb/trxcon/trxd_sbit.h>
+
+/* Large enough for a few 8-PSK bursts, plus room for misalignment */
+#define BUF_LEN		(444 * 2 + 64)
+
+static const char * const kernels[] = {
+	"generic", "sse2", "avx2", "neon",
+};
+
+/* Reference implementation (formerly used by trx_if.c) */
+static void ubit2sbit_ref(uint8_t *buf, unsigned int len)
+{
+	sbit_t *burst = (sbit_t *)buf;
+
+	for (unsigned int i = 0; i < len; i++) {
+		if (buf[i] == 255)
+			burst[i] = -127;
+		else
+			burst[i] = 127 - buf[i];
+	}
+}
+
+static void fill_buf(uint8_t *buf, unsigned int len, unsigned int seed)
+{
+	uint32_t state = seed;
+
+	for (unsigned int i = 0; i < len; i++) {
+		state = state * 1103515245 + 12345;
+		buf[i] = state >> 16;
+	}
+}
+
+/* Check all possible ubit values, the boundary 255 in particular */
+static unsigned int test_all_values(void)
+{
+	uint8_t in[256], ref[256];
+	sbit_t out[256];
+	unsigned int i;
+
+	for (i = 0; i < 256; i++)
+		in[i] = ref[i] = i;
+	ubit2sbit_ref(&ref[0], sizeof(ref));
+
+	trxd_ubit2sbit(&out[0], &in[0], sizeof(in));
+	return memcmp(&out[0], &ref[0], sizeof(ref)) != 0;
+}
+
+/* Check all lengths and misalignments, both out-of-place and in-place */
+static unsigned int test_len_align(void)
+{
+	uint8_t in[BUF_LEN], ref[BUF_LEN];
+	sbit_t out[BUF_LEN];
+	unsigned int len, off, errors = 0;
+
+	for (len = 0; len <= 444 * 2; len++) {
+		for (off = 0; off < 32; off += 7) {
+			fill_buf(&in[0], sizeof(in), len * 32 + off);
+			memcpy(&ref[0], &in[0], sizeof(in));
+			ubit2sbit_ref(&ref[off], len);
+
+			memset(&out[0], 0x55, sizeof(out));
+			trxd_ubit2sbit(&out[off], &in[off], len);
+			if (memcmp(&out[off], &ref[off], len) != 0)
+				errors++;
+			/* Must not write beyond the given length */
+			if (off + len < sizeof(out) && out[off + len] != 0x55)
+				errors++;
+
+			trxd_ubit2sbit((sbit_t *)&in[off], &in[off], len);
+			if (memcmp(&in[0], &ref[0], sizeof(in)) != 0)
+				errors++;
+		}
+	}
+
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(kernels); i++) {
+		if (trxd_ubit2sbit_select(kernels[i]) != 0)
+			continue; /* not supported by the CPU */
+		if (test_all_values() != 0)
+			printf("Kernel '%s': mismatch for some ubit values\n", kernels[i]);
+		if (test_len_align() != 0)
+			printf("Kernel '%s': mismatch for some length/alignment\n", kernels[i]);
+	}
+
+	/* The generic kernel must always be available */
+	printf("Generic kernel: %s\n",
+	       trxd_ubit2sbit_select("generic") == 0 ? "supported" : "NOT supported");
+	printf("Unknown kernel: %s\n",
+	       trxd_ubit2sbit_select("foobar") == 0 ? "supported" : "NOT supported");
+
+	return 0;
+}
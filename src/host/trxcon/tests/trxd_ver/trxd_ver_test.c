@@ -0,0 +1,693 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * TRXD PDU version test: TRXDv0, TRXDv1 and TRXDv2 (batched) PDUs
+ * exchanged with a loopback fake transceiver must result in identical
+ * burst indications (the scheduler's input) and Uplink bursts.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <sys/socket.h>
+
+#include <osmocom/core/fsm.h>
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/socket.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+
+#include <osmocom/gsm/gsm_utils.h>
+
+#include <osmocom/bb/trxcon/phyif.h>
+#include <osmocom/bb/trxcon/trx_if.h>
+#include <osmocom/bb/trxcon/logging.h>
+
+#define TEST_HOST		"127.0.0.1"
+#define TEST_BASE_PORT		6900
+
+/* Downlink bursts are sent for FRAMES_NUM frames, all 8 timeslots */
+#define FRAMES_NUM		4
+#define FRAMES_START		(GSM_TDMA_HYPERFRAME - 2) /* check FN wrapping */
+#define BURSTS_NUM		(FRAMES_NUM * 8)
+/* Timeslot using 8-PSK modulation (the others are GMSK) */
+#define TN_8PSK			5
+
+struct test_burst {
+	uint32_t fn;
+	uint8_t tn;
+	int8_t rssi;
+	int16_t toa256;
+	uint8_t pwr;
+	unsigned int burst_len;
+	sbit_t burst[GSM_NBITS_NB_8PSK_BURST];
+};
+
+/* What the trx_if passed up (Rx) and what the transceiver got (Tx) */
+struct test_result {
+	struct test_burst rx[BURSTS_NUM];
+	unsigned int rx_num;
+	unsigned int rts_num;
+	struct test_burst tx[BURSTS_NUM];
+	unsigned int tx_num;
+	unsigned int tx_pdus;
+	unsigned int tx_errors;
+};
+
+/* Fake transceiver state */
+static struct {
+	struct osmo_fd ctrl_ofd;
+	struct osmo_fd data_ofd;
+	/* Max TRXD PDU version the fake transceiver supports */
+	uint8_t ver_max;
+	/* TRXD PDU version agreed via SETFORMAT */
+	uint8_t ver;
+} fake_trx;
+
+static struct trx_instance *g_trx;
+static struct test_result *g_res;
+static void *tall_ctx;
+
+/* ------------------------------------------------------------------------ */
+/* Expected burst content                                                   */
+/* ------------------------------------------------------------------------ */
+
+static unsigned int dl_burst_len(uint8_t tn)
+{
+	return tn == TN_8PSK ? GSM_NBITS_NB_8PSK_BURST : GSM_NBITS_NB_GMSK_BURST;
+}
+
+/* Deterministic soft-bits {-127..127} for the given burst */
+static void dl_burst_gen(sbit_t *burst, uint32_t fn, uint8_t tn)
+{
+	uint32_t state = (fn << 3) | tn;
+
+	for (unsigned int i = 0; i < dl_burst_len(tn); i++) {
+		state = state * 1103515245 + 12345;
+		burst[i] = (int)((state >> 16) % 255) - 127;
+	}
+}
+
+static void ul_burst_gen(ubit_t *burst, uint32_t fn, uint8_t tn)
+{
+	for (unsigned int i = 0; i < GSM_NBITS_NB_GMSK_BURST; i++)
+		burst[i] = (fn ^ tn ^ i) & 0x01;
+}
+
+/* ------------------------------------------------------------------------ */
+/* PHYIF API (normally implemented by trxcon_shim.c)                        */
+/* ------------------------------------------------------------------------ */
+
+int trxcon_phyif_handle_burst_ind(void *priv, const struct trxcon_phyif_burst_ind *bi)
+{
+	struct test_burst *tb;
+
+	OSMO_ASSERT(g_res->rx_num < BURSTS_NUM);
+	OSMO_ASSERT(bi->burst_len <= sizeof(tb->burst));
+
+	tb = &g_res->rx[g_res->rx_num++];
+	*tb = (struct test_burst) {
+		.fn = bi->fn,
+		.tn = bi->tn,
+		.rssi = bi->rssi,
+		.toa256 = bi->toa256,
+		.burst_len = bi->burst_len,
+	};
+	memcpy(&tb->burst[0], bi->burst, bi->burst_len);
+
+	return 0;
+}
+
+int trxcon_phyif_handle_rts_ind(void *priv, const struct trxcon_phyif_rts_ind *rts)
+{
+	ubit_t burst[GSM_NBITS_NB_GMSK_BURST];
+	const struct trxcon_phyif_burst_req br = {
+		.fn = rts->fn,
+		.tn = rts->tn,
+		.pwr = rts->tn,
+		.burst = &burst[0],
+		.burst_len = sizeof(burst),
+	};
+
+	g_res->rts_num++;
+
+	ul_burst_gen(&burst[0], rts->fn, rts->tn);
+	return trx_if_handle_phyif_burst_req(g_trx, &br);
+}
+
+int trxcon_phyif_handle_rsp(void *priv, const struct trxcon_phyif_rsp *rsp)
+{
+	return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Fake transceiver                                                         */
+/* ------------------------------------------------------------------------ */
+
+static int fake_trx_ctrl_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	char buf[TRXC_BUF_SIZE], rsp[TRXC_BUF_SIZE + 16];
+	char *cmd, *args;
+	ssize_t len;
+
+	len = read(ofd->fd, buf, sizeof(buf) - 1);
+	OSMO_ASSERT(len > 4);
+	buf[len] = '\0';
+
+	OSMO_ASSERT(strncmp(buf, "CMD ", 4) == 0);
+	cmd = buf + 4;
+	args = strchr(cmd, ' ');
+	if (args != NULL)
+		*(args++) = '\0';
+
+	if (strcmp(cmd, "SETFORMAT") == 0) {
+		unsigned int ver_req = atoi(args);
+
+		/* Suggest the max supported version, or apply the requested one */
+		if (ver_req > fake_trx.ver_max) {
+			snprintf(rsp, sizeof(rsp), "RSP SETFORMAT %u %u",
+				 fake_trx.ver_max, ver_req);
+		} else {
+			snprintf(rsp, sizeof(rsp), "RSP SETFORMAT %u %u",
+				 ver_req, ver_req);
+			fake_trx.ver = ver_req;
+		}
+	} else {
+		snprintf(rsp, sizeof(rsp), "RSP %s 0%s%s",
+			 cmd, args ? " " : "", args ? args : "");
+	}
+
+	OSMO_ASSERT(send(ofd->fd, rsp, strlen(rsp) + 1, 0) > 0);
+	return 0;
+}
+
+/* Parse an Uplink TRXD PDU (of the agreed version) sent by the trx_if */
+static int fake_trx_data_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	uint8_t buf[TRXD_BUF_SIZE];
+	unsigned int offset = 0;
+	uint32_t fn = 0;
+	ssize_t len;
+
+	len = read(ofd->fd, buf, sizeof(buf));
+	OSMO_ASSERT(len > 0);
+	g_res->tx_pdus++;
+
+	if ((buf[0] >> 4) != fake_trx.ver) {
+		g_res->tx_errors++;
+		return 0;
+	}
+
+	while (offset < len) {
+		const uint8_t *hdr = &buf[offset];
+		struct test_burst *tb;
+		unsigned int hdr_len;
+		bool more = false;
+
+		OSMO_ASSERT(g_res->tx_num < BURSTS_NUM);
+		tb = &g_res->tx[g_res->tx_num++];
+
+		if (fake_trx.ver < 2) {
+			fn = osmo_load32be(&hdr[1]);
+			tb->pwr = hdr[5];
+			hdr_len = 6;
+		} else {
+			/* TRXDv2: FN is present in the first burst only */
+			hdr_len = 8;
+			if (offset == 0) {
+				fn = osmo_load32be(&hdr[8]);
+				hdr_len += 4;
+			}
+			more = !!(hdr[1] & 0x80);
+			tb->pwr = hdr[3];
+		}
+
+		tb->fn = fn;
+		tb->tn = hdr[0] & 0x07;
+		tb->burst_len = GSM_NBITS_NB_GMSK_BURST;
+		memcpy(&tb->burst[0], &hdr[hdr_len], tb->burst_len);
+		offset += hdr_len + tb->burst_len;
+
+		if (!more)
+			break;
+	}
+
+	if (offset != len)
+		g_res->tx_errors++;
+
+	return 0;
+}
+
+/* Encode a Downlink burst as a TRXD PDU of the agreed version,
+ * return the number of octets written to the given buffer. */
+static size_t fake_trx_encode_burst(uint8_t *buf, bool batched,
+				    uint32_t fn, uint8_t tn)
+{
+	sbit_t burst[GSM_NBITS_NB_8PSK_BURST];
+	const int8_t rssi = -60 - tn;
+	const int16_t toa256 = tn * 16 - 32;
+	size_t len = 0;
+
+	dl_burst_gen(&burst[0], fn, tn);
+
+	switch (fake_trx.ver) {
+	case 0:
+	case 1:
+		buf[len++] = (fake_trx.ver << 4) | tn;
+		osmo_store32be(fn, &buf[len]);
+		len += 4;
+		buf[len++] = -rssi;
+		osmo_store16be(toa256, &buf[len]);
+		len += 2;
+		if (fake_trx.ver == 1) {
+			/* MTS: GMSK (0b00SS) or 8-PSK (0b010S), TSC=7 */
+			buf[len++] = (tn == TN_8PSK ? 0x04 << 3 : 0x00) | 0x07;
+			osmo_store16be(100, &buf[len]); /* C/I in cB */
+			len += 2;
+		}
+		break;
+	case 2:
+		buf[len++] = batched ? tn : (fake_trx.ver << 4) | tn;
+		buf[len++] = 0x00; /* BATCH is set by the caller */
+		buf[len++] = (tn == TN_8PSK ? 0x04 << 3 : 0x00) | 0x07;
+		buf[len++] = -rssi;
+		osmo_store16be(toa256, &buf[len]);
+		len += 2;
+		osmo_store16be(100, &buf[len]); /* C/I in cB */
+		len += 2;
+		if (!batched) {
+			osmo_store32be(fn, &buf[len]);
+			len += 4;
+		}
+		break;
+	default:
+		OSMO_ASSERT(0);
+	}
+
+	/* Convert soft-bits {-127..127} to unsigned soft-bits {254..0} */
+	for (unsigned int i = 0; i < dl_burst_len(tn); i++)
+		buf[len++] = 127 - burst[i];
+
+	return len;
+}
+
+static void fake_trx_send_frame(uint32_t fn)
+{
+	uint8_t buf[TRXD_BUF_SIZE];
+	size_t len = 0, last_hdr = 0;
+	uint8_t tn;
+
+	for (tn = 0; tn < 8; tn++) {
+		if (fake_trx.ver < 2) {
+			/* TRXDv0 and TRXDv1: one burst per PDU */
+			len = fake_trx_encode_burst(&buf[0], false, fn, tn);
+			OSMO_ASSERT(send(fake_trx.data_ofd.fd, buf, len, 0) == len);
+			continue;
+		}
+
+		/* TRXDv2: all timeslots of a frame in a single PDU */
+		if (tn > 0) {
+			buf[last_hdr + 1] |= 0x80; /* BATCH */
+			last_hdr = len;
+		}
+		len += fake_trx_encode_burst(&buf[len], tn > 0, fn, tn);
+	}
+
+	if (fake_trx.ver >= 2)
+		OSMO_ASSERT(send(fake_trx.data_ofd.fd, buf, len, 0) == len);
+}
+
+static void fake_trx_open(void)
+{
+	int rc;
+
+	fake_trx.ctrl_ofd.cb = &fake_trx_ctrl_cb;
+	rc = osmo_sock_init2_ofd(&fake_trx.ctrl_ofd, AF_INET, SOCK_DGRAM, 0,
+				 TEST_HOST, TEST_BASE_PORT + 1,
+				 TEST_HOST, TEST_BASE_PORT + 101,
+				 OSMO_SOCK_F_BIND | OSMO_SOCK_F_CONNECT);
+	OSMO_ASSERT(rc >= 0);
+
+	fake_trx.data_ofd.cb = &fake_trx_data_cb;
+	rc = osmo_sock_init2_ofd(&fake_trx.data_ofd, AF_INET, SOCK_DGRAM, 0,
+				 TEST_HOST, TEST_BASE_PORT + 2,
+				 TEST_HOST, TEST_BASE_PORT + 102,
+				 OSMO_SOCK_F_BIND | OSMO_SOCK_F_CONNECT);
+	OSMO_ASSERT(rc >= 0);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Test cases                                                               */
+/* ------------------------------------------------------------------------ */
+
+static void test_parent_fsm_action(struct osmo_fsm_inst *fi, uint32_t event, void *data)
+{
+	/* Termination of the trx_if FSM is expected, nothing to do */
+}
+
+static struct osmo_fsm_state test_parent_fsm_states[] = {
+	{
+		.name = "ST_INIT",
+		.in_event_mask = (1 << 0),
+		.action = &test_parent_fsm_action,
+	},
+};
+
+static struct osmo_fsm test_parent_fsm = {
+	.name = "test_parent",
+	.states = test_parent_fsm_states,
+	.num_states = ARRAY_SIZE(test_parent_fsm_states),
+	.log_subsys = DAPP,
+};
+
+static bool test_burst_equal(const struct test_burst *a, const struct test_burst *b)
+{
+	if (a->fn != b->fn || a->tn != b->tn)
+		return false;
+	if (a->rssi != b->rssi || a->toa256 != b->toa256 || a->pwr != b->pwr)
+		return false;
+	if (a->burst_len != b->burst_len)
+		return false;
+	return memcmp(&a->burst[0], &b->burst[0], a->burst_len) == 0;
+}
+
+static bool test_result_equal(const struct test_burst *a, const struct test_burst *b,
+			      unsigned int num)
+{
+	for (unsigned int i = 0; i < num; i++) {
+		if (!test_burst_equal(&a[i], &b[i]))
+			return false;
+	}
+
+	return true;
+}
+
+/* Check the received bursts against what the fake transceiver has sent */
+static unsigned int test_check_rx(const struct test_result *res)
+{
+	unsigned int i, errors = 0;
+
+	for (i = 0; i < res->rx_num; i++) {
+		const struct test_burst *tb = &res->rx[i];
+		uint32_t fn = GSM_TDMA_FN_SUM(FRAMES_START, i / 8);
+		sbit_t burst[GSM_NBITS_NB_8PSK_BURST];
+		uint8_t tn = i % 8;
+
+		dl_burst_gen(&burst[0], fn, tn);
+		if (tb->fn != fn || tb->tn != tn ||
+		    tb->rssi != -60 - tn || tb->toa256 != tn * 16 - 32 ||
+		    tb->burst_len != dl_burst_len(tn) ||
+		    memcmp(&tb->burst[0], &burst[0], tb->burst_len) != 0)
+			errors++;
+	}
+
+	return errors;
+}
+
+/* Check the Uplink bursts against what the RTS handler has generated */
+static unsigned int test_check_tx(const struct test_result *res)
+{
+	unsigned int i, errors = 0;
+
+	for (i = 0; i < res->tx_num; i++) {
+		const struct test_burst *tb = &res->tx[i];
+		uint32_t fn = GSM_TDMA_FN_SUM(FRAMES_START, i / 8 + g_trx->fn_advance);
+		ubit_t burst[GSM_NBITS_NB_GMSK_BURST];
+		uint8_t tn = i % 8;
+
+		ul_burst_gen(&burst[0], fn, tn);
+		if (tb->fn != fn || tb->tn != tn || tb->pwr != tn ||
+		    memcmp(&tb->burst[0], &burst[0], sizeof(burst)) != 0)
+			errors++;
+	}
+
+	return errors;
+}
+
+static struct osmo_fsm_inst *test_trx_open(uint8_t ver_req, unsigned int rx_batch_max)
+{
+	struct trx_if_params params = {
+		.local_host = TEST_HOST,
+		.remote_host = TEST_HOST,
+		.base_port = TEST_BASE_PORT,
+		.fn_advance = 2,
+		.trxd_ver = ver_req,
+		.rx_batch_max = rx_batch_max,
+		.tx_batch = true,
+		.parent_fi = osmo_fsm_inst_alloc(&test_parent_fsm, tall_ctx, NULL, LOGL_DEBUG, NULL),
+		.parent_term_event = 0,
+	};
+
+	OSMO_ASSERT(params.parent_fi != NULL);
+	g_trx = trx_if_open(&params);
+	OSMO_ASSERT(g_trx != NULL);
+
+	return params.parent_fi;
+}
+
+static void test_trx_close(struct osmo_fsm_inst *parent_fi)
+{
+	trx_if_close(g_trx);
+	osmo_fsm_inst_free(parent_fi);
+	g_trx = NULL;
+}
+
+/* POWEROFF, ECHO and (optionally) SETFORMAT negotiation */
+static void test_trx_reset(void)
+{
+	const struct trxcon_phyif_cmd cmd = { .type = TRXCON_PHYIF_CMDT_RESET };
+
+	OSMO_ASSERT(trx_if_handle_phyif_cmd(g_trx, &cmd) == 0);
+	while (!llist_empty(&g_trx->trx_ctrl_list))
+		osmo_select_main(0);
+
+	printf("Negotiated TRXD PDU version: %u (transceiver: %u)\n",
+	       g_trx->trxd_ver, fake_trx.ver);
+}
+
+static void test_trxd_ver(struct test_result *res, uint8_t ver_req, uint8_t ver_max)
+{
+	struct osmo_fsm_inst *parent_fi;
+	unsigned int i;
+
+	printf("=== %s(): requesting TRXDv%u, transceiver supports up to TRXDv%u\n",
+	       __func__, ver_req, ver_max);
+
+	memset(res, 0, sizeof(*res));
+	fake_trx.ver_max = ver_max;
+	fake_trx.ver = 0;
+	g_res = res;
+
+	parent_fi = test_trx_open(ver_req, 0);
+	test_trx_reset();
+
+	for (i = 0; i < FRAMES_NUM; i++)
+		fake_trx_send_frame(GSM_TDMA_FN_SUM(FRAMES_START, i));
+	while (res->rx_num < BURSTS_NUM || res->tx_num < BURSTS_NUM)
+		osmo_select_main(0);
+
+	printf("Rx: %u bursts (%u RTS), %u unexpected\n",
+	       res->rx_num, res->rts_num, test_check_rx(res));
+	printf("Tx: %u bursts in %u PDUs, %u unexpected, %u malformed\n",
+	       res->tx_num, res->tx_pdus, test_check_tx(res), res->tx_errors);
+
+	test_trx_close(parent_fi);
+}
+
+/* A reset negotiates the version from scratch: the transceiver, restarted
+ * in the meantime, now supports the version which was refused before */
+static void test_trxd_ver_reset(void)
+{
+	struct osmo_fsm_inst *parent_fi;
+	static struct test_result res;
+
+	printf("=== %s()\n", __func__);
+
+	memset(&res, 0, sizeof(res));
+	fake_trx.ver_max = 1;
+	fake_trx.ver = 0;
+	g_res = &res;
+
+	parent_fi = test_trx_open(2, 0);
+	test_trx_reset();
+
+	fake_trx.ver_max = 2;
+	fake_trx.ver = 0;
+	test_trx_reset();
+
+	test_trx_close(parent_fi);
+}
+
+/* Build a TRXDv1/v2 NOPE / IDLE indication PDU, return its length */
+static size_t trxd_nope_pdu(uint8_t *buf, uint8_t ver, uint32_t fn, uint8_t tn)
+{
+	size_t len = 0;
+
+	buf[len++] = (ver << 4) | tn;
+	if (ver == 1) {
+		osmo_store32be(fn, &buf[len]);
+		len += 4;
+		buf[len++] = 110; /* RSSI */
+		osmo_store16be(0, &buf[len]); /* ToA256 */
+		len += 2;
+		buf[len++] = 0x80; /* MTS: NOPE */
+		osmo_store16be(0, &buf[len]); /* C/I */
+		len += 2;
+	} else {
+		buf[len++] = 0x00; /* TRXN, no BATCH */
+		buf[len++] = 0x80; /* MTS: NOPE */
+		buf[len++] = 110; /* RSSI */
+		osmo_store16be(0, &buf[len]); /* ToA256 */
+		len += 2;
+		osmo_store16be(0, &buf[len]); /* C/I */
+		len += 2;
+		osmo_store32be(fn, &buf[len]);
+		len += 4;
+	}
+
+	return len;
+}
+
+/* NOPE / IDLE indications (no burst bits) are passed up with burst_len 0 */
+static void test_trxd_nope(uint8_t ver)
+{
+	struct osmo_fsm_inst *parent_fi;
+	static struct test_result res;
+	const uint32_t fn = 100;
+	const uint8_t tn = 3;
+	uint8_t buf[16];
+	size_t len;
+
+	printf("=== %s(): TRXDv%u\n", __func__, ver);
+
+	memset(&res, 0, sizeof(res));
+	fake_trx.ver_max = ver;
+	fake_trx.ver = 0;
+	g_res = &res;
+
+	parent_fi = test_trx_open(ver, 0);
+	test_trx_reset();
+
+	len = trxd_nope_pdu(&buf[0], ver, fn, tn);
+	OSMO_ASSERT(send(fake_trx.data_ofd.fd, buf, len, 0) == len);
+	while (res.rx_num < 1 || res.tx_num < 1)
+		osmo_select_main(0);
+
+	printf("Rx: %u bursts (%u RTS): fn=%u tn=%u rssi=%d burst_len=%u\n",
+	       res.rx_num, res.rts_num, res.rx[0].fn, res.rx[0].tn,
+	       res.rx[0].rssi, res.rx[0].burst_len);
+
+	test_trx_close(parent_fi);
+}
+
+/* PDUs queued before a wakeup are received in one batch and accounted
+ * in the 'pdus_per_wakeup' histogram exported by trx_if_stats_dump() */
+static void test_trxd_rx_batch_stats(void)
+{
+	struct osmo_fsm_inst *parent_fi;
+	static struct test_result res;
+	uint8_t buf[16];
+	unsigned int i;
+	size_t len;
+	char *dump;
+
+	printf("=== %s()\n", __func__);
+
+	memset(&res, 0, sizeof(res));
+	fake_trx.ver_max = 1;
+	fake_trx.ver = 0;
+	g_res = &res;
+
+	parent_fi = test_trx_open(1, 4);
+	trx_if_stats_register(g_trx, 0);
+	test_trx_reset();
+
+	for (i = 0; i < 3; i++) {
+		len = trxd_nope_pdu(&buf[0], 1, 100, i);
+		OSMO_ASSERT(send(fake_trx.data_ofd.fd, buf, len, 0) == len);
+	}
+	while (res.rx_num < 3)
+		osmo_select_main(0);
+
+	dump = trx_if_stats_dump(tall_ctx, "test");
+	OSMO_ASSERT(dump != NULL);
+	printf("%s", dump);
+	talloc_free(dump);
+
+	/* Closing unregisters the instance */
+	test_trx_close(parent_fi);
+	dump = trx_if_stats_dump(tall_ctx, "test");
+	printf("%s", dump);
+	talloc_free(dump);
+}
+
+static const struct log_info_cat test_log_info_cat[] = {
+	[DAPP] = {
+		.name = "DAPP",
+		.enabled = 1, .loglevel = LOGL_DEBUG,
+	},
+	[DTRXC] = {
+		.name = "DTRXC",
+		.enabled = 1, .loglevel = LOGL_DEBUG,
+	},
+	[DTRXD] = {
+		.name = "DTRXD",
+		.enabled = 1, .loglevel = LOGL_DEBUG,
+	},
+};
+
+static const struct log_info test_log_info = {
+	.cat = test_log_info_cat,
+	.num_cat = ARRAY_SIZE(test_log_info_cat),
+};
+
+int main(int argc, char **argv)
+{
+	static struct test_result res[4];
+
+	tall_ctx = talloc_named_const(NULL, 1, __FILE__);
+	osmo_init_logging2(tall_ctx, &test_log_info);
+
+	OSMO_ASSERT(osmo_fsm_register(&test_parent_fsm) == 0);
+
+	/* Do not hang forever if something goes wrong */
+	alarm(10);
+
+	fake_trx_open();
+
+	test_trxd_ver(&res[0], 0, TRXD_VER_MAX);
+	test_trxd_ver(&res[1], 1, TRXD_VER_MAX);
+	test_trxd_ver(&res[2], 2, TRXD_VER_MAX);
+	/* The transceiver suggests an older version */
+	test_trxd_ver(&res[3], 2, 1);
+
+	test_trxd_ver_reset();
+	test_trxd_nope(1);
+	test_trxd_nope(2);
+	test_trxd_rx_batch_stats();
+
+	for (unsigned int i = 1; i < ARRAY_SIZE(res); i++) {
+		printf("Case %u vs TRXDv0: Rx %s, Tx %s\n", i,
+		       test_result_equal(res[0].rx, res[i].rx, BURSTS_NUM) ? "identical" : "DIFFERENT",
+		       test_result_equal(res[0].tx, res[i].tx, BURSTS_NUM) ? "identical" : "DIFFERENT");
+	}
+
+	return 0;
+}
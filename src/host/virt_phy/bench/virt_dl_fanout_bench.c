@@ -0,0 +1,184 @@
+/* Benchmark of the Downlink dispatch of a virtphy serving thousands of MS:
+ * GSMTAP Downlink messages are passed to gsmtapl1_rx_from_virt_um_inst_cb()
+ * (as virt_um_fd_cb() does), which forwards them as L1CTL DATA.ind to the
+ * subscribed MS.  The time spent per TDMA frame is compared to the duration
+ * of a frame (120ms / 26), which is what a single core has to keep up with.
+ *
+ * The L1CTL clients write to /dev/null: the cost of the write() system call
+ * is included, the one of the l23 reading it is not.  Each cell transmits a
+ * CCCH block on every frame, which is about four times the actual Downlink
+ * load of TS0 (a block spans four frames), so the numbers are pessimistic.
+ * Each MS is allocated as virtphy does it, including the timing wheel of
+ * its TDMA scheduler, whose size is printed along with the results.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <talloc.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/gsmtap.h>
+#include <osmocom/core/gsmtap_util.h>
+#include <osmocom/gsm/gsm_utils.h>
+
+#include <osmocom/bb/virtphy/l1ctl_sock.h>
+#include <osmocom/bb/virtphy/virt_l1_model.h>
+#include <osmocom/bb/virtphy/virt_l1_sched.h>
+#include <osmocom/bb/virtphy/gsmtapl1_if.h>
+#include <osmocom/bb/virtphy/logging.h>
+
+/* The target: that many MS served by a single core */
+#define NUM_MS_DEF		5000
+/* Number of TDMA frames to run per benchmark */
+#define NUM_FRAMES_DEF		2000
+/* Duration of a TDMA frame in ns */
+#define FRAME_NS		(120e6 / 26)
+#define BENCH_ARFCN		871
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Allocate num_ms MS camping on num_cells cells (round-robin) */
+static struct l1_model_ms **bench_ms_alloc(void *ctx, int fd, unsigned int num_ms,
+					   unsigned int num_cells)
+{
+	struct l1_model_ms **ms = talloc_zero_array(ctx, struct l1_model_ms *, num_ms);
+	unsigned int i;
+
+	OSMO_ASSERT(ms != NULL);
+	for (i = 0; i < num_ms; i++) {
+		struct l1ctl_sock_client *lsc = talloc_zero(ctx, struct l1ctl_sock_client);
+
+		OSMO_ASSERT(lsc != NULL);
+		lsc->ofd.fd = fd;
+		ms[i] = l1_model_ms_init(ctx, lsc, NULL);
+		OSMO_ASSERT(ms[i] != NULL);
+		lsc->priv = ms[i];
+
+		ms[i]->state.state = MS_STATE_IDLE_CAMPING;
+		ms[i]->state.serving_cell.arfcn = BENCH_ARFCN + i % num_cells;
+		gsmtapl1_dl_subscr_update(ms[i]);
+	}
+
+	return ms;
+}
+
+static void bench_ms_free(struct l1_model_ms **ms, unsigned int num_ms)
+{
+	unsigned int i;
+
+	for (i = 0; i < num_ms; i++) {
+		struct l1ctl_sock_client *lsc = ms[i]->lsc;
+
+		l1_model_ms_destroy(ms[i]);
+		talloc_free(lsc);
+	}
+	talloc_free(ms);
+}
+
+/* Each frame, every cell sends a CCCH block on TS0 */
+static void bench_run(void *ctx, int fd, const char *name, unsigned int num_ms,
+		      unsigned int num_cells, unsigned int num_frames)
+{
+	const uint8_t data[GSM_MACBLOCK_LEN] = { 0x01, 0x03, 0x01 };
+	struct l1_model_ms **ms = bench_ms_alloc(ctx, fd, num_ms, num_cells);
+	uint64_t ns = 0, ns_max = 0, t0, t;
+	unsigned long num_msgs = 0;
+	unsigned int fn, c;
+
+	for (fn = 0; fn < num_frames; fn++) {
+		struct msgb *msgs[num_cells];
+
+		/* only the dispatch is measured, not the composition of the GSMTAP messages */
+		for (c = 0; c < num_cells; c++) {
+			msgs[c] = gsmtap_makemsg(BENCH_ARFCN + c, 0, GSMTAP_CHANNEL_PCH, 0,
+						 fn, -60, 0, data, sizeof(data));
+			OSMO_ASSERT(msgs[c] != NULL);
+			msgs[c]->l1h = msgb_data(msgs[c]);
+		}
+
+		t0 = now_ns();
+		for (c = 0; c < num_cells; c++)
+			gsmtapl1_rx_from_virt_um_inst_cb(NULL, msgs[c]);
+		t = now_ns() - t0;
+
+		for (c = 0; c < num_cells; c++)
+			msgb_free(msgs[c]);
+
+		ns += t;
+		if (t > ns_max)
+			ns_max = t;
+		num_msgs += num_cells;
+	}
+
+	printf("%s: %u MS on %u cells, %lu GSMTAP msgs: %.1f ns per DATA.ind, "
+	       "%.0f us per frame (%.1f%% of a frame), %.0f us max (%.1f%%)\n",
+	       name, num_ms, num_cells, num_msgs,
+	       (double)ns / ((double)num_frames * num_ms),
+	       ns / 1e3 / num_frames, 100.0 * ns / num_frames / FRAME_NS,
+	       ns_max / 1e3, 100.0 * ns_max / FRAME_NS);
+
+	bench_ms_free(ms, num_ms);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int num_ms = NUM_MS_DEF;
+	unsigned int num_frames = NUM_FRAMES_DEF;
+	void *ctx;
+	int fd;
+
+	if (argc > 1)
+		num_ms = atoi(argv[1]);
+	if (argc > 2)
+		num_frames = atoi(argv[2]);
+
+	ctx = talloc_named_const(NULL, 0, "virt_dl_fanout_bench");
+	/* no logging per MS (allocation, ...) in the measurements */
+	ms_log_init(ctx, "DL1C,8:DL1P,8:DVIRPHY,8:DMAIN,8");
+	gsmtapl1_init();
+
+	printf("%zu bytes per MS (%zu of which the TDMA scheduler, %u wheel slots), "
+	       "%.1f MiB for %u MS\n", sizeof(struct l1_model_ms),
+	       sizeof(((struct l1_model_ms *)NULL)->state.sched), VIRT_L1_SCHED_WHEEL_SIZE,
+	       (double)sizeof(struct l1_model_ms) * num_ms / (1 << 20), num_ms);
+
+	fd = open("/dev/null", O_WRONLY);
+	if (fd < 0) {
+		perror("open(/dev/null)");
+		return EXIT_FAILURE;
+	}
+
+	/* All the MS camping on the same cell: each message visits all of them */
+	bench_run(ctx, fd, "one-cell", num_ms, 1, num_frames);
+	/* The MS spread over 16 cells: each message visits 1/16 of them */
+	bench_run(ctx, fd, "16-cells", num_ms, 16, num_frames);
+
+	close(fd);
+	talloc_free(ctx);
+	return 0;
+}
@@ -0,0 +1,128 @@
+/* Benchmark of the virtual layer 1 TDMA scheduler (virt_l1_sched_*()):
+ * thousands of items are scheduled ahead, the scheduler is then run
+ * frame by frame, as done by gsmtapl1_if.c on every Downlink message.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <talloc.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/gsm_utils.h>
+
+#include <osmocom/bb/virtphy/virt_l1_model.h>
+#include <osmocom/bb/virtphy/virt_l1_sched.h>
+
+/* Number of TDMA frames to run per benchmark */
+#define NUM_FRAMES_DEF		100000
+/* Uplink blocks are scheduled at most that many frames ahead (see sched_fn_ul()) */
+#define MAX_AHEAD		(2 * 51 + 42 + 15)
+
+static uint32_t exec_fn;
+static unsigned long num_exec;
+
+static void bench_cb(struct l1_model_ms *ms, uint32_t fn, uint8_t tn, struct msgb *msg)
+{
+	/* Each item shall be executed in its very frame */
+	OSMO_ASSERT(fn % GSM_TDMA_HYPERFRAME == exec_fn);
+	num_exec++;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Schedule items_per_frame items per frame, up to max_ahead frames ahead,
+ * starting shortly before the hyperframe wraps around */
+static void bench_run(void *ctx, const char *name, unsigned int num_frames,
+		      unsigned int items_per_frame, unsigned int max_ahead)
+{
+	struct l1_model_ms *ms = talloc_zero(ctx, struct l1_model_ms);
+	uint64_t ns_sched = 0, ns_exec = 0, t0;
+	unsigned long num_sched = 0;
+	unsigned int max_pending = 0;
+	uint32_t fn = GSM_TDMA_HYPERFRAME - num_frames / 2;
+	unsigned int i, j;
+
+	OSMO_ASSERT(ms != NULL);
+	virt_l1_sched_init(ms);
+	ms->state.sched.last_exec_fn = fn;
+	num_exec = 0;
+
+	for (i = 0; i < num_frames + max_ahead; i++) {
+		exec_fn = fn;
+		t0 = now_ns();
+		virt_l1_sched_execute(ms, fn);
+		ns_exec += now_ns() - t0;
+
+		if (i < num_frames) {
+			t0 = now_ns();
+			for (j = 0; j < items_per_frame; j++) {
+				/* as sched_fn_ul(), not wrapped around the hyperframe */
+				const uint32_t sched_fn = fn + 1 + rand() % max_ahead;
+
+				virt_l1_sched_schedule(ms, NULL, sched_fn, j % 8, &bench_cb);
+			}
+			ns_sched += now_ns() - t0;
+			num_sched += items_per_frame;
+		}
+
+		if (ms->state.sched.num_pending > max_pending)
+			max_pending = ms->state.sched.num_pending;
+		fn = (fn + 1) % GSM_TDMA_HYPERFRAME;
+	}
+
+	OSMO_ASSERT(num_exec == num_sched);
+	OSMO_ASSERT(ms->state.sched.num_pending == 0);
+
+	printf("%s: %lu items (up to %u pending, %u pooled): "
+	       "schedule %.1f ns/item, execute %.1f ns/item, %.1f ns/frame\n",
+	       name, num_sched, max_pending, ms->state.sched.num_allocated,
+	       (double)ns_sched / num_sched, (double)ns_exec / num_exec,
+	       (double)ns_exec / (num_frames + max_ahead));
+
+	virt_l1_sched_stop(ms);
+	talloc_free(ms);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int num_frames = NUM_FRAMES_DEF;
+	void *ctx;
+
+	if (argc > 1)
+		num_frames = atoi(argv[1]);
+
+	ctx = talloc_named_const(NULL, 0, "virt_l1_sched_bench");
+	srand(0x5c4ed);
+
+	/* A single MS in dedicated mode: about one block per frame */
+	bench_run(ctx, "sparse", num_frames, 1, MAX_AHEAD);
+	/* Thousands of items pending, all within the wheel */
+	bench_run(ctx, "dense", num_frames, 32, MAX_AHEAD);
+	/* Thousands of items pending, most of them beyond the wheel */
+	bench_run(ctx, "overflow", num_frames, 32, 4 * VIRT_L1_SCHED_WHEEL_SIZE);
+
+	talloc_free(ctx);
+	return 0;
+}
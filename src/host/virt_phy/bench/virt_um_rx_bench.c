@@ -0,0 +1,138 @@
+/* Benchmark of the virtual Um receive path (virt_um_fd_cb()): a stand-in
+ * BTS sends GSMTAP Downlink frames to a local multicast group, which are
+ * then read back in batches by the virtual Um instance of the MS side.
+ * Only the reception is measured, the sending is not.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <talloc.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/gsmtap.h>
+#include <osmocom/core/gsmtap_util.h>
+#include <osmocom/gsm/gsm_utils.h>
+
+#include <osmocom/bb/virtphy/osmo_mcast_sock.h>
+#include <osmocom/bb/virtphy/virtual_um.h>
+
+/* Not the default groups/port, so that a running virtphy is not disturbed */
+#define BENCH_DL_GROUP		"239.193.23.101"
+#define BENCH_UL_GROUP		"239.193.23.102"
+#define BENCH_PORT		14729
+/* Number of frames to queue in the socket before reading them */
+#define BENCH_CHUNK		128
+/* Number of frames to receive per benchmark */
+#define NUM_FRAMES_DEF		200000
+
+static unsigned long num_rx;
+
+static void bench_rx_cb(struct virt_um_inst *vui, struct msgb *msg)
+{
+	num_rx++;
+}
+
+static void bench_bts_rx_cb(struct virt_um_inst *vui, struct msgb *msg)
+{
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Send num_frames CCCH blocks of the given length, read them back by chunks */
+static void bench_run(struct virt_um_inst *bts, struct virt_um_inst *ms,
+		      const char *name, unsigned int num_frames, unsigned int len)
+{
+	struct osmo_fd *ofd = &ms->mcast_sock->rx_ofd;
+	const unsigned long num_batches = ms->num_rx_batches;
+	uint8_t data[GSM_MACBLOCK_LEN] = { 0x01, 0x03, 0x01 };
+	unsigned long num_sent = 0;
+	uint64_t ns_rx = 0, t0;
+	unsigned int i, j;
+
+	num_rx = 0;
+
+	for (i = 0; i < num_frames; i += BENCH_CHUNK) {
+		unsigned long prev;
+
+		for (j = 0; j < BENCH_CHUNK; j++) {
+			struct msgb *msg;
+
+			msg = gsmtap_makemsg(871, 0, GSMTAP_CHANNEL_PCH, 0,
+					     (i + j) % GSM_TDMA_HYPERFRAME, -60, 0, data, len);
+			OSMO_ASSERT(msg != NULL);
+			if (virt_um_write_msg(bts, msg) >= 0)
+				num_sent++;
+		}
+
+		/* read until the socket is drained */
+		t0 = now_ns();
+		do {
+			prev = num_rx;
+			ofd->cb(ofd, OSMO_FD_READ);
+		} while (num_rx != prev);
+		ns_rx += now_ns() - t0;
+	}
+
+	printf("%s: %lu of %lu frames received, %.1f frames per read: "
+	       "%.1f ns/frame, %.0f frames/s\n",
+	       name, num_rx, num_sent,
+	       ms->num_rx_batches > num_batches ?
+			(double)num_rx / (ms->num_rx_batches - num_batches) : 0.0,
+	       num_rx ? (double)ns_rx / num_rx : 0.0,
+	       ns_rx ? num_rx * 1e9 / ns_rx : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int num_frames = NUM_FRAMES_DEF;
+	struct virt_um_inst *bts, *ms;
+	void *ctx;
+
+	if (argc > 1)
+		num_frames = atoi(argv[1]);
+
+	ctx = talloc_named_const(NULL, 0, "virt_um_rx_bench");
+
+	/* The stand-in BTS transmits on the Downlink group, the MS listens to it */
+	bts = virt_um_init(ctx, BENCH_DL_GROUP, BENCH_PORT, BENCH_UL_GROUP, BENCH_PORT,
+			   0, NULL, bench_bts_rx_cb);
+	ms = virt_um_init(ctx, BENCH_UL_GROUP, BENCH_PORT, BENCH_DL_GROUP, BENCH_PORT,
+			  0, NULL, bench_rx_cb);
+	if (!bts || !ms) {
+		fprintf(stderr, "Failed to set up the multicast sockets\n");
+		return EXIT_FAILURE;
+	}
+
+	/* GSMTAP header only, the smallest possible datagrams */
+	bench_run(bts, ms, "header", num_frames, 0);
+	/* Full MAC blocks (BCCH, CCCH, SDCCH, SACCH) */
+	bench_run(bts, ms, "macblock", num_frames, GSM_MACBLOCK_LEN);
+
+	virt_um_destroy(ms);
+	virt_um_destroy(bts);
+	talloc_free(ctx);
+	return 0;
+}
@@ -7,7 +7,12 @@
 #include <osmocom/bb/virtphy/l1ctl_sock.h>
 #include <osmocom/bb/virtphy/virt_l1_model.h>
 
-void gsmtapl1_init(struct l1_model_ms *model);
+void gsmtapl1_init(void);
+void gsmtapl1_dl_subscr_init(struct l1_model_ms *ms);
+void gsmtapl1_dl_subscr_update(struct l1_model_ms *ms);
+void gsmtapl1_dl_subscr_del(struct l1_model_ms *ms);
+void gsmtapl1_dl_subscr_gprs(struct l1_model_ms *ms);
+void gsmtapl1_dl_stats_log(void);
 void gsmtapl1_rx_from_virt_um_inst_cb(struct virt_um_inst *vui,
                                       struct msgb *msg);
 void gsmtapl1_tx_to_virt_um_inst(struct l1_model_ms *ms, uint32_t fn, uint8_t tn, struct msgb *msg);
@@ -32,7 +32,14 @@ void l1ctl_sap_init(struct l1_model_ms *model);
 void l1ctl_sap_exit(struct l1_model_ms *model);
 void prim_pm_init(struct l1_model_ms *model);
 void prim_pm_exit(struct l1_model_ms *model);
+void prim_pm_set_timeout(uint32_t timeout_s, uint32_t timeout_us);
+void prim_pm_set_sig_lev_red(uint16_t arfcn, uint8_t red);
+int16_t prim_pm_set_sig_strength(uint16_t arfcn, int16_t sig_lev);
+int16_t prim_pm_get_sig_strength(uint16_t arfcn);
 void l1ctl_sap_tx_to_l23_inst(struct l1_model_ms *model, struct msgb *msg);
+void l1ctl_sap_tx_dl_to_l23_inst(struct l1_model_ms *model, uint8_t msg_type,
+				 const struct l1ctl_info_dl *dl, const uint8_t *data,
+				 size_t data_len, size_t min_len);
 void l1ctl_sap_rx_from_l23_inst_cb(struct l1ctl_sock_client *lsc, struct msgb *msg);
 void l1ctl_sap_handler(struct l1_model_ms *ms, struct msgb *msg);
 
@@ -59,22 +66,24 @@ void l1ctl_rx_traffic_req(struct l1_model_ms *ms, struct msgb *msg);
 void l1ctl_rx_sim_req(struct l1_model_ms *ms, struct msgb *msg);
 void l1ctl_rx_gprs_uldl_tbf_cfg_req(struct l1_model_ms *ms, struct msgb *msg);
 void l1ctl_rx_gprs_ul_block_req(struct l1_model_ms *ms, struct msgb *msg);
+void l1ctl_rx_echo_conf(struct l1_model_ms *ms, struct msgb *msg);
 
 /* transmit routines */
 void l1ctl_tx_reset(struct l1_model_ms *ms, uint8_t msg_type, uint8_t reset_type);
 void l1ctl_tx_rach_conf(struct l1_model_ms *ms, uint32_t fn, uint16_t arfcn);
 void l1ctl_tx_data_conf(struct l1_model_ms *ms, uint32_t fn, uint16_t snr, uint16_t arfcn);
-void l1ctl_tx_data_ind(struct l1_model_ms *ms, struct msgb *msg, uint16_t arfcn, uint8_t link_id,
+void l1ctl_tx_data_ind(struct l1_model_ms *ms, const struct msgb *msg, uint16_t arfcn, uint8_t link_id,
 		       uint8_t chan_nr, uint32_t fn, uint8_t snr,
 		       uint8_t rxlev, uint8_t num_biterr,
 		       uint8_t fire_crc);
 void l1ctl_tx_traffic_conf(struct l1_model_ms *ms, uint32_t fn, uint16_t snr, uint16_t arfcn);
-void l1ctl_tx_traffic_ind(struct l1_model_ms *ms, struct msgb *msg, uint16_t arfcn, uint8_t link_id,
+void l1ctl_tx_traffic_ind(struct l1_model_ms *ms, const struct msgb *msg, uint16_t arfcn, uint8_t link_id,
 			  uint8_t chan_nr, uint32_t fn, uint8_t snr,
 			  uint8_t rxlev, uint8_t num_biterr,
 			  uint8_t fire_crc);
 void l1ctl_tx_pm_conf(struct l1_model_ms *ms, struct l1ctl_pm_req *pm_req);
 void l1ctl_tx_fbsb_conf(struct l1_model_ms *ms, uint8_t res, uint16_t arfcn);
+void l1ctl_tx_echo_req(struct l1_model_ms *ms, uint32_t fn);
 void l1ctl_tx_ccch_mode_conf(struct l1_model_ms *ms, uint8_t ccch_mode);
 void l1ctl_tx_tch_mode_conf(struct l1_model_ms *ms, uint8_t tch_mode, uint8_t audio_mode);
 void l1ctl_tx_gprs_dl_block_ind(struct l1_model_ms *ms, const struct msgb *msg,
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <sys/uio.h>
+
 #include <osmocom/core/msgb.h>
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/core/select.h>
@@ -47,6 +49,11 @@ struct l1ctl_sock_inst *l1ctl_sock_init(
  */
 int l1ctl_sock_write_msg(struct l1ctl_sock_client *lsc, struct msgb *msg);
 
+/**
+ * @brief Transmit a message scattered over several buffers to l2 (single writev()).
+ */
+int l1ctl_sock_write_iov(struct l1ctl_sock_client *lsc, const struct iovec *iov, int iovcnt);
+
 /**
  * @brief Destroy instance.
  */
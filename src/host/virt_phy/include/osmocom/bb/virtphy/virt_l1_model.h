@@ -2,11 +2,14 @@
 
 /* Per-MS specific state, closely attached to the L1CTL user progran */
 
+#include <stdbool.h>
+
 #include <osmocom/gsm/gsm_utils.h>
 #include <osmocom/core/timer.h>
 
 #include <osmocom/bb/virtphy/virtual_um.h>
 #include <osmocom/bb/virtphy/l1ctl_sock.h>
+#include <osmocom/bb/virtphy/virt_l1_sched.h>
 
 #define L1S_NUM_NEIGH_CELL	6
 #define A5_KEY_LEN		8
@@ -46,10 +49,7 @@ struct l1_state_ms {
 
 	struct gsm_time	downlink_time;	/* current GSM time received on downlink */
 	struct gsm_time current_time; /* GSM time used internally for scheduling */
-	struct {
-		uint32_t last_exec_fn;
-		struct llist_head mframe_items;
-	} sched;
+	struct virt_l1_sched sched;
 
 	enum ms_state state;
 
@@ -82,15 +82,8 @@ struct l1_state_ms {
 		uint32_t arfcn;
 	} fbsb;
 
-	/* power management state */
+	/* power management state (the signal levels are shared, see virt_prim_pm.c) */
 	struct {
-		uint32_t timeout_us;
-		uint32_t timeout_s;
-		struct {
-			int16_t arfcn_sig_lev_dbm[1024];
-			uint8_t arfcn_sig_lev_red_dbm[1024];
-			struct osmo_timer_list arfcn_sig_lev_timers[1024];
-		} meas;
 		struct {
 			uint16_t band_arfcn_from;
 			uint16_t band_arfcn_to;
@@ -100,6 +93,31 @@ struct l1_state_ms {
 	} pm;
 };
 
+/* classes of downlink channels an MS can subscribe to (see gsmtapl1_if.c) */
+enum l1_dl_class {
+	L1_DL_CLASS_CCCH,	/* BCCH, CCCH and CBCH (on any timeslot) */
+	L1_DL_CLASS_DEDIC,	/* SDCCH, TCH and their SACCH */
+	L1_DL_CLASS_PDCH,	/* PDTCH, PACCH and PTCCH */
+	_NUM_L1_DL_CLASS
+};
+
+/* subscription of an MS to the downlink messages of an (ARFCN, TN, class) */
+struct l1_dl_subscr {
+	/* entry in a bucket of the subscription table, or the 'any' list */
+	struct llist_head entry;
+	struct l1_model_ms *ms;
+	bool active;
+	uint16_t arfcn;
+	uint8_t tn;
+	uint8_t cls; /* enum l1_dl_class */
+};
+
+/* one subscription for CCCH, one for the dedicated channel, one per PDCH timeslot */
+#define L1_DL_SUBSCR_CCCH	0
+#define L1_DL_SUBSCR_DEDIC	1
+#define L1_DL_SUBSCR_PDCH(tn)	(2 + (tn))
+#define L1_DL_SUBSCR_NUM	(2 + 8)
+
 struct l1_model_ms {
 	uint32_t nr;
 	/* pointer to the L1CTL socket client associated with this specific MS */
@@ -108,6 +126,18 @@ struct l1_model_ms {
 	struct virt_um_inst *vui;
 	/* GPRS state (MAC layer) */
 	struct l1gprs_state *gprs;
+	/* downlink subscriptions (see gsmtapl1_dl_subscr_update()) */
+	struct l1_dl_subscr dl_subscr[L1_DL_SUBSCR_NUM];
+	/* per-frame barrier of the fake BTS (see virt_time.c) */
+	struct {
+		/* number of L1CTL messages sent to the MS */
+		unsigned long num_tx;
+		/* value of num_tx when the last L1CTL_ECHO_REQ was sent */
+		unsigned long num_tx_echo;
+		/* whether the L1CTL_ECHO_CONF for fn is still awaited */
+		bool pending;
+		uint32_t fn;
+	} barrier;
 	/* actual per-MS state */
 	struct l1_state_ms state;
 };
@@ -4,28 +4,44 @@
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/gsm/gsm_utils.h>
 
-#include <osmocom/bb/virtphy/virt_l1_model.h>
-#include <osmocom/bb/virtphy/virt_l1_sched.h>
-
 struct l1_model_ms;
 
 typedef void virt_l1_sched_cb(struct l1_model_ms *ms, uint32_t fn, uint8_t tn, struct msgb * msg);
 
-/* bucket containing items to be executed for a specific mframe number */
-struct virt_l1_sched_mframe_item {
-	struct llist_head mframe_item_entry;
-	struct llist_head tdma_item_list; /* list of tdma sched items */
-	uint32_t fn; /* frame number of execution */
-};
+/* Number of TDMA frames covered by the timing wheel (must be a power of 2).
+ * Uplink blocks are scheduled at most 2 * 51 + 42 + 15 frames ahead (see
+ * sched_fn_ul()), items scheduled any further go to the overflow list. */
+#define VIRT_L1_SCHED_WHEEL_SIZE	256
+/* Number of items added to the pool at once when it runs dry */
+#define VIRT_L1_SCHED_POOL_CHUNK	64
 
 /* item to be be executed for a specific tdma timeslot of a framenumber */
 struct virt_l1_sched_tdma_item {
 	struct llist_head tdma_item_entry;
 	struct msgb * msg; /* the msg to be handled */
+	uint32_t fn; /* frame number of execution */
 	uint8_t ts; /* tdma timeslot of execution */
 	virt_l1_sched_cb * handler_cb; /* handler callback */
 };
 
+/* TDMA scheduler state: a timing wheel with one slot per TDMA frame, each
+ * slot holding the items of that frame ordered by timeslot */
+struct virt_l1_sched {
+	/* frame number of the last execution, and its slot in the wheel */
+	uint32_t last_exec_fn;
+	unsigned int cur;
+	/* tdma sched items per frame, and the bitmap of non-empty slots */
+	struct llist_head wheel[VIRT_L1_SCHED_WHEEL_SIZE];
+	uint32_t wheel_map[VIRT_L1_SCHED_WHEEL_SIZE / 32];
+	/* tdma sched items beyond the span of the wheel (unordered) */
+	struct llist_head overflow;
+	/* pool of unused tdma sched items */
+	struct llist_head free_items;
+	unsigned int num_pending;
+	unsigned int num_allocated;
+};
+
+void virt_l1_sched_init(struct l1_model_ms *ms);
 int virt_l1_sched_restart(struct l1_model_ms *ms, struct gsm_time time);
 void virt_l1_sched_sync_time(struct l1_model_ms *ms, struct gsm_time time, uint8_t hard_reset);
 void virt_l1_sched_stop(struct l1_model_ms *ms);
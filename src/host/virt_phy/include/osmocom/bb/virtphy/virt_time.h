@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <osmocom/bb/virtphy/virtual_um.h>
+#include <osmocom/bb/virtphy/l1ctl_sock.h>
+
+/* Duration of a TDMA frame: 120ms / 26 (3GPP TS 45.010, section 5.2.1) */
+#define VIRT_TIME_FN_DURATION_NUM_NS	120000000ULL
+#define VIRT_TIME_FN_DURATION_DEN	26
+
+/* Maximum number of System Information messages cycled by the fake BTS */
+#define VIRT_TIME_FAKE_BTS_MAX_SI	16
+/* How long (wall clock) the fake BTS waits for an MS to answer its L1CTL_ECHO_REQ */
+#define VIRT_TIME_FAKE_BTS_BARRIER_TIMEOUT_MS	1000
+
+void virt_time_init(void);
+void virt_time_frame(uint32_t fn);
+int virt_time_fake_bts_init(void *ctx, struct virt_um_inst *vui, struct l1ctl_sock_inst *lsi,
+			    uint16_t arfcn, const char *si_path);
+void virt_time_fake_bts_run(void);
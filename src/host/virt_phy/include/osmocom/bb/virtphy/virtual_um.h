@@ -16,6 +16,8 @@
  *  ranges when defining scopes for private use." */
 
 #define VIRT_UM_MSGB_SIZE	256
+/* Maximum number of datagrams read at once (see virt_um_fd_cb()) */
+#define VIRT_UM_RX_BATCH	32
 #define DEFAULT_MS_MCAST_GROUP	"239.193.23.1"
 #define DEFAULT_MS_MCAST_PORT 4729 /* IANA-registered port for GSMTAP */
 #define DEFAULT_BTS_MCAST_GROUP	"239.193.23.2"
@@ -24,7 +26,14 @@
 struct virt_um_inst {
 	void *priv;
 	struct mcast_bidir_sock *mcast_sock;
+	/* called for each received message; the message is owned by the
+	 * instance and is reused once the callback returns */
 	void (*recv_cb)(struct virt_um_inst *vui, struct msgb *msg);
+	/* receive buffers, reused for each batch of datagrams */
+	struct msgb *rx_msgs[VIRT_UM_RX_BATCH];
+	/* number of receive calls and of datagrams received */
+	unsigned long num_rx_batches;
+	unsigned long num_rx_msgs;
 };
 
 struct virt_um_inst *virt_um_init(
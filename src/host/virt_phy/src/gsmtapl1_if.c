@@ -39,9 +39,38 @@
 #include <osmocom/bb/virtphy/virt_l1_model.h>
 #include <osmocom/bb/virtphy/l1ctl_sap.h>
 #include <osmocom/bb/virtphy/gsmtapl1_if.h>
+#include <osmocom/bb/virtphy/virt_time.h>
 #include <osmocom/bb/virtphy/logging.h>
 #include <osmocom/bb/virtphy/virt_l1_sched.h>
 #include <osmocom/bb/l1ctl_proto.h>
+#include <osmocom/bb/l1gprs.h>
+
+/* Number of buckets of the downlink subscription table (must be a power of 2) */
+#define DL_SUBSCR_BUCKETS	4096
+
+/* Downlink subscription table: an MS subscribes to the (ARFCN, timeslot, channel class)
+ * tuples it is listening to (see gsmtapl1_dl_subscr_update()), so that a downlink
+ * message only visits the interested MS.  MS synchronizing to a cell also need to see
+ * the messages of the other ARFCNs (see prim_fbsb_sync()), they are in the 'any'
+ * list.  MS searching for a cell do not subscribe to anything. */
+static struct {
+	struct llist_head buckets[DL_SUBSCR_BUCKETS];
+	struct llist_head any;
+} dl_subscr_tbl;
+
+/* Downlink fan-out counters (see gsmtapl1_dl_stats_log()) */
+static struct {
+	/* frame number of the current frame, and the number of MS visited for it so far */
+	uint32_t fn;
+	unsigned int frame_fanout;
+	unsigned int max_frame_fanout;
+	unsigned long num_frames;
+	unsigned long num_msgs;
+	/* messages nobody subscribed to */
+	unsigned long num_msgs_unsubscr;
+	/* number of MS visited in total */
+	unsigned long num_visits;
+} dl_stats;
 
 static char *pseudo_lchan_name(uint16_t arfcn, uint8_t ts, uint8_t ss, uint8_t sub_type)
 {
@@ -153,19 +182,206 @@ void gsmtapl1_tx_to_virt_um_inst(struct l1_model_ms *ms, uint32_t fn, uint8_t tn
  */
 extern void prim_fbsb_sync(struct l1_model_ms *ms, struct msgb *msg);
 
+static inline unsigned int dl_subscr_bucket(uint16_t arfcn, uint8_t tn, uint8_t cls)
+{
+	const unsigned int key = ((arfcn & GSMTAP_ARFCN_MASK) * 8 + tn) * _NUM_L1_DL_CLASS + cls;
+
+	return key & (DL_SUBSCR_BUCKETS - 1);
+}
+
+/* Downlink channel class of a GSMTAP channel type (see enum l1_dl_class) */
+static uint8_t dl_class(uint8_t gsmtap_chantype)
+{
+	switch (gsmtap_chantype & ~GSMTAP_CHANNEL_ACCH & 0xff) {
+	case GSMTAP_CHANNEL_TCH_H:
+	case GSMTAP_CHANNEL_TCH_F:
+	case GSMTAP_CHANNEL_SDCCH4:
+	case GSMTAP_CHANNEL_SDCCH8:
+	case GSMTAP_CHANNEL_VOICE_F:
+	case GSMTAP_CHANNEL_VOICE_H:
+		return L1_DL_CLASS_DEDIC;
+	case GSMTAP_CHANNEL_PTCCH:
+	case GSMTAP_CHANNEL_PACCH:
+	case GSMTAP_CHANNEL_PDCH:
+		return L1_DL_CLASS_PDCH;
+	default:
+		/* BCCH, CCCH, CBCH, and whatever l1ctl_from_virt_um() ignores */
+		return L1_DL_CLASS_CCCH;
+	}
+}
+
+static void dl_subscr_del(struct l1_dl_subscr *subscr)
+{
+	if (!subscr->active)
+		return;
+	llist_del(&subscr->entry);
+	subscr->active = false;
+}
+
+/* The entry is only moved if the subscription changes, so an MS can update its
+ * subscriptions while a message is being dispatched to it */
+static void dl_subscr_set(struct l1_dl_subscr *subscr, uint16_t arfcn, uint8_t tn, uint8_t cls)
+{
+	if (subscr->active && subscr->arfcn == arfcn && subscr->tn == tn && subscr->cls == cls)
+		return;
+
+	dl_subscr_del(subscr);
+	subscr->arfcn = arfcn;
+	subscr->tn = tn;
+	subscr->cls = cls;
+	subscr->active = true;
+	llist_add_tail(&subscr->entry, &dl_subscr_tbl.buckets[dl_subscr_bucket(arfcn, tn, cls)]);
+}
+
+static void dl_subscr_set_any(struct l1_dl_subscr *subscr)
+{
+	if (subscr->active && subscr->cls == _NUM_L1_DL_CLASS)
+		return;
+
+	dl_subscr_del(subscr);
+	subscr->cls = _NUM_L1_DL_CLASS;
+	subscr->active = true;
+	llist_add_tail(&subscr->entry, &dl_subscr_tbl.any);
+}
+
+/**
+ * Init the downlink subscription table.
+ */
+void gsmtapl1_init(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < DL_SUBSCR_BUCKETS; i++)
+		INIT_LLIST_HEAD(&dl_subscr_tbl.buckets[i]);
+	INIT_LLIST_HEAD(&dl_subscr_tbl.any);
+}
+
+/**
+ * Init the (inactive) downlink subscriptions of the given MS.
+ */
+void gsmtapl1_dl_subscr_init(struct l1_model_ms *ms)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(ms->dl_subscr); i++) {
+		ms->dl_subscr[i] = (struct l1_dl_subscr) { .ms = ms };
+		INIT_LLIST_HEAD(&ms->dl_subscr[i].entry);
+	}
+}
+
+/**
+ * Update the downlink subscriptions of the given MS according to its state.
+ *
+ * Shall be called whenever the state, the ARFCN, the dedicated channel or the
+ * PDCH timeslots (TBF config) of the MS change.
+ */
+void gsmtapl1_dl_subscr_update(struct l1_model_ms *ms)
+{
+	struct l1_state_ms *l1s = &ms->state;
+	uint16_t arfcn;
+	unsigned int tn;
+
+	switch (l1s->state) {
+	case MS_STATE_IDLE_SEARCHING:
+		gsmtapl1_dl_subscr_del(ms);
+		return;
+	case MS_STATE_IDLE_SYNCING:
+		dl_subscr_set_any(&ms->dl_subscr[L1_DL_SUBSCR_CCCH]);
+		for (tn = L1_DL_SUBSCR_DEDIC; tn < L1_DL_SUBSCR_NUM; tn++)
+			dl_subscr_del(&ms->dl_subscr[tn]);
+		return;
+	case MS_STATE_DEDICATED:
+		arfcn = l1s->dedicated.band_arfcn;
+		break;
+	default:
+		arfcn = l1s->serving_cell.arfcn;
+		break;
+	}
+
+	/* the CCCH is forwarded on any timeslot, and in dedicated mode too */
+	dl_subscr_set(&ms->dl_subscr[L1_DL_SUBSCR_CCCH], arfcn, 0, L1_DL_CLASS_CCCH);
+
+	if (l1s->state == MS_STATE_DEDICATED && l1s->dedicated.chan_type != RSL_CHAN_OSMO_PDCH)
+		dl_subscr_set(&ms->dl_subscr[L1_DL_SUBSCR_DEDIC], arfcn, l1s->dedicated.tn, L1_DL_CLASS_DEDIC);
+	else
+		dl_subscr_del(&ms->dl_subscr[L1_DL_SUBSCR_DEDIC]);
+
+	/* the PDCH timeslots in use by a (pending) TBF */
+	for (tn = 0; tn < 8; tn++) {
+		struct l1_dl_subscr *subscr = &ms->dl_subscr[L1_DL_SUBSCR_PDCH(tn)];
+
+		if (l1s->state == MS_STATE_DEDICATED && ms->gprs != NULL &&
+		    l1gprs_pdch_use_count(&ms->gprs->pdch[tn]) > 0)
+			dl_subscr_set(subscr, arfcn, tn, L1_DL_CLASS_PDCH);
+		else
+			dl_subscr_del(subscr);
+	}
+}
+
 /**
- * @see virt_prim_pm.c
+ * Remove all downlink subscriptions of the given MS.
  */
-extern uint16_t prim_pm_set_sig_strength(struct l1_model_ms *ms, uint16_t arfcn, int16_t sig_lev);
+void gsmtapl1_dl_subscr_del(struct l1_model_ms *ms)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(ms->dl_subscr); i++)
+		dl_subscr_del(&ms->dl_subscr[i]);
+}
 
-static void l1ctl_from_virt_um(struct l1ctl_sock_client *lsc, struct msgb *msg, uint32_t fn,
+/* Account a downlink message visiting the given number of MS */
+static void dl_stats_update(uint32_t fn, unsigned int fanout)
+{
+	if (fn != dl_stats.fn || dl_stats.num_msgs == 0) {
+		dl_stats.fn = fn;
+		dl_stats.frame_fanout = 0;
+		dl_stats.num_frames++;
+	}
+
+	dl_stats.num_msgs++;
+	if (fanout == 0)
+		dl_stats.num_msgs_unsubscr++;
+	dl_stats.num_visits += fanout;
+	dl_stats.frame_fanout += fanout;
+	if (dl_stats.frame_fanout > dl_stats.max_frame_fanout)
+		dl_stats.max_frame_fanout = dl_stats.frame_fanout;
+}
+
+/**
+ * Log the downlink fan-out counters.
+ */
+void gsmtapl1_dl_stats_log(void)
+{
+	const unsigned long num_frames = dl_stats.num_frames ? : 1;
+	const unsigned long num_msgs = dl_stats.num_msgs ? : 1;
+
+	LOGP(DVIRPHY, LOGL_NOTICE, "DL fan-out: %lu frames, %lu messages (%lu without subscriber), "
+	     "%lu MS visited: %.2f per frame (max %u), %.2f per message\n",
+	     dl_stats.num_frames, dl_stats.num_msgs, dl_stats.num_msgs_unsubscr,
+	     dl_stats.num_visits, (double)dl_stats.num_visits / num_frames,
+	     dl_stats.max_frame_fanout, (double)dl_stats.num_visits / num_msgs);
+}
+
+static void l1gprs_pdch_changed_cb(struct l1gprs_pdch *pdch, bool active)
+{
+	struct l1_model_ms *ms = pdch->gprs->priv;
+
+	gsmtapl1_dl_subscr_update(ms);
+}
+
+/**
+ * Keep the PDCH subscriptions of the given MS in sync with its TBF config.
+ */
+void gsmtapl1_dl_subscr_gprs(struct l1_model_ms *ms)
+{
+	l1gprs_state_set_pdch_changed_cb(ms->gprs, &l1gprs_pdch_changed_cb);
+}
+
+static void l1ctl_from_virt_um(struct l1_model_ms *ms, struct msgb *msg, uint32_t fn,
 				uint16_t arfcn, uint8_t timeslot, uint8_t subslot,
 				uint8_t gsmtap_chantype, uint8_t chan_nr, uint8_t link_id,
-				uint8_t snr_db)
+				uint8_t snr_db, uint8_t rxlev)
 {
-	struct l1_model_ms *ms = lsc->priv;
-	uint8_t rxlev = dbm2rxlev(prim_pm_set_sig_strength(ms, arfcn & GSMTAP_ARFCN_MASK, MAX_SIG_LEV_DBM));
-
 	gsm_fn2gsmtime(&ms->state.downlink_time, fn);
 
 	switch (ms->state.state) {
@@ -256,12 +472,18 @@ static void l1ctl_from_virt_um(struct l1ctl_sock_client *lsc, struct msgb *msg,
  * - uplink messages
  * - messages with a wrong arfcn
  * - if in MS_STATE_IDLE_SEARCHING
+ *
+ * Only the MS subscribed to the arfcn, timeslot and channel class of the message are visited
+ * (see gsmtapl1_dl_subscr_update()).  The message is shared by all of them and stays owned by
+ * the virtual Um instance, so it must neither be modified nor freed by the handlers.
  */
 void gsmtapl1_rx_from_virt_um_inst_cb(struct virt_um_inst *vui,
 				      struct msgb *msg)
 {
-	struct l1ctl_sock_inst *lsi = vui->priv;
-	struct l1ctl_sock_client *lsc;
+	struct l1_dl_subscr *subscr, *subscr_tmp;
+	struct llist_head *bucket;
+	unsigned int fanout = 0;
+	uint8_t cls;
 
 	if (!msg)
 		return;
@@ -276,6 +498,7 @@ void gsmtapl1_rx_from_virt_um_inst_cb(struct virt_um_inst *vui,
 	uint8_t rsl_chantype;	/* rsl chan type (8.58, 9.3.1) */
 	uint8_t link_id;	/* rsl link id tells if this is an ssociated or dedicated link */
 	uint8_t chan_nr;	/* encoded rsl channel type, timeslot and mf subslot */
+	uint8_t rxlev;		/* signal level, shared by all MS */
 	struct gsm_time gtime;
 
 	msg->l2h = msgb_pull(msg, sizeof(*gh));
@@ -292,15 +515,33 @@ void gsmtapl1_rx_from_virt_um_inst_cb(struct virt_um_inst *vui,
 	/* generally ignore all uplink messages received */
 	if (arfcn & GSMTAP_ARFCN_F_UPLINK) {
 		LOGP(DVIRPHY, LOGL_NOTICE, "Ignoring unexpected uplink message in downlink!\n");
-		goto freemsg;
+		return;
 	}
 
-	/* dispatch the incoming DL message from GSMTAP to each of the registered L1CTL instances */
-	llist_for_each_entry(lsc, &lsi->clients, list) {
-		l1ctl_from_virt_um(lsc, msg, fn, arfcn, timeslot, subslot, gsmtap_chantype,
-				   chan_nr, link_id, snr);
+	/* with virtual time, the clock (and thus the timers) follows the Downlink frames */
+	virt_time_frame(fn);
+
+	rxlev = dbm2rxlev(prim_pm_set_sig_strength(arfcn & GSMTAP_ARFCN_MASK, MAX_SIG_LEV_DBM));
+
+	cls = dl_class(gsmtap_chantype);
+	bucket = &dl_subscr_tbl.buckets[dl_subscr_bucket(arfcn, cls == L1_DL_CLASS_CCCH ? 0 : timeslot, cls)];
+
+	/* dispatch the incoming DL message from GSMTAP to the subscribed L1CTL instances; an MS
+	 * synchronizing may subscribe to the ARFCN, which is why the bucket is visited first */
+	llist_for_each_entry_safe(subscr, subscr_tmp, bucket, entry) {
+		if (subscr->arfcn != arfcn || subscr->cls != cls)
+			continue;
+		if (cls != L1_DL_CLASS_CCCH && subscr->tn != timeslot)
+			continue;
+		l1ctl_from_virt_um(subscr->ms, msg, fn, arfcn, timeslot, subslot, gsmtap_chantype,
+				   chan_nr, link_id, snr, rxlev);
+		fanout++;
+	}
+	llist_for_each_entry_safe(subscr, subscr_tmp, &dl_subscr_tbl.any, entry) {
+		l1ctl_from_virt_um(subscr->ms, msg, fn, arfcn, timeslot, subslot, gsmtap_chantype,
+				   chan_nr, link_id, snr, rxlev);
+		fanout++;
 	}
 
-freemsg:
-	talloc_free(msg);
+	dl_stats_update(fn, fanout);
 }
@@ -26,6 +26,7 @@
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/core/msgb.h>
 #include <osmocom/core/utils.h>
+#include <osmocom/core/bits.h>
 #include <osmocom/core/gsmtap.h>
 #include <osmocom/gsm/protocol/gsm_08_58.h>
 #include <osmocom/gsm/protocol/gsm_04_08.h>
@@ -56,13 +57,15 @@ static void l1_model_tch_mode_set(struct l1_model_ms *ms, uint8_t tch_mode)
  */
 void l1ctl_sap_init(struct l1_model_ms *model)
 {
-	INIT_LLIST_HEAD(&model->state.sched.mframe_items);
+	virt_l1_sched_init(model);
+	gsmtapl1_dl_subscr_init(model);
 
 	prim_pm_init(model);
 }
 
 void l1ctl_sap_exit(struct l1_model_ms *model)
 {
+	gsmtapl1_dl_subscr_del(model);
 	virt_l1_sched_stop(model);
 	prim_pm_exit(model);
 }
@@ -92,6 +95,43 @@ void l1ctl_sap_tx_to_l23_inst(struct l1_model_ms *ms, struct msgb *msg)
 	/* prepend 16bit length before sending */
 	msgb_push_u16(msg, msg->len);
 	l1ctl_sock_write_msg(ms->lsc, msg);
+	ms->barrier.num_tx++;
+}
+
+/**
+ * @brief Transmit a Downlink message carrying a payload to layer 23, without copying the payload.
+ *
+ * @param [in] msg_type L1CTL primitive message type set to l1ctl_hdr.
+ * @param [in] dl the l1ctl_info_dl following the l1ctl_hdr.
+ * @param [in] data the payload, usually pointing into a received GSMTAP message.
+ * @param [in] data_len length of the payload.
+ * @param [in] min_len the payload is padded with zeros up to this length.
+ *
+ * The length prefix and the headers are composed on the stack and written together with the
+ * payload by a single writev(), so that the same payload can be sent to any number of MS.
+ */
+void l1ctl_sap_tx_dl_to_l23_inst(struct l1_model_ms *ms, uint8_t msg_type,
+				 const struct l1ctl_info_dl *dl, const uint8_t *data,
+				 size_t data_len, size_t min_len)
+{
+	static const uint8_t padding[L3_MSG_DATA];
+	const size_t pad_len = min_len > data_len ? min_len - data_len : 0;
+	const struct l1ctl_hdr l1h = { .msg_type = msg_type };
+	uint16_t len;
+
+	OSMO_ASSERT(pad_len <= sizeof(padding));
+	len = htons(sizeof(l1h) + sizeof(*dl) + data_len + pad_len);
+
+	const struct iovec iov[] = {
+		{ .iov_base = &len,		.iov_len = sizeof(len) },
+		{ .iov_base = (void *)&l1h,	.iov_len = sizeof(l1h) },
+		{ .iov_base = (void *)dl,	.iov_len = sizeof(*dl) },
+		{ .iov_base = (void *)data,	.iov_len = data_len },
+		{ .iov_base = (void *)padding,	.iov_len = pad_len },
+	};
+
+	l1ctl_sock_write_iov(ms->lsc, iov, ARRAY_SIZE(iov));
+	ms->barrier.num_tx++;
 }
 
 /**
@@ -250,6 +290,9 @@ void l1ctl_sap_handler(struct l1_model_ms *ms, struct msgb *msg)
 	case L1CTL_GPRS_UL_BLOCK_REQ:
 		l1ctl_rx_gprs_ul_block_req(ms, msg);
 		goto exit_nofree;
+	case L1CTL_ECHO_CONF:
+		l1ctl_rx_echo_conf(ms, msg);
+		break;
 	}
 
 exit_msgbfree:
@@ -298,8 +341,11 @@ void l1ctl_rx_dm_est_req(struct l1_model_ms *ms, struct msgb *msg)
 		OSMO_ASSERT(ms->gprs == NULL);
 		ms->gprs = l1gprs_state_alloc(ms, NULL, ms);
 		OSMO_ASSERT(ms->gprs != NULL);
+		gsmtapl1_dl_subscr_gprs(ms);
 	}
 
+	gsmtapl1_dl_subscr_update(ms);
+
 	/* TCH config */
 	if (rsl_chantype == RSL_CHAN_Bm_ACCHs || rsl_chantype == RSL_CHAN_Lm_ACCHs) {
 		ms->state.tch_mode = est_req->tch_mode;
@@ -387,6 +433,8 @@ void l1ctl_rx_dm_rel_req(struct l1_model_ms *ms, struct msgb *msg)
 	l1gprs_state_free(ms->gprs);
 	ms->gprs = NULL;
 
+	gsmtapl1_dl_subscr_update(ms);
+
 	/* TODO: disable ciphering */
 	/* TODO: disable audio recording / playing */
 }
@@ -434,6 +482,7 @@ void l1ctl_rx_reset_req(struct l1_model_ms *ms, struct msgb *msg)
 	case L1CTL_RES_T_FULL:
 		DEBUGPMS(DL1C, ms, "Rx L1CTL_RESET_REQ (type=FULL)\n");
 		ms->state.state = MS_STATE_IDLE_SEARCHING;
+		gsmtapl1_dl_subscr_update(ms);
 		virt_l1_sched_stop(ms);
 		l1gprs_state_free(ms->gprs);
 		ms->gprs = NULL;
@@ -555,6 +604,32 @@ void l1ctl_rx_sim_req(struct l1_model_ms *ms, struct msgb *msg)
 
 }
 
+/**
+ * @brief Handler for received L1CTL_ECHO_CONF from L23.
+ *
+ * -- echo confirm --
+ *
+ * @param [in] msg the received message.
+ *
+ * Answer to the L1CTL_ECHO_REQ sent by the fake BTS after a frame: as L1CTL is a stream,
+ * everything the MS sent in response to that frame has been received before.
+ */
+void l1ctl_rx_echo_conf(struct l1_model_ms *ms, struct msgb *msg)
+{
+	struct l1ctl_hdr *l1h = (struct l1ctl_hdr *) msg->data;
+	uint32_t fn;
+
+	if (msgb_length(msg) < sizeof(*l1h) + sizeof(fn)) {
+		LOGPMS(DL1C, LOGL_NOTICE, ms, "Rx short L1CTL_ECHO_CONF, ignoring\n");
+		return;
+	}
+	fn = osmo_load32be(l1h->data);
+
+	DEBUGPMS(DL1C, ms, "Rx L1CTL_ECHO_CONF (fn=%u)\n", fn);
+	if (ms->barrier.pending && ms->barrier.fn == fn)
+		ms->barrier.pending = false;
+}
+
 /***************************************************************
  * L1CTL TX ROUTINES *******************************************
  * For more routines check the respective handler classes ******
@@ -580,6 +655,29 @@ void l1ctl_tx_reset(struct l1_model_ms *ms, uint8_t msg_type, uint8_t reset_type
 	l1ctl_sap_tx_to_l23_inst(ms, msg);
 }
 
+/**
+ * @brief Transmit L1CTL_ECHO_REQ to layer 23.
+ *
+ * -- echo request --
+ *
+ * @param [in] fn the frame number, echoed back by layer 23 in its L1CTL_ECHO_CONF.
+ *
+ * Used by the fake BTS as a per-frame barrier, see l1ctl_rx_echo_conf().
+ */
+void l1ctl_tx_echo_req(struct l1_model_ms *ms, uint32_t fn)
+{
+	struct msgb *msg = l1ctl_msgb_alloc(L1CTL_ECHO_REQ);
+
+	osmo_store32be(fn, msgb_put(msg, sizeof(fn)));
+
+	DEBUGPMS(DL1C, ms, "Tx L1CTL_ECHO_REQ (fn=%u)\n", fn);
+	l1ctl_sap_tx_to_l23_inst(ms, msg);
+
+	ms->barrier.num_tx_echo = ms->barrier.num_tx;
+	ms->barrier.pending = true;
+	ms->barrier.fn = fn;
+}
+
 /**
  * @brief Transmit L1CTL_CCCH_MODE_CONF to layer 23.
  *
@@ -33,6 +33,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 
 #include <osmocom/core/linuxlist.h>
@@ -189,10 +190,42 @@ void l1ctl_sock_destroy(struct l1ctl_sock_inst *lsi)
 	talloc_free(lsi);
 }
 
+/* A failed or short write desynchronizes the length-prefixed framing: the connection is shut
+ * down, the client is then destroyed by l1ctl_sock_data_cb() as soon as it reads EOF. */
+static int l1ctl_sock_write_check(struct l1ctl_sock_client *lsc, ssize_t rc, size_t len)
+{
+	const int err = rc < 0 ? errno : EIO;
+
+	if (rc == len)
+		return rc;
+
+	LOGP(DL1C, LOGL_ERROR, "Failed to write %zu bytes to l2 (fd=%d): %s. "
+	     "Connection will be closed.\n", len, lsc->ofd.fd,
+	     rc < 0 ? strerror(err) : "short write");
+	shutdown(lsc->ofd.fd, SHUT_RDWR);
+
+	return -err;
+}
+
 int l1ctl_sock_write_msg(struct l1ctl_sock_client *lsc, struct msgb *msg)
 {
-	int rc;
-	rc = write(lsc->ofd.fd, msgb_data(msg), msgb_length(msg));
+	const size_t len = msgb_length(msg);
+	ssize_t rc;
+
+	rc = write(lsc->ofd.fd, msgb_data(msg), len);
 	msgb_free(msg);
-	return rc;
+	return l1ctl_sock_write_check(lsc, rc, len);
+}
+
+int l1ctl_sock_write_iov(struct l1ctl_sock_client *lsc, const struct iovec *iov, int iovcnt)
+{
+	size_t len = 0;
+	ssize_t rc;
+	int i;
+
+	for (i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+
+	rc = writev(lsc->ofd.fd, iov, iovcnt);
+	return l1ctl_sock_write_check(lsc, rc, len);
 }
@@ -19,8 +19,12 @@
  *
  */
 
+#define _GNU_SOURCE
+
 #include <unistd.h>
 #include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <osmocom/core/select.h>
 #include <osmocom/core/utils.h>
@@ -35,28 +39,58 @@
 /**
  * Virtual UM interface file descriptor callback.
  * Should be called by select.c when the fd is ready for reading.
+ *
+ * Up to VIRT_UM_RX_BATCH datagrams are read with a single recvmmsg() call
+ * into the preallocated receive buffers of the instance.
  */
 static int virt_um_fd_cb(struct osmo_fd *ofd, unsigned int what)
 {
 	struct virt_um_inst *vui = ofd->data;
+	struct mmsghdr mmsg[VIRT_UM_RX_BATCH];
+	struct iovec iov[VIRT_UM_RX_BATCH];
+	int i, rc;
+
+	if (!(what & OSMO_FD_READ))
+		return 0;
+
+	for (i = 0; i < VIRT_UM_RX_BATCH; i++) {
+		struct msgb *msg = vui->rx_msgs[i];
+
+		msgb_reset(msg);
+		iov[i] = (struct iovec) {
+			.iov_base = msgb_data(msg),
+			.iov_len = msgb_tailroom(msg),
+		};
+		mmsg[i] = (struct mmsghdr) {
+			.msg_hdr = {
+				.msg_iov = &iov[i],
+				.msg_iovlen = 1,
+			},
+		};
+	}
 
-	if (what & OSMO_FD_READ) {
-		struct msgb *msg = msgb_alloc(VIRT_UM_MSGB_SIZE, "Virtual UM Rx");
-		int rc;
-
-		/* read message from fd into message buffer */
-		rc = mcast_bidir_sock_rx(vui->mcast_sock, msgb_data(msg), msgb_tailroom(msg));
-		if (rc > 0) {
-			msgb_put(msg, rc);
-			msg->l1h = msgb_data(msg);
-			/* call the l1 callback function for a received msg */
-			vui->recv_cb(vui, msg);
-		} else if (rc == 0) {
-			vui->recv_cb(vui, NULL);
-			osmo_fd_close(ofd);
-		} else
+	/* read messages from fd into the message buffers */
+	rc = recvmmsg(ofd->fd, mmsg, VIRT_UM_RX_BATCH, MSG_DONTWAIT, NULL);
+	if (rc < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
 			perror("Read from multicast socket");
+		return 0;
+	}
+
+	vui->num_rx_batches++;
+	vui->num_rx_msgs += rc;
+
+	for (i = 0; i < rc; i++) {
+		struct msgb *msg = vui->rx_msgs[i];
+
+		/* ignore empty and truncated datagrams */
+		if (mmsg[i].msg_len == 0 || (mmsg[i].msg_hdr.msg_flags & MSG_TRUNC))
+			continue;
 
+		msgb_put(msg, mmsg[i].msg_len);
+		msg->l1h = msgb_data(msg);
+		/* call the l1 callback function for a received msg */
+		vui->recv_cb(vui, msg);
 	}
 
 	return 0;
@@ -67,7 +101,7 @@ struct virt_um_inst *virt_um_init(void *ctx, char *tx_mcast_group, uint16_t tx_m
 				  void (*recv_cb)(struct virt_um_inst *vui, struct msgb *msg))
 {
 	struct virt_um_inst *vui = talloc_zero(ctx, struct virt_um_inst);
-	int rc;
+	int i, rc;
 
 	vui->mcast_sock = mcast_bidir_sock_setup(ctx, tx_mcast_group, tx_mcast_port,
 						 rx_mcast_group, rx_mcast_port, 1, virt_um_fd_cb, vui);
@@ -78,6 +112,12 @@ struct virt_um_inst *virt_um_init(void *ctx, char *tx_mcast_group, uint16_t tx_m
 	}
 	vui->recv_cb = recv_cb;
 
+	for (i = 0; i < VIRT_UM_RX_BATCH; i++) {
+		vui->rx_msgs[i] = msgb_alloc(VIRT_UM_MSGB_SIZE, "Virtual UM Rx");
+		if (!vui->rx_msgs[i])
+			goto out_close;
+	}
+
 	if (ttl >= 0) {
 		rc = osmo_sock_mcast_ttl_set(vui->mcast_sock->tx_ofd.fd, ttl);
 		if (rc < 0) {
@@ -102,14 +142,17 @@ struct virt_um_inst *virt_um_init(void *ctx, char *tx_mcast_group, uint16_t tx_m
 	return vui;
 
 out_close:
-	mcast_bidir_sock_close(vui->mcast_sock);
-	talloc_free(vui);
+	virt_um_destroy(vui);
 	return NULL;
 }
 
 void virt_um_destroy(struct virt_um_inst *vui)
 {
+	int i;
+
 	mcast_bidir_sock_close(vui->mcast_sock);
+	for (i = 0; i < VIRT_UM_RX_BATCH; i++)
+		msgb_free(vui->rx_msgs[i]);
 	talloc_free(vui);
 }
 
@@ -18,7 +18,8 @@
  *
  */
 
-#include <time.h>
+#include <stdbool.h>
+#include <string.h>
 #include <talloc.h>
 
 #include <osmocom/core/linuxlist.h>
@@ -27,11 +28,154 @@
 #include <osmocom/bb/virtphy/virt_l1_model.h>
 #include <osmocom/bb/virtphy/logging.h>
 
+/* The scheduler is a timing wheel with one slot per TDMA frame: an item
+ * scheduled d frames after the last execution goes to slot (cur + d) of the
+ * wheel, so both inserting and expiring an item take constant time.  Within a
+ * slot, items are kept ordered by timeslot.  Items scheduled for the current
+ * or a past frame go to the current slot and are handled on the next run. */
+
+#define WHEEL_MASK	(VIRT_L1_SCHED_WHEEL_SIZE - 1)
+
+/* Distance from fn_from to fn_to, modulo the hyperframe */
+static inline uint32_t fn_distance(uint32_t fn_to, uint32_t fn_from)
+{
+	return (fn_to + GSM_TDMA_HYPERFRAME - fn_from) % GSM_TDMA_HYPERFRAME;
+}
+
+/* Whether item a shall be handled before item b (earlier frame, then lower timeslot) */
+static inline bool item_before(const struct virt_l1_sched_tdma_item *a,
+			       const struct virt_l1_sched_tdma_item *b)
+{
+	const uint32_t d = fn_distance(b->fn, a->fn);
+
+	if (d != 0)
+		return d < GSM_TDMA_HYPERFRAME / 2;
+	return a->ts < b->ts;
+}
+
+static struct virt_l1_sched_tdma_item *item_alloc(struct l1_model_ms *ms)
+{
+	struct virt_l1_sched *sched = &ms->state.sched;
+	struct virt_l1_sched_tdma_item *ti;
+
+	if (llist_empty(&sched->free_items)) {
+		/* Grow the pool, items are only released along with the MS */
+		struct virt_l1_sched_tdma_item *chunk;
+		unsigned int i;
+
+		chunk = talloc_array(ms, struct virt_l1_sched_tdma_item, VIRT_L1_SCHED_POOL_CHUNK);
+		OSMO_ASSERT(chunk != NULL);
+		for (i = 0; i < VIRT_L1_SCHED_POOL_CHUNK; i++)
+			llist_add_tail(&chunk[i].tdma_item_entry, &sched->free_items);
+		sched->num_allocated += VIRT_L1_SCHED_POOL_CHUNK;
+	}
+
+	ti = llist_entry(sched->free_items.next, struct virt_l1_sched_tdma_item, tdma_item_entry);
+	llist_del(&ti->tdma_item_entry);
+	return ti;
+}
+
+static inline void item_release(struct virt_l1_sched *sched, struct virt_l1_sched_tdma_item *ti)
+{
+	llist_add(&ti->tdma_item_entry, &sched->free_items);
+}
+
+/* Insert an item into the given list, keeping it ordered (FIFO for equal fn/ts) */
+static void item_insert(struct llist_head *list, struct virt_l1_sched_tdma_item *ti)
+{
+	struct llist_head *pos = list->prev;
+
+	/* Items mostly arrive in order, so walk backwards from the tail */
+	while (pos != list) {
+		const struct virt_l1_sched_tdma_item *prev;
+
+		prev = llist_entry(pos, struct virt_l1_sched_tdma_item, tdma_item_entry);
+		if (!item_before(ti, prev))
+			break;
+		pos = pos->prev;
+	}
+
+	llist_add(&ti->tdma_item_entry, pos);
+}
+
+/* Put an item into the wheel (or the overflow list) relative to last_exec_fn */
+static void wheel_insert(struct virt_l1_sched *sched, struct virt_l1_sched_tdma_item *ti)
+{
+	uint32_t d = fn_distance(ti->fn, sched->last_exec_fn);
+	unsigned int slot;
+
+	if (d > GSM_TDMA_HYPERFRAME / 2)
+		d = 0; /* overdue: handle on the next run */
+	else if (d >= VIRT_L1_SCHED_WHEEL_SIZE) {
+		llist_add_tail(&ti->tdma_item_entry, &sched->overflow);
+		return;
+	}
+
+	slot = (sched->cur + d) & WHEEL_MASK;
+	item_insert(&sched->wheel[slot], ti);
+	sched->wheel_map[slot / 32] |= 1U << (slot % 32);
+}
+
+/* Handle all items of the given wheel slot */
+static void wheel_expire_slot(struct l1_model_ms *ms, unsigned int slot)
+{
+	struct virt_l1_sched *sched = &ms->state.sched;
+	struct virt_l1_sched_tdma_item *ti, *ti_tmp;
+	LLIST_HEAD(items);
+
+	if (!(sched->wheel_map[slot / 32] & (1U << (slot % 32))))
+		return;
+
+	/* The handlers may schedule new items, so detach the slot first */
+	llist_splice_init(&sched->wheel[slot], &items);
+	sched->wheel_map[slot / 32] &= ~(1U << (slot % 32));
+
+	llist_for_each_entry_safe(ti, ti_tmp, &items, tdma_item_entry) {
+		/* exec tdma sched item's handler callback */
+		llist_del(&ti->tdma_item_entry);
+		sched->num_pending--;
+		ti->handler_cb(ms, ti->fn, ti->ts, ti->msg);
+		item_release(sched, ti);
+	}
+}
+
+/* Move the items of the overflow list which got close enough into the wheel */
+static void overflow_refill(struct virt_l1_sched *sched)
+{
+	struct virt_l1_sched_tdma_item *ti, *ti_tmp;
+
+	llist_for_each_entry_safe(ti, ti_tmp, &sched->overflow, tdma_item_entry) {
+		uint32_t d = fn_distance(ti->fn, sched->last_exec_fn);
+
+		if (d < VIRT_L1_SCHED_WHEEL_SIZE || d > GSM_TDMA_HYPERFRAME / 2) {
+			llist_del(&ti->tdma_item_entry);
+			wheel_insert(sched, ti);
+		}
+	}
+}
+
+/**
+ * @brief Init the scheduler state of the given MS.
+ */
+void virt_l1_sched_init(struct l1_model_ms *ms)
+{
+	struct virt_l1_sched *sched = &ms->state.sched;
+	unsigned int i;
+
+	memset(sched, 0, sizeof(*sched));
+	for (i = 0; i < VIRT_L1_SCHED_WHEEL_SIZE; i++)
+		INIT_LLIST_HEAD(&sched->wheel[i]);
+	INIT_LLIST_HEAD(&sched->overflow);
+	INIT_LLIST_HEAD(&sched->free_items);
+}
+
 /**
  * @brief Start scheduler thread based on current gsm time from model
  */
 static int virt_l1_sched_start(struct l1_model_ms *ms, struct gsm_time time)
 {
+	/* The wheel is empty, so it can be re-based at the given time */
+	ms->state.sched.last_exec_fn = time.fn;
 	virt_l1_sched_sync_time(ms, time, 1);
 	return 0;
 }
@@ -54,62 +198,71 @@ void virt_l1_sched_sync_time(struct l1_model_ms *ms, struct gsm_time time, uint8
 }
 
 /**
- * @brief Stop the scheduler thread and cleanup mframe items queue
+ * @brief Stop the scheduler thread and cleanup the pending items.
  */
 void virt_l1_sched_stop(struct l1_model_ms *ms)
 {
-	struct virt_l1_sched_mframe_item *mi_next, *mi_tmp;
+	struct virt_l1_sched *sched = &ms->state.sched;
+	struct virt_l1_sched_tdma_item *ti, *ti_tmp;
+	unsigned int slot;
+
+	/* Empty the wheel slots and the overflow list */
+	for (slot = 0; slot <= VIRT_L1_SCHED_WHEEL_SIZE; slot++) {
+		struct llist_head *list = &sched->overflow;
 
-	/* Empty tdma and mframe sched items lists */
-	llist_for_each_entry_safe(mi_next, mi_tmp, &ms->state.sched.mframe_items, mframe_item_entry) {
-		struct virt_l1_sched_tdma_item *ti_next, *ti_tmp;
+		if (slot < VIRT_L1_SCHED_WHEEL_SIZE)
+			list = &sched->wheel[slot];
 
-		llist_for_each_entry_safe(ti_next, ti_tmp, &mi_next->tdma_item_list, tdma_item_entry) {
-			talloc_free(ti_next->msg);
-			llist_del(&ti_next->tdma_item_entry);
+		llist_for_each_entry_safe(ti, ti_tmp, list, tdma_item_entry) {
+			talloc_free(ti->msg);
+			llist_del(&ti->tdma_item_entry);
+			item_release(sched, ti);
 		}
-		llist_del(&mi_next->mframe_item_entry);
-		talloc_free(mi_next);
 	}
+
+	memset(&sched->wheel_map[0], 0, sizeof(sched->wheel_map));
+	sched->num_pending = 0;
 }
 
 /**
- * @brief Handle all pending scheduled items for the current frame number.
+ * @brief Handle all pending scheduled items up to the given frame number.
  */
 void virt_l1_sched_execute(struct l1_model_ms *ms, uint32_t fn)
 {
-	struct l1_state_ms *l1s = &ms->state;
-	struct virt_l1_sched_mframe_item *mi_next, *mi_tmp;
-	uint8_t hyperframe_restart = fn < l1s->sched.last_exec_fn;
-
-	llist_for_each_entry_safe(mi_next, mi_tmp, &l1s->sched.mframe_items, mframe_item_entry) {
-		/* execute all registered handler for current mf sched item */
-		uint8_t exec_now = mi_next->fn <= fn || (hyperframe_restart && mi_next->fn > l1s->sched.last_exec_fn);
-		/* break loop, as we have an ordered list in case the hyperframe had not been reset */
-		uint8_t break_now = mi_next->fn > fn && !hyperframe_restart;
-
-		if (exec_now) {
-			struct virt_l1_sched_tdma_item *ti_next, *ti_tmp;
-			/* run through all scheduled tdma sched items for that frame number */
-			llist_for_each_entry_safe(ti_next, ti_tmp, &mi_next->tdma_item_list,
-						  tdma_item_entry) {
-				/* exec tdma sched item's handler callback */
-				/* TODO: we do not have a TDMA scheduler currently and execute
-				 * all scheduled tdma items here at once */
-				ti_next->handler_cb(ms, mi_next->fn, ti_next->ts, ti_next->msg);
-				/* remove handled tdma sched item */
-				llist_del(&ti_next->tdma_item_entry);
-				talloc_free(ti_next);
-			}
-			/* remove handled mframe sched item */
-			llist_del(&mi_next->mframe_item_entry);
-			talloc_free(mi_next);
+	struct virt_l1_sched *sched = &ms->state.sched;
+	uint32_t d = fn_distance(fn, sched->last_exec_fn);
+	unsigned int i;
+
+	/* Time went backwards (e.g. the BTS restarted): everything pending is due */
+	if (d > GSM_TDMA_HYPERFRAME / 2) {
+		struct virt_l1_sched_tdma_item *ti, *ti_tmp;
+
+		llist_for_each_entry_safe(ti, ti_tmp, &sched->overflow, tdma_item_entry) {
+			llist_del(&ti->tdma_item_entry);
+			item_insert(&sched->wheel[sched->cur], ti);
+			sched->wheel_map[sched->cur / 32] |= 1U << (sched->cur % 32);
 		}
+		for (i = 0; i < VIRT_L1_SCHED_WHEEL_SIZE; i++)
+			wheel_expire_slot(ms, (sched->cur + i) & WHEEL_MASK);
+		sched->last_exec_fn = fn;
+		return;
+	}
 
-		if (break_now)
-			break;
+	/* Items scheduled for the last executed (or an already past) frame */
+	wheel_expire_slot(ms, sched->cur);
+
+	/* Advance the wheel frame by frame, as long as there is anything pending */
+	for (; d > 0 && sched->num_pending > 0; d--) {
+		sched->cur = (sched->cur + 1) & WHEEL_MASK;
+		sched->last_exec_fn = (sched->last_exec_fn + 1) % GSM_TDMA_HYPERFRAME;
+		/* The overflow list only needs a look once per turn of the wheel */
+		if (sched->cur == 0 && !llist_empty(&sched->overflow))
+			overflow_refill(sched);
+		wheel_expire_slot(ms, sched->cur);
 	}
-	l1s->sched.last_exec_fn = fn;
+
+	sched->cur = (sched->cur + d) & WHEEL_MASK;
+	sched->last_exec_fn = fn;
 }
 
 /**
@@ -118,29 +271,15 @@ void virt_l1_sched_execute(struct l1_model_ms *ms, uint32_t fn)
 void virt_l1_sched_schedule(struct l1_model_ms *ms, struct msgb *msg, uint32_t fn, uint8_t ts,
                             virt_l1_sched_cb *handler_cb)
 {
-	struct virt_l1_sched_mframe_item *mi_next = NULL, *mi_tmp = NULL, *mi_fn = NULL;
-	struct virt_l1_sched_tdma_item *ti_new = NULL;
+	struct virt_l1_sched *sched = &ms->state.sched;
+	struct virt_l1_sched_tdma_item *ti_new;
 
-	llist_for_each_entry_safe(mi_next, mi_tmp, &ms->state.sched.mframe_items, mframe_item_entry) {
-		if (mi_next->fn == fn) {
-			mi_fn = mi_next;
-			break;
-		} else if (mi_next->fn > fn)
-			break;
-	}
-	if (!mi_fn) {
-		/* list did not contain mframe item with needed fn */
-		mi_fn = talloc_zero(ms, struct virt_l1_sched_mframe_item);
-		mi_fn->fn = fn;
-		INIT_LLIST_HEAD(&mi_fn->tdma_item_list);
-		llist_add_tail(&mi_fn->mframe_item_entry, &mi_next->mframe_item_entry);
-	}
-
-	ti_new = talloc_zero(mi_fn, struct virt_l1_sched_tdma_item);
+	ti_new = item_alloc(ms);
 	ti_new->msg = msg;
-	ti_new->handler_cb = handler_cb;
+	ti_new->fn = fn;
 	ti_new->ts = ts;
-	/* simply add at end, no ordering for tdma sched items currently */
-	llist_add_tail(&ti_new->tdma_item_entry, &mi_fn->tdma_item_list);
-	/* TODO: ordered insert needed if tdma scheduler should be implemented */
+	ti_new->handler_cb = handler_cb;
+
+	wheel_insert(sched, ti_new);
+	sched->num_pending++;
 }
@@ -76,35 +76,33 @@ void l1ctl_rx_data_req(struct l1_model_ms *ms, struct msgb *msg)
 	virt_l1_sched_schedule(ms, msg, fn_sched, timeslot, &virt_l1_sched_handler_cb);
 }
 
-void l1ctl_tx_data_ind(struct l1_model_ms *ms, struct msgb *msg, uint16_t arfcn, uint8_t link_id,
+void l1ctl_tx_data_ind(struct l1_model_ms *ms, const struct msgb *msg, uint16_t arfcn, uint8_t link_id,
 		       uint8_t chan_nr, uint32_t fn, uint8_t snr,
 		       uint8_t rxlev, uint8_t num_biterr, uint8_t fire_crc)
 {
-	struct msgb *l1ctl_msg = NULL;
-	struct l1ctl_data_ind * l1di;
-	struct l1ctl_info_dl * l1dl;
-	l1ctl_msg = l1ctl_msgb_alloc(L1CTL_DATA_IND);
-	l1dl = (struct l1ctl_info_dl *)msgb_put(l1ctl_msg,
-	                                        sizeof(struct l1ctl_info_dl));
-	l1di = (struct l1ctl_data_ind *)msgb_put(l1ctl_msg,
-	                                         sizeof(struct l1ctl_data_ind));
-
-	l1dl->band_arfcn = htons(arfcn);
-	l1dl->link_id = link_id;
-	l1dl->chan_nr = chan_nr;
-	l1dl->frame_nr = htonl(fn);
-	l1dl->snr = snr;
-	l1dl->rx_level = rxlev;
-	l1dl->num_biterr = 0; /* no biterrors */
-	l1dl->fire_crc = 0;
+	const struct l1ctl_info_dl l1dl = {
+		.band_arfcn = htons(arfcn),
+		.link_id = link_id,
+		.chan_nr = chan_nr,
+		.frame_nr = htonl(fn),
+		.snr = snr,
+		.rx_level = rxlev,
+		.num_biterr = 0, /* no biterrors */
+		.fire_crc = 0,
+	};
+	const struct l1ctl_data_ind *l1di;
+	size_t data_len = msgb_length(msg);
 
 	/* TODO: data decoding and decryption */
 
-	memcpy(l1di->data, msgb_data(msg), msgb_length(msg));
+	/* the payload is shared with the other MS, it is neither copied nor modified */
+	if (data_len > sizeof(l1di->data))
+		data_len = sizeof(l1di->data);
 
 	LOGPMS(DL1P, LOGL_DEBUG, ms, "TX L1CTL_DATA_IND (link_id=0x%02x) %s\n", link_id,
 		 osmo_hexdump(msgb_data(msg), msgb_length(msg)));
-	l1ctl_sap_tx_to_l23_inst(ms, l1ctl_msg);
+	l1ctl_sap_tx_dl_to_l23_inst(ms, L1CTL_DATA_IND, &l1dl, msgb_data(msg), data_len,
+				    sizeof(l1di->data));
 }
 
 /**
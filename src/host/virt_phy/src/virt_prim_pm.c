@@ -18,11 +18,14 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
 #include <osmocom/core/msgb.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/timer_compat.h>
 #include <osmocom/core/gsmtap.h>
 #include <osmocom/gsm/gsm_utils.h>
 #include <osmocom/gsm/protocol/gsm_08_58.h>
@@ -32,6 +35,53 @@
 #include <osmocom/bb/virtphy/logging.h>
 #include <osmocom/bb/l1ctl_proto.h>
 
+/* Number of ARFCNs the signal levels are kept for */
+#define PM_NUM_ARFCN	1024
+
+/* Signal levels measured on the virtual Um, shared by all MS: a downlink message
+ * is received once per process, so there is no point in keeping them per MS. */
+static struct {
+	/* whether anything has been received on that ARFCN yet */
+	bool valid;
+	int16_t sig_lev_dbm;
+	/* configured signal level reduction (see prim_pm_set_sig_lev_red()) */
+	uint8_t sig_lev_red_dbm;
+	/* time of the last reception, for the signal level to expire */
+	struct timespec last_rx;
+} pm_arfcn[PM_NUM_ARFCN];
+
+/* signal levels expire if nothing was received within that time (0: never) */
+static struct timespec pm_timeout;
+
+static inline bool pm_timeout_enabled(void)
+{
+	return pm_timeout.tv_sec > 0 || pm_timeout.tv_nsec > 0;
+}
+
+/**
+ * @brief Configure the time after which the signal level of an ARFCN is reset to the worst value.
+ *
+ * The signal levels are only checked against that timeout when being read, so no timers are armed.
+ *
+ * @param [in] timeout_s seconds.
+ * @param [in] timeout_us microseconds.
+ */
+void prim_pm_set_timeout(uint32_t timeout_s, uint32_t timeout_us)
+{
+	pm_timeout.tv_sec = timeout_s + timeout_us / 1000000;
+	pm_timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+}
+
+/**
+ * @brief Configure the signal level reduction for a given arfcn.
+ */
+void prim_pm_set_sig_lev_red(uint16_t arfcn, uint8_t red)
+{
+	if (arfcn >= PM_NUM_ARFCN)
+		return;
+	pm_arfcn[arfcn].sig_lev_red_dbm = red;
+}
+
 /**
  * @brief Change the signal strength for a given arfcn.
  *
@@ -39,28 +89,45 @@
  *
  * @param [in] arfcn to change sig str for.
  * @param [in] sig_lev the measured signal level value.
+ * @return the resulting signal level.
  */
-uint16_t prim_pm_set_sig_strength(struct l1_model_ms *ms, uint16_t arfcn, int16_t sig_lev)
+int16_t prim_pm_set_sig_strength(uint16_t arfcn, int16_t sig_lev)
 {
-	struct l1_state_ms *l1s = &ms->state;
+	if (arfcn >= PM_NUM_ARFCN)
+		return MIN_SIG_LEV_DBM;
 
-	if (l1s->pm.timeout_s > 0 || l1s->pm.timeout_us > 0) {
-		osmo_timer_schedule(&l1s->pm.meas.arfcn_sig_lev_timers[arfcn],
-				    l1s->pm.timeout_s, l1s->pm.timeout_us);
-	}
-	l1s->pm.meas.arfcn_sig_lev_dbm[arfcn] = sig_lev - l1s->pm.meas.arfcn_sig_lev_red_dbm[arfcn];
-	DEBUGPMS(DL1C, ms, "Power measurement set for arfcn %u. Set signal level to %d (== rxlev: %u).\n",
-		arfcn, l1s->pm.meas.arfcn_sig_lev_dbm[arfcn],
-		dbm2rxlev(l1s->pm.meas.arfcn_sig_lev_dbm[arfcn]));
-	return l1s->pm.meas.arfcn_sig_lev_dbm[arfcn];
+	if (pm_timeout_enabled())
+		osmo_clock_gettime(CLOCK_MONOTONIC, &pm_arfcn[arfcn].last_rx);
+	pm_arfcn[arfcn].sig_lev_dbm = sig_lev - pm_arfcn[arfcn].sig_lev_red_dbm;
+	pm_arfcn[arfcn].valid = true;
+
+	return pm_arfcn[arfcn].sig_lev_dbm;
 }
 
-void prim_pm_timer_cb(void *data)
+/**
+ * @brief Get the signal strength for a given arfcn.
+ *
+ * The signal level is reset to the worst value if no messages have been received
+ * from that arfcn for the configured time (see prim_pm_set_timeout()).
+ */
+int16_t prim_pm_get_sig_strength(uint16_t arfcn)
 {
-	/* reset the signal level to bad value if no messages have been
-	 * received from that rfcn for a given time */
-	DEBUGP(DL1C, "Timeout occurred for arfcn, signal level reset to worst value.\n");
-	*((int16_t*)data) = MIN_SIG_LEV_DBM;
+	struct timespec now, age;
+
+	if (arfcn >= PM_NUM_ARFCN || !pm_arfcn[arfcn].valid)
+		return MIN_SIG_LEV_DBM;
+
+	if (pm_timeout_enabled()) {
+		osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+		timespecsub(&now, &pm_arfcn[arfcn].last_rx, &age);
+		if (timespeccmp(&age, &pm_timeout, >=)) {
+			DEBUGP(DL1C, "Timeout occurred for arfcn %u, signal level reset to worst value.\n", arfcn);
+			pm_arfcn[arfcn].valid = false;
+			return MIN_SIG_LEV_DBM;
+		}
+	}
+
+	return pm_arfcn[arfcn].sig_lev_dbm;
 }
 
 /**
@@ -108,8 +175,8 @@ static void pm_conf_timer_cb(void *data)
 		pm_conf->band_arfcn = htons(arfcn_next);
 		/* set min and max to the value calculated for that
 		 * arfcn (IGNORE UPLINKK AND  PCS AND OTHER FLAGS) */
-		pm_conf->pm[0] = dbm2rxlev(l1s->pm.meas.arfcn_sig_lev_dbm[arfcn_next & ARFCN_NO_FLAGS_MASK]);
-		pm_conf->pm[1] = dbm2rxlev(l1s->pm.meas.arfcn_sig_lev_dbm[arfcn_next & ARFCN_NO_FLAGS_MASK]);
+		pm_conf->pm[0] = dbm2rxlev(prim_pm_get_sig_strength(arfcn_next & ARFCN_NO_FLAGS_MASK));
+		pm_conf->pm[1] = pm_conf->pm[0];
 		if (arfcn_next == l1s->pm.req.band_arfcn_to) {
 			struct l1ctl_hdr *resp_l1h = msgb_l1(resp_msg);
 			resp_l1h->flags |= L1CTL_F_DONE;
@@ -136,24 +203,13 @@ static void pm_conf_timer_cb(void *data)
 void prim_pm_init(struct l1_model_ms *model)
 {
 	struct l1_state_ms *l1s = &model->state;
-	int i;
-
-	/* init the signal level of all arfcns with the lowest value possible */
-	memset(l1s->pm.meas.arfcn_sig_lev_dbm, MIN_SIG_LEV_DBM, sizeof (int16_t) * 1024);
-	/* init timers */
-	for (i = 0; i < 1024; ++i) {
-		l1s->pm.meas.arfcn_sig_lev_timers[i].cb = prim_pm_timer_cb;
-		l1s->pm.meas.arfcn_sig_lev_timers[i].data = &l1s->pm.meas.arfcn_sig_lev_dbm[i];
-	}
+
 	osmo_timer_setup(&l1s->pm.req.timer, pm_conf_timer_cb, model);
 }
 
 void prim_pm_exit(struct l1_model_ms *model)
 {
 	struct l1_state_ms *l1s = &model->state;
-	int i;
 
-	for (i = 0; i < 1024; ++i)
-		osmo_timer_del(&l1s->pm.meas.arfcn_sig_lev_timers[i]);
 	osmo_timer_del(&l1s->pm.req.timer);
 }
@@ -74,44 +74,30 @@ void l1ctl_rx_traffic_req(struct l1_model_ms *ms, struct msgb *msg)
 	virt_l1_sched_schedule(ms, msg, fn_sched, timeslot, &virt_l1_sched_handler_cb);
 }
 
-void l1ctl_tx_traffic_ind(struct l1_model_ms *ms, struct msgb *msg, uint16_t arfcn, uint8_t link_id,
+void l1ctl_tx_traffic_ind(struct l1_model_ms *ms, const struct msgb *msg, uint16_t arfcn, uint8_t link_id,
 			  uint8_t chan_nr, uint32_t fn, uint8_t snr, uint8_t rxlev,
 			  uint8_t num_biterr, uint8_t fire_crc)
 {
-	struct msgb *l1ctl_msg = NULL;
-	struct l1ctl_traffic_ind * l1ti;
-	struct l1ctl_info_dl * l1dl;
-	uint8_t *frame;
-	int frame_len;
-	uint8_t rsl_chan_type, subchan, timeslot;
-	l1ctl_msg = l1ctl_msgb_alloc(L1CTL_TRAFFIC_IND);
-	l1dl = (struct l1ctl_info_dl *) msgb_put(l1ctl_msg, sizeof(*l1dl));
-	l1ti = (struct l1ctl_traffic_ind *) msgb_put(l1ctl_msg, sizeof(*l1ti));
-
-	rsl_dec_chan_nr(chan_nr, &rsl_chan_type, &subchan, &timeslot);
-
-	l1dl->band_arfcn = htons(arfcn);
-	l1dl->link_id = link_id;
-	l1dl->chan_nr = chan_nr;
-	l1dl->frame_nr = htonl(fn);
-	l1dl->snr = snr;
-	l1dl->rx_level = rxlev;
-	l1dl->num_biterr = 0; /* no biterrors */
-	l1dl->fire_crc = 0;
+	const struct l1ctl_info_dl l1dl = {
+		.band_arfcn = htons(arfcn),
+		.link_id = link_id,
+		.chan_nr = chan_nr,
+		.frame_nr = htonl(fn),
+		.snr = snr,
+		.rx_level = rxlev,
+		.num_biterr = 0, /* no biterrors */
+		.fire_crc = 0,
+	};
 
 	/* The first byte indicates the type of voice frame (enum gsmtap_um_voice_type),
 	 * which we simply ignore here and pass on the frame without that byte.
 	 * TODO: Check for consistency with ms->state.tch_mode ? */
-	frame_len = msgb_length(msg) - 1;
-	if (frame_len < 0) {
-		msgb_free(l1ctl_msg);
+	if (msgb_length(msg) < 1)
 		return;
-	}
-	frame = (uint8_t *) msgb_put(l1ctl_msg, frame_len);
-	memcpy(frame, msgb_data(msg)+1, frame_len);
 
 	DEBUGPMS(DL1P, ms, "Tx L1CTL_TRAFFIC_IND (chan_nr=0x%02x, link_id=0x%02x)\n", chan_nr, link_id);
-	l1ctl_sap_tx_to_l23_inst(ms, l1ctl_msg);
+	l1ctl_sap_tx_dl_to_l23_inst(ms, L1CTL_TRAFFIC_IND, &l1dl, msgb_data(msg) + 1,
+				    msgb_length(msg) - 1, 0);
 }
 
 /**
@@ -0,0 +1,371 @@
+/* Accelerated virtual time and fake BTS for Virtual Um regression tests
+ *
+ * Normally the time seen by virtphy (libosmocore timers, PM timeouts) is
+ * the wall clock, while its TDMA clock follows the frame numbers received
+ * from the BTS, so a scenario takes as long as it takes in the real world.
+ *
+ * Once virtual time is enabled, CLOCK_MONOTONIC (as seen through
+ * osmo_clock_gettime(), thus by the osmo timers) is overridden and only
+ * advances with the frame numbers of the Downlink frames: by 120/26 ms per
+ * TDMA frame.  The frames may then be sent as fast as the MS can process
+ * them, e.g. by the built-in fake BTS below, which generates the frames of
+ * a single cell in lock-step with the L1CTL clients: after a frame, each MS
+ * that was sent anything gets an L1CTL_ECHO_REQ, and the next frame is only
+ * generated once all of them have answered with an L1CTL_ECHO_CONF.  As
+ * L1CTL is a stream, whatever an l23 app sent in response to the frame has
+ * been received (and scheduled) by then.  Reactions deferred by the l23 apps
+ * (their timers follow the wall clock) are not covered by the barrier.
+ *
+ * The fake BTS only broadcasts a cell (BCCH and empty PCH blocks), it does
+ * not listen to the Uplink: an MS can synchronize, camp and measure, but a
+ * RACH is never answered, so there is no dedicated mode and no attach.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/gsmtap.h>
+#include <osmocom/gsm/gsm_utils.h>
+
+#include <osmocom/bb/virtphy/osmo_mcast_sock.h>
+#include <osmocom/bb/virtphy/gsmtapl1_if.h>
+#include <osmocom/bb/virtphy/l1ctl_sap.h>
+#include <osmocom/bb/virtphy/l1ctl_sock.h>
+#include <osmocom/bb/virtphy/logging.h>
+#include <osmocom/bb/virtphy/virt_time.h>
+
+static struct {
+	bool enabled;
+	/* whether a frame has been seen since virtual time was enabled */
+	bool started;
+	/* frame number of the last frame seen */
+	uint32_t last_fn;
+	/* number of TDMA frames elapsed since virtual time was enabled */
+	uint64_t num_frames;
+	/* (real) time at which virtual time was enabled */
+	struct timespec start;
+} vt;
+
+static struct {
+	struct virt_um_inst *vui;
+	struct l1ctl_sock_inst *lsi;
+	struct msgb *msg;
+	/* the L1CTL client sockets, see fake_bts_wait() */
+	struct pollfd *pfd;
+	unsigned int pfd_len;
+	uint16_t arfcn;
+	uint32_t fn;
+	/* System Information cycled on the BCCH */
+	uint8_t si[VIRT_TIME_FAKE_BTS_MAX_SI][GSM_MACBLOCK_LEN];
+	unsigned int num_si;
+} fake_bts;
+
+/* L2 fill frame (3GPP TS 44.006, section 5.4.2.3) */
+static const uint8_t fill_frame[GSM_MACBLOCK_LEN] = {
+	0x03, 0x03, 0x01, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+	0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+};
+
+/**
+ * @brief Enable virtual time: from now on the monotonic clock only advances with the frames.
+ */
+void virt_time_init(void)
+{
+	struct timespec *now;
+
+	/* start where the real clock is, so that nothing appears to be in the future */
+	osmo_clock_gettime(CLOCK_MONOTONIC, &vt.start);
+	osmo_clock_override_enable(CLOCK_MONOTONIC, true);
+	now = osmo_clock_override_gettimespec(CLOCK_MONOTONIC);
+	*now = vt.start;
+
+	vt.enabled = true;
+	vt.started = false;
+	vt.num_frames = 0;
+
+	LOGP(DVIRPHY, LOGL_NOTICE, "Virtual time enabled, the clock follows the Downlink frames\n");
+}
+
+/**
+ * @brief Advance virtual time to the given frame and run the expired timers.
+ *
+ * @param [in] fn frame number of the frame about to be processed.
+ *
+ * Called for each Downlink frame, before it is dispatched to the MS.  Several frames with
+ * the same frame number (other timeslots or ARFCNs) do not advance the clock, neither does
+ * a frame number going backwards (e.g. the BTS being restarted).
+ */
+void virt_time_frame(uint32_t fn)
+{
+	struct timespec *now;
+	uint64_t ns;
+	uint32_t delta;
+
+	if (!vt.enabled)
+		return;
+
+	if (!vt.started) {
+		vt.started = true;
+		vt.last_fn = fn;
+		return;
+	}
+
+	delta = GSM_TDMA_FN_SUB(fn, vt.last_fn);
+	if (delta == 0)
+		return;
+	vt.last_fn = fn;
+	if (delta > GSM_TDMA_HYPERFRAME / 2) {
+		LOGP(DVIRPHY, LOGL_NOTICE, "Virtual time: FN jumped back to %u, clock not advanced\n", fn);
+		return;
+	}
+
+	/* computed from the start, so that the rounding errors do not accumulate */
+	vt.num_frames += delta;
+	ns = vt.num_frames * VIRT_TIME_FN_DURATION_NUM_NS / VIRT_TIME_FN_DURATION_DEN;
+	now = osmo_clock_override_gettimespec(CLOCK_MONOTONIC);
+	now->tv_sec = vt.start.tv_sec + (vt.start.tv_nsec + ns) / 1000000000ULL;
+	now->tv_nsec = (vt.start.tv_nsec + ns) % 1000000000ULL;
+
+	/* fire the timers (e.g. pm.req.timer) that expired in the meantime, before the frame */
+	osmo_timers_prepare();
+	osmo_timers_update();
+}
+
+/* load the hex-encoded System Information messages (one per line) to be sent on the BCCH */
+static int fake_bts_load_si(const char *si_path)
+{
+	char line[256];
+	FILE *f;
+	int rc;
+
+	f = fopen(si_path, "r");
+	if (!f)
+		return -errno;
+
+	while (fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == '\0' || line[0] == '#')
+			continue;
+		if (fake_bts.num_si >= ARRAY_SIZE(fake_bts.si)) {
+			LOGP(DVIRPHY, LOGL_ERROR, "Fake BTS: too many System Information messages, "
+			     "only the first %zu are sent\n", ARRAY_SIZE(fake_bts.si));
+			break;
+		}
+
+		memcpy(fake_bts.si[fake_bts.num_si], fill_frame, GSM_MACBLOCK_LEN);
+		rc = osmo_hexparse(line, fake_bts.si[fake_bts.num_si], GSM_MACBLOCK_LEN);
+		if (rc < 0) {
+			LOGP(DVIRPHY, LOGL_ERROR, "Fake BTS: malformed System Information '%s'\n", line);
+			fclose(f);
+			return -EINVAL;
+		}
+		fake_bts.num_si++;
+	}
+
+	fclose(f);
+	return 0;
+}
+
+/**
+ * @brief Set up the fake BTS, enables virtual time.
+ *
+ * @param [in] vui the virtual Um instance, whose Downlink socket is no longer read.
+ * @param [in] lsi the L1CTL socket the MS are connected to.
+ * @param [in] arfcn the ARFCN of the cell.
+ * @param [in] si_path file containing the System Information to broadcast, may be NULL.
+ * @return 0 on success, negative errno otherwise.
+ */
+int virt_time_fake_bts_init(void *ctx, struct virt_um_inst *vui, struct l1ctl_sock_inst *lsi,
+			    uint16_t arfcn, const char *si_path)
+{
+	int rc;
+
+	if (si_path) {
+		rc = fake_bts_load_si(si_path);
+		if (rc < 0)
+			return rc;
+	}
+
+	fake_bts.msg = msgb_alloc(VIRT_UM_MSGB_SIZE, "Fake BTS");
+	if (!fake_bts.msg)
+		return -ENOMEM;
+	talloc_steal(ctx, fake_bts.msg);
+
+	/* the Downlink is generated here, frames from another BTS would only disturb */
+	osmo_fd_unregister(&vui->mcast_sock->rx_ofd);
+
+	fake_bts.vui = vui;
+	fake_bts.lsi = lsi;
+	fake_bts.arfcn = arfcn;
+	fake_bts.fn = 0;
+
+	virt_time_init();
+
+	LOGP(DVIRPHY, LOGL_NOTICE, "Fake BTS on ARFCN %u, %u System Information message(s)\n",
+	     arfcn, fake_bts.num_si);
+
+	return 0;
+}
+
+/* dispatch a Downlink block of the fake BTS to the MS, as if received on the virtual Um */
+static void fake_bts_tx(uint32_t fn, uint8_t chan_type, const uint8_t *data)
+{
+	struct msgb *msg = fake_bts.msg;
+	struct gsmtap_hdr *gh;
+
+	msgb_reset(msg);
+	gh = (struct gsmtap_hdr *)msgb_put(msg, sizeof(*gh));
+	*gh = (struct gsmtap_hdr) {
+		.version = GSMTAP_VERSION,
+		.hdr_len = sizeof(*gh) / 4,
+		.type = GSMTAP_TYPE_UM,
+		.timeslot = 0,
+		.arfcn = htons(fake_bts.arfcn),
+		.signal_dbm = -60,
+		.snr_db = 0,
+		.frame_number = htonl(fn),
+		.sub_type = chan_type,
+		.antenna_nr = 0,
+		.sub_slot = 0,
+	};
+	memcpy(msgb_put(msg, GSM_MACBLOCK_LEN), data, GSM_MACBLOCK_LEN);
+	msg->l1h = msgb_data(msg);
+
+	gsmtapl1_rx_from_virt_um_inst_cb(fake_bts.vui, msg);
+}
+
+/* generate the frame fn of a non-combined CCCH (BCCH + PCH/AGCH) on TS0 */
+static void fake_bts_frame(uint32_t fn)
+{
+	const unsigned int fn51 = fn % 51;
+
+	virt_time_frame(fn);
+
+	/* one GSMTAP message per block, sent with its first frame (as osmo-bts-virtual does) */
+	if (fn51 == 2) {
+		const uint8_t *si = fill_frame;
+
+		if (fake_bts.num_si > 0)
+			si = fake_bts.si[(fn / 51) % fake_bts.num_si];
+		fake_bts_tx(fn, GSMTAP_CHANNEL_BCCH, si);
+	} else if (fn51 >= 6 && fn51 < 50 && (fn51 % 10 == 2 || fn51 % 10 == 6)) {
+		fake_bts_tx(fn, GSMTAP_CHANNEL_PCH, fill_frame);
+	}
+}
+
+/* number of MS whose L1CTL_ECHO_CONF is still awaited */
+static unsigned int fake_bts_num_pending(void)
+{
+	struct l1ctl_sock_client *lsc;
+	unsigned int num = 0;
+
+	llist_for_each_entry(lsc, &fake_bts.lsi->clients, list) {
+		struct l1_model_ms *ms = lsc->priv;
+
+		if (ms->barrier.pending)
+			num++;
+	}
+
+	return num;
+}
+
+/* block until one of the L1CTL client sockets is readable, return 0 on timeout */
+static int fake_bts_wait(int timeout_ms)
+{
+	struct l1ctl_sock_client *lsc;
+	unsigned int n = 0;
+
+	llist_for_each_entry(lsc, &fake_bts.lsi->clients, list) {
+		if (n == fake_bts.pfd_len) {
+			fake_bts.pfd_len = fake_bts.pfd_len ? fake_bts.pfd_len * 2 : 16;
+			fake_bts.pfd = talloc_realloc(fake_bts.lsi, fake_bts.pfd, struct pollfd,
+						      fake_bts.pfd_len);
+			OSMO_ASSERT(fake_bts.pfd != NULL);
+		}
+		fake_bts.pfd[n++] = (struct pollfd) {
+			.fd = lsc->ofd.fd,
+			.events = POLLIN,
+		};
+	}
+
+	return poll(fake_bts.pfd, n, timeout_ms);
+}
+
+/* wait until each MS that was sent something during frame fn has processed it */
+static void fake_bts_barrier(uint32_t fn)
+{
+	struct l1ctl_sock_client *lsc;
+	struct l1_model_ms *ms;
+
+	llist_for_each_entry(lsc, &fake_bts.lsi->clients, list) {
+		ms = lsc->priv;
+		if (ms->barrier.num_tx != ms->barrier.num_tx_echo)
+			l1ctl_tx_echo_req(ms, fn);
+	}
+
+	while (fake_bts_num_pending() > 0) {
+		/* serve whatever is readable, including L1CTL_ECHO_CONF */
+		if (osmo_select_main(1) > 0)
+			continue;
+		if (fake_bts_wait(VIRT_TIME_FAKE_BTS_BARRIER_TIMEOUT_MS) > 0)
+			continue;
+
+		/* e.g. an l23 app not answering L1CTL_ECHO_REQ: don't wait forever */
+		llist_for_each_entry(lsc, &fake_bts.lsi->clients, list) {
+			ms = lsc->priv;
+			if (!ms->barrier.pending)
+				continue;
+			LOGPMS(DVIRPHY, LOGL_NOTICE, ms, "No L1CTL_ECHO_CONF for fn=%u "
+			       "within %u ms, not waiting for it\n", fn,
+			       VIRT_TIME_FAKE_BTS_BARRIER_TIMEOUT_MS);
+			ms->barrier.pending = false;
+		}
+	}
+}
+
+/**
+ * @brief Run the fake BTS, never returns.
+ *
+ * Replaces the osmo_select_main() loop of virtphy: frames are generated in lock-step with the
+ * MS (see fake_bts_barrier()), as fast as the l23 apps process them.  Nothing is generated
+ * (and virtual time stands still) while no MS is connected.
+ */
+void virt_time_fake_bts_run(void)
+{
+	while (1) {
+		if (llist_empty(&fake_bts.lsi->clients)) {
+			/* wait for an l23 app to connect */
+			osmo_select_main(0);
+			continue;
+		}
+
+		fake_bts_frame(fake_bts.fn);
+		fake_bts_barrier(fake_bts.fn);
+		fake_bts.fn = (fake_bts.fn + 1) % GSM_TDMA_HYPERFRAME;
+
+		/* new clients, their requests (e.g. FBSB_REQ) are served before the next frame */
+		while (osmo_select_main(1) > 0)
+			;
+	}
+}
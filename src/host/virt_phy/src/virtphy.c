@@ -21,12 +21,15 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <getopt.h>
 #include <errno.h>
 #include <signal.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
 
 #include <osmocom/core/msgb.h>
 #include <osmocom/core/select.h>
@@ -40,6 +43,7 @@
 #include <osmocom/bb/virtphy/gsmtapl1_if.h>
 #include <osmocom/bb/virtphy/logging.h>
 #include <osmocom/bb/virtphy/virt_l1_sched.h>
+#include <osmocom/bb/virtphy/virt_time.h>
 #include <osmocom/bb/l1gprs.h>
 
 #define DEFAULT_LOG_MASK "DL1C,2:DL1P,2:DVIRPHY,2:DGPRS,1:DMAIN,1"
@@ -64,6 +68,9 @@ static char *arfcn_sig_lev_red_mask = NULL;
 static char *pm_timeout = NULL;
 static char *mcast_netdev = NULL;
 static int mcast_ttl = -1;
+static bool virt_time = false;
+static int fake_bts_arfcn = -1;
+static char *fake_bts_si_path = NULL;
 
 static void print_usage(void)
 {
@@ -83,12 +90,18 @@ static void print_help(void)
 	printf("  -t --pm-timeout		power management timeout.\n");
 	printf("  -T --mcast-ttl TTL		set TTL of Virtual Um GSMTAP multicast frames\n");
 	printf("  -D --mcast-deav NETDEV	bind to given network device for Virtual Um\n");
+	printf("  -V --virt-time		timers follow the Downlink frame numbers, not the wall clock\n");
+	printf("  -B --fake-bts ARFCN		generate the Downlink of a cell, as fast as the MS allow (implies -V).\n");
+	printf("				Broadcast only: RACH is not answered, no dedicated mode/attach.\n");
+	printf("				The l23 apps must answer L1CTL_ECHO_REQ (per-frame barrier).\n");
+	printf("  -S --fake-bts-si FILE		System Information sent by the fake BTS (one hex message per line)\n");
 }
 
 static void handle_options(int argc, char **argv)
 {
 	while (1) {
 		int option_index = 0, c;
+		char *end;
 		static struct option long_options[] = {
 			{"help", 0, 0, 'h'},
 			{"dl-rx-grp", required_argument, 0, 'z'},
@@ -100,9 +113,12 @@ static void handle_options(int argc, char **argv)
 		        {"pm-timeout", required_argument, 0, 't'},
 			{"mcast-ttl", required_argument, 0, 'T'},
 			{"mcast-dev", required_argument, 0, 'D'},
+			{"virt-time", 0, 0, 'V'},
+			{"fake-bts", required_argument, 0, 'B'},
+			{"fake-bts-si", required_argument, 0, 'S'},
 		        {0, 0, 0, 0},
 		};
-		c = getopt_long(argc, argv, "hz:y:x:d:s:r:t:T:D:", long_options,
+		c = getopt_long(argc, argv, "hz:y:x:d:s:r:t:T:D:VB:S:", long_options,
 		                &option_index);
 		if (c == -1)
 			break;
@@ -139,30 +155,46 @@ static void handle_options(int argc, char **argv)
 		case 'D':
 			mcast_netdev = optarg;
 			break;
+		case 'V':
+			virt_time = true;
+			break;
+		case 'B':
+			fake_bts_arfcn = strtol(optarg, &end, 10);
+			if (*optarg == '\0' || *end != '\0' || fake_bts_arfcn < 0 || fake_bts_arfcn > 1023) {
+				fprintf(stderr, "Invalid ARFCN '%s' (0..1023)\n", optarg);
+				exit(1);
+			}
+			break;
+		case 'S':
+			fake_bts_si_path = optarg;
+			break;
 		default:
 			break;
 		}
 	}
 }
 
-void parse_pm_timeout(struct l1_model_ms *model, char *pm_timeout) {
+void parse_pm_timeout(char *pm_timeout) {
+	uint32_t timeout_s, timeout_us = 0;
 
 	if (!pm_timeout || (strcmp(pm_timeout, "") == 0))
 		return;
 
 	/* seconds */
 	char *buf = strtok(pm_timeout, ":");
-	model->state.pm.timeout_s = atoi(buf);
+	timeout_s = atoi(buf);
 	/* microseconds */
 	buf = strtok(NULL, ":");
 	if (buf)
-		model->state.pm.timeout_us = atoi(buf);
+		timeout_us = atoi(buf);
+
+	prim_pm_set_timeout(timeout_s, timeout_us);
 }
 
 /**
  * arfcn_sig_lev_red_mask has to be formatted like 666,12:888,43:176,22
  */
-void parse_arfcn_sig_lev_red(struct l1_model_ms *model, char * arfcn_sig_lev_red_mask) {
+void parse_arfcn_sig_lev_red(char * arfcn_sig_lev_red_mask) {
 
 	if (!arfcn_sig_lev_red_mask || (strcmp(arfcn_sig_lev_red_mask, "") == 0))
 		return;
@@ -183,7 +215,7 @@ void parse_arfcn_sig_lev_red(struct l1_model_ms *model, char * arfcn_sig_lev_red
 		red = atoi(colon + 1);
 
 		/* TODO: this may go wild if the token string is not properly formatted */
-		model->state.pm.meas.arfcn_sig_lev_red_dbm[arfcn] = red;
+		prim_pm_set_sig_lev_red(arfcn, red);
 	} while ((token = strtok(NULL, ":")));
 }
 
@@ -195,10 +227,6 @@ static int l1ctl_accept_cb(struct l1ctl_sock_client *lsc)
 	if (!ms)
 		return -ENOMEM;
 
-	/* apply timeout and arfcn reduction value config to model */
-	parse_pm_timeout(ms, pm_timeout);
-	parse_arfcn_sig_lev_red(ms, arfcn_sig_lev_red_mask);
-
 	lsc->priv = ms;
 
 	return 0;
@@ -212,6 +240,25 @@ static void l1ctl_close_cb(struct l1ctl_sock_client *lsc)
 
 static void *tall_vphy_ctx;
 
+/* each MS is an L1CTL connection, allow as many of them as permitted */
+static void raise_fd_limit(void)
+{
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur >= rl.rlim_max)
+		return;
+
+	rl.rlim_cur = rl.rlim_max;
+	if (setrlimit(RLIMIT_NOFILE, &rl) != 0) {
+		LOGP(DMAIN, LOGL_NOTICE, "Failed to raise the limit of open files: %s\n",
+		     strerror(errno));
+		return;
+	}
+
+	LOGP(DMAIN, LOGL_INFO, "Limit of open files (and thus MS) raised to %lu\n",
+	     (unsigned long)rl.rlim_cur);
+}
+
 static void signal_handler(int signum)
 {
 	LOGP(DMAIN, LOGL_NOTICE, "Signal %d received\n", signum);
@@ -229,8 +276,23 @@ static void signal_handler(int signum)
 	}
 }
 
+/* SIGUSR2 is delivered through a signalfd, so that the counters are logged
+ * from the select() loop instead of from within an asynchronous signal handler */
+static void signalfd_cb(struct osmo_signalfd *osfd, const struct signalfd_siginfo *fdsi)
+{
+	switch (fdsi->ssi_signo) {
+	case SIGUSR2:
+		gsmtapl1_dl_stats_log();
+		break;
+	default:
+		break;
+	}
+}
+
 int main(int argc, char *argv[])
 {
+	sigset_t sigset;
+
 	tall_vphy_ctx = talloc_named_const(NULL, 1, "root");
 
 	msgb_talloc_ctx_init(tall_vphy_ctx, 0);
@@ -238,6 +300,13 @@ int main(int argc, char *argv[])
 	signal(SIGTERM, &signal_handler);
 	signal(SIGUSR1, &signal_handler);
 	osmo_init_ignore_signals();
+	sigemptyset(&sigset);
+	sigaddset(&sigset, SIGUSR2);
+	sigprocmask(SIG_BLOCK, &sigset, NULL);
+	if (!osmo_signalfd_setup(tall_vphy_ctx, sigset, &signalfd_cb, NULL)) {
+		fprintf(stderr, "Failed to set up the signalfd\n");
+		exit(1);
+	}
 
 	/* init loginfo */
 	handle_options(argc, argv);
@@ -247,6 +316,13 @@ int main(int argc, char *argv[])
 
 	LOGP(DVIRPHY, LOGL_INFO, "Virtual physical layer starting up...\n");
 
+	/* apply timeout and arfcn reduction value config (shared by all MS) */
+	parse_pm_timeout(pm_timeout);
+	parse_arfcn_sig_lev_red(arfcn_sig_lev_red_mask);
+	raise_fd_limit();
+
+	gsmtapl1_init();
+
 	g_vphy.virt_um = virt_um_init(tall_vphy_ctx, ul_tx_grp, port, dl_rx_grp, port, mcast_ttl,
 					mcast_netdev, gsmtapl1_rx_from_virt_um_inst_cb);
 
@@ -257,6 +333,18 @@ int main(int argc, char *argv[])
 	LOGP(DVIRPHY, LOGL_INFO, "Virtual physical layer ready, waiting for l23 app(s) on %s\n",
 	     l1ctl_sock_path);
 
+	if (fake_bts_arfcn >= 0) {
+		if (virt_time_fake_bts_init(tall_vphy_ctx, g_vphy.virt_um, g_vphy.l1ctl_sock,
+					    fake_bts_arfcn, fake_bts_si_path) < 0) {
+			LOGP(DVIRPHY, LOGL_FATAL, "Failed to set up the fake BTS\n");
+			exit(1);
+		}
+		/* accelerated mode: frames are generated in lock-step with the MS */
+		virt_time_fake_bts_run();
+	} else if (virt_time) {
+		virt_time_init();
+	}
+
 	while (1) {
 		/* handle osmocom fd READ events (l1ctl-unix-socket, virtual-um-mcast-socket) */
 		osmo_select_main(0);